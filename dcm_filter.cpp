@@ -0,0 +1,257 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  dcm_filter.cpp
+ * @brief DCM filter implementation.
+ */
+
+#include "dcm_filter.h"
+#include "quaternion.h"
+
+/**
+ * @brief   Default constructor.
+ * @details Initializes the filter to a known state. The estimate starts at
+ *          the identity with no gyroscope bias, a proportional gain of
+ *          1 rad/s per radian of error, an integral gain of 0.02 and equal
+ *          weight on gravity and heading.
+ */
+DCMFilter::DCMFilter() :
+    FeedbackFilter(1.0f, 0.02f)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            R[i][j] = (i == j) ? 1.0f : 0.0f;
+        }
+    }
+}
+
+/**
+ * @brief   Aligns the estimated orientation with gravity.
+ * @details Sets the estimated orientation directly from a single
+ *          accelerometer measurement, taken while the sensor is not
+ *          accelerating. The heading is left at zero.
+ * @post    The estimated orientation is replaced.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ */
+void DCMFilter::align(float ax, float ay, float az)
+{
+    levelOrientation(ax, ay, az).convertToRotationMatrix(R);
+}
+
+/**
+ * @brief   Aligns the estimated orientation with gravity and magnetic north.
+ * @details Sets the estimated orientation directly from a single
+ *          accelerometer and magnetometer measurement, taken while the sensor
+ *          is not accelerating.
+ * @post    The estimated orientation is replaced.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void DCMFilter::align(float ax, float ay, float az,
+                      float mx, float my, float mz)
+{
+    headingOrientation(ax, ay, az, mx, my, mz).convertToRotationMatrix(R);
+}
+
+/**
+ * @brief   Gets the estimated direction cosine matrix.
+ * @details Row @e i holds earth axis @e i in the sensor frame, so the bottom
+ *          row is the direction of gravity as the accelerometer should
+ *          measure it.
+ *
+ * @param[out] m The matrix rotating the sensor frame into the earth frame,
+ *               indexed by row then column.
+ */
+void DCMFilter::matrix(float m[3][3]) const
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            m[i][j] = R[i][j];
+        }
+    }
+}
+
+/**
+ * @brief   Gets the current estimated orientation.
+ * @details Converts the direction cosine matrix to a quaternion. The
+ *          conversion is only done here, so updates do not pay for it.
+ *
+ * @return The most current estimated orientation quaternion.
+ */
+Quaternion DCMFilter::orientation() const
+{
+    return Quaternion::fromRotationMatrix(R);
+}
+
+/**
+ * @brief   Sets the estimated orientation.
+ * @details Replaces the direction cosine matrix with the rotation of a
+ *          quaternion. The gyroscope bias estimate is kept.
+ *
+ * @param[in] q The new orientation. It is normalized before being used.
+ */
+void DCMFilter::setOrientation(const Quaternion &q)
+{
+    q.normalized().convertToRotationMatrix(R);
+}
+
+/**
+ * @brief   Updates estimated orientation.
+ * @details Executes the filter algorithm with gravity as the only reference,
+ *          so the heading drifts with the gyroscope.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @pre     The proper units must be used for the input parameters.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in] wx The gyroscope X axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wy The gyroscope Y axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wz The gyroscope Z axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ */
+void DCMFilter::update(float wx, float wy, float wz,
+                       float ax, float ay, float az)
+{
+    const uint32_t started = updateStarted();
+
+    float error[3];
+    gravityError(ax, ay, az, R[2], error);
+    integrate(wx, wy, wz, error);
+
+    updateFinished(started);
+}
+
+/**
+ * @brief   Updates estimated orientation.
+ * @details Executes the filter algorithm with gravity and magnetic north as
+ *          references. Only the horizontal direction of the magnetic flux is
+ *          used, and only to correct the heading.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @pre     The proper units must be used for the input parameters.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in] wx The gyroscope X axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wy The gyroscope Y axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wz The gyroscope Z axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void DCMFilter::update(float wx, float wy, float wz,
+                       float ax, float ay, float az,
+                       float mx, float my, float mz)
+{
+    const uint32_t started = updateStarted();
+
+    float error[3];
+    gravityError(ax, ay, az, R[2], error);
+
+    // Rotate the magnetic flux into the horizontal plane of the earth frame
+    const float hx = (R[0][0] * mx) + (R[0][1] * my) + (R[0][2] * mz);
+    const float hy = (R[1][0] * mx) + (R[1][1] * my) + (R[1][2] * mz);
+    headingError(hx, hy, R[2], error);
+    integrate(wx, wy, wz, error);
+
+    updateFinished(started);
+}
+
+/**
+ * @brief   Integrates the corrected gyroscope rates.
+ * @details Passes the error through the proportional plus integral
+ *          controller, adds the result to the gyroscope rates and rotates the
+ *          matrix by them over one time step. Rounding slowly breaks the
+ *          orthogonality of the matrix, so it is then renormalized: half the
+ *          dot product of the first two rows is removed from each of them,
+ *          the third row is replaced by their cross product and every row is
+ *          scaled back to unit length with a first order approximation of
+ *          the inverse square root.
+ *
+ * @param[in] wx    The gyroscope X axis measurement in rad/s.
+ * @param[in] wy    The gyroscope Y axis measurement in rad/s.
+ * @param[in] wz    The gyroscope Z axis measurement in rad/s.
+ * @param[in] error The error against the references in radians.
+ */
+void DCMFilter::integrate(float wx, float wy, float wz, const float error[3])
+{
+    // Proportional plus integral correction of the gyroscope rates
+    feedback(wx, wy, wz, error);
+    const float dx = wx * sampleRate;
+    const float dy = wy * sampleRate;
+    const float dz = wz * sampleRate;
+
+    // Rotate the matrix, R = R (I + [d]x)
+    for (int i = 0; i < 3; ++i)
+    {
+        const float r0 = R[i][0];
+        const float r1 = R[i][1];
+        const float r2 = R[i][2];
+        R[i][0] = r0 + (r1 * dz) - (r2 * dy);
+        R[i][1] = r1 + (r2 * dx) - (r0 * dz);
+        R[i][2] = r2 + (r0 * dy) - (r1 * dx);
+    }
+
+    // Share the orthogonality error of the first two rows between them
+    const float half_error = 0.5f * ((R[0][0] * R[1][0]) + (R[0][1] * R[1][1]) + (R[0][2] * R[1][2]));
+    float X[3], Y[3], Z[3];
+    for (int j = 0; j < 3; ++j)
+    {
+        X[j] = R[0][j] - (half_error * R[1][j]);
+        Y[j] = R[1][j] - (half_error * R[0][j]);
+    }
+    Z[0] = (X[1] * Y[2]) - (X[2] * Y[1]);
+    Z[1] = (X[2] * Y[0]) - (X[0] * Y[2]);
+    Z[2] = (X[0] * Y[1]) - (X[1] * Y[0]);
+
+    // Scale each row back to unit length
+    const float sx = 0.5f * (3.0f - ((X[0] * X[0]) + (X[1] * X[1]) + (X[2] * X[2])));
+    const float sy = 0.5f * (3.0f - ((Y[0] * Y[0]) + (Y[1] * Y[1]) + (Y[2] * Y[2])));
+    const float sz = 0.5f * (3.0f - ((Z[0] * Z[0]) + (Z[1] * Z[1]) + (Z[2] * Z[2])));
+    for (int j = 0; j < 3; ++j)
+    {
+        R[0][j] = sx * X[j];
+        R[1][j] = sy * Y[j];
+        R[2][j] = sz * Z[j];
+    }
+}
@@ -0,0 +1,66 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  dcm_filter.h
+ * @brief Direction cosine matrix (DCM) filter class.
+ */
+
+#ifndef DCM_FILTER_H
+#define DCM_FILTER_H
+
+#include "feedback_filter.h"
+
+/**
+ * @brief   DCM filter.
+ * @details Filter for computing an orientation which keeps its estimate as a
+ *          direction cosine matrix rather than a quaternion. The gyroscope
+ *          rotates the matrix, which is kept orthonormal by renormalization,
+ *          and a proportional plus integral controller feeds the error against
+ *          gravity, and optionally magnetic north, back into the gyroscope
+ *          rates. The integral term estimates the gyroscope bias. Based on
+ *          the DCM IMU by W. Premerlani and P. Bizard.
+ */
+class DCMFilter : public FeedbackFilter
+{
+public:
+    DCMFilter();
+    void align(float ax, float ay, float az);
+    void align(float ax, float ay, float az,
+               float mx, float my, float mz);
+    void matrix(float m[3][3]) const;
+    Quaternion orientation() const;
+    void setOrientation(const Quaternion &q);
+    void update(float wx, float wy, float wz,
+                float ax, float ay, float az);
+    void update(float wx, float wy, float wz,
+                float ax, float ay, float az,
+                float mx, float my, float mz);
+
+private:
+    void integrate(float wx, float wy, float wz, const float error[3]);
+
+    float R[3][3]; /**< Estimated orientation, rotating the sensor frame into
+                        the earth frame */
+};
+
+#endif // DCM_FILTER_H
@@ -0,0 +1,252 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  delta_integrator.cpp
+ * @brief Delta integrator implementation.
+ */
+
+#include "delta_integrator.h"
+#include "quaternion.h"
+
+/**
+ * @brief   Default constructor.
+ * @details Starts an empty interval with no previous increment and a period
+ *          of zero, which must be set before duration() or rates() are used.
+ */
+DeltaIntegrator::DeltaIntegrator() :
+    period(0.0f),
+    increments(0)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        lastAngle[i] = 0.0f;
+        lastVelocity[i] = 0.0f;
+    }
+    reset();
+}
+
+/**
+ * @brief   Adds one pair of increments.
+ * @details Accumulates the increments along with the coning and sculling
+ *          corrections between them and the increments before,
+ * @f[
+ *   \beta \mathrel{+}= \tfrac{1}{2}\left(\alpha + \tfrac{1}{6}\Delta\alpha_{-1}\right)
+ *       \times \Delta\alpha
+ * @f]
+ *          and similarly for the velocity.
+ *
+ * @param[in] tx The X axis angle increment in rad.
+ * @param[in] ty The Y axis angle increment in rad.
+ * @param[in] tz The Z axis angle increment in rad.
+ * @param[in] vx The X axis velocity increment.
+ * @param[in] vy The Y axis velocity increment.
+ * @param[in] vz The Z axis velocity increment.
+ * @return       The number of increments in the interval.
+ */
+size_t DeltaIntegrator::add(float tx, float ty, float tz,
+                            float vx, float vy, float vz)
+{
+    // The sums so far, each with a sixth of the previous increment
+    const float cx = alpha[0] + (lastAngle[0] / 6.0f);
+    const float cy = alpha[1] + (lastAngle[1] / 6.0f);
+    const float cz = alpha[2] + (lastAngle[2] / 6.0f);
+    const float dx = nu[0] + (lastVelocity[0] / 6.0f);
+    const float dy = nu[1] + (lastVelocity[1] / 6.0f);
+    const float dz = nu[2] + (lastVelocity[2] / 6.0f);
+
+    beta[0] += 0.5f * ((cy * tz) - (cz * ty));
+    beta[1] += 0.5f * ((cz * tx) - (cx * tz));
+    beta[2] += 0.5f * ((cx * ty) - (cy * tx));
+
+    sculling[0] += 0.5f * ((cy * vz) - (cz * vy) + (dy * tz) - (dz * ty));
+    sculling[1] += 0.5f * ((cz * vx) - (cx * vz) + (dz * tx) - (dx * tz));
+    sculling[2] += 0.5f * ((cx * vy) - (cy * vx) + (dx * ty) - (dy * tx));
+
+    alpha[0] += tx;
+    alpha[1] += ty;
+    alpha[2] += tz;
+    nu[0] += vx;
+    nu[1] += vy;
+    nu[2] += vz;
+
+    lastAngle[0] = tx;
+    lastAngle[1] = ty;
+    lastAngle[2] = tz;
+    lastVelocity[0] = vx;
+    lastVelocity[1] = vy;
+    lastVelocity[2] = vz;
+    return ++increments;
+}
+
+/**
+ * @brief   Adds a burst of increments.
+ * @details As if add() was called for each, for a buffer read from a FIFO in
+ *          one go.
+ *
+ * @param[in] buffer The increments, each the three angle axes in rad
+ *                   followed by the three velocity axes.
+ * @param[in] count  The number of increments.
+ * @return           The number of increments in the interval.
+ */
+size_t DeltaIntegrator::add(const float *buffer, const size_t count)
+{
+    for (size_t i = 0; i < count; ++i, buffer += 6)
+    {
+        add(buffer[0], buffer[1], buffer[2], buffer[3], buffer[4], buffer[5]);
+    }
+    return increments;
+}
+
+/**
+ * @brief   Gets the number of increments in the interval.
+ *
+ * @return The number of increments added since the last reset().
+ */
+size_t DeltaIntegrator::count() const
+{
+    return increments;
+}
+
+/**
+ * @brief   Gets the length of the interval.
+ *
+ * @return The time covered by the increments in seconds.
+ */
+float DeltaIntegrator::duration() const
+{
+    return increments * period;
+}
+
+/**
+ * @brief   Gets the interval as rates for a filter update.
+ * @details The gyroscope rates are the compensated rotation spread evenly
+ *          over duration(), so a filter with that sample rate and the
+ *          exponential integrator turns by exactly the rotation. The
+ *          accelerometer values are the mean specific force, rotated into
+ *          the sensor frame at the end of the interval where the filter
+ *          applies its correction. They are in the units of the velocity
+ *          increments per second, which the filters do not mind as they only
+ *          use the direction. An empty interval gives zeros.
+ *
+ * @param[out] wx The gyroscope X axis rate in rad/s.
+ * @param[out] wy The gyroscope Y axis rate in rad/s.
+ * @param[out] wz The gyroscope Z axis rate in rad/s.
+ * @param[out] ax The X axis mean specific force.
+ * @param[out] ay The Y axis mean specific force.
+ * @param[out] az The Z axis mean specific force.
+ */
+void DeltaIntegrator::rates(float &wx, float &wy, float &wz,
+                            float &ax, float &ay, float &az) const
+{
+    const float time = duration();
+    if (time <= 0.0f)
+    {
+        wx = wy = wz = 0.0f;
+        ax = ay = az = 0.0f;
+        return;
+    }
+
+    float x, y, z;
+    rotation(x, y, z);
+    wx = x / time;
+    wy = y / time;
+    wz = z / time;
+
+    float v[3];
+    velocity(v[0], v[1], v[2]);
+    const Quaternion q = Quaternion::fromRotationVector(x, y, z);
+    const Quaternion a = q.conjugate() * Quaternion(0.0f, v[0], v[1], v[2]) * q;
+    ax = a.x / time;
+    ay = a.y / time;
+    az = a.z / time;
+}
+
+/**
+ * @brief   Starts a new interval.
+ * @details Clears the sums but keeps the last increments, which the
+ *          corrections of the next increment still use.
+ */
+void DeltaIntegrator::reset()
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        alpha[i] = 0.0f;
+        beta[i] = 0.0f;
+        nu[i] = 0.0f;
+        sculling[i] = 0.0f;
+    }
+    increments = 0;
+}
+
+/**
+ * @brief   Gets the rotation over the interval.
+ * @details The sum of the angle increments plus the coning correction, a
+ *          rotation vector from the sensor frame at the end of the interval
+ *          to the one at the start.
+ *
+ * @param[out] x The X axis of the rotation vector in rad.
+ * @param[out] y The Y axis of the rotation vector in rad.
+ * @param[out] z The Z axis of the rotation vector in rad.
+ */
+void DeltaIntegrator::rotation(float &x, float &y, float &z) const
+{
+    x = alpha[0] + beta[0];
+    y = alpha[1] + beta[1];
+    z = alpha[2] + beta[2];
+}
+
+/**
+ * @brief   Sets the increment period.
+ * @details The time each increment covers, the inverse of the output data
+ *          rate of the sensor.
+ * @pre     The @p period should be greater than zero, otherwise this
+ *          function does nothing.
+ *
+ * @param[in] period The period in seconds.
+ */
+void DeltaIntegrator::setPeriod(const float period)
+{
+    if (period > 0.0f)
+    {
+        this->period = period;
+    }
+}
+
+/**
+ * @brief   Gets the velocity change over the interval.
+ * @details The sum of the velocity increments with the rotation and sculling
+ *          corrections, in the sensor frame at the start of the interval.
+ * @f[
+ *   \Delta v = \nu + \tfrac{1}{2}\,\alpha \times \nu + \Delta v_{scul}
+ * @f]
+ *
+ * @param[out] x The X axis velocity change.
+ * @param[out] y The Y axis velocity change.
+ * @param[out] z The Z axis velocity change.
+ */
+void DeltaIntegrator::velocity(float &x, float &y, float &z) const
+{
+    x = nu[0] + (0.5f * ((alpha[1] * nu[2]) - (alpha[2] * nu[1]))) + sculling[0];
+    y = nu[1] + (0.5f * ((alpha[2] * nu[0]) - (alpha[0] * nu[2]))) + sculling[1];
+    z = nu[2] + (0.5f * ((alpha[0] * nu[1]) - (alpha[1] * nu[0]))) + sculling[2];
+}
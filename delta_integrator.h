@@ -0,0 +1,77 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  delta_integrator.h
+ * @brief Coning and sculling compensated integrator of sensor increments.
+ */
+
+#ifndef DELTA_INTEGRATOR_H
+#define DELTA_INTEGRATOR_H
+
+#include <stddef.h>
+
+/**
+ * @brief   Delta integrator class.
+ * @details Accumulates the delta-angle and delta-velocity increments which
+ *          many IMUs provide through their FIFOs at a high rate into one
+ *          interval for a filter update at a lower rate. Simply summing the
+ *          increments loses the rotation of the sensor within the interval,
+ *          which under vibration shows up as a steady drift. The coning
+ *          correction restores it for the rotation and the sculling
+ *          correction for the velocity, using the previous increment as in
+ *          the algorithms by P. G. Savage.
+ *
+ *          The result can be passed to any filter as an equivalent constant
+ *          rate over duration(). Filters reproduce the rotation exactly with
+ *          the exponential integrator.
+ */
+class DeltaIntegrator
+{
+public:
+    DeltaIntegrator();
+    size_t add(float tx, float ty, float tz,
+               float vx, float vy, float vz);
+    size_t add(const float *buffer, const size_t count);
+    size_t count() const;
+    float duration() const;
+    void rates(float &wx, float &wy, float &wz,
+               float &ax, float &ay, float &az) const;
+    void reset();
+    void rotation(float &x, float &y, float &z) const;
+    void setPeriod(const float period);
+    void velocity(float &x, float &y, float &z) const;
+
+private:
+    float alpha[3];        /**< Sum of the angle increments in rad */
+    float beta[3];         /**< Coning correction in rad */
+    float nu[3];           /**< Sum of the velocity increments */
+    float sculling[3];     /**< Sculling correction */
+    float lastAngle[3];    /**< Previous angle increment, kept across
+                                intervals */
+    float lastVelocity[3]; /**< Previous velocity increment, kept across
+                                intervals */
+    float period;          /**< Time covered by each increment in seconds */
+    size_t increments;     /**< Number of increments in the interval */
+};
+
+#endif // DELTA_INTEGRATOR_H
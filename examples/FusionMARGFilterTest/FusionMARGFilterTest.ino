@@ -12,6 +12,7 @@ located in Fusion/processing/Orientation/Orientation.pde.
 // Fusion library includes
 #include <marg_filter.h>
 #include <quaternion.h>
+#include <sensor_format.h>
 
 // Helper macros
 #define DPS_TO_RADS(n) (n * 0.017453293f)
@@ -31,8 +32,9 @@ unsigned long time_last = 0;
 #define LSM9DS0_G  (0x6B)
 LSM9DS0 marg(MODE_I2C, LSM9DS0_G, LSM9DS0_XM);
 
-// The filter we will use
+// The filter we will use, and the layout of the raw sensor readings
 MARGFilter filter;
+SensorFormat format;
 
 void setup() {
   Serial.begin(115200);
@@ -43,6 +45,17 @@ void setup() {
     while (true);
   }
   
+  // Describe the raw readings so that the filter converts them itself. The
+  // records are packed in the order gyroscope, accelerometer, magnetometer.
+  for (int i = 0; i < 3; ++i) {
+    format.setAxis((SensorFormat::Axis)(SensorFormat::GYRO_X + i), i,
+                   DPS_TO_RADS(marg.calcGyro(1)), 0.0f);
+    format.setAxis((SensorFormat::Axis)(SensorFormat::ACCEL_X + i), 3 + i,
+                   marg.calcAccel(1), 0.0f);
+    format.setAxis((SensorFormat::Axis)(SensorFormat::MAG_X + i), 6 + i,
+                   marg.calcMag(1), 0.0f);
+  }
+  
   // Set known error values
   filter.setGyroErrorGain(error);
   filter.setGyroDriftGain(drift);
@@ -68,16 +81,11 @@ void loop() {
   filter.setSampleRate((float)(time_now - time_last) / 1000.0f);
   time_last = time_now;
   
-  // Process the sensor data
-  filter.update(DPS_TO_RADS(marg.calcGyro(marg.gx)),
-                DPS_TO_RADS(marg.calcGyro(marg.gy)),
-                DPS_TO_RADS(marg.calcGyro(marg.gz)),
-                marg.calcAccel(marg.ax),
-                marg.calcAccel(marg.ay),
-                marg.calcAccel(marg.az),
-                marg.calcMag(marg.mx),
-                marg.calcMag(marg.my),
-                marg.calcMag(marg.mz));
+  // Process the raw sensor data
+  const int16_t record[9] = { marg.gx, marg.gy, marg.gz,
+                              marg.ax, marg.ay, marg.az,
+                              marg.mx, marg.my, marg.mz };
+  filter.update(record, format);
   Quaternion q = filter.orientation();
   
   // Reenable interrupts
@@ -0,0 +1,127 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  feedback_filter.cpp
+ * @brief Feedback filter implementation.
+ */
+
+#include "feedback_filter.h"
+
+/**
+ * @brief   Constructor.
+ * @details Initializes the controller with the default gains of the filter,
+ *          no gyroscope bias estimate and equal weight on gravity and
+ *          heading.
+ *
+ * @param[in] proportional The proportional gain.
+ * @param[in] integral     The integral gain.
+ */
+FeedbackFilter::FeedbackFilter(const float proportional, const float integral) :
+    Filter(),
+    kp(proportional),
+    ki(integral),
+    headingWeight(1.0f)
+{
+    omega_I[0] = 0.0f;
+    omega_I[1] = 0.0f;
+    omega_I[2] = 0.0f;
+}
+
+/**
+ * @brief   Destructor.
+ * @details This is an abstract destructor which prevents this class from being
+ *          used directly.
+ */
+FeedbackFilter::~FeedbackFilter()
+{
+}
+
+/**
+ * @brief   Gets the estimated gyroscope bias.
+ * @details The bias is what the integral term has learned to subtract from
+ *          the gyroscope rates. It only converges for axes the references
+ *          observe, so without a magnetometer the bias about the vertical is
+ *          not estimated.
+ *
+ * @param[out] bx The X axis bias in rad/s.
+ * @param[out] by The Y axis bias in rad/s.
+ * @param[out] bz The Z axis bias in rad/s.
+ */
+void FeedbackFilter::gyroBias(float &bx, float &by, float &bz) const
+{
+    bx = -omega_I[0];
+    by = -omega_I[1];
+    bz = -omega_I[2];
+}
+
+/**
+ * @brief   Sets the weight of the heading error.
+ * @details Scales the magnetometer heading error before it is added to the
+ *          gravity error and passed through the controller. Larger weights
+ *          lock onto magnetic north faster at the cost of more magnetometer
+ *          noise in the heading. Zero ignores the magnetometer.
+ *
+ * @param[in] weight The weight relative to the gravity error.
+ */
+void FeedbackFilter::setHeadingWeight(const float weight)
+{
+    if (weight >= 0.0f)
+    {
+        headingWeight = weight;
+    }
+}
+
+/**
+ * @brief   Sets the integral gain.
+ * @details The integral of the error is added to the gyroscope rates, which
+ *          cancels a constant gyroscope bias. Larger gains track a changing
+ *          bias faster but overshoot more, and zero disables bias estimation.
+ *
+ * @param[in] gain The gain in @f$\frac{\text{rad}}{\text{s}^{2}}@f$ per
+ *                 radian of error.
+ */
+void FeedbackFilter::setIntegralGain(const float gain)
+{
+    if (gain >= 0.0f)
+    {
+        ki = gain;
+    }
+}
+
+/**
+ * @brief   Sets the proportional gain.
+ * @details The error, scaled by this gain, is added to the gyroscope rates.
+ *          It sets how fast the estimate is pulled onto the references, and
+ *          takes the place of the gyroscope error gain, which these filters
+ *          do not use.
+ *
+ * @param[in] gain The gain in @f$\frac{\text{rad}}{\text{s}}@f$ per radian of
+ *                 error.
+ */
+void FeedbackFilter::setProportionalGain(const float gain)
+{
+    if (gain >= 0.0f)
+    {
+        kp = gain;
+    }
+}
@@ -0,0 +1,154 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  feedback_filter.h
+ * @brief Abstract class for filters with proportional plus integral
+ *        feedback.
+ */
+
+#ifndef FEEDBACK_FILTER_H
+#define FEEDBACK_FILTER_H
+
+#include <math.h>
+#include "filter.h"
+
+/**
+ * @brief   Feedback filter class.
+ * @details Common part of the filters which feed the error of each measured
+ *          reference direction against its estimate back into the gyroscope
+ *          rates through a proportional plus integral controller, after
+ *          R. Mahony, T. Hamel and J.-M. Pflimlin. The integral term
+ *          estimates the gyroscope bias. The errors are computed from rows of
+ *          the estimated rotation matrix, so the same terms serve filters
+ *          which keep a quaternion and those which keep a matrix.
+ */
+class FeedbackFilter : public Filter
+{
+public:
+    FeedbackFilter(const float proportional, const float integral);
+    virtual ~FeedbackFilter() = 0;
+    void gyroBias(float &bx, float &by, float &bz) const;
+    void setHeadingWeight(const float weight);
+    void setIntegralGain(const float gain);
+    void setProportionalGain(const float gain);
+
+protected:
+    void feedback(float &wx, float &wy, float &wz, const float error[3]);
+    static void gravityError(float ax, float ay, float az,
+                             const float vertical[3], float error[3]);
+    void headingError(const float hx, const float hy,
+                      const float vertical[3], float error[3]) const;
+
+    float kp;            /**< Proportional gain */
+    float ki;            /**< Integral gain */
+    float headingWeight; /**< Weight of the heading error against the
+                              gravity error */
+    float omega_I[3];    /**< Integral of the error, which converges to the
+                              negated gyroscope bias */
+};
+
+/**
+ * @brief   Applies the controller to the gyroscope rates.
+ * @details Adds the proportional and integral terms of the error to the
+ *          gyroscope rates, ready to be integrated over one time step.
+ *          Inline so that the per sample loops of the burst updates compile
+ *          to a single kernel.
+ *
+ * @param[in,out] wx    The gyroscope X axis rate in rad/s.
+ * @param[in,out] wy    The gyroscope Y axis rate in rad/s.
+ * @param[in,out] wz    The gyroscope Z axis rate in rad/s.
+ * @param[in]     error The error against the references in radians.
+ */
+inline void FeedbackFilter::feedback(float &wx, float &wy, float &wz,
+                                     const float error[3])
+{
+    omega_I[0] += ki * error[0] * sampleRate;
+    omega_I[1] += ki * error[1] * sampleRate;
+    omega_I[2] += ki * error[2] * sampleRate;
+    wx += (kp * error[0]) + omega_I[0];
+    wy += (kp * error[1]) + omega_I[1];
+    wz += (kp * error[2]) + omega_I[2];
+}
+
+/**
+ * @brief   Computes the gravity error.
+ * @details The cross product of the measured direction of gravity with the
+ *          direction the estimate predicts, the bottom row of its rotation
+ *          matrix. It is the rotation, in the sensor frame, which brings the
+ *          estimate onto the measurement. A zero measurement gives no error.
+ *
+ * @param[in]  ax       The accelerometer X axis measurement.
+ * @param[in]  ay       The accelerometer Y axis measurement.
+ * @param[in]  az       The accelerometer Z axis measurement.
+ * @param[in]  vertical The earth Z axis in the sensor frame.
+ * @param[out] error    The error in radians.
+ */
+inline void FeedbackFilter::gravityError(float ax, float ay, float az,
+                                         const float vertical[3],
+                                         float error[3])
+{
+    const float n = sqrt((ax * ax) + (ay * ay) + (az * az));
+    if (0.0f == n)
+    {
+        error[0] = error[1] = error[2] = 0.0f;
+        return;
+    }
+    ax /= n;
+    ay /= n;
+    az /= n;
+    error[0] = (ay * vertical[2]) - (az * vertical[1]);
+    error[1] = (az * vertical[0]) - (ax * vertical[2]);
+    error[2] = (ax * vertical[1]) - (ay * vertical[0]);
+}
+
+/**
+ * @brief   Adds the heading error.
+ * @details The sine of the heading error is the cross product of the
+ *          horizontal direction of the measured flux, rotated into the earth
+ *          frame, with the earth X axis. It only has a vertical component,
+ *          which maps back into the sensor frame along the vertical, so a
+ *          disturbed magnetic field can turn the heading but not tilt the
+ *          estimate, and the gain does not depend on the magnetic dip. The
+ *          error is scaled by the heading weight. A zero horizontal flux
+ *          adds nothing.
+ *
+ * @param[in]     hx       The earth X axis component of the flux.
+ * @param[in]     hy       The earth Y axis component of the flux.
+ * @param[in]     vertical The earth Z axis in the sensor frame.
+ * @param[in,out] error    The error in radians, added to.
+ */
+inline void FeedbackFilter::headingError(const float hx, const float hy,
+                                         const float vertical[3],
+                                         float error[3]) const
+{
+    const float h = sqrt((hx * hx) + (hy * hy));
+    if (h > 0.0f)
+    {
+        const float course = -headingWeight * hy / h;
+        error[0] += vertical[0] * course;
+        error[1] += vertical[1] * course;
+        error[2] += vertical[2] * course;
+    }
+}
+
+#endif // FEEDBACK_FILTER_H
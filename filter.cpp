@@ -29,6 +29,21 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <math.h>
 #include "filter.h"
 
+namespace
+{
+
+// Derivative of a rotation p, scalar part first, turning at the rate omega:
+// half of p * omega with omega taken as a pure quaternion
+inline void rateDerivative(const float p[4], const float omega[3], float d[4])
+{
+    d[0] = -0.5f * ((p[1] * omega[0]) + (p[2] * omega[1]) + (p[3] * omega[2]));
+    d[1] = 0.5f * ((p[0] * omega[0]) + (p[2] * omega[2]) - (p[3] * omega[1]));
+    d[2] = 0.5f * ((p[0] * omega[1]) + (p[3] * omega[0]) - (p[1] * omega[2]));
+    d[3] = 0.5f * ((p[0] * omega[2]) + (p[1] * omega[1]) - (p[2] * omega[0]));
+}
+
+} // namespace
+
 const Quaternion Filter::Eg_hat = Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
 
 /**
@@ -38,7 +53,16 @@ const Quaternion Filter::Eg_hat = Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
 Filter::Filter() :
     SEq_hat(Quaternion()),
     beta(1.0f),
-    sampleRate(0.0f)
+    sampleRate(0.0f),
+    integrator(INTEGRATOR_EULER),
+    previousRateSet(false),
+#ifdef FUSION_LATENCY
+    updateHistogram(0),
+    latencyHistogram(0),
+    arrival(0),
+    arrived(false),
+#endif
+    burstSkipped(0)
 {
 }
 
@@ -54,7 +78,8 @@ Filter::~Filter()
 /**
  * @brief   Gets the current estimated orientation.
  * @details Gets the orientation which was most recently computed in a filter
- *          update.
+ *          update. Filters which keep their estimate in another form
+ *          override this to convert it.
  *
  * @return The most current estimated orientation quaternion.
  */
@@ -63,6 +88,34 @@ Quaternion Filter::orientation() const
     return SEq_hat;
 }
 
+#ifdef FUSION_LATENCY
+/**
+ * @brief   Marks the arrival of a sample.
+ * @details Records the current time as the moment the next sample became
+ *          available, for example when it was read from the sensor. The
+ *          latency histogram counts the time from this mark until the end of
+ *          the following update.
+ */
+void Filter::markArrival()
+{
+    markArrival(LatencyHistogram::now());
+}
+
+/**
+ * @brief   Marks the arrival of a sample at a given time.
+ * @details Like markArrival(), for a time read earlier, such as in the
+ *          interrupt which signalled that the sample was ready.
+ *
+ * @param[in] time The arrival time as read from LatencyHistogram::now().
+ */
+void Filter::markArrival(const uint32_t time)
+{
+    arrival = time;
+    arrived = true;
+}
+
+#endif // FUSION_LATENCY
+
 /**
  * @brief   Sets the gyroscope error gain.
  * @details Sets the beta filter gain. This gain represents all mean zero
@@ -79,6 +132,63 @@ void Filter::setGyroErrorGain(const float error)
     beta = sqrt(3.0f / 4.0f) * error;
 }
 
+/**
+ * @brief   Sets the gyroscope integrator.
+ * @details Selects how the gyroscope rates are integrated over each time
+ *          step. The Euler step is cheapest but its error grows with the cube
+ *          of the angle turned per step, which limits how low the sample rate
+ *          can go during fast rotation. The exponential map is exact for a
+ *          rate which is constant over the step, at the cost of a sine and a
+ *          cosine. The midpoint and fourth order Runge-Kutta methods take the
+ *          rate as changing linearly from the previous sample to the current
+ *          one, so they also follow an accelerating rotation, with an error
+ *          of the third and fifth power of the step. Filters which keep their
+ *          estimate as a matrix ignore this.
+ *
+ * @param[in] method The integrator.
+ */
+void Filter::setIntegrator(const Integrator method)
+{
+    integrator = method;
+    previousRateSet = false;
+}
+
+#ifdef FUSION_LATENCY
+/**
+ * @brief   Attaches latency histograms.
+ * @details Once attached, every update records how long it took into
+ *          @p update and, if markArrival() was called before it, the time
+ *          from the arrival of the sample to the end of the update into
+ *          @p latency. The histograms may be shared between filters. Pass
+ *          null to stop recording, which is the default. Only available
+ *          when the library is built with FUSION_LATENCY defined.
+ *
+ * @param[in] update  The histogram of update durations, or null.
+ * @param[in] latency The histogram of sample latencies, or null.
+ */
+void Filter::setLatencyHistograms(LatencyHistogram *update,
+                                  LatencyHistogram *latency)
+{
+    updateHistogram = update;
+    latencyHistogram = latency;
+}
+
+#endif // FUSION_LATENCY
+
+/**
+ * @brief   Sets the estimated orientation.
+ * @details Replaces the current estimate, for example with an orientation
+ *          known from another source, so the filter does not have to converge
+ *          from the identity. Filters which keep their estimate in another
+ *          form override this to convert it.
+ *
+ * @param[in] q The new orientation. It is normalized before being stored.
+ */
+void Filter::setOrientation(const Quaternion &q)
+{
+    SEq_hat = q.normalized();
+}
+
 /**
  * @brief   Sets the sample rate.
  * @details Sets the sample rate the filter will operate at. This can also be
@@ -93,3 +203,130 @@ void Filter::setSampleRate(const float rate)
         sampleRate = rate;
     }
 }
+
+/**
+ * @brief   Integrates the gyroscope rates with a higher order method.
+ * @details The orientation follows
+ * @f[
+ *   \dot{q}(t) = \frac{1}{2} q(t) \otimes \begin{bmatrix} 0 & \omega(t) \end{bmatrix}
+ * @f]
+ *          The Runge-Kutta methods solve this with the rate interpolated
+ *          linearly from the previous step, @f$\omega_0@f$, to @p omega,
+ *          @f$\omega_1@f$, so the midpoint stages use their mean. On the
+ *          first step after the integrator is set the rate is held constant.
+ *          The exponential map holds @p omega constant over the step, which
+ *          it then integrates exactly. The scalar part of @p omega is
+ *          ignored.
+ *
+ * @param[in] q     The orientation at the start of the step.
+ * @param[in] omega The angular rate at the end of the step in rad/s as a pure
+ *                  quaternion.
+ * @return          The orientation at the end of the step.
+ */
+Quaternion Filter::gyroRotate(const Quaternion &q, const Quaternion &omega)
+{
+    const float h = sampleRate;
+    if (INTEGRATOR_EXPONENTIAL == integrator)
+    {
+        return q * Quaternion::fromRotationVector(h * omega.x, h * omega.y, h * omega.z);
+    }
+
+    const Quaternion &start = previousRateSet ? previousRate : omega;
+    const float omega_0[3] = { start.x, start.y, start.z };
+    const float omega_1[3] = { omega.x, omega.y, omega.z };
+    const float omega_m[3] = { 0.5f * (omega_0[0] + omega_1[0]),
+                               0.5f * (omega_0[1] + omega_1[1]),
+                               0.5f * (omega_0[2] + omega_1[2]) };
+
+    // The equation is linear in q, so the stages are run from the identity
+    // and the resulting rotation applied to q once
+    float k1[4] = { 0.0f, 0.5f * omega_0[0], 0.5f * omega_0[1], 0.5f * omega_0[2] };
+    float p[4], k2[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        p[i] = ((0 == i) ? 1.0f : 0.0f) + (0.5f * h * k1[i]);
+    }
+    rateDerivative(p, omega_m, k2);
+    previousRate = omega;
+    previousRateSet = true;
+    if (INTEGRATOR_MIDPOINT == integrator)
+    {
+        return q * Quaternion(1.0f + (h * k2[0]), h * k2[1], h * k2[2], h * k2[3]);
+    }
+
+    float k3[4], k4[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        p[i] = ((0 == i) ? 1.0f : 0.0f) + (0.5f * h * k2[i]);
+    }
+    rateDerivative(p, omega_m, k3);
+    for (int i = 0; i < 4; ++i)
+    {
+        p[i] = ((0 == i) ? 1.0f : 0.0f) + (h * k3[i]);
+    }
+    rateDerivative(p, omega_1, k4);
+    for (int i = 0; i < 4; ++i)
+    {
+        p[i] = (h / 6.0f) * (k1[i] + (2.0f * (k2[i] + k3[i])) + k4[i]);
+    }
+    return q * Quaternion(1.0f + p[0], p[1], p[2], p[3]);
+}
+
+/**
+ * @brief   Computes the orientation of a sensor from gravity and north.
+ * @details Levels the sensor with levelOrientation(), then turns it about the
+ *          vertical so that the horizontal component of the measured magnetic
+ *          flux points along the earth X axis.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ * @return The orientation of the sensor.
+ */
+Quaternion Filter::headingOrientation(float ax, float ay, float az,
+                                      float mx, float my, float mz)
+{
+    const Quaternion level = levelOrientation(ax, ay, az);
+    const Quaternion Eh = level * Quaternion(0.0f, mx, my, mz).normalized() * level.conjugate();
+    const float half_heading = 0.5f * atan2(Eh.y, Eh.x);
+    return Quaternion(cos(half_heading), 0.0f, 0.0f, -sin(half_heading)) * level;
+}
+
+/**
+ * @brief   Computes the orientation of a level sensor.
+ * @details Finds the smallest rotation which maps the measured direction of
+ *          gravity in the sensor frame onto the direction of gravity in the
+ *          earth frame. The heading of the result is arbitrary.
+ * @f[
+ *   q = \frac{\begin{bmatrix}
+ *   1 + \hat{a}_z & \hat{a}_y & -\hat{a}_x & 0
+ *   \end{bmatrix}}{\|\cdot\|}
+ * @f]
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @return       The orientation which levels the sensor, or the identity if
+ *               the measurement is zero.
+ */
+Quaternion Filter::levelOrientation(float ax, float ay, float az)
+{
+    const float n = sqrt((ax * ax) + (ay * ay) + (az * az));
+    if (0.0f == n)
+    {
+        return Quaternion();
+    }
+    ax /= n;
+    ay /= n;
+    az /= n;
+
+    // Upside down the rotation axis is undefined, so turn about X
+    if (az < -0.999999f)
+    {
+        return Quaternion(0.0f, 1.0f, 0.0f, 0.0f);
+    }
+    return Quaternion(1.0f + az, ay, -ax, 0.0f).normalized();
+}
@@ -29,8 +29,18 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef FILTER_H
 #define FILTER_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <quaternion.h>
 
+/*
+ * The latency hooks are only compiled in when FUSION_LATENCY is defined.
+ * Otherwise updates read no clock and filters carry no histogram pointers.
+ */
+#ifdef FUSION_LATENCY
+#include "latency_histogram.h"
+#endif
+
 /**
  * @brief   Filter class.
  * @details Abstract class for creating more complex orientation filter
@@ -39,13 +49,45 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 class Filter
 {
 public:
+    /**
+     * @brief Methods of integrating the gyroscope rates over a time step.
+     */
+    enum Integrator
+    {
+        INTEGRATOR_EULER,       /**< First order step, the default */
+        INTEGRATOR_MIDPOINT,    /**< Second order Runge-Kutta on the
+                                     interpolated rate */
+        INTEGRATOR_RK4,         /**< Fourth order Runge-Kutta on the
+                                     interpolated rate */
+        INTEGRATOR_EXPONENTIAL  /**< Exact exponential map */
+    };
+
     Filter();
     virtual ~Filter() = 0;
-    Quaternion orientation() const;
+    virtual Quaternion orientation() const;
+#ifdef FUSION_LATENCY
+    void markArrival();
+    void markArrival(const uint32_t time);
+#endif
     void setGyroErrorGain(const float error);
+    void setIntegrator(const Integrator method);
+#ifdef FUSION_LATENCY
+    void setLatencyHistograms(LatencyHistogram *update,
+                              LatencyHistogram *latency);
+#endif
+    virtual void setOrientation(const Quaternion &q);
     void setSampleRate(const float rate);
 
 protected:
+    static Quaternion headingOrientation(float ax, float ay, float az,
+                                         float mx, float my, float mz);
+    static Quaternion levelOrientation(float ax, float ay, float az);
+    bool burstOutput(const size_t decimation);
+    Quaternion gyroRotate(const Quaternion &q, const Quaternion &omega);
+    void gyroStep(Quaternion &q, const Quaternion &omega);
+    uint32_t updateStarted() const;
+    void updateFinished(const uint32_t start);
+
     static const Quaternion Eg_hat; /**< Direction of gravity in the earth
                                          frame */
     Quaternion SEq_hat;             /**< Estimated orientation */
@@ -54,6 +96,115 @@ protected:
                                          errors */
     float sampleRate;               /**< Rate at which the filter is to be
                                          updated */
+    Integrator integrator;          /**< Method of integrating the
+                                         gyroscope rates */
+    Quaternion previousRate;        /**< Rate of the previous step, the
+                                         start of the interpolated rate */
+    bool previousRateSet;           /**< Whether previousRate holds a rate
+                                         for the current integrator */
+#ifdef FUSION_LATENCY
+    LatencyHistogram *updateHistogram;  /**< Records the duration of each
+                                             update, may be null */
+    LatencyHistogram *latencyHistogram; /**< Records the time from sample
+                                             arrival to the end of the
+                                             update, may be null */
+    uint32_t arrival;                   /**< When the pending sample
+                                             arrived */
+    bool arrived;                       /**< Whether an arrival was marked
+                                             since the last update */
+#endif
+    size_t burstSkipped;                /**< Burst samples processed since
+                                             the last orientation output */
 };
 
+/**
+ * @brief   Integrates the gyroscope rates over one time step.
+ * @details Advances an orientation by the rotation the gyroscope measured,
+ *          with the method set by setIntegrator(). The Euler step adds the
+ *          quaternion derivative as the filters always have, the others are
+ *          left to gyroRotate(). Inline so that the Euler step costs
+ *          no more than before.
+ *
+ * @param[in,out] q     The orientation, advanced to the end of the step but
+ *                      not normalized.
+ * @param[in]     omega The angular rate in rad/s as a pure quaternion.
+ */
+inline void Filter::gyroStep(Quaternion &q, const Quaternion &omega)
+{
+    if (INTEGRATOR_EULER == integrator)
+    {
+        q += (0.5f * q * omega) * sampleRate;
+    }
+    else
+    {
+        q = gyroRotate(q, omega);
+    }
+}
+
+/**
+ * @brief   Decides whether a burst writes out the orientation.
+ * @details Called by the burst updates after each sample, whether or not
+ *          they were given an output buffer. Counts samples across bursts,
+ *          so the output keeps a fixed rate even when the bursts are not a
+ *          multiple of @p decimation long.
+ *
+ * @param[in] decimation The number of samples per output. Zero and one
+ *                       output every sample.
+ * @return Whether the orientation after this sample is to be written.
+ */
+inline bool Filter::burstOutput(const size_t decimation)
+{
+    if (++burstSkipped < decimation)
+    {
+        return false;
+    }
+    burstSkipped = 0;
+    return true;
+}
+
+/**
+ * @brief   Starts timing an update.
+ * @details Called first by every update. Reads the clock only when update
+ *          durations are being recorded, and never without FUSION_LATENCY.
+ *
+ * @return The time the update started, or zero.
+ */
+inline uint32_t Filter::updateStarted() const
+{
+#ifdef FUSION_LATENCY
+    return updateHistogram ? LatencyHistogram::now() : 0;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief   Finishes timing an update.
+ * @details Called last by every update, once the new orientation is
+ *          available. Records the duration of the update and the latency of
+ *          the sample into the histograms which are attached.
+ *
+ * @param[in] start The value returned by updateStarted().
+ */
+inline void Filter::updateFinished(const uint32_t start)
+{
+#ifdef FUSION_LATENCY
+    if (updateHistogram || latencyHistogram)
+    {
+        const uint32_t end = LatencyHistogram::now();
+        if (updateHistogram)
+        {
+            updateHistogram->record(end - start);
+        }
+        if (latencyHistogram && arrived)
+        {
+            latencyHistogram->record(end - arrival);
+        }
+        arrived = false;
+    }
+#else
+    (void)start;
+#endif
+}
+
 #endif // FILTER_H
@@ -0,0 +1,233 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  gauss_newton_filter.cpp
+ * @brief Gauss-Newton complementary filter implementation.
+ */
+
+#include <math.h>
+
+#include "gauss_newton_filter.h"
+#include "quaternion.h"
+
+/**
+ * @brief   Default constructor.
+ * @details Initializes the filter to a known state. One Gauss-Newton
+ *          iteration is run per update and the time constant is half a
+ *          second, which blends 98% of the gyroscope estimate at 100 Hz.
+ */
+GaussNewtonFilter::GaussNewtonFilter() :
+    Filter(),
+    iterations(1),
+    timeConstant(0.5f)
+{
+}
+
+/**
+ * @brief   Aligns the estimated orientation with gravity and magnetic north.
+ * @details Sets the estimated orientation directly from a single
+ *          accelerometer and magnetometer measurement, taken while the sensor
+ *          is not accelerating, instead of letting the filter converge from
+ *          the identity.
+ * @post    The estimated orientation is replaced.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void GaussNewtonFilter::align(float ax, float ay, float az,
+                              float mx, float my, float mz)
+{
+    SEq_hat = headingOrientation(ax, ay, az, mx, my, mz);
+}
+
+/**
+ * @brief   Sets the number of Gauss-Newton iterations.
+ * @details Each update starts from the previous estimate, which is already
+ *          close to the solution, so a single iteration is usually enough.
+ *          More iterations pull a badly wrong estimate in faster at a linear
+ *          cost per update.
+ *
+ * @param[in] count The number of iterations per update, at least one.
+ */
+void GaussNewtonFilter::setIterations(const int count)
+{
+    if (count > 0)
+    {
+        iterations = count;
+    }
+}
+
+/**
+ * @brief   Sets the time constant of the complementary blend.
+ * @details Each update blends the gyroscope estimate and the Gauss-Newton
+ *          observation with the weight
+ * @f[
+ *   K = \frac{\tau}{\tau + \Delta t}
+ * @f]
+ *          on the gyroscope, so the accelerometer and magnetometer correct
+ *          the gyroscope drift over roughly @f$\tau@f$ seconds whatever the
+ *          sample rate. Zero trusts the observation alone. This takes the
+ *          place of the gyroscope error gain, which the filter does not use.
+ *
+ * @param[in] tau The time constant in seconds.
+ */
+void GaussNewtonFilter::setTimeConstant(const float tau)
+{
+    if (tau >= 0.0f)
+    {
+        timeConstant = tau;
+    }
+}
+
+/**
+ * @brief   Updates estimated orientation.
+ * @details Executes the filter algorithm and updates the estimated
+ *          orientation. When the accelerometer or magnetometer measurement is
+ *          zero, or the two are parallel, the orientation is only integrated
+ *          from the gyroscope.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @pre     The proper units must be used for the input parameters.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in] wx The gyroscope X axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wy The gyroscope Y axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wz The gyroscope Z axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void GaussNewtonFilter::update(float wx, float wy, float wz,
+                               float ax, float ay, float az,
+                               float mx, float my, float mz)
+{
+    const uint32_t started = updateStarted();
+
+    // Integrate the gyroscope rates
+    Quaternion SEq_omega = SEq_hat;
+    gyroStep(SEq_omega, Quaternion(0.0f, wx, wy, wz));
+
+    // Compute the magnetic flux in the earth frame from the previous
+    // estimate, keeping only its horizontal and vertical components
+    const Quaternion Sa_hat = Quaternion(0.0f, ax, ay, az).normalized();
+    const Quaternion Sm_hat = Quaternion(0.0f, mx, my, mz).normalized();
+    const Quaternion Eh_hat = SEq_hat * Sm_hat * SEq_hat.conjugate();
+    const float bx = sqrt((Eh_hat.x * Eh_hat.x) + (Eh_hat.y * Eh_hat.y));
+
+    // Observe the orientation starting from the previous estimate, then
+    // blend it with the gyroscope estimate
+    Quaternion SEq_obs = SEq_hat;
+    bool observed = true;
+    for (int i = 0; observed && (i < iterations); ++i)
+    {
+        observed = observe(Sa_hat, Sm_hat, bx, Eh_hat.z, SEq_obs);
+    }
+    if (observed)
+    {
+        // Both signs describe the same orientation, so take the one nearest
+        // the gyroscope estimate before blending
+        if (SEq_obs.dot(SEq_omega) < 0.0f)
+        {
+            SEq_obs = -SEq_obs;
+        }
+        const float K = timeConstant / (timeConstant + sampleRate);
+        SEq_hat = (K * SEq_omega) + ((1.0f - K) * SEq_obs);
+    }
+    else
+    {
+        SEq_hat = SEq_omega;
+    }
+
+    // Normalize the output quaternion
+    SEq_hat.normalize();
+
+    updateFinished(started);
+}
+
+/**
+ * @brief   Runs one Gauss-Newton iteration.
+ * @details Refines an orientation so that it rotates the measured directions
+ *          of gravity and magnetic flux onto their earth frame references.
+ *          With the residual
+ * @f[
+ *   f(q) = \begin{bmatrix} q\,\hat{a}\,q^{*} - \hat{g} \\
+ *                          q\,\hat{m}\,q^{*} - \hat{b} \end{bmatrix}
+ * @f]
+ *          and its 6x4 Jacobian @f$J@f$, the step is
+ *          @f$q \leftarrow q - (J^{T}J)^{-1}J^{T}f@f$. The Jacobian of each
+ *          rotated vector is built from @f$p = q\,v@f$, which makes
+ *          @f$J^{T}J = 4(sI - p_a p_a^{T} - p_m p_m^{T})@f$ with
+ *          @f$s = |p_a|^2 + |p_m|^2@f$, so the 4x4 system is solved in
+ *          closed form through a 2x2 inverse.
+ *
+ * @param[in]     Sa_hat The normalized accelerometer measurement.
+ * @param[in]     Sm_hat The normalized magnetometer measurement.
+ * @param[in]     bx     The horizontal component of the earth flux.
+ * @param[in]     bz     The vertical component of the earth flux.
+ * @param[in,out] q      The orientation to refine, normalized on return.
+ * @return False when the measurements do not determine an orientation, in
+ *         which case q is left unchanged.
+ */
+bool GaussNewtonFilter::observe(const Quaternion &Sa_hat,
+                                const Quaternion &Sm_hat,
+                                const float bx, const float bz,
+                                Quaternion &q) const
+{
+    // Rotate each measurement into the earth frame
+    const Quaternion p_a = q * Sa_hat;
+    const Quaternion p_m = q * Sm_hat;
+    const Quaternion f_a = p_a * q.conjugate() - Eg_hat;
+    const Quaternion f_m = p_m * q.conjugate() - Quaternion(0.0f, bx, 0.0f, bz);
+
+    // Compute the gradient, the negated product of the Jacobian transpose
+    // and the residuals, up to a factor of two
+    const Quaternion g = (f_a * p_a) + (f_m * p_m);
+
+    // Invert the reduced 2x2 system of the normal equations
+    const float s_a = p_a.dot(p_a);
+    const float s_m = p_m.dot(p_m);
+    const float c = p_a.dot(p_m);
+    const float det = (s_a * s_m) - (c * c);
+    if (det <= 1e-6f * s_a * s_m)
+    {
+        return false;
+    }
+    const float g_a = p_a.dot(g);
+    const float g_m = p_m.dot(g);
+    const float t_a = ((s_a * g_a) + (c * g_m)) / det;
+    const float t_m = ((c * g_a) + (s_m * g_m)) / det;
+
+    // Take the step, with the signs and factors of the Jacobian folded in
+    q += (g + (t_a * p_a) + (t_m * p_m)) / (2.0f * (s_a + s_m));
+    q.normalize();
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  gauss_newton_filter.h
+ * @brief Gauss-Newton complementary filter class.
+ */
+
+#ifndef GAUSS_NEWTON_FILTER_H
+#define GAUSS_NEWTON_FILTER_H
+
+#include "filter.h"
+
+/**
+ * @brief   Gauss-Newton complementary filter.
+ * @details Filter for computing an orientation from a gyroscope, an
+ *          accelerometer and a magnetometer (9DoF). Each update solves for
+ *          the orientation which best explains the measured directions of
+ *          gravity and magnetic flux with Gauss-Newton iterations, then blends
+ *          that observation with the orientation integrated from the
+ *          gyroscope. Based on the quaternion complementary filter by
+ *          D. Comotti and M. Ermidoro.
+ */
+class GaussNewtonFilter : public Filter
+{
+public:
+    GaussNewtonFilter();
+    void align(float ax, float ay, float az,
+               float mx, float my, float mz);
+    void setIterations(const int count);
+    void setTimeConstant(const float tau);
+    void update(float wx, float wy, float wz,
+                float ax, float ay, float az,
+                float mx, float my, float mz);
+
+private:
+    bool observe(const Quaternion &Sa_hat,
+                 const Quaternion &Sm_hat,
+                 const float bx, const float bz, Quaternion &q) const;
+
+    int iterations;     /**< Gauss-Newton iterations per update */
+    float timeConstant; /**< Time constant of the complementary blend in
+                             seconds */
+};
+
+#endif // GAUSS_NEWTON_FILTER_H
@@ -39,6 +39,23 @@ IMUFilter::IMUFilter() :
 {
 }
 
+/**
+ * @brief   Aligns the estimated orientation with gravity.
+ * @details Sets the estimated orientation directly from a single
+ *          accelerometer measurement, taken while the sensor is not
+ *          accelerating, instead of letting the filter converge from the
+ *          identity. The heading is left at zero.
+ * @post    The estimated orientation is replaced.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ */
+void IMUFilter::align(float ax, float ay, float az)
+{
+    SEq_hat = levelOrientation(ax, ay, az);
+}
+
 /**
  * @brief   Updates estimated orientation.
  * @details Executes the filter algorithm and updates the estimated
@@ -59,6 +76,243 @@ IMUFilter::IMUFilter() :
  */
 void IMUFilter::update(float wx, float wy, float wz,
                        float ax, float ay, float az)
+{
+    const uint32_t started = updateStarted();
+    step(wx, wy, wz, ax, ay, az);
+    updateFinished(started);
+}
+
+/**
+ * @brief   Updates estimated orientation with one device record.
+ * @details Converts each count of the record through a format which
+ *          describes the device as it is used, so that raw readings need no
+ *          conversion beforehand.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in] record The record, as read from the device.
+ * @param[in] format The layout and conversion of the record.
+ */
+void IMUFilter::update(const int16_t *record, const SensorFormat &format)
+{
+    const uint32_t started = updateStarted();
+    step(format.value(record, SensorFormat::GYRO_X),
+         format.value(record, SensorFormat::GYRO_Y),
+         format.value(record, SensorFormat::GYRO_Z),
+         format.value(record, SensorFormat::ACCEL_X),
+         format.value(record, SensorFormat::ACCEL_Y),
+         format.value(record, SensorFormat::ACCEL_Z));
+    updateFinished(started);
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of samples.
+ * @details Runs the filter on each sample of a FIFO burst in turn, all taken
+ *          at the sample rate, as if update() was called for each. The
+ *          latency histograms record the whole burst as one update.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The samples, each the three gyroscope axes in
+ *                          rad/s followed by the three accelerometer axes.
+ * @param[in]  count        The number of samples.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t IMUFilter::update(const float *samples, const size_t count,
+                         Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += 6)
+    {
+        step(samples[0], samples[1], samples[2],
+             samples[3], samples[4], samples[5]);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of calibrated samples.
+ * @details As the floating point burst, but with each sample corrected by a
+ *          calibration as it is used, rather than in a pass of its own.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The samples, each the three gyroscope axes
+ *                          followed by the three accelerometer axes, before
+ *                          calibration.
+ * @param[in]  count        The number of samples.
+ * @param[in]  calibration  The calibration of the device. Only the gyroscope
+ *                          and accelerometer corrections are used.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t IMUFilter::update(const float *samples, const size_t count,
+                         const SensorCalibration &calibration,
+                         Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += 6)
+    {
+        float wx = samples[0], wy = samples[1], wz = samples[2];
+        float ax = samples[3], ay = samples[4], az = samples[5];
+        calibration.apply(SensorCalibration::SENSOR_GYRO, wx, wy, wz);
+        calibration.apply(SensorCalibration::SENSOR_ACCEL, ax, ay, az);
+        step(wx, wy, wz, ax, ay, az);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of raw samples.
+ * @details As the floating point burst, but with the counts read straight
+ *          from the sensor FIFO. The gyroscope counts are scaled as they are
+ *          used. The accelerometer counts need no scale because only their
+ *          direction is used, provided the three axes share one scale.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The samples, each the three gyroscope axes
+ *                          followed by the three accelerometer axes.
+ * @param[in]  count        The number of samples.
+ * @param[in]  gyroScale    The gyroscope rate of one count in rad/s.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t IMUFilter::update(const int16_t *samples, const size_t count,
+                         const float gyroScale,
+                         Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += 6)
+    {
+        step(gyroScale * samples[0], gyroScale * samples[1],
+             gyroScale * samples[2],
+             samples[3], samples[4], samples[5]);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of device records.
+ * @details As the floating point burst, but with each record read and
+ *          converted through a format which describes the device, so the
+ *          scale, bias and mounting of every axis are applied as the counts
+ *          are used. Records may hold words which are not used, and are
+ *          format.stride() words apart.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The records, as written by the device.
+ * @param[in]  count        The number of records.
+ * @param[in]  format       The layout and conversion of the records. Only
+ *                          the gyroscope and accelerometer axes are read.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t IMUFilter::update(const int16_t *samples, const size_t count,
+                         const SensorFormat &format,
+                         Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    const size_t stride = format.stride();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += stride)
+    {
+        step(format.value(samples, SensorFormat::GYRO_X),
+             format.value(samples, SensorFormat::GYRO_Y),
+             format.value(samples, SensorFormat::GYRO_Z),
+             format.value(samples, SensorFormat::ACCEL_X),
+             format.value(samples, SensorFormat::ACCEL_Y),
+             format.value(samples, SensorFormat::ACCEL_Z));
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of device records and a
+ *          calibration.
+ * @details As the burst of device records, with each converted reading then
+ *          corrected by the calibration before it is used, so that a raw
+ *          FIFO burst needs neither a conversion nor a calibration pass.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The records, as written by the device.
+ * @param[in]  count        The number of records.
+ * @param[in]  format       The layout and conversion of the records.
+ * @param[in]  calibration  The calibration of the converted readings.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t IMUFilter::update(const int16_t *samples, const size_t count,
+                         const SensorFormat &format,
+                         const SensorCalibration &calibration,
+                         Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    const size_t stride = format.stride();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += stride)
+    {
+        float wx = format.value(samples, SensorFormat::GYRO_X);
+        float wy = format.value(samples, SensorFormat::GYRO_Y);
+        float wz = format.value(samples, SensorFormat::GYRO_Z);
+        float ax = format.value(samples, SensorFormat::ACCEL_X);
+        float ay = format.value(samples, SensorFormat::ACCEL_Y);
+        float az = format.value(samples, SensorFormat::ACCEL_Z);
+        calibration.apply(SensorCalibration::SENSOR_GYRO, wx, wy, wz);
+        calibration.apply(SensorCalibration::SENSOR_ACCEL, ax, ay, az);
+        step(wx, wy, wz, ax, ay, az);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Runs the filter algorithm on one sample.
+ * @details A single step of gradient descent on the gravity objective
+ *          function, followed by the integration of the gyroscope rates.
+ */
+inline void IMUFilter::step(float wx, float wy, float wz,
+                            float ax, float ay, float az)
 {
     // Auxiliary variables to avoid repeated calculations
     const Quaternion two_SEq = 2.0f * SEq_hat;
@@ -83,11 +337,9 @@ void IMUFilter::update(float wx, float wy, float wz,
                          J_12_or_23 * f_g.y - J_33 * f_g.z - J_13_or_22 * f_g.x,
                          J_14_or_21 * f_g.x + J_11_or_24 * f_g.y).normalized();
 
-    // Compute the quaternion derivative measured by the gyroscope
-    const Quaternion SEq_dot_omega = 0.5f * SEq_hat * Quaternion(0.0f, wx, wy, wz);
-
-    // Compute then integrate the estimated quaternion derivative
-    SEq_hat += (SEq_dot_omega - (beta * SEq_hat_dot)) * sampleRate;
+    // Integrate the gyroscope rates, then the gradient descent correction
+    gyroStep(SEq_hat, Quaternion(0.0f, wx, wy, wz));
+    SEq_hat -= (beta * SEq_hat_dot) * sampleRate;
 
     // Normalize the output quaternion
     SEq_hat.normalize();
@@ -29,7 +29,11 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef IMU_FILTER_H
 #define IMU_FILTER_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "filter.h"
+#include "sensor_calibration.h"
+#include "sensor_format.h"
 
 /**
  * @brief   IMU filter.
@@ -41,8 +45,29 @@ class IMUFilter : public Filter
 {
 public:
     IMUFilter();
+    void align(float ax, float ay, float az);
     void update(float wx, float wy, float wz,
                 float ax, float ay, float az);
+    void update(const int16_t *record, const SensorFormat &format);
+    size_t update(const float *samples, const size_t count,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const float *samples, const size_t count,
+                  const SensorCalibration &calibration,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const int16_t *samples, const size_t count,
+                  const float gyroScale,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const int16_t *samples, const size_t count,
+                  const SensorFormat &format,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const int16_t *samples, const size_t count,
+                  const SensorFormat &format,
+                  const SensorCalibration &calibration,
+                  Quaternion *orientations, const size_t decimation);
+
+private:
+    void step(float wx, float wy, float wz,
+              float ax, float ay, float az);
 };
 
 #endif // IMU_FILTER_H
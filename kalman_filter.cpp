@@ -0,0 +1,610 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  kalman_filter.cpp
+ * @brief Multiplicative extended Kalman filter implementation.
+ */
+
+#include <math.h>
+
+#include "kalman_filter.h"
+#include "quaternion.h"
+
+/**
+ * @brief   Default constructor.
+ * @details Initializes the filter to a known state. The estimate starts at
+ *          the identity with no gyroscope bias, an attitude uncertainty of
+ *          1 rad and a bias uncertainty of 0.1 rad/s on every axis. The
+ *          gyroscope noise is 0.01 rad/s, the bias walk 0.0001 rad/s per
+ *          square root of a second and both reference directions 0.05 rad,
+ *          which leaves room for moderate linear acceleration.
+ */
+KalmanFilter::KalmanFilter() :
+    Filter(),
+    gyroNoise(0.01f),
+    gyroBiasWalk(0.0001f),
+    accelNoise(0.05f),
+    magNoise(0.05f)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = 0; j < 6; ++j)
+        {
+            P[i][j] = 0.0f;
+        }
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        P[i][i] = 1.0f;
+        P[i + 3][i + 3] = 0.01f;
+        bias[i] = 0.0f;
+    }
+}
+
+/**
+ * @brief   Aligns the estimated orientation with gravity.
+ * @details Sets the estimated orientation directly from a single
+ *          accelerometer measurement, taken while the sensor is not
+ *          accelerating. The heading is left at zero and stays uncertain,
+ *          while the tilt uncertainty drops to the accelerometer noise.
+ * @post    The estimated orientation and its covariance are replaced.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ */
+void KalmanFilter::align(float ax, float ay, float az)
+{
+    SEq_hat = levelOrientation(ax, ay, az);
+    alignCovariance(1.0f);
+}
+
+/**
+ * @brief   Aligns the estimated orientation with gravity and magnetic north.
+ * @details Sets the estimated orientation directly from a single
+ *          accelerometer and magnetometer measurement, taken while the sensor
+ *          is not accelerating. The attitude uncertainty drops to the
+ *          measurement noise.
+ * @post    The estimated orientation and its covariance are replaced.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void KalmanFilter::align(float ax, float ay, float az,
+                         float mx, float my, float mz)
+{
+    SEq_hat = headingOrientation(ax, ay, az, mx, my, mz);
+    alignCovariance(magNoise * magNoise);
+}
+
+/**
+ * @brief   Gets the attitude uncertainty.
+ * @details The root of the trace of the attitude block of the covariance,
+ *          a single figure for how far the estimate may be from the truth.
+ *          Callers may use it to drop samples before the filter has
+ *          converged, or while it coasts on the gyroscope alone.
+ *
+ * @return The uncertainty in radians.
+ */
+float KalmanFilter::attitudeUncertainty() const
+{
+    return sqrt(P[0][0] + P[1][1] + P[2][2]);
+}
+
+/**
+ * @brief   Gets the covariance of the error state.
+ * @details Rows and columns are ordered as the attitude error about the
+ *          sensor X, Y and Z axes in rad, then the gyroscope bias error on
+ *          the same axes in rad/s. Only the upper triangle is kept, the
+ *          copy is filled in symmetrically.
+ *
+ * @param[out] matrix The covariance matrix.
+ */
+void KalmanFilter::covariance(float matrix[6][6]) const
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = i; j < 6; ++j)
+        {
+            matrix[i][j] = P[i][j];
+            matrix[j][i] = P[i][j];
+        }
+    }
+}
+
+/**
+ * @brief   Gets the estimated gyroscope bias.
+ * @details The bias the filter subtracts from the gyroscope rates. Without a
+ *          magnetometer the bias about the vertical is not observed, and its
+ *          uncertainty grows instead.
+ *
+ * @param[out] bx The X axis bias in rad/s.
+ * @param[out] by The Y axis bias in rad/s.
+ * @param[out] bz The Z axis bias in rad/s.
+ */
+void KalmanFilter::gyroBias(float &bx, float &by, float &bz) const
+{
+    bx = bias[0];
+    by = bias[1];
+    bz = bias[2];
+}
+
+/**
+ * @brief   Sets the accelerometer noise.
+ * @details The standard deviation of the measured direction of gravity.
+ *          Besides the sensor noise it should cover the linear acceleration
+ *          the filter is expected to see, which it cannot tell apart.
+ *
+ * @param[in] noise The noise in radians, greater than zero.
+ */
+void KalmanFilter::setAccelerometerNoise(const float noise)
+{
+    if (noise > 0.0f)
+    {
+        accelNoise = noise;
+    }
+}
+
+/**
+ * @brief   Sets the gyroscope bias random walk.
+ * @details How fast the true bias is expected to drift. Zero assumes a
+ *          constant bias, which the filter then learns ever more slowly.
+ *
+ * @param[in] walk The walk in @f$\frac{\text{rad}}{\text{s}\sqrt{\text{s}}}@f$.
+ */
+void KalmanFilter::setGyroBiasWalk(const float walk)
+{
+    if (walk >= 0.0f)
+    {
+        gyroBiasWalk = walk;
+    }
+}
+
+/**
+ * @brief   Sets the gyroscope noise.
+ * @details The standard deviation of a single gyroscope sample, which sets
+ *          how fast the attitude uncertainty grows between measurements.
+ *
+ * @param[in] noise The noise in @f$\frac{\text{rad}}{\text{s}}@f$, zero or
+ *                  greater.
+ */
+void KalmanFilter::setGyroNoise(const float noise)
+{
+    if (noise >= 0.0f)
+    {
+        gyroNoise = noise;
+    }
+}
+
+/**
+ * @brief   Sets the magnetometer noise.
+ * @details The standard deviation of the measured direction of magnetic
+ *          flux, including local disturbances of the field.
+ *
+ * @param[in] noise The noise in radians, greater than zero.
+ */
+void KalmanFilter::setMagnetometerNoise(const float noise)
+{
+    if (noise > 0.0f)
+    {
+        magNoise = noise;
+    }
+}
+
+/**
+ * @brief   Updates estimated orientation.
+ * @details Executes the filter algorithm and updates the estimated
+ *          orientation, gyroscope bias and their covariance.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @pre     The proper units must be used for the input parameters.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in] wx The gyroscope X axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wy The gyroscope Y axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wz The gyroscope Z axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ */
+void KalmanFilter::update(float wx, float wy, float wz,
+                          float ax, float ay, float az)
+{
+    const uint32_t started = updateStarted();
+    step(wx, wy, wz, ax, ay, az, NULL);
+    updateFinished(started);
+}
+
+/**
+ * @brief   Updates estimated orientation.
+ * @details Executes the filter algorithm and updates the estimated
+ *          orientation, gyroscope bias and their covariance. The
+ *          magnetometer only corrects the heading.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @pre     The proper units must be used for the input parameters.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in] wx The gyroscope X axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wy The gyroscope Y axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wz The gyroscope Z axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void KalmanFilter::update(float wx, float wy, float wz,
+                          float ax, float ay, float az,
+                          float mx, float my, float mz)
+{
+    const uint32_t started = updateStarted();
+    const float magnetic[3] = { mx, my, mz };
+    step(wx, wy, wz, ax, ay, az, magnetic);
+    updateFinished(started);
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of samples.
+ * @details Runs the filter on each sample of a FIFO burst in turn, all taken
+ *          at the sample rate, as if update() was called for each. A sample
+ *          with a zero magnetometer reading only corrects the attitude, as
+ *          the update without a magnetometer does. The latency histograms
+ *          record the whole burst as one update.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The samples, each the three gyroscope axes in
+ *                          rad/s, the three accelerometer axes in units of
+ *                          gravity and the three magnetometer axes.
+ * @param[in]  count        The number of samples.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t KalmanFilter::update(const float *samples, const size_t count,
+                            Quaternion *orientations, const size_t decimation)
+{
+    return update(samples, count, orientations, NULL, decimation);
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of samples.
+ * @details As the burst above, also writing the attitude uncertainty
+ *          alongside each orientation, so that a caller can drop the samples
+ *          the filter is least sure of.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples       The samples, each the three gyroscope axes in
+ *                           rad/s, the three accelerometer axes in units of
+ *                           gravity and the three magnetometer axes.
+ * @param[in]  count         The number of samples.
+ * @param[out] orientations  Receives the orientation after every
+ *                           @p decimation samples, may be null.
+ * @param[out] uncertainties Receives attitudeUncertainty() with each
+ *                           orientation, may be null.
+ * @param[in]  decimation    The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t KalmanFilter::update(const float *samples, const size_t count,
+                            Quaternion *orientations, float *uncertainties,
+                            const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += 9)
+    {
+        step(samples[0], samples[1], samples[2],
+             samples[3], samples[4], samples[5], samples + 6);
+        if (burstOutput(decimation) && (orientations || uncertainties))
+        {
+            if (orientations)
+            {
+                orientations[written] = SEq_hat;
+            }
+            if (uncertainties)
+            {
+                uncertainties[written] = attitudeUncertainty();
+            }
+            ++written;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Resets the attitude covariance after an alignment.
+ * @details The tilt takes the accelerometer noise and the rotation about the
+ *          vertical the given heading variance. Correlations with the bias
+ *          are cleared, the bias covariance is kept.
+ *
+ * @param[in] heading The heading variance in rad squared.
+ */
+void KalmanFilter::alignCovariance(const float heading)
+{
+    // The vertical in the sensor frame
+    const Quaternion &q = SEq_hat;
+    const float v[3] = {
+        2.0f * ((q.x * q.z) - (q.w * q.y)),
+        2.0f * ((q.w * q.x) + (q.y * q.z)),
+        (q.w * q.w) - (q.x * q.x) - (q.y * q.y) + (q.z * q.z)
+    };
+    const float tilt = accelNoise * accelNoise;
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = i; j < 3; ++j)
+        {
+            P[i][j] = ((heading - tilt) * v[i] * v[j]) + ((i == j) ? tilt : 0.0f);
+        }
+        for (int j = 3; j < 6; ++j)
+        {
+            P[i][j] = 0.0f;
+        }
+    }
+}
+
+/**
+ * @brief   Runs the filter algorithm on one sample.
+ * @details Predicts with the gyroscope, applies the measurements to the
+ *          error state and folds the error back into the estimate.
+ */
+inline void KalmanFilter::step(float wx, float wy, float wz,
+                               float ax, float ay, float az,
+                               const float *magnetic)
+{
+    predict(wx, wy, wz);
+    float dx[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    correct(ax, ay, az, magnetic, dx);
+    reset(dx);
+}
+
+/**
+ * @brief   Propagates the estimate and its covariance over one time step.
+ * @details The quaternion is integrated with the bias corrected rates. The
+ *          error state follows
+ * @f[
+ *   \dot{\delta\theta} = -[\omega\times]\,\delta\theta - \delta b, \quad
+ *   \dot{\delta b} = 0
+ * @f]
+ *          and the covariance is propagated to first order in the time step,
+ *          block by block with only the upper triangle stored.
+ *
+ * @param[in] wx The gyroscope X axis measurement in rad/s.
+ * @param[in] wy The gyroscope Y axis measurement in rad/s.
+ * @param[in] wz The gyroscope Z axis measurement in rad/s.
+ */
+void KalmanFilter::predict(float wx, float wy, float wz)
+{
+    wx -= bias[0];
+    wy -= bias[1];
+    wz -= bias[2];
+    gyroStep(SEq_hat, Quaternion(0.0f, wx, wy, wz));
+
+    // Rotation over the step, then G = [d x] A and E = [d x] B + dt C for
+    // the attitude block A, cross block B and bias block C
+    const float dx = wx * sampleRate;
+    const float dy = wy * sampleRate;
+    const float dz = wz * sampleRate;
+
+    const float g00 = (dy * P[0][2]) - (dz * P[0][1]);
+    const float g01 = (dy * P[1][2]) - (dz * P[1][1]);
+    const float g02 = (dy * P[2][2]) - (dz * P[1][2]);
+    const float g10 = (dz * P[0][0]) - (dx * P[0][2]);
+    const float g11 = (dz * P[0][1]) - (dx * P[1][2]);
+    const float g12 = (dz * P[0][2]) - (dx * P[2][2]);
+    const float g20 = (dx * P[0][1]) - (dy * P[0][0]);
+    const float g21 = (dx * P[1][1]) - (dy * P[0][1]);
+    const float g22 = (dx * P[1][2]) - (dy * P[0][2]);
+
+    const float e00 = (dy * P[2][3]) - (dz * P[1][3]) + (sampleRate * P[3][3]);
+    const float e01 = (dy * P[2][4]) - (dz * P[1][4]) + (sampleRate * P[3][4]);
+    const float e02 = (dy * P[2][5]) - (dz * P[1][5]) + (sampleRate * P[3][5]);
+    const float e10 = (dz * P[0][3]) - (dx * P[2][3]) + (sampleRate * P[3][4]);
+    const float e11 = (dz * P[0][4]) - (dx * P[2][4]) + (sampleRate * P[4][4]);
+    const float e12 = (dz * P[0][5]) - (dx * P[2][5]) + (sampleRate * P[4][5]);
+    const float e20 = (dx * P[1][3]) - (dy * P[0][3]) + (sampleRate * P[3][5]);
+    const float e21 = (dx * P[1][4]) - (dy * P[0][4]) + (sampleRate * P[4][5]);
+    const float e22 = (dx * P[1][5]) - (dy * P[0][5]) + (sampleRate * P[5][5]);
+
+    // A' = A - (G + G^T) - dt (B + B^T) + Q
+    const float q_theta = gyroNoise * gyroNoise * sampleRate * sampleRate;
+    P[0][0] += q_theta - (2.0f * g00) - (2.0f * sampleRate * P[0][3]);
+    P[0][1] -= g01 + g10 + (sampleRate * (P[0][4] + P[1][3]));
+    P[0][2] -= g02 + g20 + (sampleRate * (P[0][5] + P[2][3]));
+    P[1][1] += q_theta - (2.0f * g11) - (2.0f * sampleRate * P[1][4]);
+    P[1][2] -= g12 + g21 + (sampleRate * (P[1][5] + P[2][4]));
+    P[2][2] += q_theta - (2.0f * g22) - (2.0f * sampleRate * P[2][5]);
+
+    // B' = B - E
+    P[0][3] -= e00;
+    P[0][4] -= e01;
+    P[0][5] -= e02;
+    P[1][3] -= e10;
+    P[1][4] -= e11;
+    P[1][5] -= e12;
+    P[2][3] -= e20;
+    P[2][4] -= e21;
+    P[2][5] -= e22;
+
+    // C' = C + Q
+    const float q_bias = gyroBiasWalk * gyroBiasWalk * sampleRate;
+    P[3][3] += q_bias;
+    P[4][4] += q_bias;
+    P[5][5] += q_bias;
+}
+
+/**
+ * @brief   Applies the measurements to the error state.
+ * @details The predicted direction of gravity in the sensor frame changes
+ *          with a small rotation as
+ * @f[
+ *   \hat{v}(\delta\theta) \approx \hat{v} + [\hat{v}\times]\,\delta\theta
+ * @f]
+ *          so each row of the skew matrix is one scalar measurement of the
+ *          error. The heading is the sine of the angle of the horizontal
+ *          magnetic flux from north, measured about the vertical. Zero
+ *          measurements are skipped.
+ *
+ * @param[in]     ax       The accelerometer X axis measurement.
+ * @param[in]     ay       The accelerometer Y axis measurement.
+ * @param[in]     az       The accelerometer Z axis measurement.
+ * @param[in]     magnetic The magnetometer axes, or NULL for none.
+ * @param[in,out] dx       The error state.
+ */
+void KalmanFilter::correct(float ax, float ay, float az,
+                           const float *magnetic, float dx[6])
+{
+    // The bottom row of the rotation matrix, the vertical in the sensor frame
+    const Quaternion &q = SEq_hat;
+    const float vx = 2.0f * ((q.x * q.z) - (q.w * q.y));
+    const float vy = 2.0f * ((q.w * q.x) + (q.y * q.z));
+    const float vz = (q.w * q.w) - (q.x * q.x) - (q.y * q.y) + (q.z * q.z);
+
+    const float a = sqrt((ax * ax) + (ay * ay) + (az * az));
+    if (a > 0.0f)
+    {
+        const float variance = accelNoise * accelNoise;
+        const float hx[3] = { 0.0f, -vz, vy };
+        const float hy[3] = { vz, 0.0f, -vx };
+        const float hz[3] = { -vy, vx, 0.0f };
+        observe(hx, (ax / a) - vx, variance, dx);
+        observe(hy, (ay / a) - vy, variance, dx);
+        observe(hz, (az / a) - vz, variance, dx);
+    }
+
+    if (magnetic != NULL)
+    {
+        const float mx = magnetic[0];
+        const float my = magnetic[1];
+        const float mz = magnetic[2];
+        const float m = sqrt((mx * mx) + (my * my) + (mz * mz));
+        if (m > 0.0f)
+        {
+            // Horizontal flux in the earth frame from the top two rows
+            const float r00 = 1.0f - (2.0f * ((q.y * q.y) + (q.z * q.z)));
+            const float r01 = 2.0f * ((q.x * q.y) - (q.w * q.z));
+            const float r02 = 2.0f * ((q.x * q.z) + (q.w * q.y));
+            const float r10 = 2.0f * ((q.x * q.y) + (q.w * q.z));
+            const float r11 = 1.0f - (2.0f * ((q.x * q.x) + (q.z * q.z)));
+            const float r12 = 2.0f * ((q.y * q.z) - (q.w * q.x));
+            const float hx = ((r00 * mx) + (r01 * my) + (r02 * mz)) / m;
+            const float hy = ((r10 * mx) + (r11 * my) + (r12 * mz)) / m;
+            const float h_squared = (hx * hx) + (hy * hy);
+            if (h_squared > 0.0f)
+            {
+                const float v[3] = { vx, vy, vz };
+                observe(v, -hy / sqrt(h_squared),
+                        magNoise * magNoise / h_squared, dx);
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Applies one scalar measurement.
+ * @details The measurement depends on the attitude error alone, so its
+ *          Jacobian is three values and the gain needs a single division.
+ *          The covariance update is written out over the upper triangle.
+ *
+ * @param[in]     h        The Jacobian with respect to the attitude error.
+ * @param[in]     residual The measurement less its prediction.
+ * @param[in]     variance The measurement noise variance.
+ * @param[in,out] dx       The error state.
+ */
+void KalmanFilter::observe(const float h[3], const float residual,
+                           const float variance, float dx[6])
+{
+    const float PHt[6] = {
+        (P[0][0] * h[0]) + (P[0][1] * h[1]) + (P[0][2] * h[2]),
+        (P[0][1] * h[0]) + (P[1][1] * h[1]) + (P[1][2] * h[2]),
+        (P[0][2] * h[0]) + (P[1][2] * h[1]) + (P[2][2] * h[2]),
+        (P[0][3] * h[0]) + (P[1][3] * h[1]) + (P[2][3] * h[2]),
+        (P[0][4] * h[0]) + (P[1][4] * h[1]) + (P[2][4] * h[2]),
+        (P[0][5] * h[0]) + (P[1][5] * h[1]) + (P[2][5] * h[2])
+    };
+    const float s = (h[0] * PHt[0]) + (h[1] * PHt[1]) + (h[2] * PHt[2]) + variance;
+    const float innovation = residual - ((h[0] * dx[0]) + (h[1] * dx[1]) + (h[2] * dx[2]));
+    const float inverse = 1.0f / s;
+    const float k[6] = {
+        PHt[0] * inverse, PHt[1] * inverse, PHt[2] * inverse,
+        PHt[3] * inverse, PHt[4] * inverse, PHt[5] * inverse
+    };
+
+    dx[0] += k[0] * innovation;
+    dx[1] += k[1] * innovation;
+    dx[2] += k[2] * innovation;
+    dx[3] += k[3] * innovation;
+    dx[4] += k[4] * innovation;
+    dx[5] += k[5] * innovation;
+
+    P[0][0] -= k[0] * PHt[0];
+    P[0][1] -= k[0] * PHt[1];
+    P[0][2] -= k[0] * PHt[2];
+    P[0][3] -= k[0] * PHt[3];
+    P[0][4] -= k[0] * PHt[4];
+    P[0][5] -= k[0] * PHt[5];
+    P[1][1] -= k[1] * PHt[1];
+    P[1][2] -= k[1] * PHt[2];
+    P[1][3] -= k[1] * PHt[3];
+    P[1][4] -= k[1] * PHt[4];
+    P[1][5] -= k[1] * PHt[5];
+    P[2][2] -= k[2] * PHt[2];
+    P[2][3] -= k[2] * PHt[3];
+    P[2][4] -= k[2] * PHt[4];
+    P[2][5] -= k[2] * PHt[5];
+    P[3][3] -= k[3] * PHt[3];
+    P[3][4] -= k[3] * PHt[4];
+    P[3][5] -= k[3] * PHt[5];
+    P[4][4] -= k[4] * PHt[4];
+    P[4][5] -= k[4] * PHt[5];
+    P[5][5] -= k[5] * PHt[5];
+}
+
+/**
+ * @brief   Folds the error state into the estimate.
+ * @details The attitude error is a rotation in the sensor frame, so it
+ *          multiplies the quaternion on the right. The normalization also
+ *          covers the gyroscope integration.
+ *
+ * @param[in] dx The error state.
+ */
+void KalmanFilter::reset(const float dx[6])
+{
+    SEq_hat = SEq_hat * Quaternion(1.0f, 0.5f * dx[0], 0.5f * dx[1], 0.5f * dx[2]);
+    SEq_hat.normalize();
+    bias[0] += dx[3];
+    bias[1] += dx[4];
+    bias[2] += dx[5];
+}
@@ -0,0 +1,96 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  kalman_filter.h
+ * @brief Multiplicative extended Kalman filter class.
+ */
+
+#ifndef KALMAN_FILTER_H
+#define KALMAN_FILTER_H
+
+#include <stddef.h>
+
+#include "filter.h"
+
+/**
+ * @brief   Multiplicative extended Kalman filter.
+ * @details Filter for computing an orientation and the gyroscope bias along
+ *          with their uncertainty. The quaternion is propagated with the
+ *          bias corrected gyroscope rates, while the Kalman filter runs on a
+ *          six element error state: a small rotation in the sensor frame and
+ *          the bias error. Gravity, and optionally magnetic heading, are
+ *          applied as sequential scalar measurements, so no matrix is ever
+ *          inverted, and the error is folded back into the quaternion by
+ *          multiplication after each update. All matrices are fixed size
+ *          members, with no heap use.
+ */
+class KalmanFilter : public Filter
+{
+public:
+    KalmanFilter();
+    void align(float ax, float ay, float az);
+    void align(float ax, float ay, float az,
+               float mx, float my, float mz);
+    float attitudeUncertainty() const;
+    void covariance(float matrix[6][6]) const;
+    void gyroBias(float &bx, float &by, float &bz) const;
+    void setAccelerometerNoise(const float noise);
+    void setGyroBiasWalk(const float walk);
+    void setGyroNoise(const float noise);
+    void setMagnetometerNoise(const float noise);
+    void update(float wx, float wy, float wz,
+                float ax, float ay, float az);
+    void update(float wx, float wy, float wz,
+                float ax, float ay, float az,
+                float mx, float my, float mz);
+    size_t update(const float *samples, const size_t count,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const float *samples, const size_t count,
+                  Quaternion *orientations, float *uncertainties,
+                  const size_t decimation);
+
+private:
+    void alignCovariance(const float heading);
+    void predict(float wx, float wy, float wz);
+    void correct(float ax, float ay, float az,
+                 const float *magnetic, float dx[6]);
+    void observe(const float h[3], const float residual,
+                 const float variance, float dx[6]);
+    void reset(const float dx[6]);
+    void step(float wx, float wy, float wz,
+              float ax, float ay, float az, const float *magnetic);
+
+    float P[6][6];        /**< Covariance of the error state, the attitude
+                               error in rad then the bias error in rad/s */
+    float bias[3];        /**< Estimated gyroscope bias in rad/s */
+    float gyroNoise;      /**< Standard deviation of a gyroscope sample in
+                               rad/s */
+    float gyroBiasWalk;   /**< Random walk of the gyroscope bias in rad/s
+                               per square root of a second */
+    float accelNoise;     /**< Standard deviation of the measured direction
+                               of gravity in rad */
+    float magNoise;       /**< Standard deviation of the measured direction
+                               of magnetic flux in rad */
+};
+
+#endif // KALMAN_FILTER_H
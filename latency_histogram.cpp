@@ -0,0 +1,400 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  latency_histogram.cpp
+ * @brief Latency histogram implementation.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "latency_histogram.h"
+
+#if !defined(FUSION_LATENCY_CLOCK)
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+namespace
+{
+
+// Percentiles reported by the text and JSON output
+const float reported[] = { 50.0f, 90.0f, 99.0f, 99.9f, 99.99f };
+const char *const reported_names[] = { "p50", "p90", "p99", "p99.9", "p99.99" };
+const size_t reported_count = sizeof(reported) / sizeof(reported[0]);
+
+// Appends formatted text, keeping track of the length the whole text needs
+void append(char *buffer, const size_t size, size_t &length, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int n = vsnprintf(buffer + ((length < size) ? length : size),
+                            (length < size) ? (size - length) : 0, format, args);
+    va_end(args);
+    length += (n > 0) ? n : 0;
+}
+
+// Lowers a shared minimum without a lock
+void storeMinimum(uint32_t *target, const uint32_t value)
+{
+    uint32_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while ((value < current)
+           && !__atomic_compare_exchange_n(target, &current, value, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+// Raises a shared maximum without a lock
+void storeMaximum(uint32_t *target, const uint32_t value)
+{
+    uint32_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while ((value > current)
+           && !__atomic_compare_exchange_n(target, &current, value, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+// Adds to a 64 bit sum kept as two 32 bit words, low word first, carrying
+// into the high word once the low one wraps
+void addWide(uint32_t *words, const uint64_t value)
+{
+    const uint32_t low = static_cast<uint32_t>(value);
+    const uint32_t before = __atomic_fetch_add(&words[0], low, __ATOMIC_RELAXED);
+    const uint32_t carry = (static_cast<uint32_t>(before + low) < before) ? 1 : 0;
+    const uint32_t high = static_cast<uint32_t>(value >> 32) + carry;
+    if (high)
+    {
+        __atomic_fetch_add(&words[1], high, __ATOMIC_RELAXED);
+    }
+}
+
+// Reads a sum written by addWide(), retrying if the high word changed
+uint64_t loadWide(const uint32_t *words)
+{
+    uint32_t high;
+    uint32_t low;
+    do
+    {
+        high = __atomic_load_n(&words[1], __ATOMIC_RELAXED);
+        low = __atomic_load_n(&words[0], __ATOMIC_RELAXED);
+    } while (high != __atomic_load_n(&words[1], __ATOMIC_RELAXED));
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+} // namespace
+
+const size_t LatencyHistogram::subBuckets;
+const size_t LatencyHistogram::bucketCount;
+
+/**
+ * @brief   Default constructor.
+ * @details Initializes the histogram to be empty.
+ */
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+/**
+ * @brief   Reads the clock latencies are measured with.
+ * @details The clock wraps around, so only differences between readings less
+ *          than 2^32 units apart are meaningful.
+ *
+ * @return The current time in nanoseconds on a desktop or in microseconds on
+ *         an Arduino.
+ */
+uint32_t LatencyHistogram::now()
+{
+#if defined(FUSION_LATENCY_CLOCK)
+    return FUSION_LATENCY_CLOCK();
+#elif defined(ARDUINO)
+    return micros();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint32_t>((static_cast<uint64_t>(ts.tv_sec) * 1000000000u) + ts.tv_nsec);
+#endif
+}
+
+/**
+ * @brief   Records a value.
+ * @details Safe to call from several threads at once.
+ *
+ * @param[in] value The value to count.
+ */
+void LatencyHistogram::record(const uint32_t value)
+{
+    __atomic_fetch_add(&counts[bucketOf(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total, 1, __ATOMIC_RELAXED);
+    addWide(sum, value);
+    storeMinimum(&lowest, value);
+    storeMaximum(&highest, value);
+}
+
+/**
+ * @brief   Merges another histogram into this one.
+ * @details Adds every count of @p histogram, for example to combine the
+ *          histograms kept by each thread.
+ *
+ * @param[in] histogram The histogram to add.
+ */
+void LatencyHistogram::add(const LatencyHistogram &histogram)
+{
+    for (size_t i = 0; i < bucketCount; ++i)
+    {
+        const uint32_t n = __atomic_load_n(&histogram.counts[i], __ATOMIC_RELAXED);
+        if (n)
+        {
+            __atomic_fetch_add(&counts[i], n, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_fetch_add(&total, __atomic_load_n(&histogram.total, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    addWide(sum, loadWide(histogram.sum));
+    if (histogram.count())
+    {
+        storeMinimum(&lowest, histogram.minimum());
+        storeMaximum(&highest, histogram.maximum());
+    }
+}
+
+/**
+ * @brief Empties the histogram.
+ */
+void LatencyHistogram::reset()
+{
+    for (size_t i = 0; i < bucketCount; ++i)
+    {
+        counts[i] = 0;
+    }
+    total = 0;
+    sum[0] = 0;
+    sum[1] = 0;
+    lowest = 0xffffffff;
+    highest = 0;
+}
+
+/**
+ * @brief Number of values recorded.
+ */
+uint32_t LatencyHistogram::count() const
+{
+    return __atomic_load_n(&total, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Smallest value recorded, or zero if the histogram is empty.
+ */
+uint32_t LatencyHistogram::minimum() const
+{
+    return count() ? __atomic_load_n(&lowest, __ATOMIC_RELAXED) : 0;
+}
+
+/**
+ * @brief Largest value recorded.
+ */
+uint32_t LatencyHistogram::maximum() const
+{
+    return __atomic_load_n(&highest, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Mean of the values recorded, or zero if the histogram is empty.
+ */
+uint32_t LatencyHistogram::mean() const
+{
+    const uint32_t n = count();
+    return n ? static_cast<uint32_t>(loadWide(sum) / n) : 0;
+}
+
+/**
+ * @brief   Value below which a given share of the values fall.
+ * @details Gives the highest value of the bucket holding the percentile,
+ *          limited to the largest value recorded.
+ *
+ * @param[in] percent The percentile, from 0 to 100.
+ * @return The value, or zero if the histogram is empty.
+ */
+uint32_t LatencyHistogram::percentile(const float percent) const
+{
+    const uint32_t n = count();
+    if (0 == n)
+    {
+        return 0;
+    }
+    const float share = (percent < 0.0f) ? 0.0f : ((percent > 100.0f) ? 100.0f : percent);
+    uint64_t target = static_cast<uint64_t>((share / 100.0f) * n + 0.5f);
+    target = (target < 1) ? 1 : target;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; ++i)
+    {
+        seen += __atomic_load_n(&counts[i], __ATOMIC_RELAXED);
+        if (seen >= target)
+        {
+            const uint32_t value = bucketHighest(i);
+            return (value < maximum()) ? value : maximum();
+        }
+    }
+    return maximum();
+}
+
+/**
+ * @brief Number of values in a bucket.
+ *
+ * @param[in] bucket The bucket, less than bucketCount.
+ */
+uint32_t LatencyHistogram::bucketCountAt(const size_t bucket) const
+{
+    return (bucket < bucketCount) ? __atomic_load_n(&counts[bucket], __ATOMIC_RELAXED) : 0;
+}
+
+/**
+ * @brief Smallest value counted in a bucket.
+ *
+ * @param[in] bucket The bucket, less than bucketCount.
+ */
+uint32_t LatencyHistogram::bucketLowest(const size_t bucket)
+{
+    if (bucket < subBuckets)
+    {
+        return bucket;
+    }
+    const size_t shift = (bucket / subBuckets) - 1;
+    return static_cast<uint32_t>(subBuckets + (bucket % subBuckets)) << shift;
+}
+
+/**
+ * @brief Largest value counted in a bucket.
+ *
+ * @param[in] bucket The bucket, less than bucketCount.
+ */
+uint32_t LatencyHistogram::bucketHighest(const size_t bucket)
+{
+    if (bucket < subBuckets)
+    {
+        return bucket;
+    }
+    const size_t shift = (bucket / subBuckets) - 1;
+    return bucketLowest(bucket) + ((static_cast<uint32_t>(1) << shift) - 1);
+}
+
+/**
+ * @brief   Bucket a value is counted in.
+ * @details Values below 16 index their bucket directly. Above that the
+ *          position of the leading bit picks the group of 16 buckets and the
+ *          next four bits pick the bucket within it.
+ *
+ * @param[in] value The value.
+ */
+size_t LatencyHistogram::bucketOf(const uint32_t value)
+{
+    if (value < subBuckets)
+    {
+        return value;
+    }
+    const size_t leading = ((8 * sizeof(unsigned long)) - 1)
+                           - __builtin_clzl(static_cast<unsigned long>(value));
+    const size_t shift = leading - 4;
+    return ((shift + 1) * subBuckets) + ((value >> shift) & (subBuckets - 1));
+}
+
+/**
+ * @brief   Writes a summary as text.
+ * @details Writes the count, minimum, mean and maximum followed by the 50th,
+ *          90th, 99th, 99.9th and 99.99th percentiles on a single line. The
+ *          output is truncated if the buffer is too small but is always
+ *          terminated.
+ *
+ * @param[out] buffer The buffer to write to.
+ * @param[in]  size   The size of the buffer in bytes.
+ * @return The number of characters the whole text needs, not counting the
+ *         terminator.
+ */
+size_t LatencyHistogram::printText(char *buffer, const size_t size) const
+{
+    size_t length = 0;
+    if (size)
+    {
+        buffer[0] = '\0';
+    }
+    append(buffer, size, length, "count=%lu min=%lu mean=%lu max=%lu",
+           static_cast<unsigned long>(count()), static_cast<unsigned long>(minimum()),
+           static_cast<unsigned long>(mean()), static_cast<unsigned long>(maximum()));
+    for (size_t i = 0; i < reported_count; ++i)
+    {
+        append(buffer, size, length, " %s=%lu", reported_names[i],
+               static_cast<unsigned long>(percentile(reported[i])));
+    }
+    append(buffer, size, length, "\n");
+    return length;
+}
+
+/**
+ * @brief   Writes the histogram as JSON.
+ * @details Writes an object holding the same summary as printText() and an
+ *          array of the buckets which are not empty, each given as its
+ *          lowest value, highest value and count.
+ *
+ * @param[out] buffer The buffer to write to.
+ * @param[in]  size   The size of the buffer in bytes.
+ * @return The number of characters the whole text needs, not counting the
+ *         terminator.
+ */
+size_t LatencyHistogram::printJson(char *buffer, const size_t size) const
+{
+    size_t length = 0;
+    if (size)
+    {
+        buffer[0] = '\0';
+    }
+    append(buffer, size, length, "{\"count\":%lu,\"min\":%lu,\"mean\":%lu,\"max\":%lu",
+           static_cast<unsigned long>(count()), static_cast<unsigned long>(minimum()),
+           static_cast<unsigned long>(mean()), static_cast<unsigned long>(maximum()));
+    for (size_t i = 0; i < reported_count; ++i)
+    {
+        append(buffer, size, length, ",\"%s\":%lu", reported_names[i],
+               static_cast<unsigned long>(percentile(reported[i])));
+    }
+    append(buffer, size, length, ",\"buckets\":[");
+    bool first = true;
+    for (size_t i = 0; i < bucketCount; ++i)
+    {
+        const uint32_t n = bucketCountAt(i);
+        if (n)
+        {
+            append(buffer, size, length, "%s[%lu,%lu,%lu]", first ? "" : ",",
+                   static_cast<unsigned long>(bucketLowest(i)),
+                   static_cast<unsigned long>(bucketHighest(i)),
+                   static_cast<unsigned long>(n));
+            first = false;
+        }
+    }
+    append(buffer, size, length, "]}\n");
+    return length;
+}
@@ -0,0 +1,86 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  latency_histogram.h
+ * @brief Histogram for recording latencies.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief   Latency histogram class.
+ * @details Counts values in log-linear buckets in the style of an HDR
+ *          histogram. Values below 16 have a bucket each and every power of
+ *          two above that is split into 16 buckets, so any value is known to
+ *          within 6.25% over the whole 32 bit range using a fixed amount of
+ *          memory.
+ *
+ *          Recording is lock-free, so one histogram may be shared by filters
+ *          updated on different threads or from an interrupt. Only 32 bit
+ *          atomics are used, as wider ones are not lock-free on most
+ *          microcontrollers, so the count wraps after 2^32 values. Histograms
+ *          filled separately can be merged with add(). Reading while others
+ *          record gives a close but not necessarily consistent snapshot.
+ *
+ *          Values are in the units of now(): nanoseconds on a desktop and
+ *          microseconds on an Arduino, unless FUSION_LATENCY_CLOCK() is
+ *          defined to read another clock.
+ */
+class LatencyHistogram
+{
+public:
+    static const size_t subBuckets = 16;   /**< Buckets per power of two */
+    static const size_t bucketCount = 464; /**< Number of buckets */
+
+    LatencyHistogram();
+    static uint32_t now();
+    void record(const uint32_t value);
+    void add(const LatencyHistogram &histogram);
+    void reset();
+    uint32_t count() const;
+    uint32_t minimum() const;
+    uint32_t maximum() const;
+    uint32_t mean() const;
+    uint32_t percentile(const float percent) const;
+    uint32_t bucketCountAt(const size_t bucket) const;
+    static uint32_t bucketLowest(const size_t bucket);
+    static uint32_t bucketHighest(const size_t bucket);
+    static size_t bucketOf(const uint32_t value);
+    size_t printText(char *buffer, const size_t size) const;
+    size_t printJson(char *buffer, const size_t size) const;
+
+private:
+    uint32_t counts[bucketCount]; /**< Number of values in each bucket */
+    uint32_t total;               /**< Number of values recorded */
+    uint32_t sum[2];              /**< Sum of the values recorded, low
+                                       word first */
+    uint32_t lowest;              /**< Smallest value recorded */
+    uint32_t highest;             /**< Largest value recorded */
+};
+
+#endif // LATENCY_HISTOGRAM_H
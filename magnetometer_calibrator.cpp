@@ -0,0 +1,548 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  magnetometer_calibrator.cpp
+ * @brief Magnetometer calibrator implementation.
+ */
+
+#include <math.h>
+#include "magnetometer_calibrator.h"
+
+namespace
+{
+
+// Smallest pivot of the normal matrix, relative to its diagonal, which still
+// counts as determined by the readings
+const float min_pivot = 1.0e-7f;
+
+// Largest weight of a reading before the sums are scaled back down
+const float max_gain = 1.0e4f;
+
+// Smallest determinant of the covariance of the readings, relative to the
+// cube of its mean eigenvalue, which still counts as spread in three
+// dimensions. Rotation about a single axis leaves the readings on a plane,
+// where only noise adds to the determinant.
+const float min_spread = 1.0e-3f;
+
+// Largest ratio between the squared axes of an accepted ellipsoid, four times
+// in length, well beyond any soft iron distortion seen in practice
+const float max_axis_ratio = 16.0f;
+
+// Diagonalizes a symmetric 3x3 matrix with cyclic Jacobi rotations. The
+// eigenvalues are left on the diagonal of a and the eigenvectors in the
+// columns of v.
+void eigenSymmetric(float a[3][3], float v[3][3])
+{
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            v[r][c] = (r == c) ? 1.0f : 0.0f;
+        }
+    }
+    for (int sweep = 0; sweep < 10; ++sweep)
+    {
+        const float off = fabs(a[0][1]) + fabs(a[0][2]) + fabs(a[1][2]);
+        if (off <= 1.0e-9f * (fabs(a[0][0]) + fabs(a[1][1]) + fabs(a[2][2])))
+        {
+            break;
+        }
+        for (int p = 0; p < 2; ++p)
+        {
+            for (int q = p + 1; q < 3; ++q)
+            {
+                if (a[p][q] == 0.0f)
+                {
+                    continue;
+                }
+
+                // Rotation which zeroes a[p][q]
+                const float theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+                const float t = ((theta >= 0.0f) ? 1.0f : -1.0f)
+                        / (fabs(theta) + sqrt((theta * theta) + 1.0f));
+                const float c = 1.0f / sqrt((t * t) + 1.0f);
+                const float s = t * c;
+                for (int k = 0; k < 3; ++k)
+                {
+                    const float akp = a[k][p];
+                    const float akq = a[k][q];
+                    a[k][p] = (c * akp) - (s * akq);
+                    a[k][q] = (s * akp) + (c * akq);
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    const float apk = a[p][k];
+                    const float aqk = a[q][k];
+                    a[p][k] = (c * apk) - (s * aqk);
+                    a[q][k] = (s * apk) + (c * aqk);
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    const float vkp = v[k][p];
+                    const float vkq = v[k][q];
+                    v[k][p] = (c * vkp) - (s * vkq);
+                    v[k][q] = (s * vkp) + (c * vkq);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @brief   Default constructor.
+ * @details Starts with no readings, a window of a thousand readings and a
+ *          fit every hundred readings.
+ */
+MagnetometerCalibrator::MagnetometerCalibrator() :
+    growth(1000.0f / 999.0f),
+    interval(100)
+{
+    reset();
+}
+
+/**
+ * @brief   Adds a magnetometer reading.
+ * @details Folds the reading into the normal equations of the ellipsoid
+ * @f[
+ *   \phi^T \theta = x^2 + y^2 + z^2, \quad
+ *   \phi = \left(x^2 + y^2 - 2z^2, x^2 + z^2 - 2y^2,
+ *                 2xy, 2xz, 2yz, 2x, 2y, 2z, 1\right)
+ * @f]
+ *          whose quadratic form has a trace of three, leaving the constant
+ *          term free so that the ellipsoid may lie anywhere relative to the
+ *          origin, then fits the ellipsoid if the fit interval has passed.
+ *          Rather than decaying every sum on each reading, each reading is
+ *          given a little more weight than the one before, and the sums are
+ *          scaled back down once in a while. Readings are taken relative to
+ *          the first one and scaled by its length, which keeps the sums well
+ *          conditioned whatever the units and the hard iron offset.
+ *
+ * @param[in] mx The magnetometer X axis measurement.
+ * @param[in] my The magnetometer Y axis measurement.
+ * @param[in] mz The magnetometer Z axis measurement.
+ */
+void MagnetometerCalibrator::add(float mx, float my, float mz)
+{
+    if (unit == 0.0f)
+    {
+        unit = sqrt((mx * mx) + (my * my) + (mz * mz));
+        if (unit == 0.0f)
+        {
+            return;
+        }
+        inverseUnit = 1.0f / unit;
+        origin[0] = mx;
+        origin[1] = my;
+        origin[2] = mz;
+    }
+    const float x = (mx - origin[0]) * inverseUnit;
+    const float y = (my - origin[1]) * inverseUnit;
+    const float z = (mz - origin[2]) * inverseUnit;
+    const float xx = x * x;
+    const float yy = y * y;
+    const float zz = z * z;
+    const float t = xx + yy + zz;
+    const float phi[9] = { xx + yy - (2.0f * zz), xx + zz - (2.0f * yy),
+                           2.0f * x * y, 2.0f * x * z, 2.0f * y * z,
+                           2.0f * x, 2.0f * y, 2.0f * z, 1.0f };
+
+    gain *= growth;
+    const float weighted_t = gain * t;
+    for (int i = 0; i < 9; ++i)
+    {
+        const float weighted = gain * phi[i];
+        for (int j = i; j < 9; ++j)
+        {
+            normal[i][j] += weighted * phi[j];
+        }
+        moment[i] += weighted_t * phi[i];
+    }
+    square += weighted_t * t;
+    weight += gain;
+
+    if (gain > max_gain)
+    {
+        rescale();
+    }
+    if (interval && (++pending >= interval))
+    {
+        pending = 0;
+        fit();
+    }
+}
+
+/**
+ * @brief   Writes the fitted correction into a sensor calibration.
+ * @details Sets the magnetometer bias and matrix of @p target, leaving the
+ *          other sensors alone, so that the calibration can be passed to
+ *          the burst updates of MARGFilter. Nothing is written before a fit
+ *          has succeeded.
+ *
+ * @param[out] target The calibration to update.
+ * @return Whether a fit was written.
+ */
+bool MagnetometerCalibrator::calibration(SensorCalibration &target) const
+{
+    if (fitted)
+    {
+        target.setBias(SensorCalibration::SENSOR_MAG,
+                       center[0], center[1], center[2]);
+        target.setMatrix(SensorCalibration::SENSOR_MAG, correction);
+    }
+    return fitted;
+}
+
+/**
+ * @brief   Gets the fitted field strength.
+ * @details The radius of the sphere the corrected readings lie on, the
+ *          geometric mean of the axes of the fitted ellipsoid.
+ *
+ * @return The field strength in the units of the readings, or zero before a
+ *         fit has succeeded.
+ */
+float MagnetometerCalibrator::fieldStrength() const
+{
+    return radius;
+}
+
+/**
+ * @brief   Fits an ellipsoid to the readings.
+ * @details Solves the normal equations by Cholesky decomposition, then
+ *          brings the ellipsoid to the form
+ * @f[
+ *   \left(m - c\right)^T B \left(m - c\right) = 1
+ * @f]
+ *          and takes the symmetric square root of @f$B@f$, scaled to keep
+ *          the average radius, as the soft iron correction. The fit is
+ *          rejected, keeping any earlier one, when the readings lie close to
+ *          a plane, do not determine an ellipsoid or determine one which is
+ *          too elongated.
+ *
+ * @return Whether the fit succeeded.
+ */
+bool MagnetometerCalibrator::fit()
+{
+    // Covariance of the readings, from the linear and constant columns
+    if (!(weight > 0.0f))
+    {
+        return false;
+    }
+    float centroid[3], cov[3][3];
+    for (int i = 0; i < 3; ++i)
+    {
+        centroid[i] = 0.5f * normal[5 + i][8] / weight;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = i; j < 3; ++j)
+        {
+            cov[i][j] = (0.25f * normal[5 + i][5 + j] / weight) - (centroid[i] * centroid[j]);
+            cov[j][i] = cov[i][j];
+        }
+    }
+    const float spread = (cov[0][0] + cov[1][1] + cov[2][2]) / 3.0f;
+    const float volume = (cov[0][0] * ((cov[1][1] * cov[2][2]) - (cov[1][2] * cov[1][2])))
+            - (cov[0][1] * ((cov[0][1] * cov[2][2]) - (cov[1][2] * cov[0][2])))
+            + (cov[0][2] * ((cov[0][1] * cov[1][2]) - (cov[1][1] * cov[0][2])));
+    if (!(volume > min_spread * spread * spread * spread))
+    {
+        return false;
+    }
+
+    // Cholesky decomposition of the normal matrix into its lower triangle
+    float l[9][9];
+    for (int j = 0; j < 9; ++j)
+    {
+        float d = normal[j][j];
+        for (int k = 0; k < j; ++k)
+        {
+            d -= l[j][k] * l[j][k];
+        }
+        if (!(d > min_pivot * normal[j][j]))
+        {
+            return false;
+        }
+        l[j][j] = sqrt(d);
+        for (int i = j + 1; i < 9; ++i)
+        {
+            float s = normal[j][i];
+            for (int k = 0; k < j; ++k)
+            {
+                s -= l[i][k] * l[j][k];
+            }
+            l[i][j] = s / l[j][j];
+        }
+    }
+
+    // Forward then back substitution
+    float theta[9];
+    for (int i = 0; i < 9; ++i)
+    {
+        float s = moment[i];
+        for (int k = 0; k < i; ++k)
+        {
+            s -= l[i][k] * theta[k];
+        }
+        theta[i] = s / l[i][i];
+    }
+    for (int i = 8; i >= 0; --i)
+    {
+        float s = theta[i];
+        for (int k = i + 1; k < 9; ++k)
+        {
+            s -= l[k][i] * theta[k];
+        }
+        theta[i] = s / l[i][i];
+    }
+
+    // The quadratic form, of trace three, and its center, c = -A^-1 g, of
+    // the ellipsoid m^T A m + 2 g^T m + j = 0
+    const float u = theta[0];
+    const float w = theta[1];
+    const float a[3][3] = { { 1.0f - u - w, -theta[2], -theta[3] },
+                            { -theta[2], 1.0f - u + (2.0f * w), -theta[4] },
+                            { -theta[3], -theta[4], 1.0f + (2.0f * u) - w } };
+    const float adj[3][3] =
+    {
+        { (a[1][1] * a[2][2]) - (a[1][2] * a[2][1]),
+          (a[0][2] * a[2][1]) - (a[0][1] * a[2][2]),
+          (a[0][1] * a[1][2]) - (a[0][2] * a[1][1]) },
+        { (a[1][2] * a[2][0]) - (a[1][0] * a[2][2]),
+          (a[0][0] * a[2][2]) - (a[0][2] * a[2][0]),
+          (a[0][2] * a[1][0]) - (a[0][0] * a[1][2]) },
+        { (a[1][0] * a[2][1]) - (a[1][1] * a[2][0]),
+          (a[0][1] * a[2][0]) - (a[0][0] * a[2][1]),
+          (a[0][0] * a[1][1]) - (a[0][1] * a[1][0]) }
+    };
+    const float det = (a[0][0] * adj[0][0]) + (a[0][1] * adj[1][0])
+            + (a[0][2] * adj[2][0]);
+    if (!(det > 0.0f))
+    {
+        return false;
+    }
+    const float g[3] = { -theta[5], -theta[6], -theta[7] };
+    float c[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        c[i] = -((adj[i][0] * g[0]) + (adj[i][1] * g[1])
+                 + (adj[i][2] * g[2])) / det;
+    }
+
+    // The ellipsoid about its center, (m - c)^T A (m - c) = k
+    const float k = theta[8] - ((c[0] * g[0]) + (c[1] * g[1]) + (c[2] * g[2]));
+    if (!(k > 0.0f))
+    {
+        return false;
+    }
+
+    // Axes of the ellipsoid, each the inverse square of a semi-axis
+    float b[3][3], v[3][3];
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int col = 0; col < 3; ++col)
+        {
+            b[r][col] = a[r][col] / k;
+        }
+    }
+    eigenSymmetric(b, v);
+    const float e[3] = { b[0][0], b[1][1], b[2][2] };
+    const float smallest = fmin(e[0], fmin(e[1], e[2]));
+    const float largest = fmax(e[0], fmax(e[1], e[2]));
+    if (!(smallest > 0.0f) || (largest > max_axis_ratio * smallest))
+    {
+        return false;
+    }
+
+    // Symmetric square root of B, scaled by the mean radius
+    const float mean = pow(e[0] * e[1] * e[2], -1.0f / 6.0f);
+    const float root[3] = { sqrt(e[0]) * mean, sqrt(e[1]) * mean,
+                            sqrt(e[2]) * mean };
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int col = 0; col < 3; ++col)
+        {
+            correction[r][col] = (v[r][0] * root[0] * v[col][0])
+                    + (v[r][1] * root[1] * v[col][1])
+                    + (v[r][2] * root[2] * v[col][2]);
+        }
+        center[r] = origin[r] + (c[r] * unit);
+    }
+    radius = mean * unit;
+
+    // The residual of each reading is k times the relative error of its
+    // squared radius, about twice the relative error of the radius
+    float rss = square;
+    for (int i = 0; i < 9; ++i)
+    {
+        rss -= theta[i] * moment[i];
+    }
+    error = sqrt(fmax(rss, 0.0f) / weight) / (2.0f * k);
+    fitted = true;
+    return true;
+}
+
+/**
+ * @brief   Gets the fitted hard iron offset.
+ *
+ * @param[out] x The X axis offset in the units of the readings.
+ * @param[out] y The Y axis offset in the units of the readings.
+ * @param[out] z The Z axis offset in the units of the readings.
+ */
+void MagnetometerCalibrator::offset(float &x, float &y, float &z) const
+{
+    x = center[0];
+    y = center[1];
+    z = center[2];
+}
+
+/**
+ * @brief   Forgets every reading and the fit.
+ * @details The window and the fit interval are kept.
+ */
+void MagnetometerCalibrator::reset()
+{
+    for (int i = 0; i < 9; ++i)
+    {
+        for (int j = 0; j < 9; ++j)
+        {
+            normal[i][j] = 0.0f;
+        }
+        moment[i] = 0.0f;
+    }
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            correction[r][c] = (r == c) ? 1.0f : 0.0f;
+        }
+        center[r] = 0.0f;
+        origin[r] = 0.0f;
+    }
+    square = 0.0f;
+    weight = 0.0f;
+    gain = 1.0f;
+    unit = 0.0f;
+    inverseUnit = 0.0f;
+    pending = 0;
+    radius = 0.0f;
+    error = 0.0f;
+    fitted = false;
+}
+
+/**
+ * @brief   Gets the quality of the fit.
+ * @details The RMS difference between the strength of the corrected
+ *          readings and the fitted field strength, relative to the field
+ *          strength. Sensor noise sets a floor, while larger values mean the
+ *          field was disturbed or the distortion changed within the window.
+ *
+ * @return The relative error, or zero before a fit has succeeded.
+ */
+float MagnetometerCalibrator::residual() const
+{
+    return error;
+}
+
+/**
+ * @brief   Scales the sums so that the latest reading has a weight of one.
+ * @details Only ratios of the sums are used, so this changes nothing but
+ *          keeps them in range.
+ */
+void MagnetometerCalibrator::rescale()
+{
+    const float scale = 1.0f / gain;
+    for (int i = 0; i < 9; ++i)
+    {
+        for (int j = i; j < 9; ++j)
+        {
+            normal[i][j] *= scale;
+        }
+        moment[i] *= scale;
+    }
+    square *= scale;
+    weight *= scale;
+    gain = 1.0f;
+}
+
+/**
+ * @brief   Sets how often the ellipsoid is fitted.
+ * @details A fit costs about as much as a few dozen readings, so fitting
+ *          every hundred readings adds little to each.
+ *
+ * @param[in] samples The number of readings between fits, or zero to fit
+ *                    only when fit() is called.
+ */
+void MagnetometerCalibrator::setFitInterval(const size_t samples)
+{
+    interval = samples;
+    pending = 0;
+}
+
+/**
+ * @brief   Sets how many readings the fit remembers.
+ * @details Each reading decays the weight of those before it, so that the
+ *          fit follows a distortion which changes, for example when the
+ *          device is moved near other equipment. The window should span
+ *          enough readings for the device to turn through most directions.
+ * @pre     The @p samples should be greater than one, otherwise this function
+ *          does nothing.
+ *
+ * @param[in] samples The effective number of readings remembered.
+ */
+void MagnetometerCalibrator::setWindow(const float samples)
+{
+    if (samples > 1.0f)
+    {
+        growth = samples / (samples - 1.0f);
+    }
+}
+
+/**
+ * @brief   Gets the fitted soft iron correction.
+ * @details The readings, once the offset is removed, are multiplied by this
+ *          matrix. It is the identity before a fit has succeeded.
+ *
+ * @param[out] m The matrix, by rows.
+ */
+void MagnetometerCalibrator::softIron(float m[3][3]) const
+{
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            m[r][c] = correction[r][c];
+        }
+    }
+}
+
+/**
+ * @brief   Gets whether a fit has succeeded.
+ *
+ * @return Whether the offset, correction and residual are available.
+ */
+bool MagnetometerCalibrator::valid() const
+{
+    return fitted;
+}
@@ -0,0 +1,90 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  magnetometer_calibrator.h
+ * @brief Online hard and soft iron calibration of a magnetometer.
+ */
+
+#ifndef MAGNETOMETER_CALIBRATOR_H
+#define MAGNETOMETER_CALIBRATOR_H
+
+#include <stddef.h>
+#include "sensor_calibration.h"
+
+/**
+ * @brief   Magnetometer calibrator class.
+ * @details Estimates the hard and soft iron distortion of a magnetometer
+ *          while it is in use. The readings of a distorted magnetometer lie
+ *          on an ellipsoid rather than on a sphere, so an ellipsoid is fitted
+ *          to them by least squares. Each reading only updates the fixed
+ *          size normal equations of the fit, with older readings slowly
+ *          forgotten so that a changing distortion is followed, which costs
+ *          the same whatever the number of readings. The equations are
+ *          solved every so many readings, or whenever fit() is called.
+ *
+ *          The fit yields the hard iron offset and a symmetric soft iron
+ *          matrix which maps the ellipsoid back onto a sphere with the
+ *          average radius, along with the RMS error of the fitted field
+ *          strength. Readings should cover as many directions as possible;
+ *          readings from rotations about a single axis do not determine an
+ *          ellipsoid and are rejected by the fit.
+ */
+class MagnetometerCalibrator
+{
+public:
+    MagnetometerCalibrator();
+    void add(float mx, float my, float mz);
+    bool calibration(SensorCalibration &target) const;
+    float fieldStrength() const;
+    bool fit();
+    void offset(float &x, float &y, float &z) const;
+    void reset();
+    float residual() const;
+    void setFitInterval(const size_t samples);
+    void setWindow(const float samples);
+    void softIron(float m[3][3]) const;
+    bool valid() const;
+
+private:
+    void rescale();
+
+    float normal[9][9];     /**< Normal matrix of the fit, only the upper
+                                 triangle is used */
+    float moment[9];        /**< Right hand side of the normal equations */
+    float square;           /**< Weighted sum of the squared targets */
+    float weight;           /**< Sum of the weights of the readings */
+    float gain;             /**< Weight of the latest reading */
+    float growth;           /**< Growth of the weight per reading */
+    float unit;             /**< Scale of the readings in the sums */
+    float inverseUnit;      /**< Inverse of the scale of the readings */
+    float origin[3];        /**< Reading the others are taken relative to */
+    size_t interval;        /**< Readings between automatic fits, or zero */
+    size_t pending;         /**< Readings since the last automatic fit */
+    float center[3];        /**< Fitted hard iron offset */
+    float correction[3][3]; /**< Fitted soft iron correction */
+    float radius;           /**< Fitted field strength */
+    float error;            /**< RMS relative error of the fit */
+    bool fitted;            /**< Whether a fit has succeeded */
+};
+
+#endif // MAGNETOMETER_CALIBRATOR_H
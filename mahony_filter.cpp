@@ -0,0 +1,48 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  mahony_filter.cpp
+ * @brief Mahony filter implementation.
+ */
+
+#include "mahony_filter.h"
+
+/**
+ * @brief   Default constructor.
+ * @details Initializes the filter to a known state. The gyroscope bias
+ *          estimate starts at zero, the proportional gain at 1 rad/s per
+ *          radian of error and the integral gain at 0.1.
+ */
+MahonyFilter::MahonyFilter() :
+    FeedbackFilter(1.0f, 0.1f)
+{
+}
+
+/**
+ * @brief   Destructor.
+ * @details This is an abstract destructor which prevents this class from being
+ *          used directly.
+ */
+MahonyFilter::~MahonyFilter()
+{
+}
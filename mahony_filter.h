@@ -0,0 +1,70 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  mahony_filter.h
+ * @brief Abstract class for Mahony complementary filters.
+ */
+
+#ifndef MAHONY_FILTER_H
+#define MAHONY_FILTER_H
+
+#include "feedback_filter.h"
+
+/**
+ * @brief   Mahony filter class.
+ * @details Common part of the explicit complementary filters by R. Mahony,
+ *          T. Hamel and J.-M. Pflimlin, which keep their estimate as a
+ *          quaternion and integrate the corrected gyroscope rates with the
+ *          selected integrator.
+ */
+class MahonyFilter : public FeedbackFilter
+{
+public:
+    MahonyFilter();
+    virtual ~MahonyFilter() = 0;
+
+protected:
+    void integrate(float wx, float wy, float wz, const float error[3]);
+};
+
+/**
+ * @brief   Applies the controller and integrates the gyroscope rates.
+ * @details Adds the proportional and integral terms of the error to the
+ *          gyroscope rates, integrates them over one time step with the
+ *          selected integrator and normalizes the result. Inline so that the
+ *          per sample loops of the burst updates compile to a single kernel.
+ *
+ * @param[in] wx    The gyroscope X axis measurement in rad/s.
+ * @param[in] wy    The gyroscope Y axis measurement in rad/s.
+ * @param[in] wz    The gyroscope Z axis measurement in rad/s.
+ * @param[in] error The error against the references in radians.
+ */
+inline void MahonyFilter::integrate(float wx, float wy, float wz,
+                                    const float error[3])
+{
+    feedback(wx, wy, wz, error);
+    gyroStep(SEq_hat, Quaternion(0.0f, wx, wy, wz));
+    SEq_hat.normalize();
+}
+
+#endif // MAHONY_FILTER_H
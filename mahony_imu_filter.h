@@ -0,0 +1,55 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  mahony_imu_filter.h
+ * @brief Mahony inertial measurement unit (IMU) filter class.
+ */
+
+#ifndef MAHONY_IMU_FILTER_H
+#define MAHONY_IMU_FILTER_H
+
+#include <stddef.h>
+#include "mahony_filter.h"
+
+/**
+ * @brief   Mahony IMU filter.
+ * @details Mahony filter for a system with a gyroscope and an accelerometer
+ *          (6DoF). Gravity is the only reference, so the heading drifts with
+ *          the gyroscope.
+ */
+class MahonyIMUFilter : public MahonyFilter
+{
+public:
+    MahonyIMUFilter();
+    void align(float ax, float ay, float az);
+    void update(float wx, float wy, float wz,
+                float ax, float ay, float az);
+    size_t update(const float *samples, const size_t count,
+                  Quaternion *orientations, const size_t decimation);
+
+private:
+    void step(float wx, float wy, float wz,
+              float ax, float ay, float az);
+};
+
+#endif // MAHONY_IMU_FILTER_H
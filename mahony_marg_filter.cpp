@@ -0,0 +1,164 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  mahony_marg_filter.cpp
+ * @brief Mahony MARG filter implementation.
+ */
+
+#include "mahony_marg_filter.h"
+#include "quaternion.h"
+
+/**
+ * @brief   Default constructor.
+ * @details Initializes the filter to a known state.
+ */
+MahonyMARGFilter::MahonyMARGFilter() :
+    MahonyFilter()
+{
+}
+
+/**
+ * @brief   Aligns the estimated orientation with gravity and magnetic north.
+ * @details Sets the estimated orientation directly from a single
+ *          accelerometer and magnetometer measurement, taken while the sensor
+ *          is not accelerating.
+ * @post    The estimated orientation is replaced.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void MahonyMARGFilter::align(float ax, float ay, float az,
+                             float mx, float my, float mz)
+{
+    SEq_hat = headingOrientation(ax, ay, az, mx, my, mz);
+}
+
+/**
+ * @brief   Updates estimated orientation.
+ * @details Executes the filter algorithm and updates the estimated
+ *          orientation.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @pre     The proper units must be used for the input parameters.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in] wx The gyroscope X axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wy The gyroscope Y axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] wz The gyroscope Z axis measurement in
+ *               @f$\frac{\text{rad}}{\text{s}}@f$.
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void MahonyMARGFilter::update(float wx, float wy, float wz,
+                              float ax, float ay, float az,
+                              float mx, float my, float mz)
+{
+    const uint32_t started = updateStarted();
+    step(wx, wy, wz, ax, ay, az, mx, my, mz);
+    updateFinished(started);
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of samples.
+ * @details Runs the filter on each sample of a FIFO burst in turn, all taken
+ *          at the sample rate, as if update() was called for each. The
+ *          latency histograms record the whole burst as one update.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The samples, each the three gyroscope axes in
+ *                          rad/s, the three accelerometer axes in units of
+ *                          gravity and the three magnetometer axes.
+ * @param[in]  count        The number of samples.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t MahonyMARGFilter::update(const float *samples, const size_t count,
+                                Quaternion *orientations,
+                                const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += 9)
+    {
+        step(samples[0], samples[1], samples[2],
+             samples[3], samples[4], samples[5],
+             samples[6], samples[7], samples[8]);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Runs the filter algorithm on one sample.
+ * @details The gravity error and the heading error, from the measured flux
+ *          rotated into the earth frame, are summed and fed back through the
+ *          controller. A zero measurement drops its reference.
+ */
+inline void MahonyMARGFilter::step(float wx, float wy, float wz,
+                                   float ax, float ay, float az,
+                                   float mx, float my, float mz)
+{
+    // Auxiliary variables to avoid repeated calculations
+    const Quaternion &q = SEq_hat;
+    const float ww = q.w * q.w;
+    const float xx = q.x * q.x;
+    const float yy = q.y * q.y;
+    const float zz = q.z * q.z;
+    const float wx_q = q.w * q.x;
+    const float wy_q = q.w * q.y;
+    const float wz_q = q.w * q.z;
+    const float xy = q.x * q.y;
+    const float xz = q.x * q.z;
+    const float yz = q.y * q.z;
+
+    // Bottom row of the rotation matrix, the direction of gravity in the
+    // sensor frame
+    const float vertical[3] = { 2.0f * (xz - wy_q),
+                                2.0f * (wx_q + yz),
+                                ww - xx - yy + zz };
+
+    float error[3];
+    gravityError(ax, ay, az, vertical, error);
+
+    // Rotate the flux into the horizontal plane of the earth frame
+    const float hx = ((ww + xx - yy - zz) * mx) + (2.0f * (xy - wz_q) * my) + (2.0f * (xz + wy_q) * mz);
+    const float hy = (2.0f * (xy + wz_q) * mx) + ((ww - xx + yy - zz) * my) + (2.0f * (yz - wx_q) * mz);
+    headingError(hx, hy, vertical, error);
+    integrate(wx, wy, wz, error);
+}
@@ -0,0 +1,59 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  mahony_marg_filter.h
+ * @brief Mahony Magnetic, Angular Rate and Gravity (MARG) filter class.
+ */
+
+#ifndef MAHONY_MARG_FILTER_H
+#define MAHONY_MARG_FILTER_H
+
+#include <stddef.h>
+#include "mahony_filter.h"
+
+/**
+ * @brief   Mahony MARG filter.
+ * @details Mahony filter for a system with a gyroscope, an accelerometer and
+ *          a magnetometer (9DoF). Gravity and the horizontal direction of the
+ *          magnetic flux are both references, so the heading and the bias
+ *          about the vertical are observed too.
+ */
+class MahonyMARGFilter : public MahonyFilter
+{
+public:
+    MahonyMARGFilter();
+    void align(float ax, float ay, float az,
+               float mx, float my, float mz);
+    void update(float wx, float wy, float wz,
+                float ax, float ay, float az,
+                float mx, float my, float mz);
+    size_t update(const float *samples, const size_t count,
+                  Quaternion *orientations, const size_t decimation);
+
+private:
+    void step(float wx, float wy, float wz,
+              float ax, float ay, float az,
+              float mx, float my, float mz);
+};
+
+#endif // MAHONY_MARG_FILTER_H
@@ -43,6 +43,31 @@ MARGFilter::MARGFilter() :
 {
 }
 
+/**
+ * @brief   Aligns the estimated orientation with gravity and magnetic north.
+ * @details Sets the estimated orientation and the earth frame magnetic flux
+ *          directly from a single accelerometer and magnetometer measurement,
+ *          taken while the sensor is not accelerating, instead of letting the
+ *          filter converge from the identity.
+ * @post    The estimated orientation and magnetic flux are replaced.
+ *
+ * @param[in] ax The accelerometer X axis measurement in units of gravity.
+ * @param[in] ay The accelerometer Y axis measurement in units of gravity.
+ * @param[in] az The accelerometer Z axis measurement in units of gravity.
+ * @param[in] mx The magnetometer X axis measurement in units of magnetic flux.
+ * @param[in] my The magnetometer Y axis measurement in units of magnetic flux.
+ * @param[in] mz The magnetometer Z axis measurement in units of magnetic flux.
+ */
+void MARGFilter::align(float ax, float ay, float az,
+                       float mx, float my, float mz)
+{
+    SEq_hat = headingOrientation(ax, ay, az, mx, my, mz);
+
+    // Normalize the magnetic flux vector to have only x and z components
+    const Quaternion Eh = SEq_hat * Quaternion(0.0f, mx, my, mz).normalized() * SEq_hat.conjugate();
+    Eb_hat = Quaternion(0.0f, sqrt((Eh.x * Eh.x) + (Eh.y * Eh.y)), 0.0f, Eh.z);
+}
+
 /**
  * @brief   Sets the gyroscope drift gain.
  * @details Sets the zeta filter gain. This gain represents the rate of
@@ -84,6 +109,263 @@ void MARGFilter::update(float wx, float wy, float wz,
                         float ax, float ay, float az,
                         float mx, float my, float mz)
 {
+    const uint32_t started = updateStarted();
+    step(wx, wy, wz, ax, ay, az, mx, my, mz);
+    updateFinished(started);
+}
+
+/**
+ * @brief   Updates estimated orientation with one device record.
+ * @details Converts each count of the record through a format which
+ *          describes the device as it is used, so that raw readings need no
+ *          conversion beforehand.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in] record The record, as read from the device.
+ * @param[in] format The layout and conversion of the record.
+ */
+void MARGFilter::update(const int16_t *record, const SensorFormat &format)
+{
+    const uint32_t started = updateStarted();
+    step(format.value(record, SensorFormat::GYRO_X),
+         format.value(record, SensorFormat::GYRO_Y),
+         format.value(record, SensorFormat::GYRO_Z),
+         format.value(record, SensorFormat::ACCEL_X),
+         format.value(record, SensorFormat::ACCEL_Y),
+         format.value(record, SensorFormat::ACCEL_Z),
+         format.value(record, SensorFormat::MAG_X),
+         format.value(record, SensorFormat::MAG_Y),
+         format.value(record, SensorFormat::MAG_Z));
+    updateFinished(started);
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of samples.
+ * @details Runs the filter on each sample of a FIFO burst in turn, all taken
+ *          at the sample rate, as if update() was called for each. The
+ *          latency histograms record the whole burst as one update.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The samples, each the three gyroscope axes in
+ *                          rad/s followed by the three accelerometer and the
+ *                          three magnetometer axes.
+ * @param[in]  count        The number of samples.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t MARGFilter::update(const float *samples, const size_t count,
+                          Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += 9)
+    {
+        step(samples[0], samples[1], samples[2],
+             samples[3], samples[4], samples[5],
+             samples[6], samples[7], samples[8]);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of calibrated samples.
+ * @details As the floating point burst, but with each sample corrected by a
+ *          calibration as it is used, rather than in a pass of its own.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The samples, each the three gyroscope axes
+ *                          followed by the three accelerometer and the three
+ *                          magnetometer axes, before calibration.
+ * @param[in]  count        The number of samples.
+ * @param[in]  calibration  The calibration of the device.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t MARGFilter::update(const float *samples, const size_t count,
+                          const SensorCalibration &calibration,
+                          Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += 9)
+    {
+        float wx = samples[0], wy = samples[1], wz = samples[2];
+        float ax = samples[3], ay = samples[4], az = samples[5];
+        float mx = samples[6], my = samples[7], mz = samples[8];
+        calibration.apply(SensorCalibration::SENSOR_GYRO, wx, wy, wz);
+        calibration.apply(SensorCalibration::SENSOR_ACCEL, ax, ay, az);
+        calibration.apply(SensorCalibration::SENSOR_MAG, mx, my, mz);
+        step(wx, wy, wz, ax, ay, az, mx, my, mz);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of raw samples.
+ * @details As the floating point burst, but with the counts read straight
+ *          from the sensor FIFO. The gyroscope counts are scaled as they are
+ *          used. The accelerometer and magnetometer counts need no scale
+ *          because only their directions are used, provided the three axes
+ *          of each sensor share one scale.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The samples, each the three gyroscope axes
+ *                          followed by the three accelerometer and the three
+ *                          magnetometer axes.
+ * @param[in]  count        The number of samples.
+ * @param[in]  gyroScale    The gyroscope rate of one count in rad/s.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t MARGFilter::update(const int16_t *samples, const size_t count,
+                          const float gyroScale,
+                          Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += 9)
+    {
+        step(gyroScale * samples[0], gyroScale * samples[1],
+             gyroScale * samples[2],
+             samples[3], samples[4], samples[5],
+             samples[6], samples[7], samples[8]);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of device records.
+ * @details As the floating point burst, but with each record read and
+ *          converted through a format which describes the device, so the
+ *          scale, bias and mounting of every axis are applied as the counts
+ *          are used. Records may hold words which are not used, and are
+ *          format.stride() words apart.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The records, as written by the device.
+ * @param[in]  count        The number of records.
+ * @param[in]  format       The layout and conversion of the records.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t MARGFilter::update(const int16_t *samples, const size_t count,
+                          const SensorFormat &format,
+                          Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    const size_t stride = format.stride();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += stride)
+    {
+        step(format.value(samples, SensorFormat::GYRO_X),
+             format.value(samples, SensorFormat::GYRO_Y),
+             format.value(samples, SensorFormat::GYRO_Z),
+             format.value(samples, SensorFormat::ACCEL_X),
+             format.value(samples, SensorFormat::ACCEL_Y),
+             format.value(samples, SensorFormat::ACCEL_Z),
+             format.value(samples, SensorFormat::MAG_X),
+             format.value(samples, SensorFormat::MAG_Y),
+             format.value(samples, SensorFormat::MAG_Z));
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Updates estimated orientation with a burst of device records and a
+ *          calibration.
+ * @details As the burst of device records, with each converted reading then
+ *          corrected by the calibration before it is used, so that a raw
+ *          FIFO burst needs neither a conversion nor a calibration pass.
+ * @pre     The sample rate must be set to a value greater than zero.
+ * @post    The estimated orientation is updated.
+ *
+ * @param[in]  samples      The records, as written by the device.
+ * @param[in]  count        The number of records.
+ * @param[in]  format       The layout and conversion of the records.
+ * @param[in]  calibration  The calibration of the converted readings.
+ * @param[out] orientations Receives the orientation after every
+ *                          @p decimation samples, may be null.
+ * @param[in]  decimation   The number of samples per orientation written.
+ * @return The number of orientations written.
+ */
+size_t MARGFilter::update(const int16_t *samples, const size_t count,
+                          const SensorFormat &format,
+                          const SensorCalibration &calibration,
+                          Quaternion *orientations, const size_t decimation)
+{
+    const uint32_t started = updateStarted();
+    const size_t stride = format.stride();
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i, samples += stride)
+    {
+        float wx = format.value(samples, SensorFormat::GYRO_X);
+        float wy = format.value(samples, SensorFormat::GYRO_Y);
+        float wz = format.value(samples, SensorFormat::GYRO_Z);
+        float ax = format.value(samples, SensorFormat::ACCEL_X);
+        float ay = format.value(samples, SensorFormat::ACCEL_Y);
+        float az = format.value(samples, SensorFormat::ACCEL_Z);
+        float mx = format.value(samples, SensorFormat::MAG_X);
+        float my = format.value(samples, SensorFormat::MAG_Y);
+        float mz = format.value(samples, SensorFormat::MAG_Z);
+        calibration.apply(SensorCalibration::SENSOR_GYRO, wx, wy, wz);
+        calibration.apply(SensorCalibration::SENSOR_ACCEL, ax, ay, az);
+        calibration.apply(SensorCalibration::SENSOR_MAG, mx, my, mz);
+        step(wx, wy, wz, ax, ay, az, mx, my, mz);
+        if (burstOutput(decimation) && orientations)
+        {
+            orientations[written++] = SEq_hat;
+        }
+    }
+    updateFinished(started);
+    return written;
+}
+
+/**
+ * @brief   Runs the filter algorithm on one sample.
+ * @details A single step of gradient descent on the gravity and magnetic
+ *          field objective functions, the gyroscope bias update and the
+ *          integration of the gyroscope rates, followed by the re-estimation
+ *          of the earth magnetic flux.
+ */
+inline void MARGFilter::step(float wx, float wy, float wz,
+                             float ax, float ay, float az,
+                             float mx, float my, float mz)
+{
+    FUSION_PROFILE_BEGIN(profile);
+
     // Auxiliary variables to avoid repeated calculations
     const Quaternion two_SEq = 2.0f * SEq_hat;
     const Quaternion two_Eb = 2.0f * Eb_hat;
@@ -93,6 +375,12 @@ void MARGFilter::update(float wx, float wy, float wz,
     // Compute the gravity objective function
     const Quaternion f_g = SEq_hat.conjugate() * Eg_hat * SEq_hat
             - Quaternion(0.0f, ax, ay, az).normalized();
+    FUSION_PROFILE_MARK(profile, STAGE_GRAVITY_OBJECTIVE);
+
+    // Compute the magnetic field objective function
+    const Quaternion Sm_hat = Quaternion(0.0f, mx, my, mz).normalized();
+    const Quaternion f_b = SEq_hat.conjugate() * Eb_hat * SEq_hat - Sm_hat;
+    FUSION_PROFILE_MARK(profile, STAGE_MAGNETIC_OBJECTIVE);
 
     // Compute the gravity Jacobian matrix
     // Negative elements are negated in matrix multiplication
@@ -103,10 +391,6 @@ void MARGFilter::update(float wx, float wy, float wz,
     const float J_32 = 2.0f * J_14_or_21;
     const float J_33 = 2.0f * J_11_or_24;
 
-    // Compute the magnetic field objective function
-    const Quaternion Sm_hat = Quaternion(0.0f, mx, my, mz).normalized();
-    const Quaternion f_b = SEq_hat.conjugate() * Eb_hat * SEq_hat - Sm_hat;
-
     // Compute the magnetic field Jacobian matrix
     // Negative elements are negated in matrix multiplication
     const float J_41 = two_Eb_z_SEq.y;
@@ -121,6 +405,7 @@ void MARGFilter::update(float wx, float wy, float wz,
     const float J_62 = two_Eb_x_SEq.z - 2.0f * two_Eb_z_SEq.x;
     const float J_63 = two_Eb_x_SEq.w - 2.0f * two_Eb_z_SEq.y;
     const float J_64 = two_Eb_x_SEq.x;
+    FUSION_PROFILE_MARK(profile, STAGE_JACOBIANS);
 
     // Compute the normalized gradient descent (matrix multiplication)
     const Quaternion SEq_hat_dot =
@@ -128,22 +413,89 @@ void MARGFilter::update(float wx, float wy, float wz,
                        J_12_or_23 * f_g.x + J_13_or_22 * f_g.y - J_32 * f_g.z + J_42 * f_b.x + J_52 * f_b.y + J_62 * f_b.z,
                        J_12_or_23 * f_g.y - J_33 * f_g.z - J_13_or_22 * f_g.x - J_43 * f_b.x + J_53 * f_b.y + J_63 * f_b.z,
                        J_14_or_21 * f_g.x + J_11_or_24 * f_g.y - J_44 * f_b.x - J_54 * f_b.y + J_64 * f_b.z).normalized();
+    FUSION_PROFILE_MARK(profile, STAGE_GRADIENT);
 
     // Compute the angular estimated direction of gyroscope error then compute
-    // and remove the gyroscope biases while computing the quaternion
-    // derivative measured by the gyroscope
+    // and remove the gyroscope biases from the measured rates
     Sw_b += zeta * (two_SEq.conjugate() * SEq_hat_dot) * sampleRate;
-    const Quaternion SEq_dot_omega = 0.5f * SEq_hat * (Quaternion(0.0f, wx, wy, wz) - Sw_b);
+    const Quaternion Sw = Quaternion(0.0f, wx, wy, wz) - Sw_b;
+    FUSION_PROFILE_MARK(profile, STAGE_BIAS);
 
-    // Compute then integrate the estimated quaternion derivative
-    SEq_hat += (SEq_dot_omega - (beta * SEq_hat_dot)) * sampleRate;
+    // Integrate the gyroscope rates, then the gradient descent correction
+    gyroStep(SEq_hat, Sw);
+    SEq_hat -= (beta * SEq_hat_dot) * sampleRate;
+    FUSION_PROFILE_MARK(profile, STAGE_INTEGRATION);
 
     // Normalize the output quaternion
     SEq_hat.normalize();
+    FUSION_PROFILE_MARK(profile, STAGE_NORMALIZATION);
     
     // Compute the magnetic flux in the earth frame
     const Quaternion Eh_hat = SEq_hat * Sm_hat * SEq_hat.conjugate();
 
     // Normalize the magnetic flux vector to have only x and z components
     Eb_hat = Quaternion(0.0f, sqrt((Eh_hat.x * Eh_hat.x) + (Eh_hat.y * Eh_hat.y)), 0.0f, Eh_hat.z);
+    FUSION_PROFILE_MARK(profile, STAGE_FLUX);
+}
+
+/**
+ * @brief   Name of an update stage.
+ * @details A short name for a stage, suitable for printing profiles.
+ *
+ * @param[in] stage The stage.
+ * @return The name, or "unknown" for a stage out of range.
+ */
+const char *MARGFilter::stageName(const Stage stage)
+{
+    static const char *const names[STAGE_COUNT] =
+    {
+        "gravity objective",
+        "magnetic objective",
+        "jacobians",
+        "gradient",
+        "bias",
+        "integration",
+        "normalization",
+        "flux"
+    };
+    return (stage < STAGE_COUNT) ? names[stage] : "unknown";
+}
+
+#ifdef FUSION_PROFILE
+/**
+ * @brief   Cycles spent in each stage of update.
+ * @details Only available when the library is built with FUSION_PROFILE
+ *          defined. Stages are indexed by the Stage enumeration.
+ */
+const StageProfile &MARGFilter::stageProfile() const
+{
+    return profile;
+}
+
+/**
+ * @brief Clears the cycles counted by update.
+ */
+void MARGFilter::resetStageProfile()
+{
+    profile.reset();
+}
+
+/**
+ * @brief   Writes the stage profile as text.
+ * @details See StageProfile::dump for the format.
+ *
+ * @param[out] buffer The buffer to write to.
+ * @param[in]  size   The size of the buffer in bytes.
+ * @return The number of characters the whole profile needs, not counting the
+ *         terminator.
+ */
+size_t MARGFilter::dumpStageProfile(char *buffer, const size_t size) const
+{
+    const char *names[STAGE_COUNT];
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        names[i] = stageName(static_cast<Stage>(i));
+    }
+    return profile.dump(buffer, size, names, STAGE_COUNT);
 }
+#endif
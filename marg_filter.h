@@ -29,7 +29,12 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef MARG_FILTER_H
 #define MARG_FILTER_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "filter.h"
+#include "sensor_calibration.h"
+#include "sensor_format.h"
+#include "stage_profile.h"
 
 /**
  * @brief   MARG filter.
@@ -40,19 +45,67 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 class MARGFilter : public Filter
 {
 public:
+    /**
+     * @brief Stages of an update, in the order they run.
+     */
+    enum Stage
+    {
+        STAGE_GRAVITY_OBJECTIVE,  /**< Gravity objective function */
+        STAGE_MAGNETIC_OBJECTIVE, /**< Magnetic field objective function */
+        STAGE_JACOBIANS,          /**< Gravity and magnetic Jacobians */
+        STAGE_GRADIENT,           /**< Normalized gradient descent */
+        STAGE_BIAS,               /**< Gyroscope bias update */
+        STAGE_INTEGRATION,        /**< Quaternion derivative integration */
+        STAGE_NORMALIZATION,      /**< Orientation normalization */
+        STAGE_FLUX,               /**< Earth magnetic flux re-estimation */
+        STAGE_COUNT               /**< Number of stages */
+    };
+
     MARGFilter();
+    void align(float ax, float ay, float az,
+               float mx, float my, float mz);
     void setGyroDriftGain(const float drift);
     void update(float wx, float wy, float wz,
                 float ax, float ay, float az,
                 float mx, float my, float mz);
+    void update(const int16_t *record, const SensorFormat &format);
+    size_t update(const float *samples, const size_t count,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const float *samples, const size_t count,
+                  const SensorCalibration &calibration,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const int16_t *samples, const size_t count,
+                  const float gyroScale,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const int16_t *samples, const size_t count,
+                  const SensorFormat &format,
+                  Quaternion *orientations, const size_t decimation);
+    size_t update(const int16_t *samples, const size_t count,
+                  const SensorFormat &format,
+                  const SensorCalibration &calibration,
+                  Quaternion *orientations, const size_t decimation);
+
+    static const char *stageName(const Stage stage);
+#ifdef FUSION_PROFILE
+    const StageProfile &stageProfile() const;
+    void resetStageProfile();
+    size_t dumpStageProfile(char *buffer, const size_t size) const;
+#endif
 
 private:
+    void step(float wx, float wy, float wz,
+              float ax, float ay, float az,
+              float mx, float my, float mz);
+
     Quaternion Eb_hat; /**< Normalized magnetic flux in the earth frame */
     Quaternion Sw_b;   /**< The angular estimated direction of gyroscope
                             error */
     float zeta;        /**< Filter gain which represents the rate of
                             convergence to remove gyroscope measurement error
                             which are not mean zero */
+#ifdef FUSION_PROFILE
+    StageProfile profile; /**< Cycles spent in each stage of update */
+#endif
 };
 
 #endif // MARG_FILTER_H
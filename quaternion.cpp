@@ -74,6 +74,84 @@ Quaternion::Quaternion(const float w, const float x, const float y, const float
 {
 }
 
+/**
+ * @brief   Creates a quaternion from a rotation matrix.
+ * @details The inverse of convertToRotationMatrix(). The component with the
+ *          largest magnitude is found from the diagonal first and the others
+ *          from the off-diagonal elements, which keeps the conversion
+ *          accurate for every rotation. The real component of the result is
+ *          not negative.
+ * @pre     The matrix must be orthonormal with a determinant of one.
+ *
+ * @param[in] m The rotation matrix, indexed by row then column.
+ * @return      The versor representing the rotation.
+ */
+Quaternion Quaternion::fromRotationMatrix(const float m[3][3])
+{
+    const float trace = m[0][0] + m[1][1] + m[2][2];
+    Quaternion q;
+    if (trace > 0.0f)
+    {
+        const float s = 0.5f / sqrt(trace + 1.0f);
+        q = Quaternion(0.25f / s, (m[2][1] - m[1][2]) * s,
+                       (m[0][2] - m[2][0]) * s, (m[1][0] - m[0][1]) * s);
+    }
+    else if ((m[0][0] > m[1][1]) && (m[0][0] > m[2][2]))
+    {
+        const float s = 0.5f / sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]);
+        q = Quaternion((m[2][1] - m[1][2]) * s, 0.25f / s,
+                       (m[0][1] + m[1][0]) * s, (m[0][2] + m[2][0]) * s);
+    }
+    else if (m[1][1] > m[2][2])
+    {
+        const float s = 0.5f / sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]);
+        q = Quaternion((m[0][2] - m[2][0]) * s, (m[0][1] + m[1][0]) * s,
+                       0.25f / s, (m[1][2] + m[2][1]) * s);
+    }
+    else
+    {
+        const float s = 0.5f / sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]);
+        q = Quaternion((m[1][0] - m[0][1]) * s, (m[0][2] + m[2][0]) * s,
+                       (m[1][2] + m[2][1]) * s, 0.25f / s);
+    }
+    return (q.w < 0.0f) ? -q : q;
+}
+
+/**
+ * @brief   Creates a quaternion from a rotation vector.
+ * @details The rotation vector points along the axis of rotation and its
+ *          length is the angle rotated by, so this is the exponential map.
+ *          Integrating an angular rate @f$\omega@f$ over a time step
+ *          @f$\Delta t@f$ exactly is the rotation vector
+ *          @f$\omega \Delta t@f$.
+ * @f[
+ *   q = \begin{bmatrix}
+ *   \cos(\frac{\theta}{2}) &
+ *   \frac{\vec{v}}{\theta} \sin(\frac{\theta}{2})
+ *   \end{bmatrix}, \quad \theta = \|\vec{v}\|
+ * @f]
+ *
+ * @param[in] x The X axis component of the rotation vector.
+ * @param[in] y The Y axis component of the rotation vector.
+ * @param[in] z The Z axis component of the rotation vector.
+ * @return      The versor representing the rotation.
+ */
+Quaternion Quaternion::fromRotationVector(const float x, const float y, const float z)
+{
+    const float angle_squared = (x * x) + (y * y) + (z * z);
+
+    // Use the Taylor series for small angles where sin(angle) / angle is
+    // poorly conditioned
+    if (angle_squared < 1.0e-8f)
+    {
+        const float s = 0.5f - (angle_squared / 48.0f);
+        return Quaternion(1.0f - (angle_squared / 8.0f), x * s, y * s, z * s);
+    }
+    const float angle = sqrt(angle_squared);
+    const float s = sin(0.5f * angle) / angle;
+    return Quaternion(cos(0.5f * angle), x * s, y * s, z * s);
+}
+
 /**
  * @brief   Computes the conjugate.
  * @details The quaternion conjugate is defined as a quaternion with its
@@ -156,6 +234,37 @@ void Quaternion::convertToEulerAngles(float &roll, float &pitch, float &yaw) con
     yaw = atan2(2.0f * ((w * z) + (x * y)), 1.0f - (2.0f * ((y * y) + (z * z))));
 }
 
+/**
+ * @brief   Converts the quaternion to a rotation matrix.
+ * @details Computes the direction cosine matrix which rotates a vector the
+ *          same way as @f$q v q^{*}@f$.
+ * @f[
+ *   M = \begin{bmatrix}
+ *   1 - 2(q_{2}^{2} + q_{3}^{2}) & 2({q_1}{q_2} - {q_0}{q_3}) &
+ *   2({q_1}{q_3} + {q_0}{q_2}) \\
+ *   2({q_1}{q_2} + {q_0}{q_3}) & 1 - 2(q_{1}^{2} + q_{3}^{2}) &
+ *   2({q_2}{q_3} - {q_0}{q_1}) \\
+ *   2({q_1}{q_3} - {q_0}{q_2}) & 2({q_2}{q_3} + {q_0}{q_1}) &
+ *   1 - 2(q_{1}^{2} + q_{2}^{2})
+ *   \end{bmatrix}
+ * @f]
+ * @pre The quaternion must be a versor (unit quaternion).
+ *
+ * @param[out] m The rotation matrix, indexed by row then column.
+ */
+void Quaternion::convertToRotationMatrix(float m[3][3]) const
+{
+    m[0][0] = 1.0f - (2.0f * ((y * y) + (z * z)));
+    m[0][1] = 2.0f * ((x * y) - (w * z));
+    m[0][2] = 2.0f * ((x * z) + (w * y));
+    m[1][0] = 2.0f * ((x * y) + (w * z));
+    m[1][1] = 1.0f - (2.0f * ((x * x) + (z * z)));
+    m[1][2] = 2.0f * ((y * z) - (w * x));
+    m[2][0] = 2.0f * ((x * z) - (w * y));
+    m[2][1] = 2.0f * ((y * z) + (w * x));
+    m[2][2] = 1.0f - (2.0f * ((x * x) + (y * y)));
+}
+
 /**
  * @brief   Dot product multiplication.
  * @details Performs dot product multiplication on quaternions. For cross
@@ -214,11 +323,16 @@ float Quaternion::norm() const
 /**
  * @brief   Normalizes the quaternion.
  * @details Computes and sets the quaternion to be normalized. This produces a
- *          versor (unit quaternion).
+ *          versor (unit quaternion). A quaternion with a norm of zero is left
+ *          unchanged.
  */
 void Quaternion::normalize()
 {
-    *this /= norm();
+    const float n = norm();
+    if (0.0f != n)
+    {
+        *this /= n;
+    }
 }
 
 /**
@@ -229,11 +343,19 @@ void Quaternion::normalize()
  *   \hat{q} = \frac{q}{\|q\|}
  * @f]
  *
- * @return A copy of the quaternion versor.
+ * @retval versor The quaternion versor.
+ * @retval zero   A copy of the quaternion if the norm is zero.
+ * @return        A copy of the quaternion versor, or of the quaternion itself
+ *                if it has a norm of zero.
  */
 Quaternion Quaternion::normalized() const
 {
-    return *this / norm();
+    const float n = norm();
+    if (0.0f == n)
+    {
+        return *this;
+    }
+    return *this / n;
 }
 
 /**
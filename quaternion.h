@@ -40,9 +40,12 @@ struct Quaternion
     Quaternion();
     Quaternion(const Quaternion &q);
     Quaternion(const float w, const float x, const float y, const float z);
+    static Quaternion fromRotationMatrix(const float m[3][3]);
+    static Quaternion fromRotationVector(const float x, const float y, const float z);
     Quaternion conjugate() const;
     void convertToAxisAngle(float &wx, float &wy, float &wz, float &angle) const;
     void convertToEulerAngles(float &roll, float &pitch, float &yaw) const;
+    void convertToRotationMatrix(float m[3][3]) const;
     float dot(const Quaternion &q) const;
     Quaternion inverse() const;
     float norm() const;
@@ -0,0 +1,325 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  quaternion_codec.cpp
+ * @brief Quaternion codec implementation.
+ */
+
+#include <math.h>
+#include "quaternion_codec.h"
+
+namespace
+{
+
+/**
+ * @brief Largest magnitude a component other than the largest one can have.
+ */
+const float component_limit = 0.707106781f;
+
+/**
+ * @brief   Packs a versor using the smallest three encoding.
+ * @details The index of the largest component is stored in the two bits
+ *          directly above the three quantized components.
+ *
+ * @param[in] q    The versor to pack.
+ * @param[in] bits The number of bits used to store each component.
+ * @return         The packed quaternion in the low bits of the result.
+ */
+inline uint64_t pack(const Quaternion &q, const unsigned int bits)
+{
+    const float c[4] = { q.w, q.x, q.y, q.z };
+    const float a[4] = { fabs(q.w), fabs(q.x), fabs(q.y), fabs(q.z) };
+
+    // Find the index of the largest component by comparing pairs
+    const unsigned int i01 = (a[1] > a[0]) ? 1 : 0;
+    const unsigned int i23 = (a[3] > a[2]) ? 3 : 2;
+    const unsigned int largest = (a[i23] > a[i01]) ? i23 : i01;
+
+    // Flip the hemisphere so that the dropped component is positive
+    const float sign = (c[largest] < 0.0f) ? -1.0f : 1.0f;
+    const uint32_t max_value = (1UL << bits) - 1UL;
+    const float scale = sign * (static_cast<float>(max_value) / (2.0f * component_limit));
+
+    uint64_t packed = largest;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+        {
+            continue;
+        }
+        float value = (c[i] * scale) + (0.5f * static_cast<float>(max_value)) + 0.5f;
+        value = (value < 0.0f) ? 0.0f : value;
+        uint32_t quantized = static_cast<uint32_t>(value);
+        quantized = (quantized > max_value) ? max_value : quantized;
+        packed = (packed << bits) | quantized;
+    }
+    return packed;
+}
+
+/**
+ * @brief   Unpacks a versor stored using the smallest three encoding.
+ * @see     pack()
+ *
+ * @param[in] packed The packed quaternion.
+ * @param[in] bits   The number of bits used to store each component.
+ * @return           The decoded versor.
+ */
+inline Quaternion unpack(const uint64_t packed, const unsigned int bits)
+{
+    const uint32_t max_value = (1UL << bits) - 1UL;
+    const float scale = (2.0f * component_limit) / static_cast<float>(max_value);
+    const unsigned int largest = static_cast<unsigned int>(packed >> (3 * bits)) & 0x3;
+
+    float c[4];
+    float sum = 0.0f;
+    unsigned int shift = 3 * bits;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+        {
+            continue;
+        }
+        shift -= bits;
+        const uint32_t quantized = static_cast<uint32_t>(packed >> shift) & max_value;
+        c[i] = (static_cast<float>(quantized) * scale) - component_limit;
+        sum += c[i] * c[i];
+    }
+    c[largest] = (sum < 1.0f) ? sqrt(1.0f - sum) : 0.0f;
+    return Quaternion(c[0], c[1], c[2], c[3]);
+}
+
+} // namespace
+
+/**
+ * @brief   Encodes a versor into 32 bits.
+ * @details Each of the three smallest components is stored using 10 bits.
+ * @pre     The quaternion must be a versor (unit quaternion).
+ *
+ * @param[in] q The versor to encode.
+ * @return      The packed quaternion.
+ */
+uint32_t QuaternionCodec::encode32(const Quaternion &q)
+{
+    return static_cast<uint32_t>(pack(q, 10));
+}
+
+/**
+ * @brief   Decodes a versor from 32 bits.
+ * @see     QuaternionCodec::encode32()
+ *
+ * @param[in] packed The packed quaternion.
+ * @return           The decoded versor.
+ */
+Quaternion QuaternionCodec::decode32(const uint32_t packed)
+{
+    return unpack(packed, 10);
+}
+
+/**
+ * @brief   Encodes a versor into 48 bits.
+ * @details Each of the three smallest components is stored using 15 bits. The
+ *          result is held in the low 48 bits of the returned value.
+ * @pre     The quaternion must be a versor (unit quaternion).
+ *
+ * @param[in] q The versor to encode.
+ * @return      The packed quaternion.
+ */
+uint64_t QuaternionCodec::encode48(const Quaternion &q)
+{
+    return pack(q, 15);
+}
+
+/**
+ * @brief   Decodes a versor from 48 bits.
+ * @see     QuaternionCodec::encode48()
+ *
+ * @param[in] packed The packed quaternion held in the low 48 bits.
+ * @return           The decoded versor.
+ */
+Quaternion QuaternionCodec::decode48(const uint64_t packed)
+{
+    return unpack(packed, 15);
+}
+
+/**
+ * @brief   Encodes a versor into 64 bits.
+ * @details Each of the three smallest components is stored using 20 bits.
+ * @pre     The quaternion must be a versor (unit quaternion).
+ *
+ * @param[in] q The versor to encode.
+ * @return      The packed quaternion.
+ */
+uint64_t QuaternionCodec::encode64(const Quaternion &q)
+{
+    return pack(q, 20);
+}
+
+/**
+ * @brief   Decodes a versor from 64 bits.
+ * @see     QuaternionCodec::encode64()
+ *
+ * @param[in] packed The packed quaternion.
+ * @return           The decoded versor.
+ */
+Quaternion QuaternionCodec::decode64(const uint64_t packed)
+{
+    return unpack(packed, 20);
+}
+
+/**
+ * @brief   Encodes an array of versors into 32 bits each.
+ * @see     QuaternionCodec::encode32(const Quaternion &)
+ *
+ * @param[in]  q      The versors to encode.
+ * @param[out] packed The packed quaternions, one per versor.
+ * @param[in]  count  The number of versors.
+ */
+void QuaternionCodec::encode32(const Quaternion *q, uint32_t *packed, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        packed[i] = static_cast<uint32_t>(pack(q[i], 10));
+    }
+}
+
+/**
+ * @brief   Decodes an array of versors from 32 bits each.
+ * @details The decoded versors are made continuous.
+ * @see     QuaternionCodec::makeContinuous()
+ *
+ * @param[in]  packed The packed quaternions.
+ * @param[out] q      The decoded versors, one per packed quaternion.
+ * @param[in]  count  The number of packed quaternions.
+ */
+void QuaternionCodec::decode32(const uint32_t *packed, Quaternion *q, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        q[i] = unpack(packed[i], 10);
+    }
+    makeContinuous(q, count);
+}
+
+/**
+ * @brief   Encodes an array of versors into 48 bits each.
+ * @details Each packed quaternion is written as six bytes in little endian
+ *          order so that the output has no padding.
+ * @see     QuaternionCodec::encode48(const Quaternion &)
+ *
+ * @param[in]  q      The versors to encode.
+ * @param[out] packed The packed quaternions, six bytes per versor.
+ * @param[in]  count  The number of versors.
+ */
+void QuaternionCodec::encode48(const Quaternion *q, uint8_t *packed, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t value = pack(q[i], 15);
+        uint8_t *out = packed + (6 * i);
+        for (unsigned int b = 0; b < 6; ++b)
+        {
+            out[b] = static_cast<uint8_t>(value >> (8 * b));
+        }
+    }
+}
+
+/**
+ * @brief   Decodes an array of versors from 48 bits each.
+ * @details The decoded versors are made continuous.
+ * @see     QuaternionCodec::encode48(const Quaternion *, uint8_t *, size_t)
+ * @see     QuaternionCodec::makeContinuous()
+ *
+ * @param[in]  packed The packed quaternions, six bytes per versor.
+ * @param[out] q      The decoded versors.
+ * @param[in]  count  The number of packed quaternions.
+ */
+void QuaternionCodec::decode48(const uint8_t *packed, Quaternion *q, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t *in = packed + (6 * i);
+        uint64_t value = 0;
+        for (unsigned int b = 0; b < 6; ++b)
+        {
+            value |= static_cast<uint64_t>(in[b]) << (8 * b);
+        }
+        q[i] = unpack(value, 15);
+    }
+    makeContinuous(q, count);
+}
+
+/**
+ * @brief   Encodes an array of versors into 64 bits each.
+ * @see     QuaternionCodec::encode64(const Quaternion &)
+ *
+ * @param[in]  q      The versors to encode.
+ * @param[out] packed The packed quaternions, one per versor.
+ * @param[in]  count  The number of versors.
+ */
+void QuaternionCodec::encode64(const Quaternion *q, uint64_t *packed, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        packed[i] = pack(q[i], 20);
+    }
+}
+
+/**
+ * @brief   Decodes an array of versors from 64 bits each.
+ * @details The decoded versors are made continuous.
+ * @see     QuaternionCodec::makeContinuous()
+ *
+ * @param[in]  packed The packed quaternions.
+ * @param[out] q      The decoded versors, one per packed quaternion.
+ * @param[in]  count  The number of packed quaternions.
+ */
+void QuaternionCodec::decode64(const uint64_t *packed, Quaternion *q, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        q[i] = unpack(packed[i], 20);
+    }
+    makeContinuous(q, count);
+}
+
+/**
+ * @brief   Removes sign flips from a sequence of versors.
+ * @details Negates every versor which lies in the opposite hemisphere to the
+ *          versor before it. The rotations represented are unchanged, but
+ *          the components of the sequence no longer jump between @f$q@f$
+ *          and @f$-q@f$ which keeps interpolation and differencing sane.
+ *
+ * @param[in,out] q     The versors to make continuous.
+ * @param[in]     count The number of versors.
+ */
+void QuaternionCodec::makeContinuous(Quaternion *q, size_t count)
+{
+    for (size_t i = 1; i < count; ++i)
+    {
+        if (q[i].dot(q[i - 1]) < 0.0f)
+        {
+            q[i] = -q[i];
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  quaternion_codec.h
+ * @brief Compact fixed-width encodings for unit quaternions.
+ */
+
+#ifndef QUATERNION_CODEC_H
+#define QUATERNION_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "quaternion.h"
+
+/**
+ * @brief   Quaternion codec.
+ * @details Packs versors (unit quaternions) using the smallest three
+ *          encoding. The largest component is dropped and later rebuilt from
+ *          the unit length constraint, so only its index and the three
+ *          remaining components need to be stored. Since @f$q@f$ and
+ *          @f$-q@f$ represent the same rotation, the dropped component is
+ *          always made positive which removes the need for a sign bit.
+ *
+ *          | Width  | Bits per component | Worst case angular error |
+ *          |--------|--------------------|--------------------------|
+ *          | 32 bit | 10                 | 0.25 degrees             |
+ *          | 48 bit | 15                 | 0.008 degrees            |
+ *          | 64 bit | 20                 | 0.0003 degrees           |
+ *
+ *          Decoding always produces the hemisphere with a positive largest
+ *          component. The bulk decoding functions flip the sign of decoded
+ *          samples when needed so that consecutive outputs stay continuous.
+ */
+class QuaternionCodec
+{
+public:
+    static uint32_t encode32(const Quaternion &q);
+    static Quaternion decode32(const uint32_t packed);
+    static uint64_t encode48(const Quaternion &q);
+    static Quaternion decode48(const uint64_t packed);
+    static uint64_t encode64(const Quaternion &q);
+    static Quaternion decode64(const uint64_t packed);
+
+    static void encode32(const Quaternion *q, uint32_t *packed, size_t count);
+    static void decode32(const uint32_t *packed, Quaternion *q, size_t count);
+    static void encode48(const Quaternion *q, uint8_t *packed, size_t count);
+    static void decode48(const uint8_t *packed, Quaternion *q, size_t count);
+    static void encode64(const Quaternion *q, uint64_t *packed, size_t count);
+    static void decode64(const uint64_t *packed, Quaternion *q, size_t count);
+
+    static void makeContinuous(Quaternion *q, size_t count);
+
+private:
+    QuaternionCodec();
+};
+
+#endif // QUATERNION_CODEC_H
@@ -0,0 +1,660 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  quaternion_stream.cpp
+ * @brief Quaternion stream encoder and decoder implementation.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "quaternion_codec.h"
+#include "quaternion_stream.h"
+
+namespace
+{
+
+/**
+ * @brief Size of a block header in bytes.
+ */
+const size_t header_size = 16;
+
+/**
+ * @brief Number of bits needed to store the residuals of one sample in the
+ *        worst case.
+ */
+const size_t max_sample_bits = 3 * (24 + 32);
+
+/**
+ * @brief   Finest resolution in radians.
+ * @details Well below the precision of a float versor, and coarse enough
+ *          that no residual can overflow a 32 bit integer.
+ */
+const float min_resolution = 1.0e-6f;
+
+/**
+ * @brief Quotients of at least this value are escaped and stored raw.
+ */
+const uint32_t rice_escape = 24;
+
+/**
+ * @brief The statistics are halved once this many values have been coded.
+ */
+const uint32_t rice_reset = 64;
+
+/**
+ * @brief   Predicts the next sample.
+ * @details Assumes that the rotation between the two previous samples will
+ *          be repeated.
+ *
+ * @param[in] previous The two most recent samples, newest first.
+ * @param[in] count    The number of samples decoded so far in the block.
+ * @return             The predicted sample.
+ */
+inline Quaternion predict(const Quaternion previous[2], const uint16_t count)
+{
+    if (count < 2)
+    {
+        return previous[0];
+    }
+    return previous[0] * (previous[1].conjugate() * previous[0]);
+}
+
+/**
+ * @brief   Applies a quantized residual to a prediction.
+ * @details The encoder and decoder must both use this function so that their
+ *          predictions never diverge.
+ *
+ * @param[in] prediction The predicted sample.
+ * @param[in] residual   The quantized residual rotation.
+ * @param[in] resolution The quantization step in radians.
+ * @return               The decoded sample.
+ */
+inline Quaternion reconstruct(const Quaternion &prediction,
+                              const int32_t residual[3],
+                              const float resolution)
+{
+    const float half_step = 0.5f * resolution;
+    const float x = static_cast<float>(residual[0]) * half_step;
+    const float y = static_cast<float>(residual[1]) * half_step;
+    const float z = static_cast<float>(residual[2]) * half_step;
+    const float s = 1.0f - ((x * x) + (y * y) + (z * z));
+    return (prediction * Quaternion((s > 0.0f) ? sqrt(s) : 0.0f, x, y, z)).normalized();
+}
+
+/**
+ * @brief Maps a signed integer onto an unsigned one, interleaving signs.
+ */
+inline uint32_t zigzag(const int32_t value)
+{
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+/**
+ * @brief Reverses zigzag().
+ */
+inline int32_t unzigzag(const uint32_t value)
+{
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+/**
+ * @brief   Selects a Rice code parameter.
+ * @details Uses the smallest parameter for which the number of coded values
+ *          shifted by the parameter covers their sum.
+ */
+inline uint8_t riceParameter(const uint32_t sum, const uint32_t count)
+{
+    uint8_t k = 0;
+    while ((k < 31) && ((count << k) < sum))
+    {
+        ++k;
+    }
+    return k;
+}
+
+/**
+ * @brief Updates the Rice statistics with a newly coded value.
+ */
+inline void riceUpdate(uint32_t &sum, uint32_t &count, const uint32_t value)
+{
+    sum += (value < 0x00FFFFFF) ? value : 0x00FFFFFF;
+    if (++count >= rice_reset)
+    {
+        sum >>= 1;
+        count >>= 1;
+    }
+}
+
+inline void store16(uint8_t *out, const uint16_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+inline uint16_t load16(const uint8_t *in)
+{
+    return static_cast<uint16_t>(in[0] | (static_cast<uint16_t>(in[1]) << 8));
+}
+
+inline void storeFloat(uint8_t *out, const float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    for (int b = 0; b < 4; ++b)
+    {
+        out[b] = static_cast<uint8_t>(bits >> (8 * b));
+    }
+}
+
+inline float loadFloat(const uint8_t *in)
+{
+    uint32_t bits = 0;
+    for (int b = 0; b < 4; ++b)
+    {
+        bits |= static_cast<uint32_t>(in[b]) << (8 * b);
+    }
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+} // namespace
+
+/**
+ * @brief   Initialization constructor.
+ * @details Creates an encoder which writes into a caller supplied buffer.
+ *          Blocks default to 256 samples with a resolution of
+ *          @f$10^{-4}@f$ radians.
+ *
+ * @param[out] buffer   The buffer to write the stream into.
+ * @param[in]  capacity The size of the buffer in bytes.
+ */
+QuaternionStreamEncoder::QuaternionStreamEncoder(uint8_t *buffer, const size_t capacity) :
+    buffer(buffer),
+    capacity(capacity),
+    length(0),
+    blockStart(0),
+    blockSamples(0),
+    blockLength(256),
+    resolution(1.0e-4f),
+    blockResolution(1.0e-4f),
+    bitBuffer(0),
+    bitCount(0)
+{
+}
+
+/**
+ * @brief   Sets the block length.
+ * @details Shorter blocks allow finer seeking at the cost of one header and
+ *          keyframe per block. The new length applies from the next block.
+ * @pre     The @p samples should be between 1 and maxBlockLength, otherwise
+ *          this function does nothing.
+ *
+ * @param[in] samples The number of samples per block.
+ */
+void QuaternionStreamEncoder::setBlockLength(const uint16_t samples)
+{
+    if ((samples > 0) && (samples <= maxBlockLength))
+    {
+        blockLength = samples;
+    }
+}
+
+/**
+ * @brief   Sets the quantization resolution.
+ * @details Sets the largest angle, in radians, by which a residual rotation
+ *          is rounded on each axis. The new resolution applies from the next
+ *          block. Resolutions finer than @f$10^{-6}@f$ radians are raised to
+ *          it, which keeps every residual within a 32 bit integer.
+ * @pre     The @p resolution should be greater than zero, otherwise this
+ *          function does nothing.
+ *
+ * @param[in] resolution The quantization step in radians.
+ */
+void QuaternionStreamEncoder::setResolution(const float resolution)
+{
+    if (resolution > 0.0f)
+    {
+        this->resolution = (resolution > min_resolution) ? resolution : min_resolution;
+    }
+}
+
+/**
+ * @brief   Appends a sample to the stream.
+ * @details Starts a new block whenever the current one is full.
+ * @pre     The quaternion must be a versor (unit quaternion).
+ *
+ * @param[in] q The sample to append.
+ * @retval true  If the sample was appended.
+ * @retval false If the buffer is too small to hold the sample. The stream is
+ *               left unchanged and can still be flushed.
+ * @return       Whether the sample was appended.
+ */
+bool QuaternionStreamEncoder::append(const Quaternion &q)
+{
+    if (blockSamples >= blockLength)
+    {
+        flush();
+    }
+
+    if (0 == blockSamples)
+    {
+        // Open a new block starting with a keyframe
+        if ((capacity - length) < header_size)
+        {
+            return false;
+        }
+        blockStart = length;
+        const uint64_t key = QuaternionCodec::encode64(q);
+        for (unsigned int b = 0; b < 8; ++b)
+        {
+            buffer[blockStart + 8 + b] = static_cast<uint8_t>(key >> (8 * b));
+        }
+        blockResolution = resolution;
+        storeFloat(buffer + blockStart + 4, blockResolution);
+        length += header_size;
+
+        previous[0] = QuaternionCodec::decode64(key);
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            riceSum[i] = 8;
+            riceCount[i] = 1;
+        }
+        blockSamples = 1;
+        return true;
+    }
+
+    if ((capacity - length) < (1 + (max_sample_bits / 8)))
+    {
+        return false;
+    }
+
+    // Quantize the rotation from the prediction to the sample
+    const Quaternion prediction = predict(previous, blockSamples);
+    Quaternion r = prediction.conjugate() * q;
+    if (r.w < 0.0f)
+    {
+        r = -r;
+    }
+    const float scale = 2.0f / blockResolution;
+    const int32_t residual[3] =
+    {
+        static_cast<int32_t>(floor((r.x * scale) + 0.5f)),
+        static_cast<int32_t>(floor((r.y * scale) + 0.5f)),
+        static_cast<int32_t>(floor((r.z * scale) + 0.5f))
+    };
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        writeRice(zigzag(residual[i]), i);
+    }
+
+    previous[1] = previous[0];
+    previous[0] = reconstruct(prediction, residual, blockResolution);
+    ++blockSamples;
+    return true;
+}
+
+/**
+ * @brief   Finishes the current block.
+ * @details Pads the block to a whole byte and completes its header. The next
+ *          sample appended will start a new block. Call this once all of the
+ *          samples have been appended.
+ */
+void QuaternionStreamEncoder::flush()
+{
+    if (0 == blockSamples)
+    {
+        return;
+    }
+    if (bitCount > 0)
+    {
+        writeBits(0, 8 - bitCount);
+    }
+    store16(buffer + blockStart, blockSamples);
+    store16(buffer + blockStart + 2,
+            static_cast<uint16_t>(length - blockStart - header_size));
+    blockSamples = 0;
+}
+
+/**
+ * @brief   Gets the size of the stream.
+ * @details Gets the number of bytes written, which includes any block which
+ *          has not been flushed yet.
+ *
+ * @return The size of the stream in bytes.
+ */
+size_t QuaternionStreamEncoder::size() const
+{
+    return length + ((bitCount > 0) ? 1 : 0);
+}
+
+/**
+ * @brief   Writes bits to the buffer.
+ * @details Bits are written most significant first.
+ *
+ * @param[in] value The bits to write, right aligned.
+ * @param[in] bits  The number of bits to write, at most 32.
+ */
+void QuaternionStreamEncoder::writeBits(const uint32_t value, uint8_t bits)
+{
+    while (bits > 0)
+    {
+        const uint8_t space = 8 - bitCount;
+        const uint8_t n = (bits < space) ? bits : space;
+        bits -= n;
+        bitBuffer = static_cast<uint8_t>((bitBuffer << n) | ((value >> bits) & ((1U << n) - 1U)));
+        bitCount += n;
+        if (8 == bitCount)
+        {
+            buffer[length++] = bitBuffer;
+            bitBuffer = 0;
+            bitCount = 0;
+        }
+    }
+}
+
+/**
+ * @brief   Writes a Rice coded value.
+ * @details The quotient is written in unary followed by the remainder. Large
+ *          quotients are replaced by an escape code and the raw value.
+ *
+ * @param[in] value The value to write.
+ * @param[in] axis  The axis whose statistics select the code parameter.
+ */
+void QuaternionStreamEncoder::writeRice(const uint32_t value, const unsigned int axis)
+{
+    const uint8_t k = riceParameter(riceSum[axis], riceCount[axis]);
+    const uint32_t quotient = value >> k;
+    if (quotient < rice_escape)
+    {
+        writeBits((1UL << quotient) - 1UL, static_cast<uint8_t>(quotient));
+        writeBits(0, 1);
+        writeBits(value, k);
+    }
+    else
+    {
+        writeBits((1UL << rice_escape) - 1UL, static_cast<uint8_t>(rice_escape));
+        writeBits(value, 32);
+    }
+    riceUpdate(riceSum[axis], riceCount[axis], value);
+}
+
+/**
+ * @brief   Initialization constructor.
+ * @details Creates a decoder positioned at the first sample of a stream.
+ *
+ * @param[in] data The encoded stream.
+ * @param[in] size The size of the encoded stream in bytes.
+ */
+QuaternionStreamDecoder::QuaternionStreamDecoder(const uint8_t *data, const size_t size) :
+    data(data),
+    size(size),
+    blockStart(0),
+    blockEnd(0),
+    blockFirst(0),
+    blockSamples(0),
+    blockDecoded(0),
+    resolution(0.0f),
+    bitOffset(0)
+{
+    openBlock(0);
+}
+
+/**
+ * @brief   Counts the blocks in the stream.
+ * @details Walks the block headers without decoding any samples.
+ *
+ * @return The number of complete blocks.
+ */
+size_t QuaternionStreamDecoder::blockCount() const
+{
+    size_t count = 0;
+    size_t offset = 0;
+    while ((size - offset) >= header_size)
+    {
+        offset += header_size + load16(data + offset + 2);
+        if (offset > size)
+        {
+            break;
+        }
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * @brief   Gets the decoding position.
+ *
+ * @return The index of the sample next() will decode.
+ */
+size_t QuaternionStreamDecoder::position() const
+{
+    return blockFirst + blockDecoded;
+}
+
+/**
+ * @brief   Moves to a sample.
+ * @details Skips every block before the one holding the sample using the
+ *          block headers, then decodes the samples before it within that
+ *          block.
+ *
+ * @param[in] sample The index of the sample next() should decode.
+ * @retval true  If the stream was positioned at the sample.
+ * @retval false If the stream has fewer samples.
+ * @return       Whether the seek succeeded.
+ */
+bool QuaternionStreamDecoder::seek(const size_t sample)
+{
+    size_t offset = 0;
+    size_t first = 0;
+    while ((size - offset) >= header_size)
+    {
+        const uint16_t count = load16(data + offset);
+        if (sample < (first + count))
+        {
+            if (!openBlock(offset))
+            {
+                return false;
+            }
+            blockFirst = first;
+            Quaternion q;
+            while (position() < sample)
+            {
+                if (!next(q))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        first += count;
+        offset += header_size + load16(data + offset + 2);
+        if (offset > size)
+        {
+            break;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief   Decodes the next sample.
+ *
+ * @param[out] q The decoded sample.
+ * @retval true  If a sample was decoded.
+ * @retval false If the end of the stream was reached or it is corrupt.
+ * @return       Whether a sample was decoded.
+ */
+bool QuaternionStreamDecoder::next(Quaternion &q)
+{
+    if (blockDecoded >= blockSamples)
+    {
+        const size_t first = blockFirst + blockSamples;
+        if (!openBlock(blockEnd))
+        {
+            return false;
+        }
+        blockFirst = first;
+    }
+
+    if (0 == blockDecoded)
+    {
+        uint64_t key = 0;
+        for (unsigned int b = 0; b < 8; ++b)
+        {
+            key |= static_cast<uint64_t>(data[blockStart + 8 + b]) << (8 * b);
+        }
+        previous[0] = QuaternionCodec::decode64(key);
+    }
+    else
+    {
+        int32_t residual[3];
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            uint32_t value;
+            if (!readRice(value, i))
+            {
+                return false;
+            }
+            residual[i] = unzigzag(value);
+        }
+        const Quaternion prediction = predict(previous, blockDecoded);
+        previous[1] = previous[0];
+        previous[0] = reconstruct(prediction, residual, resolution);
+    }
+
+    ++blockDecoded;
+    q = previous[0];
+    return true;
+}
+
+/**
+ * @brief   Prepares to decode a block.
+ *
+ * @param[in] offset The offset of the block header.
+ * @retval true  If the block is complete and holds samples.
+ * @retval false Otherwise.
+ * @return       Whether the block was opened.
+ */
+bool QuaternionStreamDecoder::openBlock(const size_t offset)
+{
+    if ((offset > size) || ((size - offset) < header_size))
+    {
+        return false;
+    }
+    const uint16_t count = load16(data + offset);
+    const size_t end = offset + header_size + load16(data + offset + 2);
+    if ((0 == count) || (end > size))
+    {
+        return false;
+    }
+
+    blockStart = offset;
+    blockEnd = end;
+    blockSamples = count;
+    blockDecoded = 0;
+    resolution = loadFloat(data + offset + 4);
+    bitOffset = 8 * (offset + header_size);
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        riceSum[i] = 8;
+        riceCount[i] = 1;
+    }
+    return true;
+}
+
+/**
+ * @brief   Reads bits from the current block.
+ * @see     QuaternionStreamEncoder::writeBits()
+ *
+ * @param[out] value The bits read, right aligned.
+ * @param[in]  bits  The number of bits to read, at most 32.
+ * @retval true  If the bits were read.
+ * @retval false If the read would pass the end of the block.
+ * @return       Whether the bits were read.
+ */
+bool QuaternionStreamDecoder::readBits(uint32_t &value, uint8_t bits)
+{
+    if ((bitOffset + bits) > (8 * blockEnd))
+    {
+        return false;
+    }
+    value = 0;
+    while (bits > 0)
+    {
+        const uint8_t used = static_cast<uint8_t>(bitOffset & 7);
+        const uint8_t available = 8 - used;
+        const uint8_t n = (bits < available) ? bits : available;
+        const uint8_t byte = data[bitOffset >> 3];
+        value = (value << n) | ((byte >> (available - n)) & ((1U << n) - 1U));
+        bitOffset += n;
+        bits -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief   Reads a Rice coded value.
+ * @see     QuaternionStreamEncoder::writeRice()
+ *
+ * @param[out] value The value read.
+ * @param[in]  axis  The axis whose statistics select the code parameter.
+ * @retval true  If the value was read.
+ * @retval false If the block ended first.
+ * @return       Whether the value was read.
+ */
+bool QuaternionStreamDecoder::readRice(uint32_t &value, const unsigned int axis)
+{
+    const uint8_t k = riceParameter(riceSum[axis], riceCount[axis]);
+    uint32_t quotient = 0;
+    uint32_t bit = 1;
+    while (quotient < rice_escape)
+    {
+        if (!readBits(bit, 1))
+        {
+            return false;
+        }
+        if (0 == bit)
+        {
+            break;
+        }
+        ++quotient;
+    }
+
+    if (quotient < rice_escape)
+    {
+        uint32_t remainder = 0;
+        if (!readBits(remainder, k))
+        {
+            return false;
+        }
+        value = (quotient << k) | remainder;
+    }
+    else if (!readBits(value, 32))
+    {
+        return false;
+    }
+    riceUpdate(riceSum[axis], riceCount[axis], value);
+    return true;
+}
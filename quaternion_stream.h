@@ -0,0 +1,132 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  quaternion_stream.h
+ * @brief Predictive compression of versor time series.
+ */
+
+#ifndef QUATERNION_STREAM_H
+#define QUATERNION_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "quaternion.h"
+
+/**
+ * @brief   Quaternion stream encoder.
+ * @details Compresses a sequence of versors such as the orientations produced
+ *          by successive filter updates. Each sample is predicted by assuming
+ *          the angular rate between the two previous samples stays constant.
+ *          Only the small rotation between the prediction and the actual
+ *          sample is stored. That rotation is quantized to a fixed angular
+ *          resolution and then entropy coded using adaptive Rice codes.
+ *
+ *          Predictions are always made from the decoded samples, so the
+ *          quantization error does not accumulate over time. The error of
+ *          every decoded sample stays within the resolution.
+ *
+ *          Samples are grouped into blocks. Each block starts with a header
+ *          and a 64 bit keyframe, and decoding can start at any block
+ *          without reading the blocks before it.
+ *
+ *          | Offset | Size | Contents                               |
+ *          |--------|------|----------------------------------------|
+ *          | 0      | 2    | Number of samples in the block         |
+ *          | 2      | 2    | Number of payload bytes after header   |
+ *          | 4      | 4    | Resolution in radians                  |
+ *          | 8      | 8    | First sample, QuaternionCodec::encode64 |
+ *          | 16     | -    | Rice coded residuals of the others     |
+ *
+ *          All multibyte fields are little endian.
+ */
+class QuaternionStreamEncoder
+{
+public:
+    static const uint16_t maxBlockLength = 2048; /**< Largest number of
+                                                      samples per block */
+
+    QuaternionStreamEncoder(uint8_t *buffer, const size_t capacity);
+    void setBlockLength(const uint16_t samples);
+    void setResolution(const float resolution);
+    bool append(const Quaternion &q);
+    void flush();
+    size_t size() const;
+
+private:
+    void writeBits(const uint32_t value, uint8_t bits);
+    void writeRice(const uint32_t value, const unsigned int axis);
+
+    uint8_t *buffer;        /**< Output buffer */
+    size_t capacity;        /**< Size of the output buffer in bytes */
+    size_t length;          /**< Number of bytes written */
+    size_t blockStart;      /**< Offset of the open block, if any */
+    uint16_t blockSamples;  /**< Number of samples in the open block */
+    uint16_t blockLength;   /**< Number of samples per block */
+    float resolution;       /**< Quantization step in radians for the
+                                 next block */
+    float blockResolution;  /**< Quantization step in radians of the open
+                                 block, as stored in its header */
+    Quaternion previous[2]; /**< The two most recently decoded samples */
+    uint32_t riceSum[3];    /**< Sum of recent coded values per axis */
+    uint32_t riceCount[3];  /**< Number of recent coded values per axis */
+    uint8_t bitBuffer;      /**< Bits not yet written to the buffer */
+    uint8_t bitCount;       /**< Number of bits in the bit buffer */
+};
+
+/**
+ * @brief   Quaternion stream decoder.
+ * @details Decodes a stream written by QuaternionStreamEncoder. Seeking uses
+ *          the block headers to skip whole blocks without decoding them.
+ * @see     QuaternionStreamEncoder
+ */
+class QuaternionStreamDecoder
+{
+public:
+    QuaternionStreamDecoder(const uint8_t *data, const size_t size);
+    size_t blockCount() const;
+    size_t position() const;
+    bool seek(const size_t sample);
+    bool next(Quaternion &q);
+
+private:
+    bool openBlock(const size_t offset);
+    bool readBits(uint32_t &value, uint8_t bits);
+    bool readRice(uint32_t &value, const unsigned int axis);
+
+    const uint8_t *data;    /**< Encoded stream */
+    size_t size;            /**< Size of the encoded stream in bytes */
+    size_t blockStart;      /**< Offset of the current block */
+    size_t blockEnd;        /**< Offset just past the current block */
+    size_t blockFirst;      /**< Index of the first sample in the block */
+    uint16_t blockSamples;  /**< Number of samples in the current block */
+    uint16_t blockDecoded;  /**< Samples decoded from the current block */
+    float resolution;       /**< Quantization step in radians */
+    Quaternion previous[2]; /**< The two most recently decoded samples */
+    uint32_t riceSum[3];    /**< Sum of recent coded values per axis */
+    uint32_t riceCount[3];  /**< Number of recent coded values per axis */
+    size_t bitOffset;       /**< Read position in bits from the stream
+                                 start */
+};
+
+#endif // QUATERNION_STREAM_H
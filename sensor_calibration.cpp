@@ -0,0 +1,263 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  sensor_calibration.cpp
+ * @brief Sensor calibration implementation.
+ */
+
+#include <string.h>
+#include "sensor_calibration.h"
+
+namespace
+{
+
+// Leading bytes of a serialized calibration, the last being the version
+const uint8_t calibration_magic[4] = { 'F', 'C', 'A', 1 };
+
+inline void storeFloat(uint8_t *out, const float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    for (int b = 0; b < 4; ++b)
+    {
+        out[b] = static_cast<uint8_t>(bits >> (8 * b));
+    }
+}
+
+inline float loadFloat(const uint8_t *in)
+{
+    uint32_t bits = 0;
+    for (int b = 0; b < 4; ++b)
+    {
+        bits |= static_cast<uint32_t>(in[b]) << (8 * b);
+    }
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+// Fletcher-16 checksum, enough to catch a corrupted or partly written copy
+uint16_t checksum(const uint8_t *data, const size_t size)
+{
+    uint16_t a = 0, b = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        a = static_cast<uint16_t>((a + data[i]) % 255);
+        b = static_cast<uint16_t>((b + a) % 255);
+    }
+    return static_cast<uint16_t>((b << 8) | a);
+}
+
+} // namespace
+
+/**
+ * @brief   Default constructor.
+ * @details Starts with no bias and identity matrices, which leave every
+ *          reading unchanged.
+ */
+SensorCalibration::SensorCalibration()
+{
+    for (int s = 0; s < SENSOR_COUNT; ++s)
+    {
+        setBias(static_cast<Sensor>(s), 0.0f, 0.0f, 0.0f);
+        setScale(static_cast<Sensor>(s), 1.0f, 1.0f, 1.0f);
+    }
+}
+
+/**
+ * @brief   Corrects a buffer of samples in place.
+ * @details Each sensor is corrected over the whole buffer before the next,
+ *          so its matrix and bias are loaded once per buffer rather than once
+ *          per sample.
+ * @pre     The @p sensors must be at most SENSOR_COUNT, and the stride at
+ *          least three values per sensor.
+ *
+ * @param[in,out] samples The samples, each the three gyroscope axes followed
+ *                        by the three accelerometer axes and, for three
+ *                        sensors, the three magnetometer axes.
+ * @param[in]     count   The number of samples.
+ * @param[in]     stride  The number of values from one sample to the next.
+ * @param[in]     sensors The number of sensors in each sample, two without a
+ *                        magnetometer and three with one.
+ */
+void SensorCalibration::apply(float *samples, const size_t count,
+                              const size_t stride, const size_t sensors) const
+{
+    for (size_t s = 0; (s < sensors) && (s < SENSOR_COUNT); ++s)
+    {
+        float *v = samples + (3 * s);
+        for (size_t i = 0; i < count; ++i, v += stride)
+        {
+            apply(static_cast<Sensor>(s), v[0], v[1], v[2]);
+        }
+    }
+}
+
+/**
+ * @brief   Reads a calibration written by serialize().
+ * @details The calibration is only replaced when the buffer holds a
+ *          complete copy of the current version with a valid checksum.
+ *
+ * @param[in] buffer The bytes to read.
+ * @param[in] size   The number of bytes available.
+ * @return Whether the calibration was read.
+ */
+bool SensorCalibration::deserialize(const uint8_t *buffer, const size_t size)
+{
+    const size_t end = serializedSize - 2;
+    if ((size < serializedSize)
+            || (0 != memcmp(buffer, calibration_magic, sizeof(calibration_magic)))
+            || (checksum(buffer, end) != (buffer[end] | (buffer[end + 1] << 8))))
+    {
+        return false;
+    }
+
+    const uint8_t *in = buffer + sizeof(calibration_magic);
+    for (int s = 0; s < SENSOR_COUNT; ++s)
+    {
+        for (int i = 0; i < 3; ++i, in += 4)
+        {
+            bias[s][i] = loadFloat(in);
+        }
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c, in += 4)
+            {
+                matrix[s][r][c] = loadFloat(in);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief   Writes the calibration as bytes.
+ * @details The layout is fixed and little endian, so a calibration can be
+ *          stored in EEPROM or a file on one machine and read on another.
+ *          It is a four byte header holding the version, the bias and the
+ *          matrix of each sensor in order as 32 bit floats, and a 16 bit
+ *          checksum.
+ *
+ * @param[out] buffer The buffer to write to.
+ * @param[in]  size   The size of the buffer in bytes.
+ * @return The number of bytes written, serializedSize, or zero when the
+ *         buffer is too small.
+ */
+size_t SensorCalibration::serialize(uint8_t *buffer, const size_t size) const
+{
+    if (size < serializedSize)
+    {
+        return 0;
+    }
+
+    memcpy(buffer, calibration_magic, sizeof(calibration_magic));
+    uint8_t *out = buffer + sizeof(calibration_magic);
+    for (int s = 0; s < SENSOR_COUNT; ++s)
+    {
+        for (int i = 0; i < 3; ++i, out += 4)
+        {
+            storeFloat(out, bias[s][i]);
+        }
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c, out += 4)
+            {
+                storeFloat(out, matrix[s][r][c]);
+            }
+        }
+    }
+
+    const uint16_t sum = checksum(buffer, serializedSize - 2);
+    out[0] = static_cast<uint8_t>(sum);
+    out[1] = static_cast<uint8_t>(sum >> 8);
+    return serializedSize;
+}
+
+/**
+ * @brief   Sets the bias of a sensor.
+ * @details The bias is removed before the matrix is applied, in the units of
+ *          the readings. For the magnetometer it is the hard iron offset.
+ * @pre     The @p sensor must be one of the sensors, otherwise this function
+ *          does nothing.
+ *
+ * @param[in] sensor The sensor.
+ * @param[in] x      The X axis bias.
+ * @param[in] y      The Y axis bias.
+ * @param[in] z      The Z axis bias.
+ */
+void SensorCalibration::setBias(const Sensor sensor, const float x,
+                                const float y, const float z)
+{
+    if (sensor < SENSOR_COUNT)
+    {
+        bias[sensor][0] = x;
+        bias[sensor][1] = y;
+        bias[sensor][2] = z;
+    }
+}
+
+/**
+ * @brief   Sets the correction matrix of a sensor.
+ * @details The matrix maps the readings, once the bias is removed, onto
+ *          orthogonal axes of equal scale. It is the product of the scale,
+ *          misalignment and, for the magnetometer, soft iron corrections.
+ * @pre     The @p sensor must be one of the sensors, otherwise this function
+ *          does nothing.
+ *
+ * @param[in] sensor The sensor.
+ * @param[in] m      The matrix, by rows.
+ */
+void SensorCalibration::setMatrix(const Sensor sensor, const float m[3][3])
+{
+    if (sensor < SENSOR_COUNT)
+    {
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                matrix[sensor][r][c] = m[r][c];
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Sets the scale of each axis of a sensor.
+ * @details Replaces the correction matrix with a diagonal one, for sensors
+ *          whose axes are aligned.
+ * @pre     The @p sensor must be one of the sensors, otherwise this function
+ *          does nothing.
+ *
+ * @param[in] sensor The sensor.
+ * @param[in] x      The X axis scale.
+ * @param[in] y      The Y axis scale.
+ * @param[in] z      The Z axis scale.
+ */
+void SensorCalibration::setScale(const Sensor sensor, const float x,
+                                 const float y, const float z)
+{
+    const float m[3][3] = { { x, 0.0f, 0.0f },
+                            { 0.0f, y, 0.0f },
+                            { 0.0f, 0.0f, z } };
+    setMatrix(sensor, m);
+}
@@ -0,0 +1,105 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  sensor_calibration.h
+ * @brief Bias, scale and misalignment calibration of the sensors.
+ */
+
+#ifndef SENSOR_CALIBRATION_H
+#define SENSOR_CALIBRATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief   Sensor calibration class.
+ * @details Holds the calibration of the gyroscope, the accelerometer and the
+ *          magnetometer of one device. Each sensor is corrected as
+ * @f[
+ *   v = M \left(r - b\right)
+ * @f]
+ *          where the bias @f$b@f$ is the zero offset, or the hard iron
+ *          offset of the magnetometer, and the matrix @f$M@f$ combines the
+ *          scale of each axis, the misalignment between the axes and the
+ *          soft iron distortion. A calibration can be applied to a buffer of
+ *          samples, passed to the burst updates of the filters which then
+ *          apply it as they go, and stored as bytes with serialize().
+ */
+class SensorCalibration
+{
+public:
+    /**
+     * @brief Sensors of a device, in the order the filters take them.
+     */
+    enum Sensor
+    {
+        SENSOR_GYRO,  /**< Gyroscope */
+        SENSOR_ACCEL, /**< Accelerometer */
+        SENSOR_MAG,   /**< Magnetometer */
+        SENSOR_COUNT  /**< Number of sensors */
+    };
+
+    static const size_t serializedSize = 150; /**< Bytes written by
+                                                   serialize() */
+
+    SensorCalibration();
+    void apply(const Sensor sensor, float &x, float &y, float &z) const;
+    void apply(float *samples, const size_t count, const size_t stride,
+               const size_t sensors) const;
+    bool deserialize(const uint8_t *buffer, const size_t size);
+    size_t serialize(uint8_t *buffer, const size_t size) const;
+    void setBias(const Sensor sensor, const float x, const float y,
+                 const float z);
+    void setMatrix(const Sensor sensor, const float m[3][3]);
+    void setScale(const Sensor sensor, const float x, const float y,
+                  const float z);
+
+private:
+    float bias[SENSOR_COUNT][3];      /**< Offset removed from each sensor */
+    float matrix[SENSOR_COUNT][3][3]; /**< Correction applied to each sensor
+                                           once the offset is removed */
+};
+
+/**
+ * @brief   Corrects one reading of a sensor.
+ * @details Inline so that the correction folds into the filter updates.
+ * @pre     The @p sensor must be one of the sensors.
+ *
+ * @param[in]     sensor The sensor the reading is from.
+ * @param[in,out] x      The X axis, replaced by the corrected value.
+ * @param[in,out] y      The Y axis, replaced by the corrected value.
+ * @param[in,out] z      The Z axis, replaced by the corrected value.
+ */
+inline void SensorCalibration::apply(const Sensor sensor,
+                                     float &x, float &y, float &z) const
+{
+    const float (&m)[3][3] = matrix[sensor];
+    const float dx = x - bias[sensor][0];
+    const float dy = y - bias[sensor][1];
+    const float dz = z - bias[sensor][2];
+    x = (m[0][0] * dx) + (m[0][1] * dy) + (m[0][2] * dz);
+    y = (m[1][0] * dx) + (m[1][1] * dy) + (m[1][2] * dz);
+    z = (m[2][0] * dx) + (m[2][1] * dy) + (m[2][2] * dz);
+}
+
+#endif // SENSOR_CALIBRATION_H
@@ -0,0 +1,113 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  sensor_format.cpp
+ * @brief Sensor format implementation.
+ */
+
+#include "sensor_format.h"
+
+/**
+ * @brief   Default constructor.
+ * @details Describes records of nine words holding the gyroscope,
+ *          accelerometer and magnetometer axes in order, each count worth
+ *          one unit with no bias.
+ */
+SensorFormat::SensorFormat() :
+    length(AXIS_COUNT)
+{
+    for (int i = 0; i < AXIS_COUNT; ++i)
+    {
+        words[i] = static_cast<uint8_t>(i);
+        scales[i] = 1.0f;
+        offsets[i] = 0.0f;
+    }
+}
+
+/**
+ * @brief   Sets where an axis is found and how it is converted.
+ * @details The value of the axis is
+ * @f[
+ *   v = s \left(r_w - b\right)
+ * @f]
+ *          for the count @f$r_w@f$ in word @f$w@f$ of the record. Only the
+ *          direction of the accelerometer and the magnetometer is used, so
+ *          their scales matter only relative to the other axes of the same
+ *          sensor.
+ * @pre     The @p axis must be one of the axes and the @p word must be
+ *          within the stride, otherwise this function does nothing.
+ *
+ * @param[in] axis  The axis.
+ * @param[in] word  The index of the word holding the axis in each record.
+ * @param[in] scale The value of one count, negative to flip the axis.
+ * @param[in] bias  The count read when the true value is zero.
+ */
+void SensorFormat::setAxis(const Axis axis, const uint8_t word,
+                           const float scale, const float bias)
+{
+    if ((axis < AXIS_COUNT) && (word < length))
+    {
+        words[axis] = word;
+        scales[axis] = scale;
+        offsets[axis] = -scale * bias;
+    }
+}
+
+/**
+ * @brief   Sets the length of each record.
+ * @details Records may hold words the filters do not use, such as a
+ *          temperature or a timestamp, or fewer than nine words when the
+ *          device has no magnetometer. Set the stride before the axes, since
+ *          any axis whose word lies beyond the new stride reads as zero
+ *          until it is set again.
+ * @pre     The @p words should be greater than zero, otherwise this function
+ *          does nothing.
+ *
+ * @param[in] words The number of words from one record to the next.
+ */
+void SensorFormat::setStride(const uint8_t words)
+{
+    if (words > 0)
+    {
+        length = words;
+        for (int i = 0; i < AXIS_COUNT; ++i)
+        {
+            if (this->words[i] >= length)
+            {
+                this->words[i] = 0;
+                scales[i] = 0.0f;
+                offsets[i] = 0.0f;
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Gets the length of each record.
+ *
+ * @return The number of words from one record to the next.
+ */
+uint8_t SensorFormat::stride() const
+{
+    return length;
+}
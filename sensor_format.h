@@ -0,0 +1,91 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+ * @file  sensor_format.h
+ * @brief Layout and conversion of raw sensor readings.
+ */
+
+#ifndef SENSOR_FORMAT_H
+#define SENSOR_FORMAT_H
+
+#include <stdint.h>
+
+/**
+ * @brief   Sensor format class.
+ * @details Describes how the raw counts a device writes to its FIFO map onto
+ *          the axes the filters expect: which word of a record holds each
+ *          axis, the scale of one count and the bias in counts. A negative
+ *          scale flips an axis, so any mounting of the sensors can be
+ *          described. The filters which take a format convert each count as
+ *          they use it, so raw bursts need no separate conversion pass.
+ */
+class SensorFormat
+{
+public:
+    /**
+     * @brief Axes of a sample, in the order the filters take them.
+     */
+    enum Axis
+    {
+        GYRO_X,    /**< Gyroscope X axis in rad/s */
+        GYRO_Y,    /**< Gyroscope Y axis in rad/s */
+        GYRO_Z,    /**< Gyroscope Z axis in rad/s */
+        ACCEL_X,   /**< Accelerometer X axis */
+        ACCEL_Y,   /**< Accelerometer Y axis */
+        ACCEL_Z,   /**< Accelerometer Z axis */
+        MAG_X,     /**< Magnetometer X axis */
+        MAG_Y,     /**< Magnetometer Y axis */
+        MAG_Z,     /**< Magnetometer Z axis */
+        AXIS_COUNT /**< Number of axes */
+    };
+
+    SensorFormat();
+    void setAxis(const Axis axis, const uint8_t word,
+                 const float scale, const float bias);
+    void setStride(const uint8_t words);
+    uint8_t stride() const;
+    float value(const int16_t *record, const Axis axis) const;
+
+private:
+    uint8_t words[AXIS_COUNT]; /**< Word of the record holding each axis */
+    float scales[AXIS_COUNT];  /**< Value of one count of each axis */
+    float offsets[AXIS_COUNT]; /**< Value of a zero count of each axis,
+                                    the bias already scaled */
+    uint8_t length;            /**< Number of words from one record to the
+                                    next, more than any word used */
+};
+
+/**
+ * @brief   Converts one axis of a record.
+ * @details Inline so that the conversion folds into the filter updates.
+ *
+ * @param[in] record The raw record.
+ * @param[in] axis   The axis to read.
+ * @return The value of the axis in the units the filters expect.
+ */
+inline float SensorFormat::value(const int16_t *record, const Axis axis) const
+{
+    return (scales[axis] * record[words[axis]]) + offsets[axis];
+}
+
+#endif // SENSOR_FORMAT_H
@@ -0,0 +1,117 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  stage_profile.cpp
+ * @brief Stage profile implementation.
+ */
+
+#include "stage_profile.h"
+
+#ifdef FUSION_PROFILE
+
+#include <stdio.h>
+
+/**
+ * @brief Default construction.
+ */
+StageProfile::StageProfile()
+{
+    reset();
+}
+
+/**
+ * @brief Clears every count.
+ */
+void StageProfile::reset()
+{
+    for (size_t i = 0; i < maxStages; ++i)
+    {
+        totals[i] = 0;
+    }
+    last = 0;
+    count = 0;
+}
+
+/**
+ * @brief   Total cycles of a stage.
+ * @details The number of cycles spent in a stage over every counted update.
+ *
+ * @param[in] stage The stage.
+ * @return The total cycles, or zero for a stage out of range.
+ */
+uint64_t StageProfile::cycles(const size_t stage) const
+{
+    return (stage < maxStages) ? totals[stage] : 0;
+}
+
+/**
+ * @brief Number of updates counted.
+ */
+uint32_t StageProfile::updates() const
+{
+    return count;
+}
+
+/**
+ * @brief   Writes the profile as text.
+ * @details Writes one line per stage with its name, its total cycles, its
+ *          mean cycles per update and its share of the whole update. The
+ *          output is truncated if the buffer is too small but is always
+ *          terminated.
+ *
+ * @param[out] buffer The buffer to write to.
+ * @param[in]  size   The size of the buffer in bytes.
+ * @param[in]  names  The name of each stage.
+ * @param[in]  count  The number of stages.
+ * @return The number of characters the whole profile needs, not counting the
+ *         terminator.
+ */
+size_t StageProfile::dump(char *buffer, const size_t size,
+                          const char *const *names, const size_t count) const
+{
+    const size_t stages = (count < maxStages) ? count : maxStages;
+    uint64_t total = 0;
+    for (size_t i = 0; i < stages; ++i)
+    {
+        total += totals[i];
+    }
+
+    size_t length = 0;
+    for (size_t i = 0; i <= stages; ++i)
+    {
+        const char *name = (i < stages) ? names[i] : "total";
+        const uint64_t cycles = (i < stages) ? totals[i] : total;
+        const unsigned long mean = this->count ? static_cast<unsigned long>(cycles / this->count) : 0;
+        const unsigned long share = total ? static_cast<unsigned long>((1000 * cycles) / total) : 0;
+        const int n = snprintf(buffer + ((length < size) ? length : size),
+                               (length < size) ? (size - length) : 0,
+                               "%-24s %12lu %8lu %3lu.%lu%%\n", name,
+                               static_cast<unsigned long>(cycles), mean,
+                               share / 10, share % 10);
+        length += (n > 0) ? n : 0;
+    }
+    return length;
+}
+
+#endif // FUSION_PROFILE
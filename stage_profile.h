@@ -0,0 +1,122 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  stage_profile.h
+ * @brief Cycle counting for the stages of a filter update.
+ */
+
+#ifndef STAGE_PROFILE_H
+#define STAGE_PROFILE_H
+
+/*
+ * Profiling is only compiled in when FUSION_PROFILE is defined. Otherwise the
+ * marker macros expand to nothing and filters carry no extra state, so there
+ * is no cost at all.
+ *
+ * The counter is the time stamp counter on x86, the virtual counter on
+ * AArch64 and micros() elsewhere. Define FUSION_PROFILE_CYCLES to an
+ * expression returning an unsigned count to use another source, such as the
+ * DWT cycle counter of a Cortex-M.
+ */
+#ifdef FUSION_PROFILE
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef FUSION_PROFILE_CYCLES
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define FUSION_PROFILE_CYCLES() __rdtsc()
+#elif defined(__aarch64__)
+static inline uint64_t fusionProfileCycles()
+{
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+}
+#define FUSION_PROFILE_CYCLES() fusionProfileCycles()
+#else
+#include <Arduino.h>
+#define FUSION_PROFILE_CYCLES() micros()
+#endif
+#endif
+
+/**
+ * @brief   Stage profile class.
+ * @details Accumulates the cycles spent in each stage of an update. An
+ *          update calls begin() once and then mark() at the end of every
+ *          stage, which charges the cycles since the previous mark to that
+ *          stage. The counter does not serialize execution, so short stages
+ *          are only meaningful when averaged over many updates.
+ */
+class StageProfile
+{
+public:
+    static const size_t maxStages = 8; /**< Most stages that can be counted */
+
+    StageProfile();
+    void reset();
+    uint64_t cycles(const size_t stage) const;
+    uint32_t updates() const;
+    size_t dump(char *buffer, const size_t size,
+                const char *const *names, const size_t count) const;
+
+    /**
+     * @brief Starts counting an update.
+     */
+    inline void begin()
+    {
+        last = FUSION_PROFILE_CYCLES();
+        ++count;
+    }
+
+    /**
+     * @brief Charges the cycles since the previous mark to a stage.
+     *
+     * @param[in] stage The stage which just finished.
+     */
+    inline void mark(const size_t stage)
+    {
+        const uint64_t now = FUSION_PROFILE_CYCLES();
+        totals[stage] += now - last;
+        last = now;
+    }
+
+private:
+    uint64_t totals[maxStages]; /**< Cycles spent in each stage */
+    uint64_t last;              /**< Counter value at the previous mark */
+    uint32_t count;             /**< Number of updates counted */
+};
+
+#define FUSION_PROFILE_BEGIN(profile) (profile).begin()
+#define FUSION_PROFILE_MARK(profile, stage) (profile).mark(stage)
+
+#else
+
+#define FUSION_PROFILE_BEGIN(profile)
+#define FUSION_PROFILE_MARK(profile, stage)
+
+#endif // FUSION_PROFILE
+
+#endif // STAGE_PROFILE_H
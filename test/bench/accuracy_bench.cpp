@@ -0,0 +1,339 @@
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "dcm_filter.h"
+#include "gauss_newton_filter.h"
+#include "imu_filter.h"
+#include "kalman_filter.h"
+#include "mahony_imu_filter.h"
+#include "mahony_marg_filter.h"
+#include "marg_filter.h"
+#include "suites.h"
+#include "../sim/trajectory.h"
+
+namespace
+{
+
+// Seconds of simulated motion per configuration
+const float duration = 60.0f;
+
+// Seconds the estimate is given to settle before errors are counted
+const float settle = 5.0f;
+
+// Number of timed passes over the simulated data
+const int passes = 5;
+
+const double rad_to_deg = 180.0 / M_PI;
+
+// Runs a filter over every sample and stores each estimate
+typedef void (*Runner)(const std::vector<SimSample> &samples, const float dt,
+                       const float gain, std::vector<Quaternion> &estimates);
+
+struct Estimator
+{
+    const char *name;
+    Runner run;
+    bool heading; // Whether the estimator observes heading
+};
+
+void runImu(const std::vector<SimSample> &samples, const float dt,
+            const float gain, std::vector<Quaternion> &estimates)
+{
+    IMUFilter filter;
+    filter.setGyroErrorGain(gain);
+    filter.setSampleRate(dt);
+    const SimSample &first = samples.front();
+    filter.align(first.accel[0], first.accel[1], first.accel[2]);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2]);
+        estimates[i] = filter.orientation();
+    }
+}
+
+void runMargWith(const std::vector<SimSample> &samples, const float dt,
+                 const float gain, std::vector<Quaternion> &estimates,
+                 const Filter::Integrator integrator)
+{
+    MARGFilter filter;
+    filter.setGyroErrorGain(gain);
+    filter.setGyroDriftGain(0.02f * gain);
+    filter.setSampleRate(dt);
+    filter.setIntegrator(integrator);
+    const SimSample &first = samples.front();
+    filter.align(first.accel[0], first.accel[1], first.accel[2],
+                 first.mag[0], first.mag[1], first.mag[2]);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        estimates[i] = filter.orientation();
+    }
+}
+
+void runMarg(const std::vector<SimSample> &samples, const float dt,
+             const float gain, std::vector<Quaternion> &estimates)
+{
+    runMargWith(samples, dt, gain, estimates, Filter::INTEGRATOR_EULER);
+}
+
+void runMargRk4(const std::vector<SimSample> &samples, const float dt,
+                const float gain, std::vector<Quaternion> &estimates)
+{
+    runMargWith(samples, dt, gain, estimates, Filter::INTEGRATOR_RK4);
+}
+
+void runMargExponential(const std::vector<SimSample> &samples, const float dt,
+                        const float gain, std::vector<Quaternion> &estimates)
+{
+    runMargWith(samples, dt, gain, estimates, Filter::INTEGRATOR_EXPONENTIAL);
+}
+
+// The Gauss-Newton filter has a time constant instead of a gain, so a larger
+// gain is read as a shorter time constant
+void runGaussNewton(const std::vector<SimSample> &samples, const float dt,
+                    const float gain, std::vector<Quaternion> &estimates)
+{
+    GaussNewtonFilter filter;
+    filter.setTimeConstant(gaussNewtonTimeConstant(gain));
+    filter.setSampleRate(dt);
+    const SimSample &first = samples.front();
+    filter.align(first.accel[0], first.accel[1], first.accel[2],
+                 first.mag[0], first.mag[1], first.mag[2]);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        estimates[i] = filter.orientation();
+    }
+}
+
+// The DCM filter runs both with and without its magnetometer
+void runDcm(const std::vector<SimSample> &samples, const float dt,
+            const float gain, std::vector<Quaternion> &estimates,
+            const bool magnetometer)
+{
+    DCMFilter filter;
+    filter.setProportionalGain(proportionalGain(gain));
+    filter.setIntegralGain(integralGain(gain));
+    filter.setSampleRate(dt);
+    const SimSample &first = samples.front();
+    if (magnetometer)
+    {
+        filter.align(first.accel[0], first.accel[1], first.accel[2],
+                     first.mag[0], first.mag[1], first.mag[2]);
+    }
+    else
+    {
+        filter.align(first.accel[0], first.accel[1], first.accel[2]);
+    }
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        if (magnetometer)
+        {
+            filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                          s.accel[0], s.accel[1], s.accel[2],
+                          s.mag[0], s.mag[1], s.mag[2]);
+        }
+        else
+        {
+            filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                          s.accel[0], s.accel[1], s.accel[2]);
+        }
+        estimates[i] = filter.orientation();
+    }
+}
+
+void runDcmImu(const std::vector<SimSample> &samples, const float dt,
+               const float gain, std::vector<Quaternion> &estimates)
+{
+    runDcm(samples, dt, gain, estimates, false);
+}
+
+void runDcmMarg(const std::vector<SimSample> &samples, const float dt,
+                const float gain, std::vector<Quaternion> &estimates)
+{
+    runDcm(samples, dt, gain, estimates, true);
+}
+
+void runMahonyImu(const std::vector<SimSample> &samples, const float dt,
+                  const float gain, std::vector<Quaternion> &estimates)
+{
+    MahonyIMUFilter filter;
+    filter.setProportionalGain(proportionalGain(gain));
+    filter.setIntegralGain(integralGain(gain));
+    filter.setSampleRate(dt);
+    const SimSample &first = samples.front();
+    filter.align(first.accel[0], first.accel[1], first.accel[2]);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2]);
+        estimates[i] = filter.orientation();
+    }
+}
+
+void runMahonyMarg(const std::vector<SimSample> &samples, const float dt,
+                   const float gain, std::vector<Quaternion> &estimates)
+{
+    MahonyMARGFilter filter;
+    filter.setProportionalGain(proportionalGain(gain));
+    filter.setIntegralGain(integralGain(gain));
+    filter.setSampleRate(dt);
+    const SimSample &first = samples.front();
+    filter.align(first.accel[0], first.accel[1], first.accel[2],
+                 first.mag[0], first.mag[1], first.mag[2]);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        estimates[i] = filter.orientation();
+    }
+}
+
+void runKalman(const std::vector<SimSample> &samples, const float dt,
+               const float gain, std::vector<Quaternion> &estimates)
+{
+    KalmanFilter filter;
+    filter.setGyroNoise(kalmanGyroNoise(gain));
+    filter.setSampleRate(dt);
+    const SimSample &first = samples.front();
+    filter.align(first.accel[0], first.accel[1], first.accel[2],
+                 first.mag[0], first.mag[1], first.mag[2]);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        estimates[i] = filter.orientation();
+    }
+}
+
+const Estimator estimators[] =
+{
+    { "imu",          runImu,         false },
+    { "marg",         runMarg,        true },
+    { "marg-rk4",     runMargRk4,     true },
+    { "marg-exp",     runMargExponential, true },
+    { "gauss-newton", runGaussNewton, true },
+    { "dcm-imu",      runDcmImu,      false },
+    { "dcm-marg",     runDcmMarg,     true },
+    { "mahony-imu",   runMahonyImu,   false },
+    { "mahony-marg",  runMahonyMarg,  true },
+    { "kalman",       runKalman,      true }
+};
+
+// Measures the error of one estimator against the ground truth as well as
+// how long it took per update
+void evaluate(Benchmark &bench, const Estimator &estimator,
+              const std::vector<SimSample> &samples, const float rate,
+              const float gain)
+{
+    char label[64];
+    snprintf(label, sizeof(label), "%s/rate:%g/gain:%g", estimator.name, rate, gain);
+    if (!bench.enabled(label))
+    {
+        return;
+    }
+
+    const size_t count = samples.size();
+    std::vector<Quaternion> estimates(count);
+    std::vector<double> ns(passes);
+    for (int p = 0; p < passes; ++p)
+    {
+        const double start = benchmarkSeconds();
+        estimator.run(samples, 1.0f / rate, gain, estimates);
+        ns[p] = ((benchmarkSeconds() - start) * 1.0e9) / count;
+        doNotOptimize(estimates.back());
+    }
+
+    double tilt = 0.0, heading = 0.0, attitude = 0.0, tilt_max = 0.0;
+    size_t counted = 0;
+    for (size_t i = static_cast<size_t>(settle * rate); i < count; ++i)
+    {
+        const double t = tiltError(estimates[i], samples[i].truth);
+        const double h = headingError(estimates[i], samples[i].truth);
+        const double a = angleBetween(estimates[i], samples[i].truth);
+        tilt += t * t;
+        heading += h * h;
+        attitude += a * a;
+        tilt_max = std::max(tilt_max, t);
+        ++counted;
+    }
+
+    BenchmarkResult result;
+    result.suite = bench.currentSuite();
+    result.name = label;
+    result.iterations = count;
+    result.repetitions = passes;
+    double sum = 0.0;
+    for (int p = 0; p < passes; ++p)
+    {
+        sum += ns[p];
+    }
+    result.nsPerOp = sum / passes;
+    result.nsMin = *std::min_element(ns.begin(), ns.end());
+    double squares = 0.0;
+    for (int p = 0; p < passes; ++p)
+    {
+        squares += (ns[p] - result.nsPerOp) * (ns[p] - result.nsPerOp);
+    }
+    result.nsStddev = sqrt(squares / (passes - 1));
+    result.opsPerSecond = (result.nsPerOp > 0.0) ? (1.0e9 / result.nsPerOp) : 0.0;
+    result.addMetric("rms_tilt_deg", sqrt(tilt / counted) * rad_to_deg);
+    result.addMetric("max_tilt_deg", tilt_max * rad_to_deg);
+    if (estimator.heading)
+    {
+        result.addMetric("rms_heading_deg", sqrt(heading / counted) * rad_to_deg);
+        result.addMetric("rms_attitude_deg", sqrt(attitude / counted) * rad_to_deg);
+    }
+    result.addMetric("cpu_us_per_second", result.nsPerOp * rate * 1.0e-3);
+    bench.add(result);
+}
+
+} // namespace
+
+// Error against simulated ground truth for a range of sample rates and gains,
+// together with the cost of reaching it
+void accuracySuite(Benchmark &bench)
+{
+    bench.setSuite("accuracy");
+    const float rates[] = { 50.0f, 100.0f, 200.0f, 500.0f };
+    const float gains[] = { 0.005f, 0.02f, 0.05f, 0.2f };
+
+    SensorNoise noise;
+    noise.gyro = 0.01f;
+    noise.accel = 0.02f;
+    noise.mag = 0.02f;
+    noise.gyroBias[0] = 0.01f;
+    noise.gyroBias[1] = -0.005f;
+    noise.gyroBias[2] = 0.008f;
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r)
+    {
+        std::vector<SimSample> samples;
+        simulateTumble(static_cast<size_t>(duration * rates[r]), 1.0f / rates[r],
+                       noise, 2024, samples);
+        for (size_t e = 0; e < sizeof(estimators) / sizeof(estimators[0]); ++e)
+        {
+            for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); ++g)
+            {
+                evaluate(bench, estimators[e], samples, rates[r], gains[g]);
+            }
+        }
+    }
+}
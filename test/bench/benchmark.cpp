@@ -0,0 +1,338 @@
+#include <math.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include "benchmark.h"
+
+namespace
+{
+
+// Writes a string as a JSON string literal
+void printJsonString(FILE *out, const std::string &s)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        const char c = s[i];
+        if ((c == '"') || (c == '\\'))
+        {
+            fputc('\\', out);
+        }
+        fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+// Finds a string field of a line of printJson output
+bool jsonString(const std::string &line, const char *key, std::string &value)
+{
+    const std::string pattern = std::string("\"") + key + "\": \"";
+    const size_t start = line.find(pattern);
+    if (std::string::npos == start)
+    {
+        return false;
+    }
+    value.clear();
+    for (size_t i = start + pattern.size(); i < line.size(); ++i)
+    {
+        if ('\\' == line[i])
+        {
+            ++i;
+        }
+        else if ('"' == line[i])
+        {
+            return true;
+        }
+        if (i < line.size())
+        {
+            value += line[i];
+        }
+    }
+    return false;
+}
+
+// Finds a number field of a line of printJson output
+bool jsonNumber(const std::string &line, const char *key, double &value)
+{
+    const std::string pattern = std::string("\"") + key + "\": ";
+    const size_t start = line.find(pattern);
+    if (std::string::npos == start)
+    {
+        return false;
+    }
+    char *end;
+    value = strtod(line.c_str() + start + pattern.size(), &end);
+    return end != (line.c_str() + start + pattern.size());
+}
+
+} // namespace
+
+BenchmarkResult::BenchmarkResult() :
+    iterations(0),
+    repetitions(0),
+    nsPerOp(0.0),
+    nsStddev(0.0),
+    nsMin(0.0),
+    opsPerSecond(0.0)
+{
+}
+
+void BenchmarkResult::addMetric(const std::string &name, const double value)
+{
+    BenchmarkMetric metric;
+    metric.name = name;
+    metric.value = value;
+    metrics.push_back(metric);
+}
+
+Benchmark::Benchmark() :
+    minTime(0.02),
+    repetitions(10),
+    maxThreads(std::thread::hardware_concurrency())
+{
+    if (0 == maxThreads)
+    {
+        maxThreads = 1;
+    }
+}
+
+void Benchmark::setSuite(const std::string &suite)
+{
+    this->suite = suite;
+}
+
+// Only benchmarks whose suite/name contains the filter are run
+void Benchmark::setFilter(const std::string &filter)
+{
+    this->filter = filter;
+}
+
+void Benchmark::setMinTime(const double seconds)
+{
+    minTime = seconds;
+}
+
+void Benchmark::setRepetitions(const size_t repetitions)
+{
+    this->repetitions = (repetitions > 0) ? repetitions : 1;
+}
+
+// Largest number of threads the scaling benchmarks use
+void Benchmark::setThreads(const unsigned int threads)
+{
+    maxThreads = (threads > 0) ? threads : 1;
+}
+
+const std::string &Benchmark::currentSuite() const
+{
+    return suite;
+}
+
+unsigned int Benchmark::threads() const
+{
+    return maxThreads;
+}
+
+bool Benchmark::enabled(const std::string &name) const
+{
+    return filter.empty() || (std::string::npos != (suite + "/" + name).find(filter));
+}
+
+void Benchmark::run(const std::string &name, const Function &function)
+{
+    if (!enabled(name))
+    {
+        return;
+    }
+
+    // Grow the iteration count until one repetition takes long enough
+    size_t iterations = 1;
+    for (;;)
+    {
+        const double start = benchmarkSeconds();
+        function(iterations);
+        const double elapsed = benchmarkSeconds() - start;
+        if ((elapsed >= minTime) || (iterations >= (size_t(1) << 40)))
+        {
+            break;
+        }
+        const double scale = (elapsed > 0.0) ? (1.4 * minTime / elapsed) : 100.0;
+        iterations = static_cast<size_t>(iterations * ((scale < 100.0) ? ((scale > 2.0) ? scale : 2.0) : 100.0));
+    }
+
+    std::vector<double> ns(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        const double start = benchmarkSeconds();
+        function(iterations);
+        ns[r] = (benchmarkSeconds() - start) * 1.0e9 / iterations;
+    }
+
+    BenchmarkResult result;
+    result.suite = suite;
+    result.name = name;
+    result.iterations = iterations;
+    result.repetitions = repetitions;
+    result.nsMin = ns[0];
+    double sum = 0.0;
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        sum += ns[r];
+        result.nsMin = (ns[r] < result.nsMin) ? ns[r] : result.nsMin;
+    }
+    result.nsPerOp = sum / repetitions;
+    double squares = 0.0;
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        squares += (ns[r] - result.nsPerOp) * (ns[r] - result.nsPerOp);
+    }
+    result.nsStddev = (repetitions > 1) ? sqrt(squares / (repetitions - 1)) : 0.0;
+    result.opsPerSecond = (result.nsPerOp > 0.0) ? (1.0e9 / result.nsPerOp) : 0.0;
+    add(result);
+}
+
+void Benchmark::add(const BenchmarkResult &result)
+{
+    all.push_back(result);
+    fprintf(stderr, "%s/%s: %.3f ns/op\n", result.suite.c_str(), result.name.c_str(), result.nsPerOp);
+}
+
+// Attaches a value to the most recent result, such as a rate derived from it
+void Benchmark::addMetric(const std::string &name, const double value)
+{
+    if (!all.empty())
+    {
+        all.back().addMetric(name, value);
+    }
+}
+
+const std::vector<BenchmarkResult> &Benchmark::results() const
+{
+    return all;
+}
+
+void Benchmark::printText(FILE *out) const
+{
+    fprintf(out, "%-48s %12s %10s %12s %16s\n", "benchmark", "ns/op", "stddev %", "min ns/op", "ops/s");
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        const BenchmarkResult &r = all[i];
+        fprintf(out, "%-48s %12.3f %10.2f %12.3f %16.0f\n", (r.suite + "/" + r.name).c_str(),
+                r.nsPerOp, (r.nsPerOp > 0.0) ? (100.0 * r.nsStddev / r.nsPerOp) : 0.0,
+                r.nsMin, r.opsPerSecond);
+        for (size_t m = 0; m < r.metrics.size(); ++m)
+        {
+            fprintf(out, "%s%s=%g", (0 == m) ? "    " : "  ",
+                    r.metrics[m].name.c_str(), r.metrics[m].value);
+        }
+        if (!r.metrics.empty())
+        {
+            fputc('\n', out);
+        }
+    }
+}
+
+void Benchmark::printJson(FILE *out) const
+{
+    fputs("{\n  \"benchmarks\": [", out);
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        const BenchmarkResult &r = all[i];
+        fputs((i > 0) ? ",\n    {" : "\n    {", out);
+        fputs("\"suite\": ", out);
+        printJsonString(out, r.suite);
+        fputs(", \"name\": ", out);
+        printJsonString(out, r.name);
+        fprintf(out, ", \"iterations\": %lu, \"repetitions\": %lu, \"ns_per_op\": %.4f, "
+                "\"ns_stddev\": %.4f, \"ns_min\": %.4f, \"ops_per_second\": %.1f",
+                static_cast<unsigned long>(r.iterations), static_cast<unsigned long>(r.repetitions),
+                r.nsPerOp, r.nsStddev, r.nsMin, r.opsPerSecond);
+        if (!r.metrics.empty())
+        {
+            fputs(", \"metrics\": {", out);
+            for (size_t m = 0; m < r.metrics.size(); ++m)
+            {
+                fputs((m > 0) ? ", " : "", out);
+                printJsonString(out, r.metrics[m].name);
+                if (isfinite(r.metrics[m].value))
+                {
+                    fprintf(out, ": %.6g", r.metrics[m].value);
+                }
+                else
+                {
+                    fputs(": null", out);
+                }
+            }
+            fputc('}', out);
+        }
+        fputc('}', out);
+    }
+    fputs("\n  ]\n}\n", out);
+}
+
+// Compares the fastest repetition of every result with the same benchmark in
+// a baseline and prints the change. Returns the number of benchmarks which
+// became slower by more than the tolerance, given in percent.
+size_t Benchmark::compare(const std::vector<BenchmarkResult> &baseline,
+                          const double tolerance, FILE *out) const
+{
+    size_t regressions = 0;
+    fprintf(out, "%-48s %12s %12s %10s\n", "benchmark", "baseline ns", "current ns", "change %");
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        const BenchmarkResult &r = all[i];
+        size_t b = 0;
+        while ((b < baseline.size())
+               && ((baseline[b].suite != r.suite) || (baseline[b].name != r.name)))
+        {
+            ++b;
+        }
+        const std::string label = r.suite + "/" + r.name;
+        if ((b == baseline.size()) || (baseline[b].nsMin <= 0.0))
+        {
+            fprintf(out, "%-48s %12s %12.3f %10s\n", label.c_str(), "-", r.nsMin, "new");
+            continue;
+        }
+        const double change = 100.0 * ((r.nsMin / baseline[b].nsMin) - 1.0);
+        const bool regressed = change > tolerance;
+        regressions += regressed ? 1 : 0;
+        fprintf(out, "%-48s %12.3f %12.3f %+10.2f%s\n", label.c_str(), baseline[b].nsMin,
+                r.nsMin, change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+// Reads results written by printJson
+bool Benchmark::loadJson(const std::string &path, std::vector<BenchmarkResult> &results)
+{
+    std::ifstream in(path.c_str());
+    if (!in)
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line))
+    {
+        BenchmarkResult r;
+        double iterations = 0.0, repetitions = 0.0;
+        if (jsonString(line, "suite", r.suite) && jsonString(line, "name", r.name)
+            && jsonNumber(line, "ns_per_op", r.nsPerOp) && jsonNumber(line, "ns_min", r.nsMin))
+        {
+            jsonNumber(line, "iterations", iterations);
+            jsonNumber(line, "repetitions", repetitions);
+            jsonNumber(line, "ns_stddev", r.nsStddev);
+            jsonNumber(line, "ops_per_second", r.opsPerSecond);
+            r.iterations = static_cast<size_t>(iterations);
+            r.repetitions = static_cast<size_t>(repetitions);
+            results.push_back(r);
+        }
+    }
+    return true;
+}
+
+double benchmarkSeconds()
+{
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
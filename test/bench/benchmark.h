@@ -0,0 +1,92 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A named value reported alongside a benchmark.
+ */
+struct BenchmarkMetric
+{
+    std::string name; /**< Name of the value */
+    double value;     /**< The value */
+};
+
+/**
+ * @brief Statistics of a single benchmark.
+ */
+struct BenchmarkResult
+{
+    BenchmarkResult();
+    void addMetric(const std::string &name, const double value);
+
+    std::string suite;     /**< Suite the benchmark belongs to */
+    std::string name;      /**< Name of the benchmark within the suite */
+    size_t iterations;     /**< Operations timed per repetition */
+    size_t repetitions;    /**< Number of timed repetitions */
+    double nsPerOp;        /**< Mean time per operation */
+    double nsStddev;       /**< Standard deviation between repetitions */
+    double nsMin;          /**< Fastest repetition */
+    double opsPerSecond;   /**< Throughput derived from the mean */
+    std::vector<BenchmarkMetric> metrics; /**< Extra values such as latency
+                                               percentiles */
+};
+
+/**
+ * @brief   Benchmark runner.
+ * @details Times a function which performs a given number of operations.
+ *          The number of operations is first calibrated so that a single
+ *          repetition takes at least the minimum time, then the function is
+ *          timed over several repetitions to measure the variance.
+ */
+class Benchmark
+{
+public:
+    typedef std::function<void(size_t)> Function;
+
+    Benchmark();
+    void setSuite(const std::string &suite);
+    void setFilter(const std::string &filter);
+    void setMinTime(const double seconds);
+    void setRepetitions(const size_t repetitions);
+    void setThreads(const unsigned int threads);
+    const std::string &currentSuite() const;
+    unsigned int threads() const;
+    bool enabled(const std::string &name) const;
+    void run(const std::string &name, const Function &function);
+    void add(const BenchmarkResult &result);
+    void addMetric(const std::string &name, const double value);
+    const std::vector<BenchmarkResult> &results() const;
+    void printText(FILE *out) const;
+    void printJson(FILE *out) const;
+    size_t compare(const std::vector<BenchmarkResult> &baseline,
+                   const double tolerance, FILE *out) const;
+    static bool loadJson(const std::string &path, std::vector<BenchmarkResult> &results);
+
+private:
+    std::string suite;
+    std::string filter;
+    double minTime;
+    size_t repetitions;
+    unsigned int maxThreads;
+    std::vector<BenchmarkResult> all;
+};
+
+double benchmarkSeconds();
+
+/**
+ * @brief   Prevents the compiler from optimizing away a value.
+ * @details Makes the compiler believe the value is read by something it
+ *          cannot see, so the computation producing it must happen.
+ */
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif // BENCHMARK_H
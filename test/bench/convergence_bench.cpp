@@ -0,0 +1,371 @@
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "dcm_filter.h"
+#include "gauss_newton_filter.h"
+#include "imu_filter.h"
+#include "kalman_filter.h"
+#include "mahony_imu_filter.h"
+#include "mahony_marg_filter.h"
+#include "marg_filter.h"
+#include "suites.h"
+#include "../sim/simulator.h"
+#include "../sim/trajectory.h"
+
+namespace
+{
+
+const float rate = 100.0f;
+
+// Longest time a filter is given to converge
+const float limit = 120.0f;
+
+// Error below which the filter counts as converged, and how long it must
+// stay there
+const double threshold = 2.0 * M_PI / 180.0;
+const float hold = 1.0f;
+
+// Axis the initial orientation error is about, so that it tilts the sensor
+// and turns its heading
+const Quaternion error_axis = Quaternion(0.0f, 1.0f, 0.5f, 0.3f).normalized();
+
+enum Strategy
+{
+    START_IDENTITY, // Default state: identity orientation, Eb_hat = (0,1,0,0)
+    START_ALIGN     // align() with the first sample
+};
+
+const char *const strategy_names[] = { "identity", "align" };
+
+// The DCM filter runs both with and without its magnetometer, which these
+// types tell apart
+struct DCMFilterIMU : public DCMFilter
+{
+};
+
+struct DCMFilterMARG : public DCMFilter
+{
+};
+
+struct Outcome
+{
+    long updates;      // Updates until converged, or -1 if it never did
+    double initNs;     // Cost of the initialization
+    double updateNs;   // Mean cost of an update
+};
+
+void initialize(IMUFilter &filter, const Strategy strategy, const float *s)
+{
+    if (START_ALIGN == strategy)
+    {
+        filter.align(s[3], s[4], s[5]);
+    }
+}
+
+void initialize(MARGFilter &filter, const Strategy strategy, const float *s)
+{
+    if (START_ALIGN == strategy)
+    {
+        filter.align(s[3], s[4], s[5], s[6], s[7], s[8]);
+    }
+}
+
+void initialize(GaussNewtonFilter &filter, const Strategy strategy, const float *s)
+{
+    if (START_ALIGN == strategy)
+    {
+        filter.align(s[3], s[4], s[5], s[6], s[7], s[8]);
+    }
+}
+
+void initialize(DCMFilterIMU &filter, const Strategy strategy, const float *s)
+{
+    if (START_ALIGN == strategy)
+    {
+        filter.align(s[3], s[4], s[5]);
+    }
+}
+
+void initialize(DCMFilterMARG &filter, const Strategy strategy, const float *s)
+{
+    if (START_ALIGN == strategy)
+    {
+        filter.align(s[3], s[4], s[5], s[6], s[7], s[8]);
+    }
+}
+
+void initialize(MahonyIMUFilter &filter, const Strategy strategy, const float *s)
+{
+    if (START_ALIGN == strategy)
+    {
+        filter.align(s[3], s[4], s[5]);
+    }
+}
+
+void initialize(MahonyMARGFilter &filter, const Strategy strategy, const float *s)
+{
+    if (START_ALIGN == strategy)
+    {
+        filter.align(s[3], s[4], s[5], s[6], s[7], s[8]);
+    }
+}
+
+void initialize(KalmanFilter &filter, const Strategy strategy, const float *s)
+{
+    if (START_ALIGN == strategy)
+    {
+        filter.align(s[3], s[4], s[5], s[6], s[7], s[8]);
+    }
+}
+
+void configure(IMUFilter &filter, const float gain)
+{
+    filter.setGyroErrorGain(gain);
+    filter.setSampleRate(1.0f / rate);
+}
+
+void configure(MARGFilter &filter, const float gain)
+{
+    filter.setGyroErrorGain(gain);
+    filter.setGyroDriftGain(0.01f * gain);
+    filter.setSampleRate(1.0f / rate);
+}
+
+void configure(GaussNewtonFilter &filter, const float gain)
+{
+    filter.setTimeConstant(gaussNewtonTimeConstant(gain));
+    filter.setSampleRate(1.0f / rate);
+}
+
+void configure(DCMFilter &filter, const float gain)
+{
+    filter.setProportionalGain(proportionalGain(gain));
+    filter.setIntegralGain(integralGain(gain));
+    filter.setSampleRate(1.0f / rate);
+}
+
+void configure(MahonyFilter &filter, const float gain)
+{
+    filter.setProportionalGain(proportionalGain(gain));
+    filter.setIntegralGain(integralGain(gain));
+    filter.setSampleRate(1.0f / rate);
+}
+
+void configure(KalmanFilter &filter, const float gain)
+{
+    filter.setGyroNoise(kalmanGyroNoise(gain));
+    filter.setSampleRate(1.0f / rate);
+}
+
+void update(IMUFilter &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5]);
+}
+
+void update(MARGFilter &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+}
+
+void update(GaussNewtonFilter &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+}
+
+void update(DCMFilterIMU &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5]);
+}
+
+void update(DCMFilterMARG &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+}
+
+void update(MahonyIMUFilter &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5]);
+}
+
+void update(MahonyMARGFilter &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+}
+
+void update(KalmanFilter &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+}
+
+// The IMU filter cannot observe heading, so only its tilt is judged
+double error(const IMUFilter &filter, const Quaternion &truth)
+{
+    return tiltError(filter.orientation(), truth);
+}
+
+double error(const MARGFilter &filter, const Quaternion &truth)
+{
+    return angleBetween(filter.orientation(), truth);
+}
+
+double error(const GaussNewtonFilter &filter, const Quaternion &truth)
+{
+    return angleBetween(filter.orientation(), truth);
+}
+
+double error(const DCMFilterIMU &filter, const Quaternion &truth)
+{
+    return tiltError(filter.orientation(), truth);
+}
+
+double error(const DCMFilterMARG &filter, const Quaternion &truth)
+{
+    return angleBetween(filter.orientation(), truth);
+}
+
+double error(const MahonyIMUFilter &filter, const Quaternion &truth)
+{
+    return tiltError(filter.orientation(), truth);
+}
+
+double error(const MahonyMARGFilter &filter, const Quaternion &truth)
+{
+    return angleBetween(filter.orientation(), truth);
+}
+
+double error(const KalmanFilter &filter, const Quaternion &truth)
+{
+    return angleBetween(filter.orientation(), truth);
+}
+
+template <typename F>
+Outcome converge(const SimBatch &batch, const float gain, const Strategy strategy)
+{
+    Outcome outcome;
+    const size_t repeats = 100;
+
+    // Time the initialization on its own
+    F filter;
+    configure(filter, gain);
+    const double init_start = benchmarkSeconds();
+    for (size_t r = 0; r < repeats; ++r)
+    {
+        initialize(filter, strategy, batch.sample(0, 0));
+        doNotOptimize(filter);
+    }
+    outcome.initNs = ((benchmarkSeconds() - init_start) * 1.0e9) / repeats;
+
+    F timed;
+    configure(timed, gain);
+    initialize(timed, strategy, batch.sample(0, 0));
+    const double start = benchmarkSeconds();
+    for (size_t i = 0; i < batch.count; ++i)
+    {
+        update(timed, batch.sample(i, 0));
+    }
+    doNotOptimize(timed);
+    outcome.updateNs = ((benchmarkSeconds() - start) * 1.0e9) / batch.count;
+
+    // Replay untimed to judge the error
+    F judged;
+    configure(judged, gain);
+    initialize(judged, strategy, batch.sample(0, 0));
+    const size_t needed = static_cast<size_t>(hold * rate);
+    size_t inside = 0;
+    outcome.updates = -1;
+    for (size_t i = 0; i < batch.count; ++i)
+    {
+        update(judged, batch.sample(i, 0));
+        inside = (error(judged, batch.truth[i]) < threshold) ? (inside + 1) : 0;
+        if (inside >= needed)
+        {
+            outcome.updates = static_cast<long>(i + 1 - needed);
+            break;
+        }
+    }
+    return outcome;
+}
+
+template <typename F>
+void evaluate(Benchmark &bench, const char *filter, const SimBatch &batch,
+              const float degrees, const float gain, const Strategy strategy)
+{
+    char label[96];
+    snprintf(label, sizeof(label), "%s/%s/error:%g/gain:%g", filter,
+             strategy_names[strategy], degrees, gain);
+    if (!bench.enabled(label))
+    {
+        return;
+    }
+    const Outcome outcome = converge<F>(batch, gain, strategy);
+
+    BenchmarkResult result;
+    result.suite = bench.currentSuite();
+    result.name = label;
+    result.iterations = batch.count;
+    result.repetitions = 1;
+    result.nsPerOp = outcome.updateNs;
+    result.nsMin = outcome.updateNs;
+    result.opsPerSecond = (outcome.updateNs > 0.0) ? (1.0e9 / outcome.updateNs) : 0.0;
+    result.addMetric("init_ns", outcome.initNs);
+    if (outcome.updates >= 0)
+    {
+        result.addMetric("updates", outcome.updates);
+        result.addMetric("seconds", outcome.updates / rate);
+        result.addMetric("cpu_us", ((outcome.updates * outcome.updateNs) + outcome.initNs) * 1.0e-3);
+    }
+    else
+    {
+        result.addMetric("updates", NAN);
+    }
+    bench.add(result);
+}
+
+// A resting device whose orientation is a given angle away from the identity
+void restingLog(const float degrees, SimBatch &batch)
+{
+    const float half = 0.5f * degrees * static_cast<float>(M_PI / 180.0);
+    Simulator simulator;
+    simulator.setSampleRate(rate);
+    simulator.setInitialOrientation(Quaternion(cosf(half), sinf(half) * error_axis.x,
+                                               sinf(half) * error_axis.y, sinf(half) * error_axis.z));
+    MotionSegment rest;
+    rest.duration = limit;
+    simulator.addSegment(rest);
+    simulator.reset(1, 11);
+    simulator.generate(batch, static_cast<size_t>(limit * rate));
+}
+
+} // namespace
+
+// Updates and time needed from startup until the attitude error stays below
+// two degrees, for a range of initial errors, gains and ways of starting
+void convergenceSuite(Benchmark &bench)
+{
+    bench.setSuite("convergence");
+    const float errors[] = { 0.0f, 10.0f, 45.0f, 90.0f, 170.0f };
+    const float gains[] = { 0.02f, 0.05f, 0.2f, 0.5f };
+
+    for (size_t e = 0; e < sizeof(errors) / sizeof(errors[0]); ++e)
+    {
+        SimBatch batch;
+        restingLog(errors[e], batch);
+        for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); ++g)
+        {
+            for (int s = START_IDENTITY; s <= START_ALIGN; ++s)
+            {
+                const Strategy strategy = static_cast<Strategy>(s);
+                evaluate<IMUFilter>(bench, "imu", batch, errors[e], gains[g], strategy);
+                evaluate<MARGFilter>(bench, "marg", batch, errors[e], gains[g], strategy);
+                evaluate<GaussNewtonFilter>(bench, "gauss-newton", batch, errors[e], gains[g], strategy);
+                evaluate<DCMFilterIMU>(bench, "dcm-imu", batch, errors[e], gains[g], strategy);
+                evaluate<DCMFilterMARG>(bench, "dcm-marg", batch, errors[e], gains[g], strategy);
+                evaluate<MahonyIMUFilter>(bench, "mahony-imu", batch, errors[e], gains[g], strategy);
+                evaluate<MahonyMARGFilter>(bench, "mahony-marg", batch, errors[e], gains[g], strategy);
+                evaluate<KalmanFilter>(bench, "kalman", batch, errors[e], gains[g], strategy);
+            }
+        }
+    }
+}
@@ -0,0 +1,258 @@
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "dcm_filter.h"
+#include "gauss_newton_filter.h"
+#include "imu_filter.h"
+#include "kalman_filter.h"
+#include "mahony_imu_filter.h"
+#include "mahony_marg_filter.h"
+#include "marg_filter.h"
+#include "perf_counters.h"
+#include "quaternion.h"
+#include "suites.h"
+
+namespace
+{
+
+// Operations counted per benchmark
+const size_t operations = 1000000;
+
+// Number of distinct operands cycled through
+const size_t operands = 1024;
+
+// Counts the events of a function performing a number of operations, after
+// one untimed run to warm the caches and branch predictors
+template <typename F>
+void count(Benchmark &bench, PerfCounters &counters, const std::string &name, F function)
+{
+    if (!bench.enabled(name))
+    {
+        return;
+    }
+    function(operations);
+    counters.start();
+    const double start = benchmarkSeconds();
+    function(operations);
+    const double elapsed = benchmarkSeconds() - start;
+    counters.stop();
+
+    BenchmarkResult result;
+    result.suite = bench.currentSuite();
+    result.name = name;
+    result.iterations = operations;
+    result.repetitions = 1;
+    result.nsPerOp = (elapsed * 1.0e9) / operations;
+    result.nsMin = result.nsPerOp;
+    result.opsPerSecond = operations / elapsed;
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+    {
+        const PerfEvent event = static_cast<PerfEvent>(e);
+        if (counters.available(event))
+        {
+            result.addMetric(std::string(PerfCounters::name(event)) + "_per_op",
+                             counters.value(event) / operations);
+        }
+    }
+    if (counters.available(PERF_INSTRUCTIONS) && counters.available(PERF_CYCLES)
+        && (counters.value(PERF_CYCLES) > 0.0))
+    {
+        result.addMetric("ipc", counters.value(PERF_INSTRUCTIONS) / counters.value(PERF_CYCLES));
+    }
+    bench.add(result);
+}
+
+std::vector<Quaternion> versors(const float seed)
+{
+    std::vector<Quaternion> q(operands);
+    for (size_t i = 0; i < operands; ++i)
+    {
+        q[i] = Quaternion(sinf(seed + 0.37f * i), cosf(seed + 1.91f * i),
+                          sinf(seed + 2.63f * i + 1.0f), cosf(seed + 0.71f * i + 2.0f)).normalized();
+    }
+    return q;
+}
+
+} // namespace
+
+// Instructions, cycles, cache and branch misses per operation of the filter
+// updates and the quaternion kernels they are built from
+void countersSuite(Benchmark &bench)
+{
+    bench.setSuite("counters");
+    PerfCounters counters;
+    if (!counters.open())
+    {
+        fprintf(stderr, "counters: hardware counters unavailable (%s), reporting time only\n",
+                counters.error().c_str());
+    }
+    else if (!counters.error().empty())
+    {
+        fprintf(stderr, "counters: some events unavailable (%s)\n", counters.error().c_str());
+    }
+
+    const std::vector<Quaternion> a = versors(0.0f);
+    const std::vector<Quaternion> b = versors(0.5f);
+    std::vector<Quaternion> out(operands);
+
+    IMUFilter imu;
+    imu.setGyroErrorGain(0.015074f);
+    imu.setSampleRate(0.005f);
+    count(bench, counters, "imu/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Quaternion &g = a[i % operands];
+            const Quaternion &s = b[i % operands];
+            imu.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f);
+        }
+        doNotOptimize(imu);
+    });
+
+    MARGFilter marg;
+    marg.setGyroErrorGain(0.015074f);
+    marg.setGyroDriftGain(0.000264f);
+    marg.setSampleRate(0.005f);
+    count(bench, counters, "marg/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Quaternion &g = a[i % operands];
+            const Quaternion &s = b[i % operands];
+            marg.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                        0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+        }
+        doNotOptimize(marg);
+    });
+
+    GaussNewtonFilter gauss_newton;
+    gauss_newton.setSampleRate(0.005f);
+    count(bench, counters, "gauss-newton/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Quaternion &g = a[i % operands];
+            const Quaternion &s = b[i % operands];
+            gauss_newton.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                                0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+        }
+        doNotOptimize(gauss_newton);
+    });
+
+    DCMFilter dcm_imu;
+    dcm_imu.setSampleRate(0.005f);
+    count(bench, counters, "dcm-imu/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Quaternion &g = a[i % operands];
+            const Quaternion &s = b[i % operands];
+            dcm_imu.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f);
+        }
+        doNotOptimize(dcm_imu);
+    });
+
+    DCMFilter dcm_marg;
+    dcm_marg.setSampleRate(0.005f);
+    count(bench, counters, "dcm-marg/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Quaternion &g = a[i % operands];
+            const Quaternion &s = b[i % operands];
+            dcm_marg.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                            0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+        }
+        doNotOptimize(dcm_marg);
+    });
+
+    MahonyIMUFilter mahony_imu;
+    mahony_imu.setSampleRate(0.005f);
+    count(bench, counters, "mahony-imu/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Quaternion &g = a[i % operands];
+            const Quaternion &s = b[i % operands];
+            mahony_imu.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f);
+        }
+        doNotOptimize(mahony_imu);
+    });
+
+    MahonyMARGFilter mahony_marg;
+    mahony_marg.setSampleRate(0.005f);
+    count(bench, counters, "mahony-marg/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Quaternion &g = a[i % operands];
+            const Quaternion &s = b[i % operands];
+            mahony_marg.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                               0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+        }
+        doNotOptimize(mahony_marg);
+    });
+
+    KalmanFilter kalman;
+    kalman.setSampleRate(0.005f);
+    count(bench, counters, "kalman/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Quaternion &g = a[i % operands];
+            const Quaternion &s = b[i % operands];
+            kalman.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                          0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+        }
+        doNotOptimize(kalman);
+    });
+
+    count(bench, counters, "quaternion/multiply", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            out[k] = a[k] * b[k];
+        }
+        doNotOptimize(out[0]);
+    });
+    count(bench, counters, "quaternion/normalize", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            out[k] = (a[k] + b[k]).normalized();
+        }
+        doNotOptimize(out[0]);
+    });
+    count(bench, counters, "quaternion/inverse", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            out[k] = a[k].inverse();
+        }
+        doNotOptimize(out[0]);
+    });
+    count(bench, counters, "quaternion/rotate", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            out[k] = a[k].conjugate() * Quaternion(0.0f, b[k].x, b[k].y, b[k].z) * a[k];
+        }
+        doNotOptimize(out[0]);
+    });
+    count(bench, counters, "quaternion/euler", [&](size_t n)
+    {
+        float roll, pitch, yaw, sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            a[i % operands].convertToEulerAngles(roll, pitch, yaw);
+            sum += roll + pitch + yaw;
+        }
+        doNotOptimize(sum);
+    });
+}
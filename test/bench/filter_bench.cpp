@@ -0,0 +1,668 @@
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "benchmark.h"
+#include "dcm_filter.h"
+#include "delta_integrator.h"
+#include "gauss_newton_filter.h"
+#include "imu_filter.h"
+#include "kalman_filter.h"
+#include "latency_histogram.h"
+#include "magnetometer_calibrator.h"
+#include "mahony_imu_filter.h"
+#include "mahony_marg_filter.h"
+#include "marg_filter.h"
+#include "sensor_calibration.h"
+#include "sensor_format.h"
+#include "suites.h"
+
+namespace
+{
+
+// Number of distinct samples cycled through by the benchmarks
+const size_t sample_count = 4096;
+
+// Gyroscope, accelerometer then magnetometer axes of one sample
+struct Sample
+{
+    float v[9];
+};
+
+// Reproducible input from a smooth tumbling motion with a little noise
+std::vector<Sample> syntheticSamples()
+{
+    std::vector<Sample> samples(sample_count);
+    uint32_t state = 12345;
+    for (size_t i = 0; i < sample_count; ++i)
+    {
+        const float t = 0.005f * i;
+        float *v = samples[i].v;
+        for (size_t k = 0; k < 9; ++k)
+        {
+            state = (state * 1664525u) + 1013904223u;
+            v[k] = 0.01f * ((state >> 8) * (1.0f / 16777216.0f) - 0.5f);
+        }
+        v[0] += 0.5f * sinf(0.9f * t);
+        v[1] += 0.3f * cosf(1.3f * t);
+        v[2] += 0.2f;
+        v[3] += 0.2f * sinf(0.7f * t);
+        v[4] += 0.2f * cosf(0.5f * t);
+        v[5] += 0.96f;
+        v[6] += 0.4f * cosf(0.2f * t);
+        v[7] += 0.4f * sinf(0.2f * t);
+        v[8] += -0.8f;
+    }
+    return samples;
+}
+
+void updateImu(IMUFilter &filter, const Sample &s)
+{
+    filter.update(s.v[0], s.v[1], s.v[2], s.v[3], s.v[4], s.v[5]);
+}
+
+void updateMarg(MARGFilter &filter, const Sample &s)
+{
+    filter.update(s.v[0], s.v[1], s.v[2], s.v[3], s.v[4], s.v[5], s.v[6], s.v[7], s.v[8]);
+}
+
+void updateGaussNewton(GaussNewtonFilter &filter, const Sample &s)
+{
+    filter.update(s.v[0], s.v[1], s.v[2], s.v[3], s.v[4], s.v[5], s.v[6], s.v[7], s.v[8]);
+}
+
+void updateDcmImu(DCMFilter &filter, const Sample &s)
+{
+    filter.update(s.v[0], s.v[1], s.v[2], s.v[3], s.v[4], s.v[5]);
+}
+
+void updateDcmMarg(DCMFilter &filter, const Sample &s)
+{
+    filter.update(s.v[0], s.v[1], s.v[2], s.v[3], s.v[4], s.v[5], s.v[6], s.v[7], s.v[8]);
+}
+
+void updateMahonyImu(MahonyIMUFilter &filter, const Sample &s)
+{
+    filter.update(s.v[0], s.v[1], s.v[2], s.v[3], s.v[4], s.v[5]);
+}
+
+void updateMahonyMarg(MahonyMARGFilter &filter, const Sample &s)
+{
+    filter.update(s.v[0], s.v[1], s.v[2], s.v[3], s.v[4], s.v[5], s.v[6], s.v[7], s.v[8]);
+}
+
+void updateKalman(KalmanFilter &filter, const Sample &s)
+{
+    filter.update(s.v[0], s.v[1], s.v[2], s.v[3], s.v[4], s.v[5], s.v[6], s.v[7], s.v[8]);
+}
+
+template <typename F>
+void configure(F &filter)
+{
+    filter.setGyroErrorGain(0.015074f);
+    filter.setSampleRate(0.005f);
+}
+
+void configure(MARGFilter &filter)
+{
+    filter.setGyroErrorGain(0.015074f);
+    filter.setGyroDriftGain(0.000264f);
+    filter.setSampleRate(0.005f);
+}
+
+void configure(GaussNewtonFilter &filter)
+{
+    filter.setSampleRate(0.005f);
+}
+
+void configure(DCMFilter &filter)
+{
+    filter.setSampleRate(0.005f);
+}
+
+void configure(KalmanFilter &filter)
+{
+    filter.setSampleRate(0.005f);
+}
+
+// Times every update on its own, less the overhead of reading the clock
+template <typename F, typename U>
+void latency(Benchmark &bench, const std::string &name,
+             const std::vector<Sample> &samples, U update)
+{
+    if (!bench.enabled(name))
+    {
+        return;
+    }
+    typedef std::chrono::steady_clock Clock;
+    const size_t count = 200000;
+
+    double overhead = 1.0e30;
+    for (int r = 0; r < 1000; ++r)
+    {
+        const Clock::time_point a = Clock::now();
+        const Clock::time_point b = Clock::now();
+        overhead = std::min(overhead, std::chrono::duration<double, std::nano>(b - a).count());
+    }
+
+    F filter;
+    configure(filter);
+    std::vector<double> ns(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Clock::time_point start = Clock::now();
+        update(filter, samples[i % sample_count]);
+        const Clock::time_point end = Clock::now();
+        ns[i] = std::max(0.0, std::chrono::duration<double, std::nano>(end - start).count() - overhead);
+    }
+    doNotOptimize(filter);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        sum += ns[i];
+    }
+    std::sort(ns.begin(), ns.end());
+    BenchmarkResult result;
+    result.suite = bench.currentSuite();
+    result.name = name;
+    result.iterations = count;
+    result.repetitions = 1;
+    result.nsPerOp = sum / count;
+    result.nsMin = ns.front();
+    result.opsPerSecond = (result.nsPerOp > 0.0) ? (1.0e9 / result.nsPerOp) : 0.0;
+    double squares = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        squares += (ns[i] - result.nsPerOp) * (ns[i] - result.nsPerOp);
+    }
+    result.nsStddev = sqrt(squares / (count - 1));
+    const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+    for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); ++p)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "p%g_ns", percentiles[p]);
+        result.addMetric(label, ns[static_cast<size_t>((percentiles[p] / 100.0) * (count - 1))]);
+    }
+    result.addMetric("max_ns", ns.back());
+    result.addMetric("clock_overhead_ns", overhead);
+    bench.add(result);
+}
+
+// Runs one filter per thread over the same number of updates each
+template <typename F, typename U>
+void scaling(Benchmark &bench, const std::string &name,
+             const std::vector<Sample> &samples, U update)
+{
+    std::vector<unsigned int> counts;
+    for (unsigned int t = 1; t < bench.threads(); t *= 2)
+    {
+        counts.push_back(t);
+    }
+    counts.push_back(bench.threads());
+
+    const size_t updates = 2000000;
+    double single = 0.0;
+    for (size_t c = 0; c < counts.size(); ++c)
+    {
+        const unsigned int threads = counts[c];
+        char label[64];
+        snprintf(label, sizeof(label), "%s/threads:%u", name.c_str(), threads);
+        if (!bench.enabled(label))
+        {
+            continue;
+        }
+
+        // Release every thread at once so they overlap fully
+        std::atomic<unsigned int> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> pool;
+        for (unsigned int t = 0; t < threads; ++t)
+        {
+            pool.push_back(std::thread([&]()
+            {
+                F filter;
+                configure(filter);
+                ++ready;
+                while (!go)
+                {
+                    std::this_thread::yield();
+                }
+                for (size_t i = 0; i < updates; ++i)
+                {
+                    update(filter, samples[i % sample_count]);
+                }
+                doNotOptimize(filter);
+            }));
+        }
+        while (ready < threads)
+        {
+            std::this_thread::yield();
+        }
+        const double start = benchmarkSeconds();
+        go = true;
+        for (size_t t = 0; t < pool.size(); ++t)
+        {
+            pool[t].join();
+        }
+        const double elapsed = benchmarkSeconds() - start;
+
+        const double rate = (threads * updates) / elapsed;
+        single = (1 == threads) ? rate : single;
+        BenchmarkResult result;
+        result.suite = bench.currentSuite();
+        result.name = label;
+        result.iterations = threads * updates;
+        result.repetitions = 1;
+        result.nsPerOp = (elapsed * 1.0e9) / (threads * updates);
+        result.nsMin = result.nsPerOp;
+        result.opsPerSecond = rate;
+        result.addMetric("threads", threads);
+        result.addMetric("updates_per_second", rate);
+        if (single > 0.0)
+        {
+            result.addMetric("speedup", rate / single);
+            result.addMetric("efficiency", rate / (single * threads));
+        }
+        bench.add(result);
+    }
+}
+
+// Records every update into histograms attached to the filters while all
+// threads run at once. Each thread keeps its own histogram of update
+// durations, merged at the end, and all of them share one histogram of the
+// time from marking the arrival of a sample to the end of its update.
+template <typename F, typename U>
+void histogram(Benchmark &bench, const std::string &name,
+               const std::vector<Sample> &samples, U update)
+{
+    if (!bench.enabled(name))
+    {
+        return;
+    }
+    const unsigned int threads = bench.threads();
+    const size_t updates = 500000;
+    std::vector<LatencyHistogram> durations(threads);
+    LatencyHistogram latencies;
+    std::vector<std::thread> pool;
+    const double start = benchmarkSeconds();
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        pool.push_back(std::thread([&, t]()
+        {
+            F filter;
+            configure(filter);
+            filter.setLatencyHistograms(&durations[t], &latencies);
+            for (size_t i = 0; i < updates; ++i)
+            {
+                filter.markArrival();
+                update(filter, samples[i % sample_count]);
+            }
+            doNotOptimize(filter);
+        }));
+    }
+    for (size_t t = 0; t < pool.size(); ++t)
+    {
+        pool[t].join();
+    }
+    const double elapsed = benchmarkSeconds() - start;
+
+    LatencyHistogram merged;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        merged.add(durations[t]);
+    }
+    BenchmarkResult result;
+    result.suite = bench.currentSuite();
+    result.name = name;
+    result.iterations = merged.count();
+    result.repetitions = 1;
+    result.nsPerOp = merged.mean();
+    result.nsMin = merged.minimum();
+    result.opsPerSecond = merged.count() / elapsed;
+    result.addMetric("threads", threads);
+    const float percentiles[] = { 50.0f, 99.0f, 99.9f, 99.99f };
+    for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); ++p)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "update_p%g_ns", percentiles[p]);
+        result.addMetric(label, merged.percentile(percentiles[p]));
+    }
+    result.addMetric("update_max_ns", merged.maximum());
+    result.addMetric("latency_p50_ns", latencies.percentile(50.0f));
+    result.addMetric("latency_p99.9_ns", latencies.percentile(99.9f));
+    result.addMetric("latency_max_ns", latencies.maximum());
+    bench.add(result);
+}
+
+#ifdef FUSION_PROFILE
+// Mean cycles spent in each stage of MARGFilter::update
+void stages(Benchmark &bench, const std::vector<Sample> &samples)
+{
+    if (!bench.enabled("marg/stages"))
+    {
+        return;
+    }
+    const size_t count = 1000000;
+    MARGFilter filter;
+    configure(filter);
+    const double start = benchmarkSeconds();
+    for (size_t i = 0; i < count; ++i)
+    {
+        updateMarg(filter, samples[i % sample_count]);
+    }
+    const double elapsed = benchmarkSeconds() - start;
+    doNotOptimize(filter);
+
+    BenchmarkResult result;
+    result.suite = bench.currentSuite();
+    result.name = "marg/stages";
+    result.iterations = count;
+    result.repetitions = 1;
+    result.nsPerOp = (elapsed * 1.0e9) / count;
+    result.nsMin = result.nsPerOp;
+    result.opsPerSecond = count / elapsed;
+    const StageProfile &profile = filter.stageProfile();
+    for (int i = 0; i < MARGFilter::STAGE_COUNT; ++i)
+    {
+        std::string name = MARGFilter::stageName(static_cast<MARGFilter::Stage>(i));
+        std::replace(name.begin(), name.end(), ' ', '_');
+        result.addMetric(name + "_cycles", static_cast<double>(profile.cycles(i)) / profile.updates());
+    }
+    bench.add(result);
+}
+#endif
+
+} // namespace
+
+// Updates per second of a single filter, the distribution of the time taken
+// by individual updates, and the total rate of one filter per thread
+void filterSuite(Benchmark &bench)
+{
+    bench.setSuite("filters");
+    const std::vector<Sample> samples = syntheticSamples();
+
+    IMUFilter imu;
+    configure(imu);
+    bench.run("imu/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateImu(imu, samples[i % sample_count]);
+        }
+        doNotOptimize(imu);
+    });
+
+    MARGFilter marg;
+    configure(marg);
+    bench.run("marg/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateMarg(marg, samples[i % sample_count]);
+        }
+        doNotOptimize(marg);
+    });
+
+    GaussNewtonFilter gauss_newton;
+    configure(gauss_newton);
+    bench.run("gauss-newton/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateGaussNewton(gauss_newton, samples[i % sample_count]);
+        }
+        doNotOptimize(gauss_newton);
+    });
+
+    DCMFilter dcm_imu;
+    configure(dcm_imu);
+    bench.run("dcm-imu/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateDcmImu(dcm_imu, samples[i % sample_count]);
+        }
+        doNotOptimize(dcm_imu);
+    });
+
+    DCMFilter dcm_marg;
+    configure(dcm_marg);
+    bench.run("dcm-marg/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateDcmMarg(dcm_marg, samples[i % sample_count]);
+        }
+        doNotOptimize(dcm_marg);
+    });
+
+    MahonyIMUFilter mahony_imu;
+    configure(mahony_imu);
+    bench.run("mahony-imu/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateMahonyImu(mahony_imu, samples[i % sample_count]);
+        }
+        doNotOptimize(mahony_imu);
+    });
+
+    MahonyMARGFilter mahony_marg;
+    configure(mahony_marg);
+    bench.run("mahony-marg/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateMahonyMarg(mahony_marg, samples[i % sample_count]);
+        }
+        doNotOptimize(mahony_marg);
+    });
+
+    KalmanFilter kalman;
+    configure(kalman);
+    bench.run("kalman/update", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateKalman(kalman, samples[i % sample_count]);
+        }
+        doNotOptimize(kalman);
+    });
+
+    // The batch updates take every sample in one call, packed as the six or
+    // nine values the filters expect
+    std::vector<float> packed_imu, packed_marg;
+    for (size_t i = 0; i < sample_count; ++i)
+    {
+        packed_imu.insert(packed_imu.end(), samples[i].v, samples[i].v + 6);
+        packed_marg.insert(packed_marg.end(), samples[i].v, samples[i].v + 9);
+    }
+    bench.run("mahony-imu/batch", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            mahony_imu.update(&packed_imu[0], std::min(sample_count, n - i), 0, 0);
+        }
+        doNotOptimize(mahony_imu);
+    });
+    bench.run("mahony-marg/batch", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            mahony_marg.update(&packed_marg[0], std::min(sample_count, n - i), 0, 0);
+        }
+        doNotOptimize(mahony_marg);
+    });
+    bench.run("kalman/batch", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            kalman.update(&packed_marg[0], std::min(sample_count, n - i), 0, 0);
+        }
+        doNotOptimize(kalman);
+    });
+
+    // FIFO bursts with one orientation written per eight samples, and the
+    // same bursts as raw counts with the gyroscope scaled in the update
+    std::vector<Quaternion> outputs(sample_count / 8);
+    bench.run("imu/burst", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            imu.update(&packed_imu[0], std::min(sample_count, n - i),
+                       &outputs[0], 8);
+        }
+        doNotOptimize(imu);
+    });
+    bench.run("marg/burst", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            marg.update(&packed_marg[0], std::min(sample_count, n - i),
+                        &outputs[0], 8);
+        }
+        doNotOptimize(marg);
+    });
+    std::vector<int16_t> raw_marg(packed_marg.size());
+    for (size_t i = 0; i < raw_marg.size(); ++i)
+    {
+        const float scale = (i % 9 < 3) ? 1000.0f : 8000.0f;
+        raw_marg[i] = static_cast<int16_t>(scale * packed_marg[i]);
+    }
+    bench.run("marg/raw-burst", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            marg.update(&raw_marg[0], std::min(sample_count, n - i), 0.001f,
+                        &outputs[0], 8);
+        }
+        doNotOptimize(marg);
+    });
+
+    SensorFormat format;
+    for (int i = 0; i < SensorFormat::AXIS_COUNT; ++i)
+    {
+        format.setAxis(static_cast<SensorFormat::Axis>(i), static_cast<uint8_t>(i),
+                       (i < 3) ? 0.001f : 0.000125f, 0.0f);
+    }
+    bench.run("marg/format-burst", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            marg.update(&raw_marg[0], std::min(sample_count, n - i), format,
+                        &outputs[0], 8);
+        }
+        doNotOptimize(marg);
+    });
+
+    // A calibration pass over the samples on its own, then fused into the
+    // bursts. Each run restores the samples since the pass is in place.
+    SensorCalibration calibration;
+    const float soft_iron[3][3] = { { 1.1f, 0.05f, 0.0f },
+                                    { 0.05f, 0.9f, 0.02f },
+                                    { 0.0f, 0.02f, 1.05f } };
+    calibration.setBias(SensorCalibration::SENSOR_GYRO, 0.01f, -0.02f, 0.005f);
+    calibration.setScale(SensorCalibration::SENSOR_ACCEL, 1.02f, 0.99f, 1.01f);
+    calibration.setMatrix(SensorCalibration::SENSOR_MAG, soft_iron);
+    calibration.setBias(SensorCalibration::SENSOR_MAG, 0.3f, -0.1f, 0.2f);
+    std::vector<float> calibrated(packed_marg);
+    bench.run("calibration/apply", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            const size_t count = std::min(sample_count, n - i);
+            std::copy(packed_marg.begin(), packed_marg.begin() + 9 * count, calibrated.begin());
+            calibration.apply(&calibrated[0], count, 9, 3);
+        }
+        doNotOptimize(calibrated[0]);
+    });
+    bench.run("marg/calibrated-burst", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            marg.update(&packed_marg[0], std::min(sample_count, n - i),
+                        calibration, &outputs[0], 8);
+        }
+        doNotOptimize(marg);
+    });
+    bench.run("marg/format-calibrated-burst", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; i += sample_count)
+        {
+            marg.update(&raw_marg[0], std::min(sample_count, n - i), format,
+                        calibration, &outputs[0], 8);
+        }
+        doNotOptimize(marg);
+    });
+
+    // The online magnetometer calibration alongside a filter, including the
+    // fit it runs every hundred readings
+    MagnetometerCalibrator mag_calibrator;
+    bench.run("mag-calibrator/add", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const float *v = samples[i % sample_count].v;
+            mag_calibrator.add(v[6], v[7], v[8]);
+        }
+        doNotOptimize(mag_calibrator);
+    });
+
+    // An update followed by reading the orientation, which converts the
+    // matrix to a quaternion
+    bench.run("dcm-marg/orientation", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            updateDcmMarg(dcm_marg, samples[i % sample_count]);
+            doNotOptimize(dcm_marg.orientation());
+        }
+    });
+
+    // Sixteen delta increments per update, the gyroscope and accelerometer
+    // samples read as increments over one period
+    DeltaIntegrator delta;
+    delta.setPeriod(0.005f);
+    IMUFilter delta_imu;
+    configure(delta_imu);
+    delta_imu.setIntegrator(Filter::INTEGRATOR_EXPONENTIAL);
+    bench.run("delta-imu/increment", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const float *v = samples[i % sample_count].v;
+            delta.add(0.005f * v[0], 0.005f * v[1], 0.005f * v[2],
+                      0.005f * v[3], 0.005f * v[4], 0.005f * v[5]);
+            if (delta.count() == 16)
+            {
+                float w[3], a[3];
+                delta.rates(w[0], w[1], w[2], a[0], a[1], a[2]);
+                delta_imu.setSampleRate(delta.duration());
+                delta_imu.update(w[0], w[1], w[2], a[0], a[1], a[2]);
+                delta.reset();
+            }
+        }
+        doNotOptimize(delta_imu);
+    });
+
+    latency<IMUFilter>(bench, "imu/latency", samples, updateImu);
+    latency<MARGFilter>(bench, "marg/latency", samples, updateMarg);
+    latency<GaussNewtonFilter>(bench, "gauss-newton/latency", samples, updateGaussNewton);
+    latency<DCMFilter>(bench, "dcm-imu/latency", samples, updateDcmImu);
+    latency<DCMFilter>(bench, "dcm-marg/latency", samples, updateDcmMarg);
+    latency<MahonyIMUFilter>(bench, "mahony-imu/latency", samples, updateMahonyImu);
+    latency<MahonyMARGFilter>(bench, "mahony-marg/latency", samples, updateMahonyMarg);
+    latency<KalmanFilter>(bench, "kalman/latency", samples, updateKalman);
+    scaling<IMUFilter>(bench, "imu/scaling", samples, updateImu);
+    scaling<MARGFilter>(bench, "marg/scaling", samples, updateMarg);
+    histogram<IMUFilter>(bench, "imu/histogram", samples, updateImu);
+    histogram<MARGFilter>(bench, "marg/histogram", samples, updateMarg);
+#ifdef FUSION_PROFILE
+    stages(bench, samples);
+#endif
+}
@@ -0,0 +1,172 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "suites.h"
+
+namespace
+{
+
+struct Suite
+{
+    const char *name;
+    void (*run)(Benchmark &bench);
+};
+
+const Suite suites[] =
+{
+    { "quaternion", quaternionSuite },
+    { "filters",    filterSuite },
+    { "accuracy",   accuracySuite },
+    { "simulator",  simulatorSuite },
+    { "counters",   countersSuite },
+    { "convergence", convergenceSuite }
+};
+
+const size_t suite_count = sizeof(suites) / sizeof(suites[0]);
+
+void usage(FILE *out)
+{
+    fputs("Usage: fusion-bench [OPTION]...\n"
+          "Benchmarks the Fusion library.\n"
+          "\n"
+          "  -s, --suite=NAME        run only this suite, may be repeated\n"
+          "  -f, --filter=TEXT       run only benchmarks whose suite/name contains TEXT\n"
+          "  -r, --repetitions=N     timed repetitions per benchmark (default 10)\n"
+          "  -t, --min-time=SECONDS  minimum time per repetition (default 0.02)\n"
+          "  -T, --threads=N         most threads for scaling runs (default: all cores)\n"
+          "  -j, --json              print results as JSON\n"
+          "  -b, --baseline=FILE     compare with results saved by --json and fail if\n"
+          "                          any benchmark became slower than the tolerance\n"
+          "  -p, --tolerance=PERCENT slowdown allowed by --baseline (default 10)\n"
+          "  -l, --list              list the suites\n"
+          "  -h, --help              show this help\n", out);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    static const struct option long_options[] =
+    {
+        { "suite",       required_argument, 0, 's' },
+        { "filter",      required_argument, 0, 'f' },
+        { "repetitions", required_argument, 0, 'r' },
+        { "min-time",    required_argument, 0, 't' },
+        { "threads",     required_argument, 0, 'T' },
+        { "json",        no_argument,       0, 'j' },
+        { "baseline",    required_argument, 0, 'b' },
+        { "tolerance",   required_argument, 0, 'p' },
+        { "list",        no_argument,       0, 'l' },
+        { "help",        no_argument,       0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    Benchmark bench;
+    std::vector<std::string> selected;
+    bool json = false;
+    std::string baseline;
+    double tolerance = 10.0;
+    int c;
+    while (-1 != (c = getopt_long(argc, argv, "s:f:r:t:T:jb:p:lh", long_options, 0)))
+    {
+        switch (c)
+        {
+        case 's':
+            selected.push_back(optarg);
+            break;
+        case 'f':
+            bench.setFilter(optarg);
+            break;
+        case 'r':
+            bench.setRepetitions(strtoul(optarg, 0, 10));
+            break;
+        case 't':
+            bench.setMinTime(strtod(optarg, 0));
+            break;
+        case 'T':
+            bench.setThreads(strtoul(optarg, 0, 10));
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        case 'p':
+            tolerance = strtod(optarg, 0);
+            break;
+        case 'l':
+            for (size_t i = 0; i < suite_count; ++i)
+            {
+                puts(suites[i].name);
+            }
+            return 0;
+        case 'h':
+            usage(stdout);
+            return 0;
+        default:
+            usage(stderr);
+            return 2;
+        }
+    }
+
+    for (size_t i = 0; i < selected.size(); ++i)
+    {
+        size_t s = 0;
+        while ((s < suite_count) && (selected[i] != suites[s].name))
+        {
+            ++s;
+        }
+        if (s == suite_count)
+        {
+            fprintf(stderr, "fusion-bench: unknown suite '%s'\n", selected[i].c_str());
+            return 2;
+        }
+    }
+
+    std::vector<BenchmarkResult> reference;
+    if (!baseline.empty() && !Benchmark::loadJson(baseline, reference))
+    {
+        fprintf(stderr, "fusion-bench: cannot read baseline '%s'\n", baseline.c_str());
+        return 2;
+    }
+
+    for (size_t i = 0; i < suite_count; ++i)
+    {
+        bool run = selected.empty();
+        for (size_t s = 0; s < selected.size(); ++s)
+        {
+            run = run || (selected[s] == suites[i].name);
+        }
+        if (run)
+        {
+            suites[i].run(bench);
+        }
+    }
+
+    if (json)
+    {
+        bench.printJson(stdout);
+    }
+    else
+    {
+        bench.printText(stdout);
+    }
+
+    // The baseline comparison goes to stderr so that --json output stays valid
+    if (!baseline.empty())
+    {
+        const size_t regressions = bench.compare(reference, tolerance, stderr);
+        if (regressions > 0)
+        {
+            fprintf(stderr, "fusion-bench: %lu benchmarks slower than the baseline by more than %g%%\n",
+                    static_cast<unsigned long>(regressions), tolerance);
+            return 1;
+        }
+    }
+    return 0;
+}
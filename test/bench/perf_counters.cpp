@@ -0,0 +1,144 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "perf_counters.h"
+
+namespace
+{
+
+struct EventConfig
+{
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+};
+
+const EventConfig configs[PERF_EVENT_COUNT] =
+{
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), "l1d_misses" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch_misses" }
+};
+
+// Layout of a read with the enabled and running times
+struct Reading
+{
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+};
+
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        fds[i] = -1;
+        values[i] = 0.0;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (fds[i] >= 0)
+        {
+            close(fds[i]);
+        }
+    }
+}
+
+// Opens every event for the calling thread. Returns whether any of them
+// could be opened, error() tells why the first unavailable one was not.
+bool PerfCounters::open()
+{
+    bool any = false;
+    message.clear();
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (fds[i] >= 0)
+        {
+            any = true;
+            continue;
+        }
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = configs[i].type;
+        attr.config = configs[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fds[i] >= 0)
+        {
+            any = true;
+        }
+        else if (message.empty())
+        {
+            message = std::string(configs[i].name) + ": " + strerror(errno);
+        }
+    }
+    return any;
+}
+
+bool PerfCounters::available(const PerfEvent event) const
+{
+    return fds[event] >= 0;
+}
+
+const std::string &PerfCounters::error() const
+{
+    return message;
+}
+
+void PerfCounters::start()
+{
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (fds[i] >= 0)
+        {
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop()
+{
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (fds[i] >= 0)
+        {
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        Reading r;
+        values[i] = 0.0;
+        if ((fds[i] >= 0) && (sizeof(r) == read(fds[i], &r, sizeof(r))) && (r.running > 0))
+        {
+            values[i] = static_cast<double>(r.value) * (static_cast<double>(r.enabled) / r.running);
+        }
+    }
+}
+
+// Count of an event over the last start() and stop()
+double PerfCounters::value(const PerfEvent event) const
+{
+    return values[event];
+}
+
+const char *PerfCounters::name(const PerfEvent event)
+{
+    return configs[event].name;
+}
@@ -0,0 +1,49 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief Hardware events counted by PerfCounters.
+ */
+enum PerfEvent
+{
+    PERF_INSTRUCTIONS,  /**< Instructions retired */
+    PERF_CYCLES,        /**< CPU cycles */
+    PERF_L1D_MISSES,    /**< Level 1 data cache read misses */
+    PERF_BRANCH_MISSES, /**< Mispredicted branches */
+    PERF_EVENT_COUNT    /**< Number of events */
+};
+
+/**
+ * @brief   Hardware performance counters.
+ * @details Counts user space events of the calling thread between start()
+ *          and stop() using the Linux perf_event_open interface. Each event
+ *          is opened on its own, so an event the CPU or the kernel settings
+ *          do not allow is simply unavailable while the others still work.
+ *          Counts are scaled up when the kernel had to multiplex counters.
+ */
+class PerfCounters
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+    bool open();
+    bool available(const PerfEvent event) const;
+    const std::string &error() const;
+    void start();
+    void stop();
+    double value(const PerfEvent event) const;
+    static const char *name(const PerfEvent event);
+
+private:
+    PerfCounters(const PerfCounters &);
+    PerfCounters &operator=(const PerfCounters &);
+
+    int fds[PERF_EVENT_COUNT];
+    double values[PERF_EVENT_COUNT];
+    std::string message;
+};
+
+#endif // PERF_COUNTERS_H
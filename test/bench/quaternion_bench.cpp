@@ -0,0 +1,161 @@
+#include <math.h>
+#include <vector>
+#include "benchmark.h"
+#include "quaternion.h"
+#include "suites.h"
+
+namespace
+{
+
+// Number of independent operands used by the throughput benchmarks
+const size_t operands = 1024;
+
+// Deterministic versors spread over the sphere
+std::vector<Quaternion> versors(const size_t count, const float seed)
+{
+    std::vector<Quaternion> q(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        q[i] = Quaternion(sinf(seed + 0.37f * i), cosf(seed + 1.91f * i),
+                          sinf(seed + 2.63f * i + 1.0f), cosf(seed + 0.71f * i + 2.0f)).normalized();
+    }
+    return q;
+}
+
+} // namespace
+
+// Every operation is timed twice. The throughput benchmark applies it to
+// independent operands so calls can overlap in the pipeline, while the chain
+// benchmark feeds each result into the next call and so measures latency.
+void quaternionSuite(Benchmark &bench)
+{
+    bench.setSuite("quaternion");
+    const std::vector<Quaternion> a = versors(operands, 0.0f);
+    const std::vector<Quaternion> b = versors(operands, 0.5f);
+    std::vector<Quaternion> out(operands);
+    std::vector<float> scalars(operands * 4);
+
+    bench.run("multiply/throughput", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            out[k] = a[k] * b[k];
+        }
+        doNotOptimize(out[0]);
+    });
+    bench.run("multiply/chain", [&](size_t n)
+    {
+        Quaternion q = a[0];
+        const Quaternion r = b[0];
+        for (size_t i = 0; i < n; ++i)
+        {
+            q = q * r;
+        }
+        doNotOptimize(q);
+    });
+
+    bench.run("normalize/throughput", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            out[k] = a[k] * 2.0f;
+            out[k].normalize();
+        }
+        doNotOptimize(out[0]);
+    });
+    bench.run("normalize/chain", [&](size_t n)
+    {
+        Quaternion q = a[0];
+        for (size_t i = 0; i < n; ++i)
+        {
+            q = (q * 2.0f).normalized();
+        }
+        doNotOptimize(q);
+    });
+
+    bench.run("inverse/throughput", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            out[k] = a[k].inverse();
+        }
+        doNotOptimize(out[0]);
+    });
+    bench.run("inverse/chain", [&](size_t n)
+    {
+        Quaternion q = a[0];
+        for (size_t i = 0; i < n; ++i)
+        {
+            q = q.inverse();
+        }
+        doNotOptimize(q);
+    });
+
+    bench.run("convertToEulerAngles/throughput", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            a[k].convertToEulerAngles(scalars[3 * k], scalars[(3 * k) + 1], scalars[(3 * k) + 2]);
+        }
+        doNotOptimize(scalars[0]);
+    });
+    bench.run("convertToEulerAngles/chain", [&](size_t n)
+    {
+        // The difference of a result with itself is zero but not known to
+        // be zero at compile time, which makes the next call depend on it
+        Quaternion q = a[0];
+        float roll, pitch, yaw;
+        for (size_t i = 0; i < n; ++i)
+        {
+            q.convertToEulerAngles(roll, pitch, yaw);
+            q.x += roll - roll;
+        }
+        doNotOptimize(q);
+    });
+
+    bench.run("convertToAxisAngle/throughput", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            a[k].convertToAxisAngle(scalars[4 * k], scalars[(4 * k) + 1],
+                                    scalars[(4 * k) + 2], scalars[(4 * k) + 3]);
+        }
+        doNotOptimize(scalars[0]);
+    });
+    bench.run("convertToAxisAngle/chain", [&](size_t n)
+    {
+        Quaternion q = a[0];
+        float x, y, z, angle;
+        for (size_t i = 0; i < n; ++i)
+        {
+            q.convertToAxisAngle(x, y, z, angle);
+            q.w += angle - angle;
+        }
+        doNotOptimize(q);
+    });
+
+    bench.run("dot/throughput", [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t k = i % operands;
+            scalars[k] = a[k].dot(b[k]);
+        }
+        doNotOptimize(scalars[0]);
+    });
+    bench.run("dot/chain", [&](size_t n)
+    {
+        Quaternion q = a[0];
+        const Quaternion r = b[0];
+        for (size_t i = 0; i < n; ++i)
+        {
+            q.w = q.dot(r);
+        }
+        doNotOptimize(q);
+    });
+}
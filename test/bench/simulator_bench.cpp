@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string>
+#include "benchmark.h"
+#include "suites.h"
+#include "../sim/simulator.h"
+
+namespace
+{
+
+// Samples generated per device by each call
+const size_t batch_count = 1024;
+
+// A scenario touching every kind of motion
+void scenario(Simulator &simulator)
+{
+    MotionSegment segment;
+    segment.type = MOTION_TUMBLE;
+    segment.duration = 5.0f;
+    simulator.addSegment(segment);
+
+    segment = MotionSegment();
+    segment.type = MOTION_VIBRATION;
+    segment.duration = 2.0f;
+    segment.amplitude = 0.01f;
+    segment.frequency = 40.0f;
+    segment.shake = 0.3f;
+    simulator.addSegment(segment);
+
+    segment = MotionSegment();
+    segment.type = MOTION_FREE_FALL;
+    segment.duration = 0.5f;
+    segment.rate[0] = 1.0f;
+    simulator.addSegment(segment);
+
+    segment = MotionSegment();
+    segment.type = MOTION_ROTATION;
+    segment.duration = 2.0f;
+    segment.rate[2] = 2.0f;
+    segment.magnetic[0] = 0.3f;
+    simulator.addSegment(segment);
+}
+
+void generation(Benchmark &bench, const size_t devices, const int substeps)
+{
+    char label[64];
+    snprintf(label, sizeof(label), "generate/devices:%zu/substeps:%d", devices, substeps);
+    if (!bench.enabled(label))
+    {
+        return;
+    }
+
+    SensorModel model;
+    model.gyroBias = 0.01f;
+    model.gyroBiasWalk = 0.001f;
+    model.jitter = 0.0001f;
+    model.mounting = true;
+    Simulator simulator;
+    simulator.setSampleRate(1000.0f);
+    simulator.setSubsteps(substeps);
+    simulator.setSensor(model);
+    scenario(simulator);
+    simulator.reset(devices, 7);
+
+    SimBatch batch;
+    bench.run(label, [&](size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            simulator.generate(batch, batch_count);
+        }
+        doNotOptimize(batch.samples.back());
+    });
+
+    // Report the rate of samples and of the data behind them
+    const double samples = (batch_count * devices * 1.0e9) / bench.results().back().nsPerOp;
+    bench.addMetric("samples_per_second", samples);
+    bench.addMetric("mb_per_second", samples * 9 * sizeof(float) * 1.0e-6);
+}
+
+} // namespace
+
+// Speed of the simulator which produces data for the other suites
+void simulatorSuite(Benchmark &bench)
+{
+    bench.setSuite("simulator");
+    generation(bench, 1, 1);
+    generation(bench, 1, 4);
+    generation(bench, 8, 1);
+    generation(bench, 8, 4);
+}
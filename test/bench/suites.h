@@ -0,0 +1,43 @@
+#ifndef SUITES_H
+#define SUITES_H
+
+#include "benchmark.h"
+
+void quaternionSuite(Benchmark &bench);
+void filterSuite(Benchmark &bench);
+void accuracySuite(Benchmark &bench);
+void simulatorSuite(Benchmark &bench);
+void countersSuite(Benchmark &bench);
+void convergenceSuite(Benchmark &bench);
+
+// Time constant in seconds the Gauss-Newton filter is run with where the
+// Madgwick filters are given a gyroscope error gain, so both sweep from slow
+// to fast correction over the same gains
+inline float gaussNewtonTimeConstant(const float gain)
+{
+    return 0.1f / gain;
+}
+
+// Proportional and integral gains the DCM and Mahony filters are run with for
+// a gyroscope error gain. The integral gain keeps the controller damped at
+// every gain.
+inline float proportionalGain(const float gain)
+{
+    return 10.0f * gain;
+}
+
+inline float integralGain(const float gain)
+{
+    return 10.0f * gain * gain;
+}
+
+// Gyroscope noise the Kalman filter is run with for a gyroscope error gain.
+// Its steady state correction rate is about the gyroscope noise over the
+// reference noise, so with the default reference noise of 0.05 rad this
+// matches the proportional gain above.
+inline float kalmanGyroNoise(const float gain)
+{
+    return 0.05f * proportionalGain(gain);
+}
+
+#endif // SUITES_H
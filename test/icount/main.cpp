@@ -0,0 +1,450 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "dcm_filter.h"
+#include "delta_integrator.h"
+#include "gauss_newton_filter.h"
+#include "imu_filter.h"
+#include "kalman_filter.h"
+#include "magnetometer_calibrator.h"
+#include "mahony_imu_filter.h"
+#include "mahony_marg_filter.h"
+#include "marg_filter.h"
+#include "quaternion.h"
+#include "tracer.h"
+
+namespace
+{
+
+// Number of distinct operands cycled through
+const size_t operands = 64;
+
+Quaternion a[operands];
+Quaternion b[operands];
+Quaternion out[operands];
+volatile float sink;
+
+void prepare()
+{
+    for (size_t i = 0; i < operands; ++i)
+    {
+        a[i] = Quaternion(sinf(0.37f * i), cosf(1.91f * i),
+                          sinf(2.63f * i + 1.0f), cosf(0.71f * i + 2.0f)).normalized();
+        b[i] = Quaternion(sinf(0.5f + 0.37f * i), cosf(0.5f + 1.91f * i),
+                          sinf(0.5f + 2.63f * i + 1.0f), cosf(0.5f + 0.71f * i + 2.0f)).normalized();
+    }
+}
+
+void multiply(size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i % operands] = a[i % operands] * b[i % operands];
+    }
+}
+
+void normalize(size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i % operands] = (a[i % operands] + b[i % operands]).normalized();
+    }
+}
+
+void inverse(size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i % operands] = a[i % operands].inverse();
+    }
+}
+
+void rotate(size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &v = b[i % operands];
+        out[i % operands] = a[i % operands].conjugate() * Quaternion(0.0f, v.x, v.y, v.z) * a[i % operands];
+    }
+}
+
+void euler(size_t n)
+{
+    float roll, pitch, yaw;
+    for (size_t i = 0; i < n; ++i)
+    {
+        a[i % operands].convertToEulerAngles(roll, pitch, yaw);
+        sink = roll + pitch + yaw;
+    }
+}
+
+void rotationVector(size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &v = b[i % operands];
+        out[i % operands] = Quaternion::fromRotationVector(0.01f * v.x, 0.01f * v.y, 0.01f * v.z);
+    }
+}
+
+void deltaAdd(size_t n)
+{
+    DeltaIntegrator delta;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        delta.add(0.001f * g.x, 0.001f * g.y, 0.001f * g.z, 0.001f * s.x, 0.001f * s.y, 0.01f);
+    }
+    float x, y, z;
+    delta.rotation(x, y, z);
+    sink = x;
+}
+
+// Readings of a magnetometer with a hard iron offset, turned through the
+// operands as directions
+void magneticReading(size_t i, float m[3])
+{
+    const Quaternion d = a[i % operands].normalized();
+    m[0] = 400.0f * d.x + 120.0f;
+    m[1] = 360.0f * d.y - 60.0f;
+    m[2] = 420.0f * d.z + 40.0f;
+}
+
+// Readings only, and fits only, as a calibrator set to fit on demand
+void magCalibratorAdd(size_t n)
+{
+    MagnetometerCalibrator calibrator;
+    calibrator.setFitInterval(0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        float m[3];
+        magneticReading(i, m);
+        calibrator.add(m[0], m[1], m[2]);
+    }
+    sink = calibrator.fieldStrength();
+}
+
+void magCalibratorFit(size_t n)
+{
+    MagnetometerCalibrator calibrator;
+    calibrator.setFitInterval(0);
+    for (size_t i = 0; i < operands; ++i)
+    {
+        float m[3];
+        magneticReading(i, m);
+        calibrator.add(m[0], m[1], m[2]);
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        calibrator.fit();
+    }
+    sink = calibrator.fieldStrength();
+}
+
+// Filters start from the same state on every run so that runs of n and 2n
+// updates differ only in the number of updates
+void imuUpdate(size_t n)
+{
+    IMUFilter filter;
+    filter.setGyroErrorGain(0.015074f);
+    filter.setSampleRate(0.005f);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        filter.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f);
+    }
+    sink = filter.orientation().w;
+}
+
+// The MARG filter with a given gyroscope integrator
+void margUpdateWith(size_t n, const Filter::Integrator integrator)
+{
+    MARGFilter filter;
+    filter.setGyroErrorGain(0.015074f);
+    filter.setGyroDriftGain(0.000264f);
+    filter.setSampleRate(0.005f);
+    filter.setIntegrator(integrator);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        filter.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                      0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+    }
+    sink = filter.orientation().w;
+}
+
+void margUpdate(size_t n)
+{
+    margUpdateWith(n, Filter::INTEGRATOR_EULER);
+}
+
+void margRk4Update(size_t n)
+{
+    margUpdateWith(n, Filter::INTEGRATOR_RK4);
+}
+
+void margExponentialUpdate(size_t n)
+{
+    margUpdateWith(n, Filter::INTEGRATOR_EXPONENTIAL);
+}
+
+void gaussNewtonUpdate(size_t n)
+{
+    GaussNewtonFilter filter;
+    filter.setSampleRate(0.005f);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        filter.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                      0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+    }
+    sink = filter.orientation().w;
+}
+
+void dcmImuUpdate(size_t n)
+{
+    DCMFilter filter;
+    filter.setSampleRate(0.005f);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        filter.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f);
+    }
+    sink = filter.orientation().w;
+}
+
+void dcmMargUpdate(size_t n)
+{
+    DCMFilter filter;
+    filter.setSampleRate(0.005f);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        filter.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                      0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+    }
+    sink = filter.orientation().w;
+}
+
+void mahonyImuUpdate(size_t n)
+{
+    MahonyIMUFilter filter;
+    filter.setSampleRate(0.005f);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        filter.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f);
+    }
+    sink = filter.orientation().w;
+}
+
+void mahonyMargUpdate(size_t n)
+{
+    MahonyMARGFilter filter;
+    filter.setSampleRate(0.005f);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        filter.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                      0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+    }
+    sink = filter.orientation().w;
+}
+
+void kalmanUpdate(size_t n)
+{
+    KalmanFilter filter;
+    filter.setSampleRate(0.005f);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Quaternion &g = a[i % operands];
+        const Quaternion &s = b[i % operands];
+        filter.update(0.2f * g.x, 0.2f * g.y, 0.2f * g.z, 0.1f * s.x, 0.1f * s.y, 1.0f,
+                      0.5f + 0.1f * s.z, 0.1f * g.w, -0.8f);
+    }
+    sink = filter.orientation().w;
+}
+
+const Workload all_workloads[] =
+{
+    { "quaternion/multiply",        multiply },
+    { "quaternion/normalize",       normalize },
+    { "quaternion/inverse",         inverse },
+    { "quaternion/rotate",          rotate },
+    { "quaternion/euler",           euler },
+    { "quaternion/rotation_vector", rotationVector },
+    { "delta/add",                  deltaAdd },
+    { "mag-calibrator/add",         magCalibratorAdd },
+    { "mag-calibrator/fit",         magCalibratorFit },
+    { "imu/update",                 imuUpdate },
+    { "marg/update",                margUpdate },
+    { "marg-rk4/update",            margRk4Update },
+    { "marg-exp/update",            margExponentialUpdate },
+    { "gauss-newton/update",        gaussNewtonUpdate },
+    { "dcm-imu/update",             dcmImuUpdate },
+    { "dcm-marg/update",            dcmMargUpdate },
+    { "mahony-imu/update",          mahonyImuUpdate },
+    { "mahony-marg/update",         mahonyMargUpdate },
+    { "kalman/update",              kalmanUpdate }
+};
+
+void usage(FILE *out)
+{
+    fputs("Usage: fusion-icount [OPTION]...\n"
+          "Counts the exact instructions per operation of the Fusion hot paths by\n"
+          "single-stepping them with ptrace.\n"
+          "\n"
+          "  -n, --operations=N      operations per counted run (default 100)\n"
+          "  -f, --filter=TEXT       count only workloads whose name contains TEXT\n"
+          "  -b, --baseline=FILE     compare with counts saved by --save and fail if\n"
+          "                          any grew by more than the tolerance\n"
+          "  -p, --tolerance=PERCENT growth allowed by --baseline (default 0)\n"
+          "  -s, --save=FILE         save the counts as a baseline\n"
+          "  -h, --help              show this help\n", out);
+}
+
+bool loadBaseline(const char *path, std::vector<InstructionCount> &counts)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+    char name[128];
+    double value;
+    while (2 == fscanf(file, "%127s %lf", name, &value))
+    {
+        InstructionCount count;
+        count.name = name;
+        count.perOp = value;
+        counts.push_back(count);
+    }
+    fclose(file);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    static const struct option long_options[] =
+    {
+        { "operations", required_argument, 0, 'n' },
+        { "filter",     required_argument, 0, 'f' },
+        { "baseline",   required_argument, 0, 'b' },
+        { "tolerance",  required_argument, 0, 'p' },
+        { "save",       required_argument, 0, 's' },
+        { "help",       no_argument,       0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    size_t n = 100;
+    const char *filter = "";
+    const char *baseline = 0;
+    const char *save = 0;
+    double tolerance = 0.0;
+    int c;
+    while (-1 != (c = getopt_long(argc, argv, "n:f:b:p:s:h", long_options, 0)))
+    {
+        switch (c)
+        {
+        case 'n':
+            n = strtoul(optarg, 0, 10);
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        case 'p':
+            tolerance = strtod(optarg, 0);
+            break;
+        case 's':
+            save = optarg;
+            break;
+        case 'h':
+            usage(stdout);
+            return 0;
+        default:
+            usage(stderr);
+            return 2;
+        }
+    }
+    if (0 == n)
+    {
+        usage(stderr);
+        return 2;
+    }
+
+    std::vector<Workload> workloads;
+    for (size_t i = 0; i < sizeof(all_workloads) / sizeof(all_workloads[0]); ++i)
+    {
+        if (strstr(all_workloads[i].name, filter))
+        {
+            workloads.push_back(all_workloads[i]);
+        }
+    }
+
+    std::vector<InstructionCount> reference;
+    if (baseline && !loadBaseline(baseline, reference))
+    {
+        fprintf(stderr, "fusion-icount: cannot read baseline '%s'\n", baseline);
+        return 2;
+    }
+
+    prepare();
+    std::vector<InstructionCount> counts;
+    std::string error;
+    if (!countInstructions(workloads, n, counts, error))
+    {
+        fprintf(stderr, "fusion-icount: %s\n", error.c_str());
+        return 1;
+    }
+
+    int status = 0;
+    printf("%-32s %14s%s\n", "workload", "instructions", baseline ? "   baseline   change %" : "");
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        printf("%-32s %14.2f", counts[i].name.c_str(), counts[i].perOp);
+        for (size_t r = 0; baseline && (r < reference.size()); ++r)
+        {
+            if (reference[r].name == counts[i].name)
+            {
+                const double change = 100.0 * ((counts[i].perOp / reference[r].perOp) - 1.0);
+                const bool regressed = change > tolerance;
+                status = regressed ? 1 : status;
+                printf(" %10.2f %+10.2f%s", reference[r].perOp, change, regressed ? "  REGRESSION" : "");
+            }
+        }
+        putchar('\n');
+    }
+
+    if (save)
+    {
+        FILE *file = fopen(save, "w");
+        if (!file)
+        {
+            fprintf(stderr, "fusion-icount: cannot write '%s'\n", save);
+            return 2;
+        }
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            fprintf(file, "%s %.2f\n", counts[i].name.c_str(), counts[i].perOp);
+        }
+        fclose(file);
+    }
+    return status;
+}
@@ -0,0 +1,117 @@
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "tracer.h"
+
+namespace
+{
+
+// Runs in the traced child. Every measured run is bracketed by two stops so
+// the parent knows when to single-step.
+void traced(const std::vector<Workload> &workloads, const size_t n)
+{
+    ptrace(PTRACE_TRACEME, 0, 0, 0);
+    raise(SIGSTOP);
+    for (size_t w = 0; w < workloads.size(); ++w)
+    {
+        // Resolve lazily bound symbols and fault in memory before counting
+        workloads[w].run(1);
+        for (size_t k = 1; k <= 2; ++k)
+        {
+            raise(SIGSTOP);
+            workloads[w].run(k * n);
+            raise(SIGSTOP);
+        }
+    }
+    _exit(0);
+}
+
+bool waitStop(const pid_t child, int &signal)
+{
+    int status;
+    if ((waitpid(child, &status, 0) < 0) || !WIFSTOPPED(status))
+    {
+        return false;
+    }
+    signal = WSTOPSIG(status);
+    return true;
+}
+
+// Resumes the child until its next marker stop
+bool resume(const pid_t child)
+{
+    int signal;
+    return (0 == ptrace(PTRACE_CONT, child, 0, 0)) && waitStop(child, signal)
+           && (SIGSTOP == signal);
+}
+
+// Single-steps the child until its next marker stop, counting instructions
+bool step(const pid_t child, uint64_t &count)
+{
+    count = 0;
+    for (;;)
+    {
+        int signal;
+        if ((0 != ptrace(PTRACE_SINGLESTEP, child, 0, 0)) || !waitStop(child, signal))
+        {
+            return false;
+        }
+        if (SIGSTOP == signal)
+        {
+            return true;
+        }
+        ++count;
+    }
+}
+
+} // namespace
+
+// Counts the user space instructions of each workload by single-stepping a
+// child process with ptrace. Each workload is run n and 2n times and the
+// difference divided by n, which cancels the fixed cost of the markers and
+// makes the result exact and independent of machine load.
+bool countInstructions(const std::vector<Workload> &workloads, const size_t n,
+                       std::vector<InstructionCount> &counts, std::string &error)
+{
+    const pid_t child = fork();
+    if (child < 0)
+    {
+        error = std::string("fork: ") + strerror(errno);
+        return false;
+    }
+    if (0 == child)
+    {
+        traced(workloads, n);
+    }
+
+    int signal;
+    bool ok = waitStop(child, signal);
+    for (size_t w = 0; ok && (w < workloads.size()); ++w)
+    {
+        uint64_t single, twice;
+        ok = resume(child) && step(child, single) && resume(child) && step(child, twice);
+        if (ok)
+        {
+            InstructionCount count;
+            count.name = workloads[w].name;
+            count.perOp = (static_cast<double>(twice) - static_cast<double>(single)) / n;
+            counts.push_back(count);
+        }
+    }
+    if (!ok)
+    {
+        error = std::string("tracing failed: ") + strerror(errno);
+        kill(child, SIGKILL);
+    }
+    else
+    {
+        ptrace(PTRACE_CONT, child, 0, 0);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    return ok;
+}
@@ -0,0 +1,27 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Something whose instructions can be counted. run performs the operation n
+// times.
+struct Workload
+{
+    const char *name;
+    void (*run)(size_t n);
+};
+
+// Exact instructions per operation of one workload
+struct InstructionCount
+{
+    std::string name;
+    double perOp;
+};
+
+bool countInstructions(const std::vector<Workload> &workloads, const size_t n,
+                       std::vector<InstructionCount> &counts, std::string &error);
+
+#endif // TRACER_H
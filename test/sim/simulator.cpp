@@ -0,0 +1,284 @@
+#include <math.h>
+#include "simulator.h"
+
+// Field pointing north and down at a dip angle of about 58 degrees
+const Quaternion earth_field = Quaternion(0.0f, 0.53f, 0.0f, -0.848f).normalized();
+
+namespace
+{
+
+const MotionSegment resting;
+
+uint64_t splitmix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Approximately normal value from the sum of four uniform values. It is much
+// cheaper than an exact method and its tails are cut at 3.5 deviations, which
+// does not matter for exercising filters.
+inline float gaussian(uint64_t &state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    const uint64_t r = state * 0x2545f4914f6cdd1dull;
+    const uint32_t sum = static_cast<uint32_t>(r & 0xffff) + static_cast<uint32_t>((r >> 16) & 0xffff)
+                         + static_cast<uint32_t>((r >> 32) & 0xffff) + static_cast<uint32_t>(r >> 48);
+    return (static_cast<float>(sum) - 131070.0f) * (1.7320508f / 65536.0f);
+}
+
+// Rotates a vector from the body frame of q into the frame q is relative to
+inline void rotate(const Quaternion &q, const double v[3], float out[3])
+{
+    const Quaternion r = q * Quaternion(0.0f, v[0], v[1], v[2]) * q.conjugate();
+    out[0] = r.x;
+    out[1] = r.y;
+    out[2] = r.z;
+}
+
+} // namespace
+
+MotionSegment::MotionSegment() :
+    type(MOTION_STATIC),
+    duration(1.0f),
+    amplitude(1.0f),
+    frequency(0.0f),
+    shake(0.0f)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        rate[i] = 0.0f;
+        magnetic[i] = 0.0f;
+    }
+}
+
+SensorModel::SensorModel() :
+    gyroNoise(0.01f),
+    accelNoise(0.01f),
+    magNoise(0.01f),
+    gyroBias(0.0f),
+    gyroBiasWalk(0.0f),
+    jitter(0.0f),
+    mounting(false)
+{
+}
+
+SimBatch::SimBatch() :
+    devices(0),
+    count(0)
+{
+}
+
+const float *SimBatch::sample(const size_t i, const size_t device) const
+{
+    return &samples[((i * devices) + device) * 9];
+}
+
+Simulator::Simulator() :
+    rate(100.0f),
+    substeps(4),
+    initial(Quaternion(0.9f, 0.1f, -0.3f, 0.2f).normalized())
+{
+    reset(1, 1);
+}
+
+void Simulator::setSampleRate(const float rate)
+{
+    this->rate = rate;
+}
+
+// Number of steps used to integrate the true orientation between samples
+void Simulator::setSubsteps(const int substeps)
+{
+    this->substeps = (substeps < 1) ? 1 : substeps;
+}
+
+void Simulator::setSensor(const SensorModel &model)
+{
+    this->model = model;
+}
+
+// Orientation of the body at time zero, used from the next reset
+void Simulator::setInitialOrientation(const Quaternion &q)
+{
+    initial = q.normalized();
+}
+
+void Simulator::addSegment(const MotionSegment &segment)
+{
+    segments.push_back(segment);
+}
+
+void Simulator::clearSegments()
+{
+    segments.clear();
+}
+
+float Simulator::duration() const
+{
+    float total = 0.0f;
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        total += segments[i].duration;
+    }
+    return total;
+}
+
+// Starts every device again at time zero. Each device draws its own noise,
+// bias and mounting from the seed, so equal seeds give equal streams.
+void Simulator::reset(const size_t devices, const uint32_t seed)
+{
+    state.resize(devices);
+    for (size_t d = 0; d < devices; ++d)
+    {
+        Device &device = state[d];
+        device.random = splitmix((static_cast<uint64_t>(seed) << 32) + d);
+        device.body = initial;
+        device.mount = Quaternion();
+        if (model.mounting)
+        {
+            const float w = gaussian(device.random);
+            const float x = gaussian(device.random);
+            const float y = gaussian(device.random);
+            const float z = gaussian(device.random);
+            device.mount = Quaternion(w, x, y, z).normalized();
+        }
+        device.time = 0.0;
+        device.nominal = 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            device.bias[i] = model.gyroBias * gaussian(device.random);
+        }
+    }
+}
+
+// Generates the next count samples of every device into the batch
+size_t Simulator::generate(SimBatch &batch, const size_t count)
+{
+    const size_t devices = state.size();
+    batch.devices = devices;
+    batch.count = count;
+    batch.time.resize(count * devices);
+    batch.samples.resize(count * devices * 9);
+    batch.truth.resize(count * devices);
+
+    const double period = 1.0 / rate;
+    for (size_t d = 0; d < devices; ++d)
+    {
+        Device &device = state[d];
+        const Quaternion mount_conjugate = device.mount.conjugate();
+        for (size_t i = 0; i < count; ++i)
+        {
+            device.nominal += period;
+            double target = device.nominal + (model.jitter * gaussian(device.random));
+            target = (target > device.time + (0.1 * period)) ? target : (device.time + (0.1 * period));
+
+            double w[3], f[3], b[3];
+            const double h = (target - device.time) / substeps;
+            for (int k = 0; k < substeps; ++k)
+            {
+                motion(device.time + ((k + 0.5) * h), w, f, b);
+                device.body *= Quaternion::fromRotationVector(w[0] * h, w[1] * h, w[2] * h);
+            }
+            device.body.normalize();
+            device.time = target;
+
+            const double dt_sqrt = sqrt(h * substeps);
+            for (int k = 0; k < 3; ++k)
+            {
+                device.bias[k] += model.gyroBiasWalk * dt_sqrt * gaussian(device.random);
+            }
+
+            // The sensor frame is the body frame turned by the mounting
+            motion(target, w, f, b);
+            const Quaternion truth = device.body * device.mount;
+            const Quaternion truth_conjugate = truth.conjugate();
+            const size_t index = (i * devices) + d;
+            float *s = &batch.samples[index * 9];
+            rotate(mount_conjugate, w, s);
+            rotate(truth_conjugate, f, s + 3);
+            rotate(truth_conjugate, b, s + 6);
+            for (int k = 0; k < 3; ++k)
+            {
+                s[k] += device.bias[k] + (model.gyroNoise * gaussian(device.random));
+                s[k + 3] += model.accelNoise * gaussian(device.random);
+                s[k + 6] += model.magNoise * gaussian(device.random);
+            }
+            batch.time[index] = target;
+            batch.truth[index] = truth;
+        }
+    }
+    return count;
+}
+
+// Finds the segment active at time t and turns t into the time within it
+const MotionSegment &Simulator::segmentAt(double &t) const
+{
+    const double total = duration();
+    if (segments.empty() || (total <= 0.0))
+    {
+        return resting;
+    }
+    t = fmod(t, total);
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        if (t < segments[i].duration)
+        {
+            return segments[i];
+        }
+        t -= segments[i].duration;
+    }
+    return segments.back();
+}
+
+// Body rate, specific force in the earth frame and magnetic field in the
+// earth frame at time t
+void Simulator::motion(const double time, double w[3], double f[3], double b[3]) const
+{
+    double t = time;
+    const MotionSegment &segment = segmentAt(t);
+    w[0] = w[1] = w[2] = 0.0;
+    f[0] = f[1] = 0.0;
+    f[2] = 1.0;
+    b[0] = earth_field.x + segment.magnetic[0];
+    b[1] = earth_field.y + segment.magnetic[1];
+    b[2] = earth_field.z + segment.magnetic[2];
+
+    switch (segment.type)
+    {
+    case MOTION_STATIC:
+        break;
+    case MOTION_ROTATION:
+        w[0] = segment.rate[0];
+        w[1] = segment.rate[1];
+        w[2] = segment.rate[2];
+        break;
+    case MOTION_TUMBLE:
+        w[0] = segment.amplitude * ((0.9 * sin(0.61 * t)) + (0.3 * sin((2.3 * t) + 1.0)));
+        w[1] = segment.amplitude * ((0.7 * sin((0.43 * t) + 2.0)) + (0.2 * sin(3.1 * t)));
+        w[2] = segment.amplitude * ((0.5 * sin((0.29 * t) + 4.0)) + (0.4 * cos(1.7 * t)));
+        break;
+    case MOTION_VIBRATION:
+    {
+        const double omega = 2.0 * M_PI * segment.frequency;
+        const double peak = segment.amplitude * omega;
+        w[0] = peak * cos(omega * t);
+        w[1] = peak * cos((omega * t) + 2.1);
+        w[2] = peak * cos((omega * t) + 4.2);
+        f[0] = segment.shake * sin(omega * t);
+        f[1] = segment.shake * sin((omega * t) + 1.3);
+        f[2] += segment.shake * sin((omega * t) + 2.6);
+        break;
+    }
+    case MOTION_FREE_FALL:
+        w[0] = segment.rate[0];
+        w[1] = segment.rate[1];
+        w[2] = segment.rate[2];
+        f[2] = 0.0;
+        break;
+    }
+}
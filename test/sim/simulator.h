@@ -0,0 +1,109 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "quaternion.h"
+
+// Direction of the magnetic field in the earth frame, normalized
+extern const Quaternion earth_field;
+
+// Kinds of motion a segment of a scenario can describe
+enum MotionType
+{
+    MOTION_STATIC,    // Resting in the initial attitude
+    MOTION_ROTATION,  // Spinning at a constant body rate
+    MOTION_TUMBLE,    // Smooth random looking rotation about every axis
+    MOTION_VIBRATION, // Small fast angular and linear oscillation
+    MOTION_FREE_FALL  // Constant body rate with no specific force
+};
+
+// One piece of a scenario. Angular values are in rad/s, accelerations in g
+// and fields in the units of the earth field, which has a norm of one.
+struct MotionSegment
+{
+    MotionSegment();
+
+    MotionType type;
+    float duration;     // Length of the segment in seconds
+    float rate[3];      // Body rate of rotations and free fall
+    float amplitude;    // Scale of a tumble, or the angle of a vibration
+    float frequency;    // Frequency of a vibration in Hz
+    float shake;        // Linear acceleration amplitude of a vibration
+    float magnetic[3];  // Disturbance added to the earth field
+};
+
+// Errors of one device. Noise values are standard deviations, the walks are
+// the standard deviation of the change per square root of a second.
+struct SensorModel
+{
+    SensorModel();
+
+    float gyroNoise;
+    float accelNoise;
+    float magNoise;
+    float gyroBias;      // Spread of the initial gyroscope bias
+    float gyroBiasWalk;  // Random walk of the gyroscope bias
+    float jitter;        // Spread of the sample time in seconds
+    bool mounting;       // Whether each device is mounted at a random angle
+};
+
+// Samples of every device. Sample i of device d is at index i * devices + d,
+// and each sample holds the gyroscope, accelerometer and magnetometer axes.
+struct SimBatch
+{
+    SimBatch();
+    const float *sample(const size_t i, const size_t device) const;
+
+    size_t devices;
+    size_t count;
+    std::vector<double> time;      // Time of each sample in seconds
+    std::vector<float> samples;    // Nine values per sample
+    std::vector<Quaternion> truth; // True orientation of each device
+};
+
+/**
+ * @brief   Sensor simulator.
+ * @details Generates the readings of several devices attached to a rigid body
+ *          which follows a scenario made of motion segments. The scenario
+ *          repeats when it runs out, so streams may be made as long as
+ *          needed by calling generate repeatedly.
+ */
+class Simulator
+{
+public:
+    Simulator();
+    void setSampleRate(const float rate);
+    void setSubsteps(const int substeps);
+    void setSensor(const SensorModel &model);
+    void setInitialOrientation(const Quaternion &q);
+    void addSegment(const MotionSegment &segment);
+    void clearSegments();
+    float duration() const;
+    void reset(const size_t devices, const uint32_t seed);
+    size_t generate(SimBatch &batch, const size_t count);
+
+private:
+    struct Device
+    {
+        Quaternion body;   // Orientation of the body at the last sample
+        Quaternion mount;  // Orientation of the device on the body
+        double time;       // Time of the last sample
+        double nominal;    // Time the last sample was due
+        float bias[3];
+        uint64_t random;
+    };
+
+    const MotionSegment &segmentAt(double &t) const;
+    void motion(const double t, double w[3], double f[3], double b[3]) const;
+
+    float rate;
+    int substeps;
+    Quaternion initial;
+    SensorModel model;
+    std::vector<MotionSegment> segments;
+    std::vector<Device> state;
+};
+
+#endif // SIMULATOR_H
@@ -0,0 +1,95 @@
+#include <math.h>
+#include "trajectory.h"
+
+namespace
+{
+
+const Quaternion earth_gravity(0.0f, 0.0f, 0.0f, 1.0f);
+
+// Rotates an earth frame vector into the sensor frame
+Quaternion toSensor(const Quaternion &q, const Quaternion &v)
+{
+    return q.conjugate() * v * q;
+}
+
+} // namespace
+
+SensorNoise::SensorNoise() :
+    gyro(0.01f),
+    accel(0.01f),
+    mag(0.01f)
+{
+    gyroBias[0] = 0.0f;
+    gyroBias[1] = 0.0f;
+    gyroBias[2] = 0.0f;
+}
+
+// Generates a smooth tumbling motion which explores every attitude. The true
+// orientation is integrated with small exact steps, so it is far more
+// accurate than any filter fed with the sampled rates.
+void simulateTumble(const size_t count, const float dt, const SensorNoise &noise,
+                    const uint32_t seed, std::vector<SimSample> &out)
+{
+    SensorModel model;
+    model.gyroNoise = noise.gyro;
+    model.accelNoise = noise.accel;
+    model.magNoise = noise.mag;
+    MotionSegment tumble;
+    tumble.type = MOTION_TUMBLE;
+    tumble.duration = 1.0e6f;
+
+    Simulator simulator;
+    simulator.setSampleRate(1.0f / dt);
+    simulator.setSubsteps(8);
+    simulator.setSensor(model);
+    simulator.addSegment(tumble);
+    simulator.reset(1, seed);
+    SimBatch batch;
+    simulator.generate(batch, count);
+
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        SimSample &s = out[i];
+        const float *v = batch.sample(i, 0);
+        s.truth = batch.truth[i];
+        for (int k = 0; k < 3; ++k)
+        {
+            s.gyro[k] = v[k] + noise.gyroBias[k];
+            s.accel[k] = v[k + 3];
+            s.mag[k] = v[k + 6];
+        }
+    }
+}
+
+// Angle of the rotation taking q1 to q2 in radians
+double angleBetween(const Quaternion &q1, const Quaternion &q2)
+{
+    const Quaternion d = q1.conjugate() * q2;
+    const double v = sqrt(static_cast<double>(d.x) * d.x + static_cast<double>(d.y) * d.y
+                          + static_cast<double>(d.z) * d.z);
+    return 2.0 * atan2(v, fabs(static_cast<double>(d.w)));
+}
+
+// Angle between the estimated and true direction of gravity in radians
+double tiltError(const Quaternion &estimate, const Quaternion &truth)
+{
+    const Quaternion a = toSensor(estimate, earth_gravity);
+    const Quaternion b = toSensor(truth, earth_gravity);
+    const double dot = static_cast<double>(a.x) * b.x + static_cast<double>(a.y) * b.y
+                       + static_cast<double>(a.z) * b.z;
+    const double cross = sqrt(pow(a.y * b.z - a.z * b.y, 2) + pow(a.z * b.x - a.x * b.z, 2)
+                              + pow(a.x * b.y - a.y * b.x, 2));
+    return atan2(cross, dot);
+}
+
+// Absolute difference between the estimated and true heading in radians
+double headingError(const Quaternion &estimate, const Quaternion &truth)
+{
+    float roll, pitch, yaw_estimate, yaw_truth;
+    estimate.convertToEulerAngles(roll, pitch, yaw_estimate);
+    truth.convertToEulerAngles(roll, pitch, yaw_truth);
+    double d = fmod(static_cast<double>(yaw_estimate) - yaw_truth, 2.0 * M_PI);
+    d = (d > M_PI) ? (d - 2.0 * M_PI) : ((d < -M_PI) ? (d + 2.0 * M_PI) : d);
+    return fabs(d);
+}
@@ -0,0 +1,38 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "quaternion.h"
+#include "simulator.h"
+
+// Standard deviation of the white noise added to each sensor, and a constant
+// gyroscope bias in rad/s
+struct SensorNoise
+{
+    SensorNoise();
+
+    float gyro;
+    float accel;
+    float mag;
+    float gyroBias[3];
+};
+
+// The true orientation at a sample along with what the sensors measured
+struct SimSample
+{
+    Quaternion truth;
+    float gyro[3];
+    float accel[3];
+    float mag[3];
+};
+
+void simulateTumble(const size_t count, const float dt, const SensorNoise &noise,
+                    const uint32_t seed, std::vector<SimSample> &out);
+
+double angleBetween(const Quaternion &q1, const Quaternion &q2);
+double tiltError(const Quaternion &estimate, const Quaternion &truth);
+double headingError(const Quaternion &estimate, const Quaternion &truth);
+
+#endif // TRAJECTORY_H
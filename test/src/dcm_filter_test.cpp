@@ -0,0 +1,149 @@
+#include <cmath>
+#include <vector>
+#include "gtest/gtest.h"
+#include "filter_test.h"
+#include "dcm_filter.h"
+#include "quaternion.h"
+#include "../sim/trajectory.h"
+
+TEST(DCMFilterTest, Default)
+{
+    const DCMFilter filter;
+    EXPECT_EQ(Quaternion(), filter.orientation());
+    float m[3][3];
+    filter.matrix(m);
+    EXPECT_EQ(1.0f, m[0][0]);
+    EXPECT_EQ(0.0f, m[0][1]);
+    EXPECT_EQ(1.0f, m[2][2]);
+}
+
+TEST(DCMFilterTest, SetOrientation)
+{
+    const Quaternion q = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    DCMFilter filter;
+    filter.setOrientation(q);
+    EXPECT_NEAR(1.0f, std::fabs(q.dot(filter.orientation())), 1.0e-6f);
+
+    // The same through the base class
+    Filter &base = filter;
+    base.setOrientation(Quaternion());
+    EXPECT_NEAR(1.0f, base.orientation().w, 1.0e-6f);
+}
+
+TEST(DCMFilterTest, Align)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    DCMFilter filter;
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(DCMFilterTest, AlignedStaysStill)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    DCMFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(DCMFilterTest, ConvergesFromIdentity)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    DCMFilter filter;
+    filter.setSampleRate(0.01f);
+    for (int i = 0; i < 6000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    EXPECT_LT(angleBetween(filter.orientation(), truth), 0.01);
+}
+
+TEST(DCMFilterTest, IntegralCancelsGyroscopeBias)
+{
+    // At rest with a biased gyroscope the proportional term alone leaves a
+    // standing error, which the integral term removes
+    const Quaternion truth = Quaternion(0.9f, 0.3f, 0.1f, 0.0f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+
+    DCMFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.setIntegralGain(0.2f);
+    filter.align(a.x, a.y, a.z);
+    for (int i = 0; i < 6000; ++i)
+    {
+        filter.update(0.02f, -0.03f, 0.0f, a.x, a.y, a.z);
+    }
+    EXPECT_LT(tiltError(filter.orientation(), truth), 0.001);
+
+    // Only the horizontal axes of the bias are observed through gravity
+    float bx, by, bz;
+    filter.gyroBias(bx, by, bz);
+    const Quaternion b = truth * Quaternion(0.0f, bx, by, bz) * truth.conjugate();
+    const Quaternion expected = truth * Quaternion(0.0f, 0.02f, -0.03f, 0.0f) * truth.conjugate();
+    EXPECT_NEAR(expected.x, b.x, 1.0e-3f);
+    EXPECT_NEAR(expected.y, b.y, 1.0e-3f);
+}
+
+TEST(DCMFilterTest, StaysOrthonormal)
+{
+    DCMFilter filter;
+    filter.setSampleRate(0.005f);
+    for (int i = 0; i < 20000; ++i)
+    {
+        filter.update(1.3f, -2.1f, 3.7f, 0.0f, 0.0f, 0.0f);
+    }
+    float m[3][3];
+    filter.matrix(m);
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            const float dot = (m[i][0] * m[j][0]) + (m[i][1] * m[j][1]) + (m[i][2] * m[j][2]);
+            EXPECT_NEAR((i == j) ? 1.0f : 0.0f, dot, 1.0e-5f);
+        }
+    }
+}
+
+TEST(DCMFilterTest, TracksTumble)
+{
+    const float dt = 0.005f;
+    SensorNoise noise;
+    noise.gyro = 0.01f;
+    noise.accel = 0.01f;
+    noise.mag = 0.01f;
+    std::vector<SimSample> samples;
+    simulateTumble(12000, dt, noise, 7, samples);
+
+    DCMFilter filter;
+    filter.setSampleRate(dt);
+    const SimSample &first = samples[0];
+    filter.align(first.accel[0], first.accel[1], first.accel[2],
+                 first.mag[0], first.mag[1], first.mag[2]);
+    double worst = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        if (i > 200)
+        {
+            worst = std::max(worst, angleBetween(filter.orientation(), s.truth));
+        }
+    }
+    EXPECT_LT(worst, 0.1);
+}
@@ -0,0 +1,214 @@
+#include <cmath>
+#include <vector>
+#include "gtest/gtest.h"
+#include "delta_integrator.h"
+#include "imu_filter.h"
+#include "quaternion.h"
+#include "../sim/trajectory.h"
+
+namespace
+{
+
+// Coning motion: the body axis sweeps a cone of half angle a/2 at w rad/s
+const double cone = 0.1;
+const double cone_rate = 2.0 * M_PI * 10.0;
+
+Quaternion coning(const double t)
+{
+    return Quaternion(static_cast<float>(cos(0.5 * cone)),
+                      static_cast<float>(sin(0.5 * cone) * cos(cone_rate * t)),
+                      static_cast<float>(sin(0.5 * cone) * sin(cone_rate * t)), 0.0f);
+}
+
+// Body rate of the coning motion, twice the vector part of q* dq/dt
+void coningRate(const double t, double w[3])
+{
+    const double c = cos(0.5 * cone), s = sin(0.5 * cone);
+    const double qx = s * cos(cone_rate * t), qy = s * sin(cone_rate * t);
+    const double dx = -s * cone_rate * sin(cone_rate * t);
+    const double dy = s * cone_rate * cos(cone_rate * t);
+    w[0] = 2.0 * (c * dx);
+    w[1] = 2.0 * (c * dy);
+    w[2] = 2.0 * ((qy * dx) - (qx * dy));
+}
+
+// Angle increment over [t, t + dt] by Simpson's rule
+void coningIncrement(const double t, const double dt, float increment[3])
+{
+    const int steps = 16;
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i <= steps; ++i)
+    {
+        const double weight = (i == 0 || i == steps) ? 1.0 : ((i % 2) ? 4.0 : 2.0);
+        double w[3];
+        coningRate(t + (dt * i / steps), w);
+        for (int j = 0; j < 3; ++j)
+        {
+            sum[j] += weight * w[j];
+        }
+    }
+    for (int j = 0; j < 3; ++j)
+    {
+        increment[j] = static_cast<float>(sum[j] * dt / (3.0 * steps));
+    }
+}
+
+// Runs the coning motion through an IMU filter which only integrates the
+// gyroscope, one update per interval of increments, and returns the final
+// attitude error. Without compensation the increments are just summed.
+double coningError(const bool compensate)
+{
+    const double dt = 0.001;
+    const size_t ratio = 20;
+    const size_t count = 5000;
+
+    DeltaIntegrator delta;
+    delta.setPeriod(static_cast<float>(dt));
+    IMUFilter filter;
+    filter.setGyroErrorGain(0.0f);
+    filter.setIntegrator(Filter::INTEGRATOR_EXPONENTIAL);
+    filter.setOrientation(coning(0.0));
+    float sum[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t i = 0; i < count; ++i)
+    {
+        float increment[3];
+        coningIncrement(i * dt, dt, increment);
+        for (int j = 0; j < 3; ++j)
+        {
+            sum[j] += increment[j];
+        }
+        if (delta.add(increment[0], increment[1], increment[2], 0.0f, 0.0f, 1.0f) == ratio)
+        {
+            float w[3], a[3];
+            delta.rates(w[0], w[1], w[2], a[0], a[1], a[2]);
+            const float time = delta.duration();
+            if (!compensate)
+            {
+                for (int j = 0; j < 3; ++j)
+                {
+                    w[j] = sum[j] / time;
+                }
+            }
+            filter.setSampleRate(time);
+            filter.update(w[0], w[1], w[2], a[0], a[1], a[2]);
+            delta.reset();
+            sum[0] = sum[1] = sum[2] = 0.0f;
+        }
+    }
+    return angleBetween(filter.orientation(), coning(count * dt));
+}
+
+} // namespace
+
+TEST(DeltaIntegratorTest, Empty)
+{
+    DeltaIntegrator delta;
+    delta.setPeriod(0.001f);
+    EXPECT_EQ(0u, delta.count());
+    EXPECT_EQ(0.0f, delta.duration());
+    float wx, wy, wz, ax, ay, az;
+    delta.rates(wx, wy, wz, ax, ay, az);
+    EXPECT_EQ(0.0f, wx);
+    EXPECT_EQ(0.0f, az);
+}
+
+TEST(DeltaIntegratorTest, ParallelIncrementsAdd)
+{
+    DeltaIntegrator delta;
+    delta.setPeriod(0.01f);
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(static_cast<size_t>(i + 1),
+                  delta.add(0.003f, -0.006f, 0.009f, 0.0f, 0.0f, 0.01f));
+    }
+    float x, y, z;
+    delta.rotation(x, y, z);
+    EXPECT_NEAR(0.03f, x, 1.0e-6f);
+    EXPECT_NEAR(-0.06f, y, 1.0e-6f);
+    EXPECT_NEAR(0.09f, z, 1.0e-6f);
+
+    float wx, wy, wz, ax, ay, az;
+    delta.rates(wx, wy, wz, ax, ay, az);
+    EXPECT_NEAR(0.1f, delta.duration(), 1.0e-6f);
+    EXPECT_NEAR(0.3f, wx, 1.0e-5f);
+    EXPECT_NEAR(-0.6f, wy, 1.0e-5f);
+    EXPECT_NEAR(0.9f, wz, 1.0e-5f);
+}
+
+TEST(DeltaIntegratorTest, VelocityFollowsRotation)
+{
+    // A constant force along X while turning about Z sweeps the velocity
+    // change in the starting frame towards Y
+    const float rate = 2.0f;
+    const float dt = 0.001f;
+    const int count = 100;
+    DeltaIntegrator delta;
+    delta.setPeriod(dt);
+    for (int i = 0; i < count; ++i)
+    {
+        delta.add(0.0f, 0.0f, rate * dt, dt, 0.0f, 0.0f);
+    }
+    const double T = count * dt;
+    float x, y, z;
+    delta.velocity(x, y, z);
+    EXPECT_NEAR(sin(rate * T) / rate, x, 1.0e-3);
+    EXPECT_NEAR((1.0 - cos(rate * T)) / rate, y, 1.0e-4);
+    EXPECT_NEAR(0.0f, z, 1.0e-9f);
+}
+
+TEST(DeltaIntegratorTest, BurstMatchesAdd)
+{
+    std::vector<float> buffer;
+    for (int i = 0; i < 32; ++i)
+    {
+        const float increment[6] = {
+            0.001f * sinf(0.3f * i), 0.002f * cosf(0.5f * i), 0.0005f * i,
+            0.01f, -0.002f * i, 0.01f * cosf(0.1f * i)
+        };
+        buffer.insert(buffer.end(), increment, increment + 6);
+    }
+
+    DeltaIntegrator single, burst;
+    for (int i = 0; i < 32; ++i)
+    {
+        const float *s = &buffer[i * 6];
+        single.add(s[0], s[1], s[2], s[3], s[4], s[5]);
+    }
+    EXPECT_EQ(32u, burst.add(&buffer[0], 32));
+
+    float x1, y1, z1, x2, y2, z2;
+    single.rotation(x1, y1, z1);
+    burst.rotation(x2, y2, z2);
+    EXPECT_EQ(x1, x2);
+    EXPECT_EQ(y1, y2);
+    EXPECT_EQ(z1, z2);
+    single.velocity(x1, y1, z1);
+    burst.velocity(x2, y2, z2);
+    EXPECT_EQ(x1, x2);
+    EXPECT_EQ(y1, y2);
+    EXPECT_EQ(z1, z2);
+}
+
+TEST(DeltaIntegratorTest, ResetKeepsCount)
+{
+    DeltaIntegrator delta;
+    delta.add(0.01f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    delta.add(0.0f, 0.01f, 0.0f, 0.0f, 0.0f, 0.0f);
+    delta.reset();
+    EXPECT_EQ(0u, delta.count());
+    float x, y, z;
+    delta.rotation(x, y, z);
+    EXPECT_EQ(0.0f, x);
+    EXPECT_EQ(0.0f, y);
+    EXPECT_EQ(0.0f, z);
+}
+
+TEST(DeltaIntegratorTest, ConingCompensation)
+{
+    // Summing the increments drifts about the cone axis, the compensated
+    // rotation follows the motion at a twentieth of the increment rate
+    const double plain = coningError(false);
+    const double compensated = coningError(true);
+    EXPECT_GT(plain, 0.1);
+    EXPECT_LT(compensated, 1.0e-3);
+}
@@ -0,0 +1,173 @@
+#include <cmath>
+#include "gtest/gtest.h"
+#include "dcm_filter.h"
+#include "gauss_newton_filter.h"
+#include "imu_filter.h"
+#include "kalman_filter.h"
+#include "mahony_imu_filter.h"
+#include "mahony_marg_filter.h"
+#include "marg_filter.h"
+#include "../sim/simulator.h"
+#include "../sim/trajectory.h"
+
+namespace
+{
+
+const float rate = 200.0f;
+
+// Every kind of motion in turn, ending at rest so the filters can settle
+void scenario(Simulator &simulator)
+{
+    MotionSegment segment;
+    segment.type = MOTION_TUMBLE;
+    segment.duration = 20.0f;
+    simulator.addSegment(segment);
+
+    segment = MotionSegment();
+    segment.type = MOTION_VIBRATION;
+    segment.duration = 5.0f;
+    segment.amplitude = 0.01f;
+    segment.frequency = 30.0f;
+    segment.shake = 0.5f;
+    simulator.addSegment(segment);
+
+    segment = MotionSegment();
+    segment.type = MOTION_FREE_FALL;
+    segment.duration = 1.0f;
+    segment.rate[1] = 3.0f;
+    simulator.addSegment(segment);
+
+    segment = MotionSegment();
+    segment.type = MOTION_ROTATION;
+    segment.duration = 5.0f;
+    segment.rate[2] = 1.5f;
+    segment.magnetic[1] = 0.4f;
+    simulator.addSegment(segment);
+
+    segment = MotionSegment();
+    segment.type = MOTION_STATIC;
+    segment.duration = 20.0f;
+    simulator.addSegment(segment);
+}
+
+void generate(SimBatch &batch, const size_t devices)
+{
+    SensorModel model;
+    model.gyroNoise = 0.02f;
+    model.accelNoise = 0.02f;
+    model.magNoise = 0.02f;
+    model.gyroBias = 0.01f;
+    model.gyroBiasWalk = 0.0005f;
+    model.jitter = 0.0002f;
+    model.mounting = true;
+    Simulator simulator;
+    simulator.setSampleRate(rate);
+    simulator.setSensor(model);
+    scenario(simulator);
+    simulator.reset(devices, 99);
+    simulator.generate(batch, static_cast<size_t>(simulator.duration() * rate));
+}
+
+// Feeds samples to filters which use the gyroscope and accelerometer, or
+// with Magnetic set the magnetometer as well
+template <bool Magnetic>
+struct Feed
+{
+    template <typename F>
+    static void align(F &filter, const float *s)
+    {
+        filter.align(s[3], s[4], s[5]);
+    }
+
+    template <typename F>
+    static void update(F &filter, const float *s)
+    {
+        filter.update(s[0], s[1], s[2], s[3], s[4], s[5]);
+    }
+};
+
+template <>
+struct Feed<true>
+{
+    template <typename F>
+    static void align(F &filter, const float *s)
+    {
+        filter.align(s[3], s[4], s[5], s[6], s[7], s[8]);
+    }
+
+    template <typename F>
+    static void update(F &filter, const float *s)
+    {
+        filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+    }
+};
+
+// Runs every device of the scenario through a copy of a configured filter,
+// which must stay finite throughout and end within tolerance of the truth
+template <bool Magnetic, typename F>
+void expectSettles(const F &configured,
+                   double (*error)(const Quaternion &, const Quaternion &),
+                   const double tolerance)
+{
+    SimBatch batch;
+    generate(batch, 4);
+    for (size_t d = 0; d < batch.devices; ++d)
+    {
+        SCOPED_TRACE(d);
+        F filter = configured;
+        Feed<Magnetic>::align(filter, batch.sample(0, d));
+        double previous = 0.0;
+        for (size_t i = 0; i < batch.count; ++i)
+        {
+            const double time = batch.time[(i * batch.devices) + d];
+            filter.setSampleRate(time - previous);
+            previous = time;
+            Feed<Magnetic>::update(filter, batch.sample(i, d));
+            ASSERT_FALSE(std::isnan(filter.orientation().w)) << "at sample " << i;
+        }
+        const Quaternion &truth = batch.truth[batch.truth.size() - batch.devices + d];
+        EXPECT_LT(error(filter.orientation(), truth), tolerance);
+    }
+}
+
+} // namespace
+
+TEST(FilterStressTest, IMUSettlesAfterEveryMotion)
+{
+    IMUFilter filter;
+    filter.setGyroErrorGain(0.05f);
+    expectSettles<false>(filter, tiltError, 0.02);
+}
+
+TEST(FilterStressTest, MARGSettlesAfterEveryMotion)
+{
+    MARGFilter filter;
+    filter.setGyroErrorGain(0.05f);
+    filter.setGyroDriftGain(0.001f);
+    expectSettles<true>(filter, angleBetween, 0.05);
+}
+
+TEST(FilterStressTest, GaussNewtonSettlesAfterEveryMotion)
+{
+    expectSettles<true>(GaussNewtonFilter(), angleBetween, 0.05);
+}
+
+TEST(FilterStressTest, DCMSettlesAfterEveryMotion)
+{
+    expectSettles<true>(DCMFilter(), angleBetween, 0.05);
+}
+
+TEST(FilterStressTest, MahonyIMUSettlesAfterEveryMotion)
+{
+    expectSettles<false>(MahonyIMUFilter(), tiltError, 0.02);
+}
+
+TEST(FilterStressTest, MahonyMARGSettlesAfterEveryMotion)
+{
+    expectSettles<true>(MahonyMARGFilter(), angleBetween, 0.05);
+}
+
+TEST(FilterStressTest, KalmanSettlesAfterEveryMotion)
+{
+    expectSettles<true>(KalmanFilter(), angleBetween, 0.05);
+}
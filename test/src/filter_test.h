@@ -0,0 +1,16 @@
+#ifndef FILTER_TEST_H
+#define FILTER_TEST_H
+
+#include "quaternion.h"
+
+// Rotates an earth frame vector into the sensor frame
+inline Quaternion toSensor(const Quaternion &q, const Quaternion &v)
+{
+    return q.conjugate() * v * q;
+}
+
+// Gravity and a magnetic field dipping below the horizon, in the earth frame
+const Quaternion Eg(0.0f, 0.0f, 0.0f, 1.0f);
+const Quaternion Eb = Quaternion(0.0f, 0.5f, 0.0f, -0.8f).normalized();
+
+#endif // FILTER_TEST_H
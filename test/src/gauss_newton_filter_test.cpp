@@ -0,0 +1,102 @@
+#include <cmath>
+#include <vector>
+#include "gtest/gtest.h"
+#include "filter_test.h"
+#include "gauss_newton_filter.h"
+#include "quaternion.h"
+#include "../sim/trajectory.h"
+
+TEST(GaussNewtonFilterTest, Default)
+{
+    const GaussNewtonFilter filter;
+    EXPECT_EQ(Quaternion(), filter.orientation());
+}
+
+TEST(GaussNewtonFilterTest, Align)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    GaussNewtonFilter filter;
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(GaussNewtonFilterTest, ObservationConverges)
+{
+    // Without the gyroscope blend each update is a pure Gauss-Newton solve
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    GaussNewtonFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.setTimeConstant(0.0f);
+    filter.setIterations(3);
+    for (int i = 0; i < 10; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(GaussNewtonFilterTest, AlignedStaysStill)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    GaussNewtonFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(GaussNewtonFilterTest, GyroscopeOnlyWithoutGravity)
+{
+    // A zero accelerometer gives no observation, so the gyroscope alone
+    // turns the sensor a quarter turn about Z in one second
+    GaussNewtonFilter filter;
+    filter.setSampleRate(0.001f);
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.5f * M_PI, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, -0.8f);
+    }
+    const Quaternion expected(std::cos(M_PI / 4.0), 0.0f, 0.0f, std::sin(M_PI / 4.0));
+    EXPECT_GT(std::fabs(expected.dot(filter.orientation())), 0.9999f);
+}
+
+TEST(GaussNewtonFilterTest, TracksTumble)
+{
+    const float dt = 0.005f;
+    SensorNoise noise;
+    noise.gyro = 0.01f;
+    noise.accel = 0.01f;
+    noise.mag = 0.01f;
+    std::vector<SimSample> samples;
+    simulateTumble(12000, dt, noise, 7, samples);
+
+    GaussNewtonFilter filter;
+    filter.setSampleRate(dt);
+    const SimSample &first = samples[0];
+    filter.align(first.accel[0], first.accel[1], first.accel[2],
+                 first.mag[0], first.mag[1], first.mag[2]);
+    double worst = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        if (i > 200)
+        {
+            worst = std::max(worst, angleBetween(filter.orientation(), s.truth));
+        }
+    }
+    EXPECT_LT(worst, 0.1);
+}
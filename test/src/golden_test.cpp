@@ -0,0 +1,218 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "imu_filter.h"
+#include "marg_filter.h"
+#include "../sim/simulator.h"
+#include "../sim/trajectory.h"
+
+// Runs the filters over long simulated logs and compares their estimates at
+// regular checkpoints with golden orientations stored in the data directory.
+// The tests must be run from the test directory. After a change which is
+// meant to alter the output, regenerate the golden files by running
+//
+//     FUSION_UPDATE_GOLDEN=1 ./fusion-test --gtest_filter='GoldenTest.*'
+//
+// and review the difference before committing them.
+
+namespace
+{
+
+const float rate = 200.0f;
+const size_t devices = 2;
+const size_t interval = 500;
+
+// Largest angle allowed between an estimate and its golden value. Loose
+// enough for changes in rounding, tight enough to catch any change in the
+// algorithm.
+const double tolerance = 0.001;
+
+struct Checkpoint
+{
+    size_t device;
+    size_t sample;
+    Quaternion q;
+};
+
+// Two minutes of every kind of motion with realistic sensor errors
+void referenceLog(SimBatch &batch)
+{
+    SensorModel model;
+    model.gyroNoise = 0.01f;
+    model.accelNoise = 0.02f;
+    model.magNoise = 0.02f;
+    model.gyroBias = 0.02f;
+    model.gyroBiasWalk = 0.0005f;
+    model.jitter = 0.0001f;
+    model.mounting = true;
+
+    Simulator simulator;
+    simulator.setSampleRate(rate);
+    simulator.setSensor(model);
+    MotionSegment segment;
+    segment.type = MOTION_STATIC;
+    segment.duration = 10.0f;
+    simulator.addSegment(segment);
+    segment.type = MOTION_TUMBLE;
+    segment.duration = 40.0f;
+    simulator.addSegment(segment);
+    segment = MotionSegment();
+    segment.type = MOTION_VIBRATION;
+    segment.duration = 15.0f;
+    segment.amplitude = 0.005f;
+    segment.frequency = 25.0f;
+    segment.shake = 0.3f;
+    simulator.addSegment(segment);
+    segment = MotionSegment();
+    segment.type = MOTION_ROTATION;
+    segment.duration = 20.0f;
+    segment.rate[0] = 0.3f;
+    segment.rate[2] = -1.2f;
+    segment.magnetic[1] = 0.2f;
+    simulator.addSegment(segment);
+    segment = MotionSegment();
+    segment.type = MOTION_FREE_FALL;
+    segment.duration = 1.0f;
+    segment.rate[1] = 2.0f;
+    simulator.addSegment(segment);
+    segment = MotionSegment();
+    segment.type = MOTION_TUMBLE;
+    segment.duration = 34.0f;
+    segment.amplitude = 2.0f;
+    simulator.addSegment(segment);
+    simulator.reset(devices, 2015);
+    simulator.generate(batch, static_cast<size_t>(simulator.duration() * rate));
+}
+
+template <typename F>
+void configure(F &filter)
+{
+    filter.setGyroErrorGain(0.05f);
+}
+
+void configure(MARGFilter &filter)
+{
+    filter.setGyroErrorGain(0.05f);
+    filter.setGyroDriftGain(0.002f);
+}
+
+void update(IMUFilter &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5]);
+}
+
+void update(MARGFilter &filter, const float *s)
+{
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+}
+
+template <typename F>
+std::vector<Checkpoint> run(const SimBatch &batch)
+{
+    std::vector<Checkpoint> out;
+    for (size_t d = 0; d < batch.devices; ++d)
+    {
+        F filter;
+        configure(filter);
+        double previous = 0.0;
+        for (size_t i = 0; i < batch.count; ++i)
+        {
+            const double time = batch.time[(i * batch.devices) + d];
+            filter.setSampleRate(time - previous);
+            previous = time;
+            update(filter, batch.sample(i, d));
+            if (0 == ((i + 1) % interval))
+            {
+                Checkpoint c = { d, i + 1, filter.orientation() };
+                out.push_back(c);
+            }
+        }
+    }
+    return out;
+}
+
+bool readGolden(const std::string &path, std::vector<Checkpoint> &golden)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file)
+    {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        unsigned long device, sample;
+        Checkpoint c;
+        if (6 == sscanf(line, "%lu,%lu,%f,%f,%f,%f", &device, &sample,
+                        &c.q.w, &c.q.x, &c.q.y, &c.q.z))
+        {
+            c.device = device;
+            c.sample = sample;
+            golden.push_back(c);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+bool writeGolden(const std::string &path, const std::vector<Checkpoint> &checkpoints)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file)
+    {
+        return false;
+    }
+    fputs("# device,sample,w,x,y,z\n", file);
+    for (size_t i = 0; i < checkpoints.size(); ++i)
+    {
+        const Checkpoint &c = checkpoints[i];
+        fprintf(file, "%lu,%lu,%.9g,%.9g,%.9g,%.9g\n", static_cast<unsigned long>(c.device),
+                static_cast<unsigned long>(c.sample), c.q.w, c.q.x, c.q.y, c.q.z);
+    }
+    return 0 == fclose(file);
+}
+
+void compare(const std::string &path, const std::vector<Checkpoint> &actual)
+{
+    if (getenv("FUSION_UPDATE_GOLDEN"))
+    {
+        ASSERT_TRUE(writeGolden(path, actual)) << "cannot write " << path;
+        return;
+    }
+    std::vector<Checkpoint> golden;
+    ASSERT_TRUE(readGolden(path, golden)) << "cannot read " << path
+                                          << ", run the tests from the test directory";
+    ASSERT_EQ(golden.size(), actual.size());
+    for (size_t i = 0; i < golden.size(); ++i)
+    {
+        ASSERT_EQ(golden[i].device, actual[i].device);
+        ASSERT_EQ(golden[i].sample, actual[i].sample);
+        EXPECT_LT(angleBetween(golden[i].q, actual[i].q), tolerance)
+                << "device " << golden[i].device << " sample " << golden[i].sample;
+    }
+}
+
+const SimBatch &reference()
+{
+    static SimBatch batch;
+    if (0 == batch.count)
+    {
+        referenceLog(batch);
+    }
+    return batch;
+}
+
+} // namespace
+
+TEST(GoldenTest, IMUFilter)
+{
+    compare("data/imu_golden.csv", run<IMUFilter>(reference()));
+}
+
+TEST(GoldenTest, MARGFilter)
+{
+    compare("data/marg_golden.csv", run<MARGFilter>(reference()));
+}
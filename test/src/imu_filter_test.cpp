@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "filter_test.h"
+#include "imu_filter.h"
+#include "sensor_calibration.h"
+#include "sensor_format.h"
+#include "quaternion.h"
+#include "../sim/trajectory.h"
+
+TEST(IMUFilterTest, Default)
+{
+    const IMUFilter filter;
+    EXPECT_EQ(Quaternion(), filter.orientation());
+}
+
+TEST(IMUFilterTest, SetOrientation)
+{
+    IMUFilter filter;
+    filter.setOrientation(Quaternion(2.0f, 0.0f, 0.0f, 0.0f));
+    EXPECT_EQ(Quaternion(), filter.orientation());
+}
+
+TEST(IMUFilterTest, Align)
+{
+    const float g[][3] = { { 0.0f, 0.0f, 1.0f }, { 0.3f, -0.5f, 0.8f },
+                           { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.2f, -0.9f },
+                           { 0.0f, 0.0f, -1.0f } };
+    for (size_t i = 0; i < sizeof(g) / sizeof(g[0]); ++i)
+    {
+        IMUFilter filter;
+        filter.align(g[i][0], g[i][1], g[i][2]);
+        const Quaternion q = filter.orientation();
+        const Quaternion a = Quaternion(0.0f, g[i][0], g[i][1], g[i][2]).normalized();
+        const Quaternion s = toSensor(q, Quaternion(0.0f, 0.0f, 0.0f, 1.0f));
+        EXPECT_NEAR(1.0f, q.norm(), 1.0e-5f);
+        EXPECT_NEAR(a.x, s.x, 1.0e-5f);
+        EXPECT_NEAR(a.y, s.y, 1.0e-5f);
+        EXPECT_NEAR(a.z, s.z, 1.0e-5f);
+    }
+}
+
+TEST(IMUFilterTest, AlignedStaysStill)
+{
+    IMUFilter filter;
+    filter.setGyroErrorGain(0.1f);
+    filter.setSampleRate(0.01f);
+    filter.align(0.3f, -0.5f, 0.8f);
+    const Quaternion aligned = filter.orientation();
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, 0.3f, -0.5f, 0.8f);
+    }
+    EXPECT_GT(std::fabs(aligned.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(IMUFilterTest, IntegratorsFollowFastRotation)
+{
+    // With no correction the filter only integrates the gyroscope, here a
+    // constant 8 rad/s sampled at 20 Hz, 0.4 rad per step
+    const Quaternion axis = Quaternion(0.0f, 0.3f, -0.5f, 0.8f).normalized();
+    const float rate = 8.0f;
+    const float dt = 0.05f;
+    const int steps = 40;
+    const Quaternion truth = Quaternion::fromRotationVector(
+            axis.x * rate * dt * steps, axis.y * rate * dt * steps, axis.z * rate * dt * steps);
+
+    const Filter::Integrator methods[] = {
+        Filter::INTEGRATOR_EULER, Filter::INTEGRATOR_MIDPOINT,
+        Filter::INTEGRATOR_RK4, Filter::INTEGRATOR_EXPONENTIAL
+    };
+    double errors[4];
+    for (int m = 0; m < 4; ++m)
+    {
+        IMUFilter filter;
+        filter.setGyroErrorGain(0.0f);
+        filter.setSampleRate(dt);
+        filter.setIntegrator(methods[m]);
+        for (int i = 0; i < steps; ++i)
+        {
+            filter.update(axis.x * rate, axis.y * rate, axis.z * rate, 0.0f, 0.0f, 1.0f);
+        }
+        errors[m] = angleBetween(filter.orientation(), truth);
+    }
+    EXPECT_GT(errors[0], 0.1);
+    EXPECT_LT(errors[1], 0.6 * errors[0]);
+    EXPECT_LT(errors[2], 1.0e-3);
+    EXPECT_LT(errors[3], 1.0e-5);
+}
+
+TEST(IMUFilterTest, RungeKuttaFollowsAcceleratingRotation)
+{
+    // A constant 2 rad/s then a steady acceleration of 8 rad/s^2 about one
+    // axis. The rate is linear between the samples, which the Runge-Kutta
+    // methods interpolate while the exponential map holds each sample.
+    const Quaternion axis = Quaternion(0.0f, 0.3f, -0.5f, 0.8f).normalized();
+    const float dt = 0.05f;
+    const int hold = 10;
+    const int steps = 40;
+    const double ramp = (steps - hold) * dt;
+    const double angle = (2.0 * steps * dt) + (0.5 * 8.0 * ramp * ramp);
+    const Quaternion truth = Quaternion::fromRotationVector(
+            axis.x * angle, axis.y * angle, axis.z * angle);
+
+    const Filter::Integrator methods[] = {
+        Filter::INTEGRATOR_EULER, Filter::INTEGRATOR_MIDPOINT,
+        Filter::INTEGRATOR_RK4, Filter::INTEGRATOR_EXPONENTIAL
+    };
+    double errors[4];
+    for (int m = 0; m < 4; ++m)
+    {
+        IMUFilter filter;
+        filter.setGyroErrorGain(0.0f);
+        filter.setSampleRate(dt);
+        filter.setIntegrator(methods[m]);
+        for (int i = 1; i <= steps; ++i)
+        {
+            const float rate = 2.0f + ((i > hold) ? 8.0f * (i - hold) * dt : 0.0f);
+            filter.update(axis.x * rate, axis.y * rate, axis.z * rate, 0.0f, 0.0f, 1.0f);
+        }
+        errors[m] = angleBetween(filter.orientation(), truth);
+    }
+    EXPECT_GT(errors[3], 0.1);
+    EXPECT_LT(errors[1], 0.5 * errors[3]);
+    EXPECT_LT(errors[2], 1.0e-3);
+}
+
+TEST(IMUFilterTest, BurstMatchesUpdate)
+{
+    float samples[64][6];
+    for (int i = 0; i < 64; ++i)
+    {
+        samples[i][0] = 0.3f * std::sin(0.1f * i);
+        samples[i][1] = 0.2f;
+        samples[i][2] = -0.1f;
+        samples[i][3] = 0.1f;
+        samples[i][4] = 0.05f * std::cos(0.2f * i);
+        samples[i][5] = 0.98f;
+    }
+    IMUFilter single;
+    IMUFilter burst;
+    single.setSampleRate(0.01f);
+    burst.setSampleRate(0.01f);
+    Quaternion expected[16];
+    for (int i = 0; i < 64; ++i)
+    {
+        single.update(samples[i][0], samples[i][1], samples[i][2],
+                      samples[i][3], samples[i][4], samples[i][5]);
+        if (3 == i % 4)
+        {
+            expected[i / 4] = single.orientation();
+        }
+    }
+    Quaternion orientations[16];
+    EXPECT_EQ(16u, burst.update(&samples[0][0], 64, orientations, 4));
+    for (int i = 0; i < 16; ++i)
+    {
+        EXPECT_EQ(expected[i], orientations[i]);
+    }
+    EXPECT_EQ(single.orientation(), burst.orientation());
+}
+
+TEST(IMUFilterTest, BurstDecimationSpansBursts)
+{
+    float samples[3][6];
+    for (int i = 0; i < 3; ++i)
+    {
+        const float sample[6] = { 0.1f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+        std::copy(sample, sample + 6, samples[i]);
+    }
+    IMUFilter filter;
+    filter.setSampleRate(0.01f);
+    Quaternion orientations[3];
+
+    // One output in four samples over bursts of three
+    EXPECT_EQ(0u, filter.update(&samples[0][0], 3, orientations, 4));
+    EXPECT_EQ(1u, filter.update(&samples[0][0], 3, orientations, 4));
+    EXPECT_EQ(1u, filter.update(&samples[0][0], 3, orientations, 4));
+    EXPECT_EQ(1u, filter.update(&samples[0][0], 3, orientations, 4));
+    EXPECT_EQ(filter.orientation(), orientations[0]);
+
+    // Without a buffer nothing is written, but the samples still count
+    EXPECT_EQ(0u, filter.update(&samples[0][0], 3, 0, 4));
+    EXPECT_EQ(1u, filter.update(&samples[0][0], 1, orientations, 4));
+    EXPECT_EQ(0u, filter.update(&samples[0][0], 3, orientations, 4));
+    EXPECT_EQ(1u, filter.update(&samples[0][0], 1, orientations, 4));
+}
+
+TEST(IMUFilterTest, RawBurstMatchesScaled)
+{
+    const float scale = 0.001f;
+    int16_t raw[32][6];
+    float scaled[32][6];
+    for (int i = 0; i < 32; ++i)
+    {
+        raw[i][0] = static_cast<int16_t>(300 * i - 4000);
+        raw[i][1] = 250;
+        raw[i][2] = -120;
+        raw[i][3] = 1600;
+        raw[i][4] = static_cast<int16_t>(-40 * i);
+        raw[i][5] = 16000;
+        for (int j = 0; j < 6; ++j)
+        {
+            scaled[i][j] = (j < 3) ? scale * raw[i][j] : raw[i][j];
+        }
+    }
+    IMUFilter integer;
+    IMUFilter floating;
+    integer.setSampleRate(0.01f);
+    floating.setSampleRate(0.01f);
+    EXPECT_EQ(0u, integer.update(&raw[0][0], 32, scale, 0, 0));
+    EXPECT_EQ(0u, floating.update(&scaled[0][0], 32, 0, 0));
+    EXPECT_EQ(floating.orientation(), integer.orientation());
+}
+
+TEST(IMUFilterTest, FormatBurstMatchesConverted)
+{
+    // Records of accelerometer, temperature then gyroscope, with the sensor
+    // mounted turned a quarter about Z
+    SensorFormat format;
+    format.setStride(7);
+    format.setAxis(SensorFormat::GYRO_X, 5, -0.001f, 3.0f);
+    format.setAxis(SensorFormat::GYRO_Y, 4, 0.001f, -5.0f);
+    format.setAxis(SensorFormat::GYRO_Z, 6, 0.001f, 1.0f);
+    format.setAxis(SensorFormat::ACCEL_X, 1, -1.0f, 20.0f);
+    format.setAxis(SensorFormat::ACCEL_Y, 0, 1.0f, -12.0f);
+    format.setAxis(SensorFormat::ACCEL_Z, 2, 1.0f, 40.0f);
+
+    int16_t raw[32][7];
+    float converted[32][6];
+    for (int i = 0; i < 32; ++i)
+    {
+        raw[i][0] = 1600;
+        raw[i][1] = static_cast<int16_t>(-40 * i);
+        raw[i][2] = 16000;
+        raw[i][3] = 2500;
+        raw[i][4] = static_cast<int16_t>(300 * i - 4000);
+        raw[i][5] = 250;
+        raw[i][6] = -120;
+        for (int j = 0; j < 6; ++j)
+        {
+            converted[i][j] = format.value(raw[i], static_cast<SensorFormat::Axis>(j));
+        }
+    }
+    IMUFilter integer;
+    IMUFilter floating;
+    integer.setSampleRate(0.01f);
+    floating.setSampleRate(0.01f);
+    EXPECT_EQ(0u, integer.update(&raw[0][0], 32, format, 0, 0));
+    EXPECT_EQ(0u, floating.update(&converted[0][0], 32, 0, 0));
+    EXPECT_EQ(floating.orientation(), integer.orientation());
+}
+
+TEST(IMUFilterTest, CalibratedBurstMatchesCalibrated)
+{
+    SensorCalibration calibration;
+    calibration.setBias(SensorCalibration::SENSOR_GYRO, 0.01f, -0.02f, 0.005f);
+    const float m[3][3] = { { 1.02f, 0.01f, 0.0f },
+                            { -0.01f, 0.98f, 0.02f },
+                            { 0.0f, 0.03f, 1.01f } };
+    calibration.setMatrix(SensorCalibration::SENSOR_ACCEL, m);
+    calibration.setBias(SensorCalibration::SENSOR_ACCEL, 0.02f, 0.01f, -0.03f);
+
+    float samples[32][6];
+    for (int i = 0; i < 32; ++i)
+    {
+        samples[i][0] = 0.3f * std::sin(0.1f * i);
+        samples[i][1] = 0.2f;
+        samples[i][2] = -0.1f;
+        samples[i][3] = 0.1f;
+        samples[i][4] = 0.05f * std::cos(0.2f * i);
+        samples[i][5] = 0.98f;
+    }
+    IMUFilter fused;
+    IMUFilter separate;
+    fused.setSampleRate(0.01f);
+    separate.setSampleRate(0.01f);
+    EXPECT_EQ(0u, fused.update(&samples[0][0], 32, calibration, 0, 0));
+    calibration.apply(&samples[0][0], 32, 6, 2);
+    EXPECT_EQ(0u, separate.update(&samples[0][0], 32, 0, 0));
+    EXPECT_EQ(separate.orientation(), fused.orientation());
+}
+
+TEST(IMUFilterTest, RecordMatchesUpdate)
+{
+    SensorFormat format;
+    format.setStride(6);
+    for (int i = 0; i < 6; ++i)
+    {
+        format.setAxis(static_cast<SensorFormat::Axis>(i), static_cast<uint8_t>(i),
+                       (i < 3) ? 0.001f : 0.5f, 3.0f);
+    }
+    const int16_t record[6] = { -400, 250, 1200, 40, -300, 2000 };
+    IMUFilter raw;
+    IMUFilter converted;
+    raw.setSampleRate(0.01f);
+    converted.setSampleRate(0.01f);
+    raw.update(record, format);
+    converted.update(format.value(record, SensorFormat::GYRO_X),
+                     format.value(record, SensorFormat::GYRO_Y),
+                     format.value(record, SensorFormat::GYRO_Z),
+                     format.value(record, SensorFormat::ACCEL_X),
+                     format.value(record, SensorFormat::ACCEL_Y),
+                     format.value(record, SensorFormat::ACCEL_Z));
+    EXPECT_EQ(converted.orientation(), raw.orientation());
+}
+
+TEST(IMUFilterTest, FormatCalibratedBurstMatchesCalibrated)
+{
+    SensorFormat format;
+    format.setStride(7);
+    for (int i = 0; i < 6; ++i)
+    {
+        format.setAxis(static_cast<SensorFormat::Axis>(i), static_cast<uint8_t>(i + 1),
+                       (i < 3) ? 0.001f : 0.0005f, -2.0f);
+    }
+    SensorCalibration calibration;
+    calibration.setBias(SensorCalibration::SENSOR_GYRO, 0.01f, -0.02f, 0.005f);
+    calibration.setScale(SensorCalibration::SENSOR_ACCEL, 1.02f, 0.99f, 1.01f);
+
+    int16_t records[16][7];
+    float samples[16][6];
+    for (int i = 0; i < 16; ++i)
+    {
+        records[i][0] = static_cast<int16_t>(100 * i);
+        records[i][1] = static_cast<int16_t>(300 * std::sin(0.1f * i));
+        records[i][2] = 200;
+        records[i][3] = -100;
+        records[i][4] = 200;
+        records[i][5] = static_cast<int16_t>(100 * std::cos(0.2f * i));
+        records[i][6] = 1960;
+        for (int j = 0; j < 6; ++j)
+        {
+            samples[i][j] = format.value(records[i], static_cast<SensorFormat::Axis>(j));
+        }
+    }
+    IMUFilter fused;
+    IMUFilter separate;
+    fused.setSampleRate(0.01f);
+    separate.setSampleRate(0.01f);
+    Quaternion orientations[4];
+    EXPECT_EQ(4u, fused.update(&records[0][0], 16, format, calibration, orientations, 4));
+    calibration.apply(&samples[0][0], 16, 6, 2);
+    EXPECT_EQ(0u, separate.update(&samples[0][0], 16, 0, 0));
+    EXPECT_EQ(separate.orientation(), fused.orientation());
+    EXPECT_EQ(separate.orientation(), orientations[3]);
+}
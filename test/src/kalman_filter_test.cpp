@@ -0,0 +1,249 @@
+#include <cmath>
+#include <vector>
+#include "gtest/gtest.h"
+#include "filter_test.h"
+#include "kalman_filter.h"
+#include "quaternion.h"
+#include "../sim/trajectory.h"
+
+TEST(KalmanFilterTest, Default)
+{
+    const KalmanFilter filter;
+    EXPECT_EQ(Quaternion(), filter.orientation());
+    float bx, by, bz;
+    filter.gyroBias(bx, by, bz);
+    EXPECT_EQ(0.0f, bx);
+    EXPECT_EQ(0.0f, by);
+    EXPECT_EQ(0.0f, bz);
+    EXPECT_NEAR(std::sqrt(3.0f), filter.attitudeUncertainty(), 1.0e-6f);
+}
+
+TEST(KalmanFilterTest, Align)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    KalmanFilter filter;
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+    EXPECT_LT(filter.attitudeUncertainty(), 0.1f);
+}
+
+TEST(KalmanFilterTest, AlignWithoutHeadingLeavesVerticalUncertain)
+{
+    const Quaternion truth = Quaternion(0.9f, 0.3f, 0.1f, 0.0f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+
+    KalmanFilter filter;
+    filter.align(a.x, a.y, a.z);
+
+    // The variance about the vertical is large, about any horizontal axis
+    // it is small
+    float P[6][6];
+    filter.covariance(P);
+    const float v[3] = { a.x, a.y, a.z };
+    float vertical = 0.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            vertical += v[i] * P[i][j] * v[j];
+        }
+    }
+    EXPECT_NEAR(1.0f, vertical, 1.0e-4f);
+    EXPECT_NEAR(1.0f + (2.0f * 0.05f * 0.05f), P[0][0] + P[1][1] + P[2][2], 1.0e-4f);
+}
+
+TEST(KalmanFilterTest, CovarianceIsSymmetric)
+{
+    KalmanFilter filter;
+    filter.setSampleRate(0.01f);
+    for (int i = 0; i < 100; ++i)
+    {
+        filter.update(0.3f, -0.2f, 0.5f, 0.1f, 0.2f, 0.9f, 0.4f, 0.1f, -0.7f);
+    }
+    float P[6][6];
+    filter.covariance(P);
+    for (int i = 0; i < 6; ++i)
+    {
+        EXPECT_GT(P[i][i], 0.0f);
+        for (int j = 0; j < 6; ++j)
+        {
+            EXPECT_EQ(P[i][j], P[j][i]);
+        }
+    }
+}
+
+TEST(KalmanFilterTest, UncertaintyGrowsWithoutMeasurements)
+{
+    KalmanFilter filter;
+    filter.setSampleRate(0.01f);
+    const Quaternion a = toSensor(Quaternion(), Eg);
+    const Quaternion m = toSensor(Quaternion(), Eb);
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    const float settled = filter.attitudeUncertainty();
+    EXPECT_LT(settled, 0.05f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+    EXPECT_GT(filter.attitudeUncertainty(), settled);
+}
+
+TEST(KalmanFilterTest, ConvergesFromIdentity)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    KalmanFilter filter;
+    filter.setSampleRate(0.01f);
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    EXPECT_LT(angleBetween(filter.orientation(), truth), 0.01);
+}
+
+TEST(KalmanFilterTest, EstimatesGyroscopeBias)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    KalmanFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    for (int i = 0; i < 6000; ++i)
+    {
+        filter.update(0.02f, -0.03f, 0.01f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    float bx, by, bz;
+    filter.gyroBias(bx, by, bz);
+    EXPECT_NEAR(0.02f, bx, 1.0e-3f);
+    EXPECT_NEAR(-0.03f, by, 1.0e-3f);
+    EXPECT_NEAR(0.01f, bz, 1.0e-3f);
+    EXPECT_LT(angleBetween(filter.orientation(), truth), 0.005);
+}
+
+TEST(KalmanFilterTest, BatchMatchesUpdate)
+{
+    const float dt = 0.005f;
+    std::vector<SimSample> samples;
+    simulateTumble(500, dt, SensorNoise(), 3, samples);
+    std::vector<float> packed;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        packed.insert(packed.end(), s.gyro, s.gyro + 3);
+        packed.insert(packed.end(), s.accel, s.accel + 3);
+        packed.insert(packed.end(), s.mag, s.mag + 3);
+    }
+
+    KalmanFilter single, batch;
+    single.setSampleRate(dt);
+    batch.setSampleRate(dt);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        single.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+    }
+    EXPECT_EQ(0u, batch.update(&packed[0], samples.size(), 0, 0));
+    EXPECT_EQ(single.orientation(), batch.orientation());
+}
+
+TEST(KalmanFilterTest, BurstWithoutMagnetometerMatchesUpdate)
+{
+    // A zero magnetometer reading leaves the heading to the gyroscope
+    std::vector<SimSample> samples;
+    simulateTumble(100, 0.01f, SensorNoise(), 5, samples);
+    std::vector<float> packed;
+    KalmanFilter single, burst;
+    single.setSampleRate(0.01f);
+    burst.setSampleRate(0.01f);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        single.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2]);
+        packed.insert(packed.end(), s.gyro, s.gyro + 3);
+        packed.insert(packed.end(), s.accel, s.accel + 3);
+        packed.insert(packed.end(), 3, 0.0f);
+    }
+    EXPECT_EQ(0u, burst.update(&packed[0], samples.size(), 0, 0));
+    EXPECT_EQ(single.orientation(), burst.orientation());
+}
+
+TEST(KalmanFilterTest, BurstWritesUncertainty)
+{
+    std::vector<SimSample> samples;
+    simulateTumble(40, 0.01f, SensorNoise(), 9, samples);
+    std::vector<float> packed;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        packed.insert(packed.end(), s.gyro, s.gyro + 3);
+        packed.insert(packed.end(), s.accel, s.accel + 3);
+        packed.insert(packed.end(), s.mag, s.mag + 3);
+    }
+
+    // Every sample with decimation one, checked against single updates
+    KalmanFilter single, burst;
+    single.setSampleRate(0.01f);
+    burst.setSampleRate(0.01f);
+    Quaternion orientations[40];
+    float uncertainties[40];
+    EXPECT_EQ(40u, burst.update(&packed[0], 40, orientations, uncertainties, 1));
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        single.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        EXPECT_EQ(single.orientation(), orientations[i]);
+        EXPECT_EQ(single.attitudeUncertainty(), uncertainties[i]);
+    }
+
+    // The uncertainty alone, without the orientations
+    KalmanFilter only;
+    only.setSampleRate(0.01f);
+    EXPECT_EQ(4u, only.update(&packed[0], 40, 0, uncertainties, 10));
+    EXPECT_EQ(burst.attitudeUncertainty(), uncertainties[3]);
+}
+
+TEST(KalmanFilterTest, TracksTumble)
+{
+    const float dt = 0.005f;
+    SensorNoise noise;
+    noise.gyro = 0.01f;
+    noise.accel = 0.01f;
+    noise.mag = 0.01f;
+    std::vector<SimSample> samples;
+    simulateTumble(12000, dt, noise, 7, samples);
+
+    KalmanFilter filter;
+    filter.setSampleRate(dt);
+    const SimSample &first = samples[0];
+    filter.align(first.accel[0], first.accel[1], first.accel[2],
+                 first.mag[0], first.mag[1], first.mag[2]);
+    double worst = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        if (i > 200)
+        {
+            worst = std::max(worst, angleBetween(filter.orientation(), s.truth));
+        }
+    }
+    EXPECT_LT(worst, 0.1);
+}
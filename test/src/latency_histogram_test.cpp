@@ -0,0 +1,152 @@
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "imu_filter.h"
+#include "latency_histogram.h"
+
+TEST(LatencyHistogramTest, Empty)
+{
+    const LatencyHistogram histogram;
+    EXPECT_EQ(0u, histogram.count());
+    EXPECT_EQ(0u, histogram.minimum());
+    EXPECT_EQ(0u, histogram.maximum());
+    EXPECT_EQ(0u, histogram.percentile(50.0f));
+}
+
+TEST(LatencyHistogramTest, Buckets)
+{
+    // Every value lies within the bounds of its bucket and buckets are
+    // contiguous
+    const uint32_t values[] = { 0, 1, 15, 16, 17, 31, 32, 33, 1000, 123456, 0x7fffffff, 0xffffffff };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+    {
+        const size_t bucket = LatencyHistogram::bucketOf(values[i]);
+        ASSERT_LT(bucket, LatencyHistogram::bucketCount);
+        EXPECT_LE(LatencyHistogram::bucketLowest(bucket), values[i]);
+        EXPECT_GE(LatencyHistogram::bucketHighest(bucket), values[i]);
+    }
+    for (size_t b = 1; b < LatencyHistogram::bucketCount; ++b)
+    {
+        EXPECT_EQ(LatencyHistogram::bucketHighest(b - 1) + 1, LatencyHistogram::bucketLowest(b));
+    }
+    EXPECT_EQ(0xffffffffu, LatencyHistogram::bucketHighest(LatencyHistogram::bucketCount - 1));
+}
+
+TEST(LatencyHistogramTest, Percentiles)
+{
+    LatencyHistogram histogram;
+    for (uint32_t v = 1; v <= 10000; ++v)
+    {
+        histogram.record(v);
+    }
+    EXPECT_EQ(10000u, histogram.count());
+    EXPECT_EQ(1u, histogram.minimum());
+    EXPECT_EQ(10000u, histogram.maximum());
+    EXPECT_EQ(5000u, histogram.mean());
+    EXPECT_NEAR(5000.0, histogram.percentile(50.0f), 5000.0 * 0.0625);
+    EXPECT_NEAR(9900.0, histogram.percentile(99.0f), 9900.0 * 0.0625);
+    EXPECT_EQ(10000u, histogram.percentile(100.0f));
+}
+
+TEST(LatencyHistogramTest, SumCarriesPast32Bits)
+{
+    LatencyHistogram histogram;
+    for (int i = 0; i < 4; ++i)
+    {
+        histogram.record(0xfffffff0u);
+    }
+    EXPECT_EQ(0xfffffff0u, histogram.mean());
+
+    LatencyHistogram merged;
+    merged.add(histogram);
+    merged.add(histogram);
+    EXPECT_EQ(8u, merged.count());
+    EXPECT_EQ(0xfffffff0u, merged.mean());
+}
+
+TEST(LatencyHistogramTest, MergeAcrossThreads)
+{
+    const int threads = 4;
+    const uint32_t per_thread = 10000;
+    LatencyHistogram shared;
+    std::vector<LatencyHistogram> own(threads);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+    {
+        pool.push_back(std::thread([&, t]()
+        {
+            for (uint32_t v = 0; v < per_thread; ++v)
+            {
+                shared.record(v + t);
+                own[t].record(v + t);
+            }
+        }));
+    }
+    for (int t = 0; t < threads; ++t)
+    {
+        pool[t].join();
+    }
+
+    LatencyHistogram merged;
+    for (int t = 0; t < threads; ++t)
+    {
+        merged.add(own[t]);
+    }
+    EXPECT_EQ(threads * per_thread, shared.count());
+    EXPECT_EQ(shared.count(), merged.count());
+    EXPECT_EQ(shared.minimum(), merged.minimum());
+    EXPECT_EQ(shared.maximum(), merged.maximum());
+    for (size_t b = 0; b < LatencyHistogram::bucketCount; ++b)
+    {
+        EXPECT_EQ(shared.bucketCountAt(b), merged.bucketCountAt(b));
+    }
+}
+
+TEST(LatencyHistogramTest, Print)
+{
+    LatencyHistogram histogram;
+    histogram.record(100);
+    histogram.record(200);
+
+    char text[256];
+    const size_t text_length = histogram.printText(text, sizeof(text));
+    EXPECT_EQ(std::strlen(text), text_length);
+    EXPECT_NE(static_cast<const char *>(0), std::strstr(text, "count=2"));
+
+    char json[512];
+    const size_t length = histogram.printJson(json, sizeof(json));
+    EXPECT_EQ(std::strlen(json), length);
+    EXPECT_EQ('{', json[0]);
+    EXPECT_NE(static_cast<const char *>(0), std::strstr(json, "\"max\":200"));
+
+    // A short buffer is truncated but still reports the full length
+    char small[8];
+    EXPECT_EQ(length, histogram.printJson(small, sizeof(small)));
+    EXPECT_EQ(sizeof(small) - 1, std::strlen(small));
+}
+
+#ifdef FUSION_LATENCY
+TEST(LatencyHistogramTest, FilterRecords)
+{
+    LatencyHistogram updates;
+    LatencyHistogram latencies;
+    IMUFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.setLatencyHistograms(&updates, &latencies);
+    for (int i = 0; i < 10; ++i)
+    {
+        if (i % 2)
+        {
+            filter.markArrival();
+        }
+        filter.update(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    EXPECT_EQ(10u, updates.count());
+    EXPECT_EQ(5u, latencies.count());
+
+    filter.setLatencyHistograms(0, 0);
+    filter.update(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    EXPECT_EQ(10u, updates.count());
+}
+#endif
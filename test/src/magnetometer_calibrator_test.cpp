@@ -0,0 +1,294 @@
+#include <stdint.h>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "magnetometer_calibrator.h"
+#include "sensor_calibration.h"
+
+namespace
+{
+
+// Generates the readings of a distorted magnetometer turned through random
+// directions, m = D h + o for a field h of the given strength
+class DistortedField
+{
+public:
+    DistortedField(const float strength, const float noise) :
+        strength(strength),
+        noise(noise),
+        random(12345)
+    {
+        const float d[3][3] = { { 1.2f, 0.1f, 0.0f },
+                                { 0.1f, 0.9f, 0.05f },
+                                { 0.0f, 0.05f, 1.05f } };
+        setDistortion(d, 120.0f, -60.0f, 40.0f);
+    }
+
+    void setDistortion(const float d[3][3], const float ox, const float oy,
+                       const float oz)
+    {
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                distortion[r][c] = d[r][c];
+            }
+        }
+        offset[0] = ox;
+        offset[1] = oy;
+        offset[2] = oz;
+    }
+
+    // A reading in a random direction, or only about Z when flat is set
+    void read(float m[3], const bool flat = false)
+    {
+        const float z = flat ? 0.3f : 2.0f * uniform() - 1.0f;
+        const float phi = 6.2831853f * uniform();
+        const float s = std::sqrt(1.0f - z * z);
+        const float h[3] = { strength * s * std::cos(phi),
+                             strength * s * std::sin(phi),
+                             strength * z };
+        for (int r = 0; r < 3; ++r)
+        {
+            m[r] = offset[r] + noise * (2.0f * uniform() - 1.0f);
+            for (int c = 0; c < 3; ++c)
+            {
+                m[r] += distortion[r][c] * h[c];
+            }
+        }
+    }
+
+    float distortion[3][3];
+    float offset[3];
+
+private:
+    float uniform()
+    {
+        random = random * 1664525u + 1013904223u;
+        return (random >> 8) / 16777216.0f;
+    }
+
+    float strength;
+    float noise;
+    uint32_t random;
+};
+
+// Length of a reading once corrected
+float corrected(const MagnetometerCalibrator &calibrator, const float m[3])
+{
+    SensorCalibration calibration;
+    calibrator.calibration(calibration);
+    float x = m[0], y = m[1], z = m[2];
+    calibration.apply(SensorCalibration::SENSOR_MAG, x, y, z);
+    return std::sqrt(x * x + y * y + z * z);
+}
+
+} // namespace
+
+TEST(MagnetometerCalibratorTest, Default)
+{
+    MagnetometerCalibrator calibrator;
+    EXPECT_FALSE(calibrator.valid());
+    EXPECT_FALSE(calibrator.fit());
+    SensorCalibration calibration;
+    EXPECT_FALSE(calibrator.calibration(calibration));
+    float x, y, z;
+    calibrator.offset(x, y, z);
+    EXPECT_EQ(0.0f, x);
+    EXPECT_EQ(0.0f, calibrator.fieldStrength());
+}
+
+TEST(MagnetometerCalibratorTest, RecoversHardAndSoftIron)
+{
+    DistortedField field(400.0f, 1.0f);
+    MagnetometerCalibrator calibrator;
+    for (int i = 0; i < 1000; ++i)
+    {
+        float m[3];
+        field.read(m);
+        calibrator.add(m[0], m[1], m[2]);
+    }
+    ASSERT_TRUE(calibrator.valid());
+
+    float x, y, z;
+    calibrator.offset(x, y, z);
+    EXPECT_NEAR(120.0f, x, 2.0f);
+    EXPECT_NEAR(-60.0f, y, 2.0f);
+    EXPECT_NEAR(40.0f, z, 2.0f);
+    EXPECT_LT(calibrator.residual(), 0.005f);
+
+    // The correction undoes the distortion up to a scale
+    float m[3][3];
+    calibrator.softIron(m);
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            float product = 0.0f;
+            for (int k = 0; k < 3; ++k)
+            {
+                product += m[r][k] * field.distortion[k][c];
+            }
+            if (r == c)
+            {
+                EXPECT_NEAR(calibrator.fieldStrength() / 400.0f, product, 0.01f);
+            }
+            else
+            {
+                EXPECT_NEAR(0.0f, product, 0.01f);
+            }
+        }
+    }
+
+    // Corrected readings lie on a sphere of the fitted strength
+    for (int i = 0; i < 100; ++i)
+    {
+        float reading[3];
+        field.read(reading);
+        EXPECT_NEAR(calibrator.fieldStrength(), corrected(calibrator, reading),
+                    0.01f * calibrator.fieldStrength());
+    }
+}
+
+TEST(MagnetometerCalibratorTest, RecoversOffsetLargerThanField)
+{
+    // Hard iron offsets of two and five times the field, which put the
+    // origin well outside the ellipsoid
+    const float scales[] = { 2.0f, 5.0f };
+    for (int s = 0; s < 2; ++s)
+    {
+        DistortedField field(400.0f, 1.0f);
+        const float d[3][3] = { { 1.1f, 0.05f, 0.0f },
+                                { 0.05f, 0.95f, 0.0f },
+                                { 0.0f, 0.0f, 1.0f } };
+        const float ox = 0.6f * scales[s] * 400.0f;
+        const float oy = -0.48f * scales[s] * 400.0f;
+        const float oz = 0.64f * scales[s] * 400.0f;
+        field.setDistortion(d, ox, oy, oz);
+        MagnetometerCalibrator calibrator;
+        for (int i = 0; i < 1000; ++i)
+        {
+            float m[3];
+            field.read(m);
+            calibrator.add(m[0], m[1], m[2]);
+        }
+        ASSERT_TRUE(calibrator.valid());
+
+        float x, y, z;
+        calibrator.offset(x, y, z);
+        EXPECT_NEAR(ox, x, 2.0f);
+        EXPECT_NEAR(oy, y, 2.0f);
+        EXPECT_NEAR(oz, z, 2.0f);
+        EXPECT_LT(calibrator.residual(), 0.005f);
+        for (int i = 0; i < 100; ++i)
+        {
+            float reading[3];
+            field.read(reading);
+            EXPECT_NEAR(calibrator.fieldStrength(), corrected(calibrator, reading),
+                        0.01f * calibrator.fieldStrength());
+        }
+    }
+}
+
+TEST(MagnetometerCalibratorTest, ResidualFollowsNoise)
+{
+    DistortedField quiet(400.0f, 0.5f);
+    DistortedField noisy(400.0f, 20.0f);
+    MagnetometerCalibrator a;
+    MagnetometerCalibrator b;
+    for (int i = 0; i < 1000; ++i)
+    {
+        float m[3];
+        quiet.read(m);
+        a.add(m[0], m[1], m[2]);
+        noisy.read(m);
+        b.add(m[0], m[1], m[2]);
+    }
+    ASSERT_TRUE(a.valid());
+    ASSERT_TRUE(b.valid());
+    EXPECT_LT(a.residual(), 0.002f);
+    EXPECT_GT(b.residual(), 0.01f);
+    EXPECT_LT(b.residual(), 0.05f);
+}
+
+TEST(MagnetometerCalibratorTest, RejectsSingleAxisRotation)
+{
+    DistortedField field(400.0f, 1.0f);
+    MagnetometerCalibrator calibrator;
+    calibrator.setFitInterval(0);
+    for (int i = 0; i < 1000; ++i)
+    {
+        float m[3];
+        field.read(m, true);
+        calibrator.add(m[0], m[1], m[2]);
+    }
+    EXPECT_FALSE(calibrator.fit());
+    EXPECT_FALSE(calibrator.valid());
+}
+
+TEST(MagnetometerCalibratorTest, FitsOnlyWhenAsked)
+{
+    DistortedField field(400.0f, 1.0f);
+    MagnetometerCalibrator calibrator;
+    calibrator.setFitInterval(0);
+    for (int i = 0; i < 500; ++i)
+    {
+        float m[3];
+        field.read(m);
+        calibrator.add(m[0], m[1], m[2]);
+    }
+    EXPECT_FALSE(calibrator.valid());
+    EXPECT_TRUE(calibrator.fit());
+    EXPECT_TRUE(calibrator.valid());
+
+    calibrator.reset();
+    EXPECT_FALSE(calibrator.valid());
+}
+
+TEST(MagnetometerCalibratorTest, FollowsChangingDistortion)
+{
+    DistortedField field(400.0f, 1.0f);
+    MagnetometerCalibrator calibrator;
+    calibrator.setWindow(500.0f);
+    float m[3];
+    for (int i = 0; i < 1000; ++i)
+    {
+        field.read(m);
+        calibrator.add(m[0], m[1], m[2]);
+    }
+
+    // The device is moved next to something magnetic
+    const float d[3][3] = { { 1.0f, 0.0f, 0.0f },
+                            { 0.0f, 1.1f, 0.0f },
+                            { 0.0f, 0.0f, 0.95f } };
+    field.setDistortion(d, -80.0f, 30.0f, 150.0f);
+    for (int i = 0; i < 5000; ++i)
+    {
+        field.read(m);
+        calibrator.add(m[0], m[1], m[2]);
+    }
+    float x, y, z;
+    calibrator.offset(x, y, z);
+    EXPECT_NEAR(-80.0f, x, 2.0f);
+    EXPECT_NEAR(30.0f, y, 2.0f);
+    EXPECT_NEAR(150.0f, z, 2.0f);
+    EXPECT_LT(calibrator.residual(), 0.005f);
+}
+
+TEST(MagnetometerCalibratorTest, CalibrationLeavesOtherSensors)
+{
+    DistortedField field(400.0f, 1.0f);
+    MagnetometerCalibrator calibrator;
+    for (int i = 0; i < 200; ++i)
+    {
+        float m[3];
+        field.read(m);
+        calibrator.add(m[0], m[1], m[2]);
+    }
+    SensorCalibration calibration;
+    calibration.setBias(SensorCalibration::SENSOR_GYRO, 1.0f, 2.0f, 3.0f);
+    ASSERT_TRUE(calibrator.calibration(calibration));
+    float x = 1.0f, y = 2.0f, z = 3.0f;
+    calibration.apply(SensorCalibration::SENSOR_GYRO, x, y, z);
+    EXPECT_EQ(0.0f, x);
+    EXPECT_EQ(0.0f, z);
+}
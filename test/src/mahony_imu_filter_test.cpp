@@ -0,0 +1,85 @@
+#include <cmath>
+#include "gtest/gtest.h"
+#include "filter_test.h"
+#include "mahony_imu_filter.h"
+#include "quaternion.h"
+#include "../sim/trajectory.h"
+
+TEST(MahonyIMUFilterTest, Default)
+{
+    const MahonyIMUFilter filter;
+    EXPECT_EQ(Quaternion(), filter.orientation());
+    float bx, by, bz;
+    filter.gyroBias(bx, by, bz);
+    EXPECT_EQ(0.0f, bx);
+    EXPECT_EQ(0.0f, by);
+    EXPECT_EQ(0.0f, bz);
+}
+
+TEST(MahonyIMUFilterTest, Align)
+{
+    const Quaternion truth = Quaternion(0.9f, 0.3f, 0.1f, 0.0f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+
+    MahonyIMUFilter filter;
+    filter.align(a.x, a.y, a.z);
+    EXPECT_LT(tiltError(filter.orientation(), truth), 1.0e-4);
+}
+
+TEST(MahonyIMUFilterTest, ConvergesFromIdentity)
+{
+    const Quaternion truth = Quaternion(0.9f, 0.3f, 0.1f, 0.0f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+
+    MahonyIMUFilter filter;
+    filter.setSampleRate(0.01f);
+    for (int i = 0; i < 6000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z);
+    }
+    EXPECT_LT(tiltError(filter.orientation(), truth), 0.001);
+}
+
+TEST(MahonyIMUFilterTest, EstimatesGyroscopeBias)
+{
+    // Level, so the bias about X and Y is observed but not the one about Z
+    MahonyIMUFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.setIntegralGain(0.2f);
+    for (int i = 0; i < 6000; ++i)
+    {
+        filter.update(0.02f, -0.03f, 0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    float bx, by, bz;
+    filter.gyroBias(bx, by, bz);
+    EXPECT_NEAR(0.02f, bx, 1.0e-4f);
+    EXPECT_NEAR(-0.03f, by, 1.0e-4f);
+    EXPECT_LT(tiltError(filter.orientation(), Quaternion()), 0.001);
+}
+
+TEST(MahonyIMUFilterTest, BatchMatchesUpdate)
+{
+    float samples[100][6];
+    for (int i = 0; i < 100; ++i)
+    {
+        samples[i][0] = 0.3f * std::sin(0.1f * i);
+        samples[i][1] = 0.2f;
+        samples[i][2] = -0.1f;
+        samples[i][3] = 0.1f;
+        samples[i][4] = 0.05f * std::cos(0.2f * i);
+        samples[i][5] = 0.98f;
+    }
+    MahonyIMUFilter single;
+    MahonyIMUFilter batch;
+    single.setSampleRate(0.01f);
+    batch.setSampleRate(0.01f);
+    for (int i = 0; i < 100; ++i)
+    {
+        single.update(samples[i][0], samples[i][1], samples[i][2],
+                      samples[i][3], samples[i][4], samples[i][5]);
+    }
+    Quaternion orientations[10];
+    EXPECT_EQ(10u, batch.update(&samples[0][0], 100, orientations, 10));
+    EXPECT_EQ(single.orientation(), batch.orientation());
+    EXPECT_EQ(single.orientation(), orientations[9]);
+}
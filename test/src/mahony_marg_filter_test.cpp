@@ -0,0 +1,128 @@
+#include <cmath>
+#include <vector>
+#include "gtest/gtest.h"
+#include "filter_test.h"
+#include "mahony_imu_filter.h"
+#include "mahony_marg_filter.h"
+#include "quaternion.h"
+#include "../sim/trajectory.h"
+
+TEST(MahonyMARGFilterTest, Default)
+{
+    const MahonyMARGFilter filter;
+    EXPECT_EQ(Quaternion(), filter.orientation());
+}
+
+TEST(MahonyMARGFilterTest, AlignedStaysStill)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    MahonyMARGFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(MahonyMARGFilterTest, EstimatesGyroscopeBias)
+{
+    // The magnetometer makes the bias about the vertical observable too
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    MahonyMARGFilter filter;
+    filter.setSampleRate(0.01f);
+    filter.setIntegralGain(0.2f);
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    for (int i = 0; i < 6000; ++i)
+    {
+        filter.update(0.02f, -0.03f, 0.01f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    float bx, by, bz;
+    filter.gyroBias(bx, by, bz);
+    EXPECT_NEAR(0.02f, bx, 1.0e-4f);
+    EXPECT_NEAR(-0.03f, by, 1.0e-4f);
+    EXPECT_NEAR(0.01f, bz, 1.0e-4f);
+    EXPECT_LT(angleBetween(filter.orientation(), truth), 0.001);
+}
+
+TEST(MahonyMARGFilterTest, ZeroHeadingWeightIgnoresMagnetometer)
+{
+    std::vector<SimSample> samples;
+    simulateTumble(200, 0.01f, SensorNoise(), 4, samples);
+    MahonyMARGFilter marg;
+    MahonyIMUFilter imu;
+    marg.setSampleRate(0.01f);
+    imu.setSampleRate(0.01f);
+    marg.setHeadingWeight(0.0f);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        marg.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                    s.accel[0], s.accel[1], s.accel[2],
+                    s.mag[0], s.mag[1], s.mag[2]);
+        imu.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                   s.accel[0], s.accel[1], s.accel[2]);
+    }
+    EXPECT_EQ(imu.orientation(), marg.orientation());
+}
+
+TEST(MahonyMARGFilterTest, BatchMatchesUpdate)
+{
+    std::vector<SimSample> samples;
+    simulateTumble(200, 0.01f, SensorNoise(), 3, samples);
+    std::vector<float> interleaved;
+    MahonyMARGFilter single;
+    single.setSampleRate(0.01f);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        single.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        interleaved.insert(interleaved.end(), s.gyro, s.gyro + 3);
+        interleaved.insert(interleaved.end(), s.accel, s.accel + 3);
+        interleaved.insert(interleaved.end(), s.mag, s.mag + 3);
+    }
+    MahonyMARGFilter batch;
+    batch.setSampleRate(0.01f);
+    EXPECT_EQ(0u, batch.update(&interleaved[0], samples.size(), 0, 0));
+    EXPECT_EQ(single.orientation(), batch.orientation());
+}
+
+TEST(MahonyMARGFilterTest, TracksTumble)
+{
+    const float dt = 0.005f;
+    SensorNoise noise;
+    noise.gyro = 0.01f;
+    noise.accel = 0.01f;
+    noise.mag = 0.01f;
+    std::vector<SimSample> samples;
+    simulateTumble(12000, dt, noise, 7, samples);
+
+    MahonyMARGFilter filter;
+    filter.setSampleRate(dt);
+    const SimSample &first = samples[0];
+    filter.align(first.accel[0], first.accel[1], first.accel[2],
+                 first.mag[0], first.mag[1], first.mag[2]);
+    double worst = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const SimSample &s = samples[i];
+        filter.update(s.gyro[0], s.gyro[1], s.gyro[2],
+                      s.accel[0], s.accel[1], s.accel[2],
+                      s.mag[0], s.mag[1], s.mag[2]);
+        if (i > 200)
+        {
+            worst = std::max(worst, angleBetween(filter.orientation(), s.truth));
+        }
+    }
+    EXPECT_LT(worst, 0.1);
+}
@@ -0,0 +1,295 @@
+#include <cmath>
+#include <cstring>
+#include "gtest/gtest.h"
+#include "filter_test.h"
+#include "marg_filter.h"
+#include "sensor_calibration.h"
+#include "sensor_format.h"
+#include "quaternion.h"
+
+TEST(MARGFilterTest, Default)
+{
+    const MARGFilter filter;
+    EXPECT_EQ(Quaternion(), filter.orientation());
+}
+
+TEST(MARGFilterTest, Align)
+{
+    // Earth field pointing north and down, sensor in an arbitrary attitude
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion Eg(0.0f, 0.0f, 0.0f, 1.0f);
+    const Quaternion Eb = Quaternion(0.0f, 0.5f, 0.0f, -0.8f).normalized();
+    const Quaternion a = toSensor(truth, Eg);
+    const Quaternion m = toSensor(truth, Eb);
+
+    MARGFilter filter;
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(MARGFilterTest, AlignedStaysStill)
+{
+    const Quaternion truth = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    const Quaternion a = toSensor(truth, Quaternion(0.0f, 0.0f, 0.0f, 1.0f));
+    const Quaternion m = toSensor(truth, Quaternion(0.0f, 0.5f, 0.0f, -0.8f));
+
+    MARGFilter filter;
+    filter.setGyroErrorGain(0.1f);
+    filter.setGyroDriftGain(0.01f);
+    filter.setSampleRate(0.01f);
+    filter.align(a.x, a.y, a.z, m.x, m.y, m.z);
+    for (int i = 0; i < 1000; ++i)
+    {
+        filter.update(0.0f, 0.0f, 0.0f, a.x, a.y, a.z, m.x, m.y, m.z);
+    }
+    EXPECT_GT(std::fabs(truth.dot(filter.orientation())), 0.99999f);
+}
+
+TEST(MARGFilterTest, StageNames)
+{
+    EXPECT_STREQ("gravity objective", MARGFilter::stageName(MARGFilter::STAGE_GRAVITY_OBJECTIVE));
+    EXPECT_STREQ("flux", MARGFilter::stageName(MARGFilter::STAGE_FLUX));
+    EXPECT_STREQ("unknown", MARGFilter::stageName(MARGFilter::STAGE_COUNT));
+}
+
+#ifdef FUSION_PROFILE
+TEST(MARGFilterTest, StageProfile)
+{
+    MARGFilter filter;
+    filter.setSampleRate(0.01f);
+    for (int i = 0; i < 100; ++i)
+    {
+        filter.update(0.1f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.5f, 0.0f, -0.8f);
+    }
+    EXPECT_EQ(100u, filter.stageProfile().updates());
+
+    char text[1024];
+    const size_t length = filter.dumpStageProfile(text, sizeof(text));
+    EXPECT_EQ(length, strlen(text));
+    EXPECT_NE(static_cast<const char *>(0), strstr(text, "integration"));
+
+    filter.resetStageProfile();
+    EXPECT_EQ(0u, filter.stageProfile().updates());
+}
+#endif
+
+TEST(MARGFilterTest, BurstMatchesUpdate)
+{
+    float samples[64][9];
+    for (int i = 0; i < 64; ++i)
+    {
+        samples[i][0] = 0.3f * std::sin(0.1f * i);
+        samples[i][1] = 0.2f;
+        samples[i][2] = -0.1f;
+        samples[i][3] = 0.1f;
+        samples[i][4] = 0.05f * std::cos(0.2f * i);
+        samples[i][5] = 0.98f;
+        samples[i][6] = 0.5f;
+        samples[i][7] = 0.1f * std::sin(0.3f * i);
+        samples[i][8] = -0.8f;
+    }
+    MARGFilter single;
+    MARGFilter burst;
+    single.setSampleRate(0.01f);
+    burst.setSampleRate(0.01f);
+    Quaternion expected[8];
+    for (int i = 0; i < 64; ++i)
+    {
+        single.update(samples[i][0], samples[i][1], samples[i][2],
+                      samples[i][3], samples[i][4], samples[i][5],
+                      samples[i][6], samples[i][7], samples[i][8]);
+        if (7 == i % 8)
+        {
+            expected[i / 8] = single.orientation();
+        }
+    }
+    Quaternion orientations[8];
+    EXPECT_EQ(8u, burst.update(&samples[0][0], 64, orientations, 8));
+    for (int i = 0; i < 8; ++i)
+    {
+        EXPECT_EQ(expected[i], orientations[i]);
+    }
+    EXPECT_EQ(single.orientation(), burst.orientation());
+}
+
+TEST(MARGFilterTest, RawBurstMatchesScaled)
+{
+    const float scale = 0.001f;
+    int16_t raw[32][9];
+    float scaled[32][9];
+    for (int i = 0; i < 32; ++i)
+    {
+        raw[i][0] = static_cast<int16_t>(300 * i - 4000);
+        raw[i][1] = 250;
+        raw[i][2] = -120;
+        raw[i][3] = 1600;
+        raw[i][4] = static_cast<int16_t>(-40 * i);
+        raw[i][5] = 16000;
+        raw[i][6] = 2400;
+        raw[i][7] = static_cast<int16_t>(15 * i);
+        raw[i][8] = -3800;
+        for (int j = 0; j < 9; ++j)
+        {
+            scaled[i][j] = (j < 3) ? scale * raw[i][j] : raw[i][j];
+        }
+    }
+    MARGFilter integer;
+    MARGFilter floating;
+    integer.setSampleRate(0.01f);
+    floating.setSampleRate(0.01f);
+    Quaternion orientations[32];
+    EXPECT_EQ(32u, integer.update(&raw[0][0], 32, scale, orientations, 1));
+    EXPECT_EQ(0u, floating.update(&scaled[0][0], 32, 0, 0));
+    EXPECT_EQ(floating.orientation(), integer.orientation());
+    EXPECT_EQ(floating.orientation(), orientations[31]);
+}
+
+TEST(MARGFilterTest, FormatBurstMatchesConverted)
+{
+    // Packed records with every axis scaled and biased, and the
+    // magnetometer axes swapped as on many combined devices
+    SensorFormat format;
+    for (int i = 0; i < SensorFormat::AXIS_COUNT; ++i)
+    {
+        format.setAxis(static_cast<SensorFormat::Axis>(i), static_cast<uint8_t>(i),
+                       (i < 3) ? 0.001f : 0.5f, static_cast<float>(i) - 4.0f);
+    }
+    format.setAxis(SensorFormat::MAG_X, 7, 0.5f, 6.0f);
+    format.setAxis(SensorFormat::MAG_Y, 6, -0.5f, -2.0f);
+
+    int16_t raw[32][9];
+    float converted[32][9];
+    for (int i = 0; i < 32; ++i)
+    {
+        raw[i][0] = static_cast<int16_t>(300 * i - 4000);
+        raw[i][1] = 250;
+        raw[i][2] = -120;
+        raw[i][3] = 1600;
+        raw[i][4] = static_cast<int16_t>(-40 * i);
+        raw[i][5] = 16000;
+        raw[i][6] = static_cast<int16_t>(15 * i);
+        raw[i][7] = 2400;
+        raw[i][8] = -3800;
+        for (int j = 0; j < 9; ++j)
+        {
+            converted[i][j] = format.value(raw[i], static_cast<SensorFormat::Axis>(j));
+        }
+    }
+    MARGFilter integer;
+    MARGFilter floating;
+    integer.setSampleRate(0.01f);
+    floating.setSampleRate(0.01f);
+    EXPECT_EQ(0u, integer.update(&raw[0][0], 32, format, 0, 0));
+    EXPECT_EQ(0u, floating.update(&converted[0][0], 32, 0, 0));
+    EXPECT_EQ(floating.orientation(), integer.orientation());
+}
+
+TEST(MARGFilterTest, CalibratedBurstMatchesCalibrated)
+{
+    SensorCalibration calibration;
+    calibration.setBias(SensorCalibration::SENSOR_GYRO, 0.01f, -0.02f, 0.005f);
+    calibration.setScale(SensorCalibration::SENSOR_ACCEL, 1.02f, 0.99f, 1.01f);
+    const float m[3][3] = { { 1.2f, 0.1f, 0.0f },
+                            { 0.1f, 0.8f, 0.05f },
+                            { 0.0f, 0.05f, 1.1f } };
+    calibration.setMatrix(SensorCalibration::SENSOR_MAG, m);
+    calibration.setBias(SensorCalibration::SENSOR_MAG, 0.3f, -0.1f, 0.2f);
+
+    float samples[32][9];
+    for (int i = 0; i < 32; ++i)
+    {
+        samples[i][0] = 0.3f * std::sin(0.1f * i);
+        samples[i][1] = 0.2f;
+        samples[i][2] = -0.1f;
+        samples[i][3] = 0.1f;
+        samples[i][4] = 0.05f * std::cos(0.2f * i);
+        samples[i][5] = 0.98f;
+        samples[i][6] = 0.5f;
+        samples[i][7] = 0.1f * std::sin(0.3f * i);
+        samples[i][8] = -0.8f;
+    }
+    MARGFilter fused;
+    MARGFilter separate;
+    fused.setSampleRate(0.01f);
+    separate.setSampleRate(0.01f);
+    EXPECT_EQ(0u, fused.update(&samples[0][0], 32, calibration, 0, 0));
+    calibration.apply(&samples[0][0], 32, 9, 3);
+    EXPECT_EQ(0u, separate.update(&samples[0][0], 32, 0, 0));
+    EXPECT_EQ(separate.orientation(), fused.orientation());
+}
+
+TEST(MARGFilterTest, RecordMatchesUpdate)
+{
+    SensorFormat format;
+    format.setStride(9);
+    for (int i = 0; i < 9; ++i)
+    {
+        format.setAxis(static_cast<SensorFormat::Axis>(i), static_cast<uint8_t>(i),
+                       (i < 3) ? 0.001f : 0.5f, 3.0f);
+    }
+    const int16_t record[9] = { -400, 250, 1200, 40, -300, 2000, 700, -90, -1500 };
+    MARGFilter raw;
+    MARGFilter converted;
+    raw.setSampleRate(0.01f);
+    converted.setSampleRate(0.01f);
+    raw.update(record, format);
+    converted.update(format.value(record, SensorFormat::GYRO_X),
+                     format.value(record, SensorFormat::GYRO_Y),
+                     format.value(record, SensorFormat::GYRO_Z),
+                     format.value(record, SensorFormat::ACCEL_X),
+                     format.value(record, SensorFormat::ACCEL_Y),
+                     format.value(record, SensorFormat::ACCEL_Z),
+                     format.value(record, SensorFormat::MAG_X),
+                     format.value(record, SensorFormat::MAG_Y),
+                     format.value(record, SensorFormat::MAG_Z));
+    EXPECT_EQ(converted.orientation(), raw.orientation());
+}
+
+TEST(MARGFilterTest, FormatCalibratedBurstMatchesCalibrated)
+{
+    SensorFormat format;
+    format.setStride(10);
+    for (int i = 0; i < 9; ++i)
+    {
+        format.setAxis(static_cast<SensorFormat::Axis>(i), static_cast<uint8_t>(i + 1),
+                       (i < 3) ? 0.001f : 0.0005f, -2.0f);
+    }
+    SensorCalibration calibration;
+    const float soft_iron[3][3] = { { 1.1f, 0.05f, 0.0f },
+                                    { 0.05f, 0.9f, 0.02f },
+                                    { 0.0f, 0.02f, 1.05f } };
+    calibration.setBias(SensorCalibration::SENSOR_GYRO, 0.01f, -0.02f, 0.005f);
+    calibration.setScale(SensorCalibration::SENSOR_ACCEL, 1.02f, 0.99f, 1.01f);
+    calibration.setMatrix(SensorCalibration::SENSOR_MAG, soft_iron);
+    calibration.setBias(SensorCalibration::SENSOR_MAG, 0.3f, -0.1f, 0.2f);
+
+    int16_t records[16][10];
+    float samples[16][9];
+    for (int i = 0; i < 16; ++i)
+    {
+        records[i][0] = static_cast<int16_t>(100 * i);
+        records[i][1] = static_cast<int16_t>(300 * std::sin(0.1f * i));
+        records[i][2] = 200;
+        records[i][3] = -100;
+        records[i][4] = 200;
+        records[i][5] = static_cast<int16_t>(100 * std::cos(0.2f * i));
+        records[i][6] = 1960;
+        records[i][7] = 1000;
+        records[i][8] = static_cast<int16_t>(200 * std::sin(0.3f * i));
+        records[i][9] = -1600;
+        for (int j = 0; j < 9; ++j)
+        {
+            samples[i][j] = format.value(records[i], static_cast<SensorFormat::Axis>(j));
+        }
+    }
+    MARGFilter fused;
+    MARGFilter separate;
+    fused.setSampleRate(0.01f);
+    separate.setSampleRate(0.01f);
+    Quaternion orientations[4];
+    EXPECT_EQ(4u, fused.update(&records[0][0], 16, format, calibration, orientations, 4));
+    calibration.apply(&samples[0][0], 16, 9, 3);
+    EXPECT_EQ(0u, separate.update(&samples[0][0], 16, 0, 0));
+    EXPECT_EQ(separate.orientation(), fused.orientation());
+    EXPECT_EQ(separate.orientation(), orientations[3]);
+}
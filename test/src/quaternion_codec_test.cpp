@@ -0,0 +1,134 @@
+#include <cmath>
+#include "gtest/gtest.h"
+#include "quaternion.h"
+#include "quaternion_codec.h"
+
+namespace
+{
+
+// Angle of the rotation taking q1 to q2 in degrees
+double angleBetween(const Quaternion &q1, const Quaternion &q2)
+{
+    const Quaternion d = q1.conjugate() * q2;
+    const double v = std::sqrt((double)d.x * d.x + (double)d.y * d.y + (double)d.z * d.z);
+    return 2.0 * std::atan2(v, std::fabs((double)d.w)) * 180.0 / M_PI;
+}
+
+// Deterministic spread of versors covering every largest component index
+Quaternion sample(const int i)
+{
+    Quaternion q(std::sin(0.37f * i), std::cos(1.91f * i),
+                 std::sin(2.63f * i + 1.0f), std::cos(0.71f * i + 2.0f));
+    return q.normalized();
+}
+
+} // namespace
+
+TEST(QuaternionCodecTest, Identity)
+{
+    const Quaternion q;
+    const Quaternion q32 = QuaternionCodec::decode32(QuaternionCodec::encode32(q));
+    const Quaternion q64 = QuaternionCodec::decode64(QuaternionCodec::encode64(q));
+    EXPECT_NEAR(1.0f, q32.w, 1.0e-5f);
+    EXPECT_NEAR(0.0f, q32.z, 1.0e-3f);
+    EXPECT_NEAR(1.0f, q64.w, 1.0e-6f);
+    EXPECT_NEAR(0.0f, q64.z, 1.0e-5f);
+}
+
+TEST(QuaternionCodecTest, RoundTrip32)
+{
+    for (int i = 0; i < 10000; ++i)
+    {
+        const Quaternion q = sample(i);
+        EXPECT_LT(angleBetween(q, QuaternionCodec::decode32(QuaternionCodec::encode32(q))), 0.25);
+    }
+}
+
+TEST(QuaternionCodecTest, RoundTrip48)
+{
+    for (int i = 0; i < 10000; ++i)
+    {
+        const Quaternion q = sample(i);
+        const uint64_t packed = QuaternionCodec::encode48(q);
+        EXPECT_EQ(0u, packed >> 48);
+        EXPECT_LT(angleBetween(q, QuaternionCodec::decode48(packed)), 0.008);
+    }
+}
+
+TEST(QuaternionCodecTest, RoundTrip64)
+{
+    for (int i = 0; i < 10000; ++i)
+    {
+        const Quaternion q = sample(i);
+        EXPECT_LT(angleBetween(q, QuaternionCodec::decode64(QuaternionCodec::encode64(q))), 0.0003);
+    }
+}
+
+TEST(QuaternionCodecTest, NegatedEncodesIdentically)
+{
+    const Quaternion q = sample(42);
+    EXPECT_EQ(QuaternionCodec::encode32(q), QuaternionCodec::encode32(-q));
+    EXPECT_EQ(QuaternionCodec::encode64(q), QuaternionCodec::encode64(-q));
+}
+
+TEST(QuaternionCodecTest, BulkMatchesSingle)
+{
+    const size_t count = 64;
+    Quaternion q[count];
+    for (size_t i = 0; i < count; ++i)
+    {
+        q[i] = sample(i);
+    }
+
+    uint32_t packed32[count];
+    uint8_t packed48[6 * count];
+    uint64_t packed64[count];
+    QuaternionCodec::encode32(q, packed32, count);
+    QuaternionCodec::encode48(q, packed48, count);
+    QuaternionCodec::encode64(q, packed64, count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        EXPECT_EQ(QuaternionCodec::encode32(q[i]), packed32[i]);
+        EXPECT_EQ(QuaternionCodec::encode64(q[i]), packed64[i]);
+        uint64_t value = 0;
+        for (int b = 5; b >= 0; --b)
+        {
+            value = (value << 8) | packed48[(6 * i) + b];
+        }
+        EXPECT_EQ(QuaternionCodec::encode48(q[i]), value);
+    }
+}
+
+TEST(QuaternionCodecTest, BulkDecodeIsContinuous)
+{
+    // Rotate about Z through the point where the largest component changes
+    const size_t count = 200;
+    Quaternion q[count];
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float half_angle = 0.02f * i;
+        q[i] = Quaternion(std::cos(half_angle), 0.0f, 0.0f, std::sin(half_angle));
+    }
+
+    uint64_t packed[count];
+    Quaternion decoded[count];
+    QuaternionCodec::encode64(q, packed, count);
+    QuaternionCodec::decode64(packed, decoded, count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        EXPECT_GT(decoded[i].dot(q[i]), 0.9999f);
+    }
+}
+
+TEST(QuaternionCodecTest, MakeContinuous)
+{
+    Quaternion q[3] = { Quaternion(0.8f, 0.6f, 0.0f, 0.0f),
+                        Quaternion(-0.8f, -0.6f, 0.0f, 0.0f),
+                        Quaternion(0.8f, 0.6f, 0.0f, 0.0f) };
+    QuaternionCodec::makeContinuous(q, 3);
+    EXPECT_EQ(0.8f, q[0].w);
+    EXPECT_EQ(0.8f, q[1].w);
+    EXPECT_EQ(0.8f, q[2].w);
+}
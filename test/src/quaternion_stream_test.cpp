@@ -0,0 +1,225 @@
+#include <cmath>
+#include <vector>
+#include "gtest/gtest.h"
+#include "quaternion.h"
+#include "quaternion_stream.h"
+
+namespace
+{
+
+// Angle of the rotation taking q1 to q2 in radians
+double angleBetween(const Quaternion &q1, const Quaternion &q2)
+{
+    const Quaternion d = q1.conjugate() * q2;
+    const double v = std::sqrt((double)d.x * d.x + (double)d.y * d.y + (double)d.z * d.z);
+    return 2.0 * std::atan2(v, std::fabs((double)d.w));
+}
+
+// Smoothly varying orientation like the output of a filter at 100 Hz
+std::vector<Quaternion> trajectory(const size_t count)
+{
+    std::vector<Quaternion> q(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float t = 0.01f * i;
+        const float roll = 0.8f * std::sin(0.7f * t);
+        const float pitch = 0.4f * std::sin(1.3f * t + 0.5f);
+        const float yaw = 0.9f * t;
+        const Quaternion qx(std::cos(roll / 2.0f), std::sin(roll / 2.0f), 0.0f, 0.0f);
+        const Quaternion qy(std::cos(pitch / 2.0f), 0.0f, std::sin(pitch / 2.0f), 0.0f);
+        const Quaternion qz(std::cos(yaw / 2.0f), 0.0f, 0.0f, std::sin(yaw / 2.0f));
+        q[i] = qz * qy * qx;
+    }
+    return q;
+}
+
+} // namespace
+
+TEST(QuaternionStreamTest, RoundTrip)
+{
+    const std::vector<Quaternion> q = trajectory(5000);
+    std::vector<uint8_t> buffer(q.size() * 16);
+    QuaternionStreamEncoder encoder(&buffer[0], buffer.size());
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        ASSERT_TRUE(encoder.append(q[i]));
+    }
+    encoder.flush();
+
+    // The residuals of a smooth trajectory should take only a few bits
+    EXPECT_LT(encoder.size(), q.size() * 4);
+
+    QuaternionStreamDecoder decoder(&buffer[0], encoder.size());
+    EXPECT_EQ(20u, decoder.blockCount());
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        Quaternion decoded;
+        ASSERT_TRUE(decoder.next(decoded));
+        EXPECT_LT(angleBetween(q[i], decoded), 1.0e-4);
+    }
+    Quaternion extra;
+    EXPECT_FALSE(decoder.next(extra));
+}
+
+TEST(QuaternionStreamTest, Resolution)
+{
+    const std::vector<Quaternion> q = trajectory(1000);
+    std::vector<uint8_t> buffer(q.size() * 16);
+    QuaternionStreamEncoder encoder(&buffer[0], buffer.size());
+    encoder.setResolution(1.0e-2f);
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        ASSERT_TRUE(encoder.append(q[i]));
+    }
+    encoder.flush();
+
+    QuaternionStreamDecoder decoder(&buffer[0], encoder.size());
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        Quaternion decoded;
+        ASSERT_TRUE(decoder.next(decoded));
+        EXPECT_LT(angleBetween(q[i], decoded), 1.0e-2);
+    }
+}
+
+TEST(QuaternionStreamTest, ResolutionLittleEndian)
+{
+    std::vector<uint8_t> buffer(64);
+    QuaternionStreamEncoder encoder(&buffer[0], buffer.size());
+    encoder.setResolution(0.5f);
+    ASSERT_TRUE(encoder.append(Quaternion()));
+    encoder.flush();
+
+    // 0.5 is 0x3f000000 as an IEEE 754 float
+    EXPECT_EQ(0x00, buffer[4]);
+    EXPECT_EQ(0x00, buffer[5]);
+    EXPECT_EQ(0x00, buffer[6]);
+    EXPECT_EQ(0x3f, buffer[7]);
+}
+
+TEST(QuaternionStreamTest, ResolutionChangeWaitsForNextBlock)
+{
+    const std::vector<Quaternion> q = trajectory(300);
+    std::vector<uint8_t> buffer(q.size() * 16);
+    QuaternionStreamEncoder encoder(&buffer[0], buffer.size());
+    encoder.setBlockLength(100);
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        if (50 == i)
+        {
+            encoder.setResolution(1.0e-2f);
+        }
+        ASSERT_TRUE(encoder.append(q[i]));
+    }
+    encoder.flush();
+
+    // The rest of the open block keeps the fine resolution, and the blocks
+    // after it use the coarse one
+    QuaternionStreamDecoder decoder(&buffer[0], encoder.size());
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        Quaternion decoded;
+        ASSERT_TRUE(decoder.next(decoded));
+        EXPECT_LT(angleBetween(q[i], decoded), (i < 100) ? 1.0e-4 : 1.0e-2) << "at " << i;
+    }
+}
+
+TEST(QuaternionStreamTest, TinyResolution)
+{
+    // Residuals at the finest resolution still fit, and a finer one is
+    // raised to it rather than overflowing
+    const std::vector<Quaternion> q = trajectory(200);
+    std::vector<uint8_t> buffer(q.size() * 32);
+    QuaternionStreamEncoder encoder(&buffer[0], buffer.size());
+    encoder.setResolution(1.0e-30f);
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        ASSERT_TRUE(encoder.append(q[i]));
+    }
+    encoder.flush();
+
+    QuaternionStreamDecoder decoder(&buffer[0], encoder.size());
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        Quaternion decoded;
+        ASSERT_TRUE(decoder.next(decoded));
+        EXPECT_LT(angleBetween(q[i], decoded), 1.0e-5);
+    }
+}
+
+TEST(QuaternionStreamTest, Seek)
+{
+    const std::vector<Quaternion> q = trajectory(3000);
+    std::vector<uint8_t> buffer(q.size() * 16);
+    QuaternionStreamEncoder encoder(&buffer[0], buffer.size());
+    encoder.setBlockLength(100);
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        ASSERT_TRUE(encoder.append(q[i]));
+    }
+    encoder.flush();
+
+    std::vector<Quaternion> sequential(q.size());
+    QuaternionStreamDecoder decoder(&buffer[0], encoder.size());
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        ASSERT_TRUE(decoder.next(sequential[i]));
+    }
+
+    const size_t targets[] = { 2999, 0, 1234, 100, 99 };
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); ++t)
+    {
+        ASSERT_TRUE(decoder.seek(targets[t]));
+        EXPECT_EQ(targets[t], decoder.position());
+        Quaternion decoded;
+        ASSERT_TRUE(decoder.next(decoded));
+        EXPECT_EQ(sequential[targets[t]], decoded);
+    }
+    EXPECT_FALSE(decoder.seek(q.size()));
+}
+
+TEST(QuaternionStreamTest, LargeJumps)
+{
+    // Alternate between opposite orientations to force escaped residuals
+    std::vector<uint8_t> buffer(1024);
+    QuaternionStreamEncoder encoder(&buffer[0], buffer.size());
+    const Quaternion a;
+    const Quaternion b(0.0f, 0.0f, 1.0f, 0.0f);
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(encoder.append((i % 2) ? b : a));
+    }
+    encoder.flush();
+
+    QuaternionStreamDecoder decoder(&buffer[0], encoder.size());
+    for (int i = 0; i < 10; ++i)
+    {
+        Quaternion decoded;
+        ASSERT_TRUE(decoder.next(decoded));
+        EXPECT_LT(angleBetween((i % 2) ? b : a, decoded), 1.0e-4);
+    }
+}
+
+TEST(QuaternionStreamTest, BufferFull)
+{
+    const std::vector<Quaternion> q = trajectory(1000);
+    uint8_t buffer[64];
+    QuaternionStreamEncoder encoder(buffer, sizeof(buffer));
+    size_t appended = 0;
+    while ((appended < q.size()) && encoder.append(q[appended]))
+    {
+        ++appended;
+    }
+    encoder.flush();
+    EXPECT_GT(appended, 1u);
+    EXPECT_LT(appended, q.size());
+    EXPECT_LE(encoder.size(), sizeof(buffer));
+
+    QuaternionStreamDecoder decoder(buffer, encoder.size());
+    for (size_t i = 0; i < appended; ++i)
+    {
+        Quaternion decoded;
+        ASSERT_TRUE(decoder.next(decoded));
+        EXPECT_LT(angleBetween(q[i], decoded), 1.0e-4);
+    }
+}
@@ -30,6 +30,49 @@ TEST(QuaternionTest, Initialize)
     EXPECT_EQ(4.0f, q.z);
 }
 
+TEST(QuaternionTest, FromRotationMatrix)
+{
+    // A quarter turn about Z
+    const float m[3][3] = { { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+    const Quaternion q = Quaternion::fromRotationMatrix(m);
+    EXPECT_NEAR(0.707107f, q.w, 1.0e-6f);
+    EXPECT_FLOAT_EQ(0.0f, q.x);
+    EXPECT_FLOAT_EQ(0.0f, q.y);
+    EXPECT_NEAR(0.707107f, q.z, 1.0e-6f);
+
+    // Half turns have a negative trace and exercise every other branch
+    const Quaternion turns[] =
+    {
+        Quaternion(0.0f, 1.0f, 0.0f, 0.0f),
+        Quaternion(0.0f, 0.0f, 1.0f, 0.0f),
+        Quaternion(0.1f, -0.2f, 0.1f, 0.97f).normalized(),
+        Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized()
+    };
+    for (size_t i = 0; i < sizeof(turns) / sizeof(turns[0]); ++i)
+    {
+        float r[3][3];
+        turns[i].convertToRotationMatrix(r);
+        EXPECT_NEAR(1.0f, std::fabs(turns[i].dot(Quaternion::fromRotationMatrix(r))), 1.0e-6f);
+    }
+}
+
+TEST(QuaternionTest, FromRotationVector)
+{
+    const Quaternion q = Quaternion::fromRotationVector(0.0f, 0.0f, 1.57079633f);
+    EXPECT_NEAR(0.707107f, q.w, 1.0e-6f);
+    EXPECT_FLOAT_EQ(0.0f, q.x);
+    EXPECT_FLOAT_EQ(0.0f, q.y);
+    EXPECT_NEAR(0.707107f, q.z, 1.0e-6f);
+
+    const Quaternion small = Quaternion::fromRotationVector(1.0e-5f, -2.0e-5f, 0.0f);
+    EXPECT_FLOAT_EQ(1.0f, small.w);
+    EXPECT_FLOAT_EQ(0.5e-5f, small.x);
+    EXPECT_FLOAT_EQ(-1.0e-5f, small.y);
+    EXPECT_FLOAT_EQ(0.0f, small.z);
+
+    EXPECT_EQ(Quaternion(), Quaternion::fromRotationVector(0.0f, 0.0f, 0.0f));
+}
+
 TEST(QuaternionTest, Conjugate)
 {
     const Quaternion temp(1.0f, 2.0f, 3.0f, 4.0f);
@@ -61,6 +104,28 @@ TEST(QuaternionTest, ConvertToEulerAngles)
     EXPECT_NEAR(1.57079633f, yaw, 1.0e-4f);
 }
 
+TEST(QuaternionTest, ConvertToRotationMatrix)
+{
+    // Each column is where the matrix takes a unit axis, which must match
+    // rotating the axis with the quaternion
+    const Quaternion q = Quaternion(0.8f, 0.2f, -0.3f, 0.5f).normalized();
+    float m[3][3];
+    q.convertToRotationMatrix(m);
+    const Quaternion axes[] =
+    {
+        Quaternion(0.0f, 1.0f, 0.0f, 0.0f),
+        Quaternion(0.0f, 0.0f, 1.0f, 0.0f),
+        Quaternion(0.0f, 0.0f, 0.0f, 1.0f)
+    };
+    for (int c = 0; c < 3; ++c)
+    {
+        const Quaternion v = q * axes[c] * q.conjugate();
+        EXPECT_NEAR(v.x, m[0][c], 1.0e-6f);
+        EXPECT_NEAR(v.y, m[1][c], 1.0e-6f);
+        EXPECT_NEAR(v.z, m[2][c], 1.0e-6f);
+    }
+}
+
 TEST(QuaternionTest, DotProductMultiplication)
 {
     const Quaternion q1(1.0f, 2.0f, 3.0f, 4.0f);
@@ -104,6 +169,15 @@ TEST(QuaternionTest, Normalized)
     EXPECT_FLOAT_EQ(2.0f * std::sqrt(2.0f / 15.0f), q.z);
 }
 
+TEST(QuaternionTest, NormalizedZero)
+{
+    const Quaternion temp(0.0f, 0.0f, 0.0f, 0.0f);
+    Quaternion q = temp;
+    q.normalize();
+    EXPECT_EQ(temp, q);
+    EXPECT_EQ(temp, temp.normalized());
+}
+
 TEST(QuaternionTest, Assignment)
 {
     const Quaternion temp(1.0f, 2.0f, 3.0f, 4.0f);
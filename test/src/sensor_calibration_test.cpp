@@ -0,0 +1,190 @@
+#include <stdint.h>
+#include "gtest/gtest.h"
+#include "sensor_calibration.h"
+
+namespace
+{
+
+// A calibration with a different bias and full matrix for each sensor
+SensorCalibration skewed()
+{
+    SensorCalibration calibration;
+    for (int s = 0; s < SensorCalibration::SENSOR_COUNT; ++s)
+    {
+        const SensorCalibration::Sensor sensor = static_cast<SensorCalibration::Sensor>(s);
+        const float m[3][3] = { { 1.1f + s, 0.02f, -0.01f },
+                                { 0.03f, 0.9f, 0.05f },
+                                { -0.04f, 0.01f, 1.2f } };
+        calibration.setMatrix(sensor, m);
+        calibration.setBias(sensor, 0.1f * s, -0.2f, 0.3f + s);
+    }
+    return calibration;
+}
+
+} // namespace
+
+TEST(SensorCalibrationTest, Default)
+{
+    const SensorCalibration calibration;
+    float x = 1.0f, y = -2.0f, z = 3.0f;
+    calibration.apply(SensorCalibration::SENSOR_MAG, x, y, z);
+    EXPECT_EQ(1.0f, x);
+    EXPECT_EQ(-2.0f, y);
+    EXPECT_EQ(3.0f, z);
+}
+
+TEST(SensorCalibrationTest, BiasAndScale)
+{
+    SensorCalibration calibration;
+    calibration.setBias(SensorCalibration::SENSOR_ACCEL, 1.0f, 2.0f, 3.0f);
+    calibration.setScale(SensorCalibration::SENSOR_ACCEL, 2.0f, -1.0f, 0.5f);
+    float x = 2.0f, y = 2.0f, z = 7.0f;
+    calibration.apply(SensorCalibration::SENSOR_ACCEL, x, y, z);
+    EXPECT_FLOAT_EQ(2.0f, x);
+    EXPECT_FLOAT_EQ(0.0f, y);
+    EXPECT_FLOAT_EQ(2.0f, z);
+
+    // The other sensors are untouched
+    x = 2.0f;
+    calibration.apply(SensorCalibration::SENSOR_GYRO, x, y, z);
+    EXPECT_EQ(2.0f, x);
+}
+
+TEST(SensorCalibrationTest, Matrix)
+{
+    SensorCalibration calibration;
+    const float m[3][3] = { { 0.0f, 1.0f, 0.0f },
+                            { -1.0f, 0.0f, 0.0f },
+                            { 0.0f, 0.5f, 1.0f } };
+    calibration.setMatrix(SensorCalibration::SENSOR_MAG, m);
+    calibration.setBias(SensorCalibration::SENSOR_MAG, 0.0f, 1.0f, 0.0f);
+    float x = 3.0f, y = 5.0f, z = -1.0f;
+    calibration.apply(SensorCalibration::SENSOR_MAG, x, y, z);
+    EXPECT_FLOAT_EQ(4.0f, x);
+    EXPECT_FLOAT_EQ(-3.0f, y);
+    EXPECT_FLOAT_EQ(1.0f, z);
+}
+
+TEST(SensorCalibrationTest, BatchMatchesSingle)
+{
+    const SensorCalibration calibration = skewed();
+    float samples[16][10];
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int j = 0; j < 10; ++j)
+        {
+            samples[i][j] = 0.1f * i - 0.3f * j;
+        }
+    }
+    float expected[16][10];
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int j = 0; j < 10; ++j)
+        {
+            expected[i][j] = samples[i][j];
+        }
+        for (int s = 0; s < SensorCalibration::SENSOR_COUNT; ++s)
+        {
+            calibration.apply(static_cast<SensorCalibration::Sensor>(s),
+                              expected[i][3 * s], expected[i][3 * s + 1], expected[i][3 * s + 2]);
+        }
+    }
+    calibration.apply(&samples[0][0], 16, 10, 3);
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int j = 0; j < 10; ++j)
+        {
+            EXPECT_EQ(expected[i][j], samples[i][j]);
+        }
+    }
+}
+
+TEST(SensorCalibrationTest, BatchWithoutMagnetometer)
+{
+    // Two sensors leave the rest of each sample alone, whatever the stride
+    const SensorCalibration calibration = skewed();
+    float samples[2][9] = { { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f },
+                            { 7.0f, 8.0f, 9.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f } };
+    float expected[2][9];
+    for (int i = 0; i < 2; ++i)
+    {
+        for (int j = 0; j < 9; ++j)
+        {
+            expected[i][j] = samples[i][j];
+        }
+        calibration.apply(SensorCalibration::SENSOR_GYRO, expected[i][0], expected[i][1], expected[i][2]);
+        calibration.apply(SensorCalibration::SENSOR_ACCEL, expected[i][3], expected[i][4], expected[i][5]);
+    }
+    calibration.apply(&samples[0][0], 2, 9, 2);
+    for (int i = 0; i < 2; ++i)
+    {
+        for (int j = 0; j < 9; ++j)
+        {
+            EXPECT_EQ(expected[i][j], samples[i][j]);
+        }
+    }
+}
+
+TEST(SensorCalibrationTest, SerializeRoundTrip)
+{
+    const size_t size = SensorCalibration::serializedSize;
+    const SensorCalibration original = skewed();
+    uint8_t buffer[size + 4];
+    EXPECT_EQ(size, original.serialize(buffer, sizeof(buffer)));
+
+    SensorCalibration restored;
+    EXPECT_TRUE(restored.deserialize(buffer, size));
+    for (int s = 0; s < SensorCalibration::SENSOR_COUNT; ++s)
+    {
+        const SensorCalibration::Sensor sensor = static_cast<SensorCalibration::Sensor>(s);
+        float ax = 0.5f, ay = -1.5f, az = 2.5f;
+        float bx = ax, by = ay, bz = az;
+        original.apply(sensor, ax, ay, az);
+        restored.apply(sensor, bx, by, bz);
+        EXPECT_EQ(ax, bx);
+        EXPECT_EQ(ay, by);
+        EXPECT_EQ(az, bz);
+    }
+}
+
+TEST(SensorCalibrationTest, SerializedLayout)
+{
+    SensorCalibration calibration;
+    calibration.setBias(SensorCalibration::SENSOR_GYRO, 1.0f, 0.0f, 0.0f);
+    uint8_t buffer[SensorCalibration::serializedSize];
+    calibration.serialize(buffer, sizeof(buffer));
+
+    // Header, then the gyroscope X bias as a little endian float
+    EXPECT_EQ('F', buffer[0]);
+    EXPECT_EQ('C', buffer[1]);
+    EXPECT_EQ(0x00, buffer[4]);
+    EXPECT_EQ(0x00, buffer[5]);
+    EXPECT_EQ(0x80, buffer[6]);
+    EXPECT_EQ(0x3F, buffer[7]);
+}
+
+TEST(SensorCalibrationTest, DeserializeRejectsDamage)
+{
+    const size_t size = SensorCalibration::serializedSize;
+    uint8_t buffer[size];
+    skewed().serialize(buffer, size);
+
+    SensorCalibration calibration;
+    EXPECT_FALSE(calibration.deserialize(buffer, size - 1));
+    buffer[40] ^= 0x10;
+    EXPECT_FALSE(calibration.deserialize(buffer, size));
+    buffer[40] ^= 0x10;
+    buffer[3] = 2;
+    EXPECT_FALSE(calibration.deserialize(buffer, size));
+
+    // A rejected buffer leaves the calibration as it was
+    float x = 1.0f, y = 2.0f, z = 3.0f;
+    calibration.apply(SensorCalibration::SENSOR_GYRO, x, y, z);
+    EXPECT_EQ(1.0f, x);
+}
+
+TEST(SensorCalibrationTest, SerializeTooSmall)
+{
+    uint8_t buffer[SensorCalibration::serializedSize];
+    EXPECT_EQ(0u, SensorCalibration().serialize(buffer, sizeof(buffer) - 1));
+}
@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+#include "sensor_format.h"
+
+TEST(SensorFormatTest, Default)
+{
+    const SensorFormat format;
+    const int16_t record[9] = { 1, -2, 3, -4, 5, -6, 7, -8, 9 };
+    EXPECT_EQ(9, format.stride());
+    for (int i = 0; i < SensorFormat::AXIS_COUNT; ++i)
+    {
+        EXPECT_EQ(record[i], format.value(record, static_cast<SensorFormat::Axis>(i)));
+    }
+}
+
+TEST(SensorFormatTest, SetAxis)
+{
+    SensorFormat format;
+    format.setAxis(SensorFormat::GYRO_X, 4, 0.5f, 10.0f);
+    format.setAxis(SensorFormat::ACCEL_Z, 0, -0.25f, -8.0f);
+    const int16_t record[5] = { 100, 0, 0, 0, 30 };
+    EXPECT_FLOAT_EQ(10.0f, format.value(record, SensorFormat::GYRO_X));
+    EXPECT_FLOAT_EQ(-27.0f, format.value(record, SensorFormat::ACCEL_Z));
+    EXPECT_FLOAT_EQ(0.0f, format.value(record, SensorFormat::GYRO_Y));
+}
+
+TEST(SensorFormatTest, InvalidAxis)
+{
+    SensorFormat format;
+    format.setAxis(SensorFormat::AXIS_COUNT, 0, 2.0f, 1.0f);
+    const int16_t record[9] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    for (int i = 0; i < SensorFormat::AXIS_COUNT; ++i)
+    {
+        EXPECT_EQ(record[i], format.value(record, static_cast<SensorFormat::Axis>(i)));
+    }
+}
+
+TEST(SensorFormatTest, SetStride)
+{
+    SensorFormat format;
+    format.setStride(7);
+    EXPECT_EQ(7, format.stride());
+
+    // Axes beyond the record read as zero, a zero stride is ignored
+    const int16_t record[7] = { 1, 2, 3, 4, 5, 6, 7 };
+    EXPECT_EQ(7.0f, format.value(record, SensorFormat::MAG_X));
+    EXPECT_EQ(0.0f, format.value(record, SensorFormat::MAG_Y));
+    EXPECT_EQ(0.0f, format.value(record, SensorFormat::MAG_Z));
+    format.setStride(0);
+    EXPECT_EQ(7, format.stride());
+}
+
+TEST(SensorFormatTest, WordBeyondStride)
+{
+    SensorFormat format;
+    format.setStride(6);
+    format.setAxis(SensorFormat::GYRO_X, 6, 2.0f, 0.0f);
+    format.setAxis(SensorFormat::GYRO_Y, 5, 2.0f, 0.0f);
+    const int16_t record[6] = { 1, 2, 3, 4, 5, 6 };
+    EXPECT_EQ(1.0f, format.value(record, SensorFormat::GYRO_X));
+    EXPECT_EQ(12.0f, format.value(record, SensorFormat::GYRO_Y));
+}
@@ -0,0 +1,332 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  fusion_replay.cpp
+ * @brief Command line tool which replays sensor logs through the filters.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "replay.h"
+
+namespace
+{
+
+/**
+ * @brief Prints the command line usage.
+ */
+void usage(FILE *out)
+{
+    fputs("Usage: fusion-replay [OPTION]... LOG...\n"
+          "Runs a Fusion filter over each sensor log, in parallel, and writes the\n"
+          "estimated orientation of every sample.\n"
+          "\n"
+          "  -f, --filter=imu|marg|gyro  filter to run (default imu), gyro integrates\n"
+          "                              the gyroscope alone using a parallel scan\n"
+          "  -e, --gyro-error=RAD/S      gyroscope error (default 0.015074)\n"
+          "  -d, --gyro-drift=RAD/S/S    gyroscope drift, marg only (default 0.000264)\n"
+          "  -r, --rate=HZ               fixed sample rate instead of log timestamps\n"
+          "  -j, --jobs=N                number of threads (default: all cores)\n"
+          "  -o, --output-dir=DIR        directory for output files (default .)\n"
+          "  -F, --format=csv|bin|stream output format (default csv)\n"
+          "  -a, --align                 align each filter with its first sample\n"
+          "  -c, --chunks=N              split each log into N chunks filtered in\n"
+          "                              parallel, one log at a time, marg only and\n"
+          "                              always aligned\n"
+          "  -w, --warmup=SECONDS        samples filtered before each chunk and then\n"
+          "                              discarded (default 10)\n"
+          "  -V, --verify                report the largest deviation of the chunked\n"
+          "                              output from a serial run\n"
+          "  -H, --histogram=text|json   print the distribution of filter update\n"
+          "                              times in nanoseconds\n"
+          "  -h, --help                  show this help\n"
+          "\n"
+          "Logs hold a timestamp in seconds followed by the gyroscope (rad/s),\n"
+          "accelerometer and, for marg, magnetometer axes. Files ending in .bin are\n"
+          "read as little endian records of a double timestamp and float axes,\n"
+          "anything else as CSV.\n", out);
+}
+
+/**
+ * @brief Parses a float option, exiting on malformed input.
+ */
+float parseFloat(const char *name, const char *value)
+{
+    char *end;
+    const float f = strtof(value, &end);
+    if ((end == value) || *end)
+    {
+        fprintf(stderr, "fusion-replay: invalid %s '%s'\n", name, value);
+        exit(2);
+    }
+    return f;
+}
+
+/**
+ * @brief   Parses a count option, exiting on malformed input.
+ * @details Accepts only a whole number from zero to max. strtoul() would
+ *          also accept a sign, so one is rejected as well.
+ */
+unsigned long parseCount(const char *name, const char *value, const unsigned long max)
+{
+    char *end;
+    errno = 0;
+    const unsigned long n = strtoul(value, &end, 10);
+    if ((end == value) || *end || (errno != 0) || (n > max) || strchr(value, '-') || strchr(value, '+'))
+    {
+        fprintf(stderr, "fusion-replay: invalid %s '%s'\n", name, value);
+        exit(2);
+    }
+    return n;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    static const struct option long_options[] =
+    {
+        { "filter",     required_argument, 0, 'f' },
+        { "gyro-error", required_argument, 0, 'e' },
+        { "gyro-drift", required_argument, 0, 'd' },
+        { "rate",       required_argument, 0, 'r' },
+        { "jobs",       required_argument, 0, 'j' },
+        { "output-dir", required_argument, 0, 'o' },
+        { "format",     required_argument, 0, 'F' },
+        { "align",      no_argument,       0, 'a' },
+        { "chunks",     required_argument, 0, 'c' },
+        { "warmup",     required_argument, 0, 'w' },
+        { "verify",     no_argument,       0, 'V' },
+        { "histogram",  required_argument, 0, 'H' },
+        { "help",       no_argument,       0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    ReplayOptions options;
+    LatencyHistogram histogram;
+    bool json = false;
+    unsigned int jobs = std::thread::hardware_concurrency();
+    int c;
+    while (-1 != (c = getopt_long(argc, argv, "f:e:d:r:j:o:F:ac:w:VH:h", long_options, 0)))
+    {
+        switch (c)
+        {
+        case 'f':
+            if (0 == strcmp(optarg, "imu"))
+            {
+                options.filter = FILTER_IMU;
+            }
+            else if (0 == strcmp(optarg, "marg"))
+            {
+                options.filter = FILTER_MARG;
+            }
+            else if (0 == strcmp(optarg, "gyro"))
+            {
+                options.filter = FILTER_GYRO;
+            }
+            else
+            {
+                fprintf(stderr, "fusion-replay: unknown filter '%s'\n", optarg);
+                return 2;
+            }
+            break;
+        case 'e':
+            options.gyroError = parseFloat("gyro error", optarg);
+            break;
+        case 'd':
+            options.gyroDrift = parseFloat("gyro drift", optarg);
+            break;
+        case 'r':
+            options.rate = parseFloat("rate", optarg);
+            break;
+        case 'j':
+            jobs = static_cast<unsigned int>(parseCount("jobs", optarg, UINT_MAX));
+            break;
+        case 'o':
+            options.outputDir = optarg;
+            break;
+        case 'F':
+            if (0 == strcmp(optarg, "csv"))
+            {
+                options.format = OUTPUT_CSV;
+            }
+            else if (0 == strcmp(optarg, "bin"))
+            {
+                options.format = OUTPUT_BINARY;
+            }
+            else if (0 == strcmp(optarg, "stream"))
+            {
+                options.format = OUTPUT_STREAM;
+            }
+            else
+            {
+                fprintf(stderr, "fusion-replay: unknown format '%s'\n", optarg);
+                return 2;
+            }
+            break;
+        case 'a':
+            options.align = true;
+            break;
+        case 'c':
+            options.chunks = static_cast<size_t>(parseCount("chunks", optarg, SIZE_MAX));
+            break;
+        case 'w':
+            options.warmup = parseFloat("warmup", optarg);
+            break;
+        case 'V':
+            options.verify = true;
+            break;
+        case 'H':
+            if ((0 != strcmp(optarg, "text")) && (0 != strcmp(optarg, "json")))
+            {
+                fprintf(stderr, "fusion-replay: unknown histogram format '%s'\n", optarg);
+                return 2;
+            }
+            json = (0 == strcmp(optarg, "json"));
+            options.histogram = &histogram;
+            break;
+        case 'h':
+            usage(stdout);
+            return 0;
+        default:
+            usage(stderr);
+            return 2;
+        }
+    }
+
+    const std::vector<std::string> inputs(argv + optind, argv + argc);
+    if (inputs.empty())
+    {
+        usage(stderr);
+        return 2;
+    }
+    if (0 == jobs)
+    {
+        jobs = 1;
+    }
+
+    // IMUFilter never observes the heading, so every chunk would settle on a
+    // heading of its own. MARGFilter does, but converges on it so slowly from
+    // the identity that its chunks start from their measured orientation.
+    if ((options.chunks > 1) && (FILTER_GYRO != options.filter))
+    {
+        if (FILTER_IMU == options.filter)
+        {
+            fputs("fusion-replay: --chunks needs the marg filter, imu cannot "
+                  "recover the heading of a chunk\n", stderr);
+            return 2;
+        }
+        options.align = true;
+    }
+
+    // Chunked logs and gyroscope integration use every thread on one log at a
+    // time, otherwise each thread takes the next unclaimed log until none are
+    // left
+    std::vector<ReplayResult> results(inputs.size());
+    const double start = seconds();
+    if ((options.chunks > 1) || (FILTER_GYRO == options.filter))
+    {
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            results[i] = replayFile(inputs[i], options, jobs);
+        }
+    }
+    else
+    {
+        if (jobs > inputs.size())
+        {
+            jobs = static_cast<unsigned int>(inputs.size());
+        }
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < jobs; ++t)
+        {
+            threads.push_back(std::thread([&]()
+            {
+                size_t i;
+                while ((i = next++) < inputs.size())
+                {
+                    results[i] = replayFile(inputs[i], options, 1);
+                }
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); ++t)
+        {
+            threads[t].join();
+        }
+    }
+    const double elapsed = seconds() - start;
+
+    int status = 0;
+    size_t total = 0;
+    printf("%-32s %12s %10s %10s %10s %14s%s\n",
+           "log", "samples", "load s", "filter s", "write s", "updates/s",
+           options.verify ? "    max dev deg" : "");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const ReplayResult &r = results[i];
+        if (!r.error.empty())
+        {
+            fprintf(stderr, "fusion-replay: %s\n", r.error.c_str());
+            status = 1;
+            continue;
+        }
+        total += r.samples;
+        printf("%-32s %12lu %10.3f %10.3f %10.3f %14.0f", r.input.c_str(),
+               static_cast<unsigned long>(r.samples), r.loadSeconds, r.filterSeconds,
+               r.writeSeconds, (r.filterSeconds > 0.0) ? (r.samples / r.filterSeconds) : 0.0);
+        if (r.maxDeviation >= 0.0)
+        {
+            printf(" %15.6f", r.maxDeviation * 180.0 / M_PI);
+        }
+        putchar('\n');
+    }
+    printf("%lu samples from %lu logs in %.3f s using %u threads (%.0f samples/s)\n",
+           static_cast<unsigned long>(total), static_cast<unsigned long>(results.size()),
+           elapsed, jobs, (elapsed > 0.0) ? (total / elapsed) : 0.0);
+    if (options.histogram)
+    {
+        std::vector<char> text(json ? 16384 : 256);
+        const size_t length = json ? histogram.printJson(&text[0], text.size())
+                                   : histogram.printText(&text[0], text.size());
+        if (length >= text.size())
+        {
+            text.resize(length + 1);
+            json ? histogram.printJson(&text[0], text.size())
+                 : histogram.printText(&text[0], text.size());
+        }
+        printf("update ns: %s", &text[0]);
+    }
+    return status;
+}
@@ -0,0 +1,289 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  gyro_scan.cpp
+ * @brief Gyroscope integration implementation.
+ * @details Integrating only the gyroscope gives
+ *          @f$q_k = q_0 \otimes \Delta q_1 \otimes \cdots \otimes \Delta q_k@f$,
+ *          a prefix product. Quaternion multiplication is associative, so
+ *          the products can be regrouped and computed in parallel. The scan
+ *          follows the usual up sweep and down sweep pattern with one level
+ *          per thread and one per lane:
+ *          1. Every thread scans its own chunk, as several interleaved lanes
+ *             whose dependency chains are independent. Each step gathers
+ *             one quaternion of every lane into separate component arrays,
+ *             so the product over the lanes is a plain loop over floats
+ *             which the compiler vectorizes. The gather and the scatter
+ *             back stay scalar, so the gain is modest.
+ *          2. The chunk totals are scanned serially, which is cheap since
+ *             there is only one per thread.
+ *          3. Every thread multiplies its chunk by the product of all the
+ *             chunks before it.
+ *
+ *          Since the products are regrouped the rounding differs slightly
+ *          from a serial loop, but no approximation is made.
+ */
+
+#include <thread>
+#include <vector>
+#include "gyro_scan.h"
+
+namespace
+{
+
+/**
+ * @brief Number of interleaved lanes scanned by each thread.
+ */
+const size_t lanes = 8;
+
+/**
+ * @brief   Scans a chunk in place using interleaved lanes.
+ *
+ * @param[in,out] q     The chunk, replaced by its inclusive prefix products.
+ * @param[in]     count The number of quaternions in the chunk.
+ */
+void scanChunk(Quaternion *q, const size_t count)
+{
+    const size_t stride = (count + lanes - 1) / lanes;
+
+    // Scan every lane at once, one step of each lane per iteration
+    float w[lanes], x[lanes], y[lanes], z[lanes];
+    for (size_t j = 0; j < lanes; ++j)
+    {
+        w[j] = 1.0f;
+        x[j] = 0.0f;
+        y[j] = 0.0f;
+        z[j] = 0.0f;
+    }
+    const size_t last = (lanes - 1) * stride;
+    const size_t full = (count > last) ? (count - last) : 0;
+    for (size_t k = 0; k < full; ++k)
+    {
+        // Gather one step of every lane into separate component arrays so
+        // the products below run on whole vectors of lanes
+        float bw[lanes], bx[lanes], by[lanes], bz[lanes];
+        for (size_t j = 0; j < lanes; ++j)
+        {
+            const Quaternion &b = q[(j * stride) + k];
+            bw[j] = b.w;
+            bx[j] = b.x;
+            by[j] = b.y;
+            bz[j] = b.z;
+        }
+        for (size_t j = 0; j < lanes; ++j)
+        {
+            const float tw = (w[j] * bw[j]) - (x[j] * bx[j]) - (y[j] * by[j]) - (z[j] * bz[j]);
+            const float tx = (w[j] * bx[j]) + (x[j] * bw[j]) + (y[j] * bz[j]) - (z[j] * by[j]);
+            const float ty = (w[j] * by[j]) - (x[j] * bz[j]) + (y[j] * bw[j]) + (z[j] * bx[j]);
+            const float tz = (w[j] * bz[j]) + (x[j] * by[j]) - (y[j] * bx[j]) + (z[j] * bw[j]);
+            w[j] = tw;
+            x[j] = tx;
+            y[j] = ty;
+            z[j] = tz;
+        }
+        for (size_t j = 0; j < lanes; ++j)
+        {
+            q[(j * stride) + k] = Quaternion(w[j], x[j], y[j], z[j]);
+        }
+    }
+
+    // Finish the lanes which are longer than the shortest one
+    for (size_t j = 0; j < lanes; ++j)
+    {
+        const size_t end = ((j + 1) * stride < count) ? ((j + 1) * stride) : count;
+        Quaternion acc(w[j], x[j], y[j], z[j]);
+        for (size_t i = (j * stride) + full; i < end; ++i)
+        {
+            acc *= q[i];
+            q[i] = acc;
+        }
+    }
+
+    // Carry the total of each lane into the lanes after it
+    Quaternion carry = q[((stride < count) ? stride : count) - 1];
+    for (size_t j = 1; (j * stride) < count; ++j)
+    {
+        const size_t begin = j * stride;
+        const size_t end = (begin + stride < count) ? (begin + stride) : count;
+        for (size_t i = begin; i < end; ++i)
+        {
+            q[i] = carry * q[i];
+        }
+        carry = q[end - 1];
+    }
+}
+
+/**
+ * @brief   Multiplies every quaternion in a range by an offset.
+ * @details The results are normalized, which removes the slow drift in
+ *          length that comes from rounding in long products.
+ *
+ * @param[in]     offset The left hand operand of every product.
+ * @param[in,out] q      The quaternions to multiply.
+ * @param[in]     count  The number of quaternions.
+ */
+void applyOffset(const Quaternion &offset, Quaternion *q, const size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        q[i] = (offset * q[i]).normalized();
+    }
+}
+
+/**
+ * @brief   Runs a function over chunks of a range on several threads.
+ *
+ * @param[in] jobs   The number of threads, which is also the number of chunks.
+ * @param[in] count  The size of the range.
+ * @param[in] work   Called as work(chunk, begin, end) for each chunk.
+ */
+template <typename Work>
+void parallelChunks(const unsigned int jobs, const size_t count, Work work)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int c = 1; c < jobs; ++c)
+    {
+        threads.push_back(std::thread(work, c, (count * c) / jobs, (count * (c + 1)) / jobs));
+    }
+    work(0, 0, count / jobs);
+    for (size_t t = 0; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+}
+
+} // namespace
+
+/**
+ * @brief   Computes the rotation measured by each gyroscope sample.
+ * @details Each increment is the exact exponential map of the angular rate
+ *          held over the sample interval.
+ * @see     Quaternion::fromRotationVector()
+ *
+ * @param[in]  log   The sensor log, gyroscope in the first three channels.
+ * @param[in]  rate  Fixed sample rate in Hz, or zero to use the timestamps.
+ * @param[in]  begin The index of the first sample.
+ * @param[in]  end   The index one past the last sample.
+ * @param[out] dq    The increment of each sample.
+ */
+void gyroIncrements(const SensorLog &log, const float rate,
+                    const size_t begin, const size_t end, Quaternion *dq)
+{
+    const float fixed = (rate > 0.0f) ? (1.0f / rate) : 0.0f;
+    for (size_t i = begin; i < end; ++i)
+    {
+        const float *s = log.sample(i);
+        const float dt = (rate > 0.0f) ? fixed : log.interval(i);
+        dq[i - begin] = Quaternion::fromRotationVector(s[0] * dt, s[1] * dt, s[2] * dt);
+    }
+}
+
+/**
+ * @brief   Computes inclusive prefix products in place.
+ * @details Replaces each quaternion with the product of itself and all of
+ *          the quaternions before it, multiplying in order from the left.
+ *          The results are normalized.
+ *
+ * @param[in,out] q     The quaternions to scan.
+ * @param[in]     count The number of quaternions.
+ * @param[in]     jobs  The number of threads to use.
+ */
+void prefixProduct(Quaternion *q, const size_t count, const unsigned int jobs)
+{
+    if (0 == count)
+    {
+        return;
+    }
+    unsigned int n = (jobs > 0) ? jobs : 1;
+    n = (count < (n * lanes)) ? 1 : n;
+
+    parallelChunks(n, count, [q](unsigned int, size_t begin, size_t end)
+    {
+        scanChunk(q + begin, end - begin);
+    });
+
+    // Scan the chunk totals to find the offset of each chunk
+    std::vector<Quaternion> offsets(n);
+    for (unsigned int c = 1; c < n; ++c)
+    {
+        offsets[c] = offsets[c - 1] * q[((count * c) / n) - 1];
+    }
+
+    parallelChunks(n, count, [q, &offsets](unsigned int c, size_t begin, size_t end)
+    {
+        applyOffset(offsets[c], q + begin, end - begin);
+    });
+}
+
+/**
+ * @brief   Integrates the gyroscope of a whole log in parallel.
+ *
+ * @param[in]  log     The sensor log, gyroscope in the first three channels.
+ * @param[in]  rate    Fixed sample rate in Hz, or zero to use the timestamps.
+ * @param[in]  initial The orientation before the first sample.
+ * @param[in]  jobs    The number of threads to use.
+ * @param[out] out     The orientation after each sample.
+ */
+void integrateGyro(const SensorLog &log, const float rate,
+                   const Quaternion &initial, const unsigned int jobs,
+                   Quaternion *out)
+{
+    const size_t count = log.size();
+    if (0 == count)
+    {
+        return;
+    }
+    const unsigned int n = (jobs > 0) ? jobs : 1;
+    parallelChunks(n, count, [&log, rate, out](unsigned int, size_t begin, size_t end)
+    {
+        gyroIncrements(log, rate, begin, end, out + begin);
+    });
+    out[0] = initial * out[0];
+    prefixProduct(out, count, n);
+}
+
+/**
+ * @brief   Integrates the gyroscope of a whole log serially.
+ * @details This is the reference the parallel integration is verified
+ *          against.
+ *
+ * @param[in]  log     The sensor log, gyroscope in the first three channels.
+ * @param[in]  rate    Fixed sample rate in Hz, or zero to use the timestamps.
+ * @param[in]  initial The orientation before the first sample.
+ * @param[out] out     The orientation after each sample.
+ */
+void integrateGyroSerial(const SensorLog &log, const float rate,
+                         const Quaternion &initial, Quaternion *out)
+{
+    const float fixed = (rate > 0.0f) ? (1.0f / rate) : 0.0f;
+    Quaternion q = initial;
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        const float *s = log.sample(i);
+        const float dt = (rate > 0.0f) ? fixed : log.interval(i);
+        q *= Quaternion::fromRotationVector(s[0] * dt, s[1] * dt, s[2] * dt);
+        q.normalize();
+        out[i] = q;
+    }
+}
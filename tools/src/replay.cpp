@@ -0,0 +1,505 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  replay.cpp
+ * @brief Log replay implementation.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "gyro_scan.h"
+#include "imu_filter.h"
+#include "marg_filter.h"
+#include "quaternion_stream.h"
+#include "replay.h"
+
+namespace
+{
+
+/**
+ * @brief Writes a 32 bit float in little endian order.
+ */
+inline void storeFloat(uint8_t *out, const float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    for (int b = 0; b < 4; ++b)
+    {
+        out[b] = static_cast<uint8_t>(bits >> (8 * b));
+    }
+}
+
+/**
+ * @brief Writes a 64 bit double in little endian order.
+ */
+inline void storeDouble(uint8_t *out, const double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    for (int b = 0; b < 8; ++b)
+    {
+        out[b] = static_cast<uint8_t>(bits >> (8 * b));
+    }
+}
+
+/**
+ * @brief Sets the sample rate of a filter before updating a sample.
+ */
+inline void setInterval(Filter &filter, const SensorLog &log,
+                        const ReplayOptions &options, const size_t index)
+{
+    if (options.rate <= 0.0f)
+    {
+        filter.setSampleRate(log.interval(index));
+    }
+}
+
+/**
+ * @brief Configures a filter from the replay options.
+ */
+void configure(Filter &filter, const ReplayOptions &options)
+{
+    filter.setGyroErrorGain(options.gyroError);
+    filter.setLatencyHistograms(options.histogram, 0);
+    if (options.rate > 0.0f)
+    {
+        filter.setSampleRate(1.0f / options.rate);
+    }
+}
+
+/**
+ * @brief Writes orientations as CSV text.
+ */
+bool writeCsv(FILE *file, const SensorLog &log, const std::vector<Quaternion> &q)
+{
+    fputs("t,w,x,y,z\n", file);
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        fprintf(file, "%.6f,%.7f,%.7f,%.7f,%.7f\n",
+                log.time(i), q[i].w, q[i].x, q[i].y, q[i].z);
+    }
+    return true;
+}
+
+/**
+ * @brief Writes orientations as binary records of a double timestamp and
+ *        four floats, the same layout as a binary sensor log.
+ */
+bool writeBinary(FILE *file, const SensorLog &log, const std::vector<Quaternion> &q)
+{
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        uint8_t record[8 + (4 * 4)];
+        storeDouble(record, log.time(i));
+        storeFloat(record + 8, q[i].w);
+        storeFloat(record + 12, q[i].x);
+        storeFloat(record + 16, q[i].y);
+        storeFloat(record + 20, q[i].z);
+        if (1 != fwrite(record, sizeof(record), 1, file))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Writes orientations as a compressed quaternion stream.
+ */
+bool writeStream(FILE *file, const std::vector<Quaternion> &q)
+{
+    std::vector<uint8_t> buffer((q.size() * 24) + 64);
+    QuaternionStreamEncoder encoder(&buffer[0], buffer.size());
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        if (!encoder.append(q[i]))
+        {
+            return false;
+        }
+    }
+    encoder.flush();
+    return (0 == encoder.size()) || (1 == fwrite(&buffer[0], encoder.size(), 1, file));
+}
+
+} // namespace
+
+/**
+ * @brief   Default constructor.
+ * @details Uses the IMU filter with the gains from the example sketches and
+ *          writes CSV output to the current directory.
+ */
+ReplayOptions::ReplayOptions() :
+    filter(FILTER_IMU),
+    gyroError(0.015074f),
+    gyroDrift(0.000264f),
+    rate(0.0f),
+    format(OUTPUT_CSV),
+    outputDir("."),
+    align(false),
+    chunks(1),
+    warmup(10.0f),
+    verify(false),
+    histogram(0)
+{
+}
+
+/**
+ * @brief   Gets the number of channels the selected filter needs.
+ *
+ * @return The number of channels per sample.
+ */
+size_t ReplayOptions::channels() const
+{
+    return (FILTER_MARG == filter) ? 9 : 6;
+}
+
+/**
+ * @brief   Default constructor.
+ * @details Creates an empty result.
+ */
+ReplayResult::ReplayResult() :
+    samples(0),
+    loadSeconds(0.0),
+    filterSeconds(0.0),
+    writeSeconds(0.0),
+    maxDeviation(-1.0)
+{
+}
+
+/**
+ * @brief   Runs a filter over part of a log.
+ * @details A new filter is created for every call, so calls are independent
+ *          and may run on different threads at once. Samples from @p start
+ *          up to @p begin only warm up the filter and produce no output.
+ *
+ * @param[in]  log     The sensor log.
+ * @param[in]  options The filter settings.
+ * @param[in]  start   The index of the first sample to filter.
+ * @param[in]  begin   The index of the first sample to output.
+ * @param[in]  end     The index one past the last sample to filter.
+ * @param[out] out     The orientation after each update from @p begin, which
+ *                     is @p end - @p begin values.
+ */
+void runFilter(const SensorLog &log, const ReplayOptions &options,
+               const size_t start, const size_t begin, const size_t end,
+               Quaternion *out)
+{
+    if (start >= end)
+    {
+        return;
+    }
+
+    const float *first = log.sample(start);
+    if (FILTER_MARG == options.filter)
+    {
+        MARGFilter filter;
+        configure(filter, options);
+        filter.setGyroDriftGain(options.gyroDrift);
+        if (options.align)
+        {
+            filter.align(first[3], first[4], first[5], first[6], first[7], first[8]);
+        }
+        for (size_t i = start; i < end; ++i)
+        {
+            const float *s = log.sample(i);
+            setInterval(filter, log, options, i);
+            filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+            if (i >= begin)
+            {
+                out[i - begin] = filter.orientation();
+            }
+        }
+    }
+    else
+    {
+        IMUFilter filter;
+        configure(filter, options);
+        if (options.align)
+        {
+            filter.align(first[3], first[4], first[5]);
+        }
+        for (size_t i = start; i < end; ++i)
+        {
+            const float *s = log.sample(i);
+            setInterval(filter, log, options, i);
+            filter.update(s[0], s[1], s[2], s[3], s[4], s[5]);
+            if (i >= begin)
+            {
+                out[i - begin] = filter.orientation();
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Runs a filter over a whole log in parallel chunks.
+ * @details The log is split into ReplayOptions::chunks equal chunks which are
+ *          filtered on up to @p jobs threads. Each chunk starts its filter
+ *          ReplayOptions::warmup seconds before its first sample, so that the
+ *          filter has forgotten its initial state by the time its output is
+ *          used. The first chunk has no samples before it and so matches a
+ *          serial run exactly. Only the tilt is recovered by the warm-up of
+ *          an IMUFilter, whose heading is never observed, and a MARGFilter
+ *          needs ReplayOptions::align to settle its heading within a
+ *          practical warm-up.
+ *
+ * @param[in]  log     The sensor log.
+ * @param[in]  options The filter and chunk settings.
+ * @param[in]  jobs    The largest number of threads to use.
+ * @param[out] out     The orientation after each update, one per sample.
+ */
+void runChunked(const SensorLog &log, const ReplayOptions &options,
+                const unsigned int jobs, Quaternion *out)
+{
+    const size_t n = log.size();
+    if (0 == n)
+    {
+        return;
+    }
+    const size_t chunks = ((options.chunks > 0) && (options.chunks < n)) ? options.chunks : 1;
+
+    std::vector<size_t> starts(chunks);
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t c = 0; c <= chunks; ++c)
+    {
+        bounds[c] = (n * c) / chunks;
+    }
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        size_t start = bounds[c];
+        if (options.rate > 0.0f)
+        {
+            const size_t warmup = static_cast<size_t>(options.warmup * options.rate);
+            start = (warmup < start) ? (start - warmup) : 0;
+        }
+        else
+        {
+            const double from = log.time(bounds[c]) - options.warmup;
+            while ((start > 0) && (log.time(start - 1) >= from))
+            {
+                --start;
+            }
+        }
+        starts[c] = start;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    const size_t count = (jobs < chunks) ? ((jobs > 0) ? jobs : 1) : chunks;
+    for (size_t t = 0; t < count; ++t)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            size_t c;
+            while ((c = next++) < chunks)
+            {
+                runFilter(log, options, starts[c], bounds[c], bounds[c + 1], out + bounds[c]);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+}
+
+/**
+ * @brief   Writes orientations to a file.
+ *
+ * @param[in]  path   The file to write.
+ * @param[in]  log    The log the orientations were computed from.
+ * @param[in]  q      The orientation of each sample.
+ * @param[in]  format The output format.
+ * @param[out] error  Why the write failed.
+ * @retval true  If the file was written.
+ * @retval false Otherwise.
+ * @return       Whether the file was written.
+ */
+bool writeOrientations(const std::string &path, const SensorLog &log,
+                       const std::vector<Quaternion> &q,
+                       const OutputFormat format, std::string &error)
+{
+    FILE *file = fopen(path.c_str(), (OUTPUT_CSV == format) ? "w" : "wb");
+    if (!file)
+    {
+        error = "cannot create " + path;
+        return false;
+    }
+
+    bool ok;
+    switch (format)
+    {
+    case OUTPUT_BINARY:
+        ok = writeBinary(file, log, q);
+        break;
+    case OUTPUT_STREAM:
+        ok = writeStream(file, q);
+        break;
+    default:
+        ok = writeCsv(file, log, q);
+        break;
+    }
+    ok = (0 == fclose(file)) && ok;
+    if (!ok)
+    {
+        error = "cannot write " + path;
+    }
+    return ok;
+}
+
+/**
+ * @brief   Gets the output file name for a log.
+ * @details Replaces the directory and extension of the log with the output
+ *          directory and an extension matching the output format.
+ *
+ * @param[in] input   The log file name.
+ * @param[in] options The replay options.
+ * @return            The output file name.
+ */
+std::string outputPath(const std::string &input, const ReplayOptions &options)
+{
+    const size_t slash = input.find_last_of('/');
+    std::string stem = (std::string::npos == slash) ? input : input.substr(slash + 1);
+    const size_t dot = stem.find_last_of('.');
+    if ((std::string::npos != dot) && (dot > 0))
+    {
+        stem.erase(dot);
+    }
+
+    const char *extension = ".orientation.csv";
+    if (OUTPUT_BINARY == options.format)
+    {
+        extension = ".orientation.bin";
+    }
+    else if (OUTPUT_STREAM == options.format)
+    {
+        extension = ".orientation.qs";
+    }
+    return options.outputDir + "/" + stem + extension;
+}
+
+/**
+ * @brief   Replays a single log.
+ * @details Loads the log, filters every sample and writes the orientations,
+ *          timing each step. When chunking is enabled the chunks are filtered
+ *          in parallel, and with verification the result is also compared
+ *          against a serial run. Gyroscope integration is always done with a
+ *          parallel scan, which needs no warm-up.
+ *
+ * @param[in] path    The log to replay.
+ * @param[in] options The replay options.
+ * @param[in] jobs    The largest number of threads to use for chunks or
+ *                    gyroscope integration.
+ * @return            The outcome of the replay.
+ */
+ReplayResult replayFile(const std::string &path, const ReplayOptions &options,
+                        const unsigned int jobs)
+{
+    ReplayResult result;
+    result.input = path;
+    result.output = outputPath(path, options);
+
+    double start = seconds();
+    SensorLog log;
+    if (!log.load(path, options.channels()))
+    {
+        result.error = log.error();
+        return result;
+    }
+    result.loadSeconds = seconds() - start;
+
+    std::vector<Quaternion> q(log.size());
+    if (!q.empty())
+    {
+        // Gyroscope integration starts level when aligned
+        Quaternion initial;
+        if (options.align)
+        {
+            IMUFilter level;
+            level.align(log.sample(0)[3], log.sample(0)[4], log.sample(0)[5]);
+            initial = level.orientation();
+        }
+
+        start = seconds();
+        if (FILTER_GYRO == options.filter)
+        {
+            integrateGyro(log, options.rate, initial, jobs, &q[0]);
+        }
+        else if (options.chunks > 1)
+        {
+            runChunked(log, options, jobs, &q[0]);
+        }
+        else
+        {
+            runFilter(log, options, 0, 0, log.size(), &q[0]);
+        }
+        result.filterSeconds = seconds() - start;
+
+        if (options.verify)
+        {
+            std::vector<Quaternion> serial(log.size());
+            if (FILTER_GYRO == options.filter)
+            {
+                integrateGyroSerial(log, options.rate, initial, &serial[0]);
+            }
+            else
+            {
+                // Keep the reference run out of the update histogram
+                ReplayOptions reference = options;
+                reference.histogram = 0;
+                runFilter(log, reference, 0, 0, log.size(), &serial[0]);
+            }
+            result.maxDeviation = 0.0;
+            for (size_t i = 0; i < q.size(); ++i)
+            {
+                const Quaternion d = serial[i].conjugate() * q[i];
+                const double v = sqrt((d.x * d.x) + (d.y * d.y) + (d.z * d.z));
+                const double angle = 2.0 * atan2(v, fabs(d.w));
+                result.maxDeviation = (angle > result.maxDeviation) ? angle : result.maxDeviation;
+            }
+        }
+    }
+    result.samples = log.size();
+
+    start = seconds();
+    writeOrientations(result.output, log, q, options.format, result.error);
+    result.writeSeconds = seconds() - start;
+    return result;
+}
+
+/**
+ * @brief   Reads a monotonic clock.
+ *
+ * @return The current time in seconds from an arbitrary epoch.
+ */
+double seconds()
+{
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
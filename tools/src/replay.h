@@ -0,0 +1,116 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  replay.h
+ * @brief Runs the Fusion filters over recorded sensor logs.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "latency_histogram.h"
+#include "quaternion.h"
+#include "sensor_log.h"
+
+/**
+ * @brief The filters which can be replayed.
+ */
+enum FilterType
+{
+    FILTER_IMU, /**< IMUFilter, six channels per sample */
+    FILTER_MARG, /**< MARGFilter, nine channels per sample */
+    FILTER_GYRO  /**< Gyroscope integration only, six channels per sample */
+};
+
+/**
+ * @brief The formats orientation output can be written in.
+ */
+enum OutputFormat
+{
+    OUTPUT_CSV,   /**< Text lines of t,w,x,y,z */
+    OUTPUT_BINARY,/**< Little endian records of t as a double and w,x,y,z
+                       as floats */
+    OUTPUT_STREAM /**< QuaternionStreamEncoder stream, no timestamps */
+};
+
+/**
+ * @brief Settings shared by every replayed log.
+ */
+struct ReplayOptions
+{
+    ReplayOptions();
+    size_t channels() const;
+
+    FilterType filter;       /**< The filter to run */
+    float gyroError;         /**< Gyroscope error in rad/s */
+    float gyroDrift;         /**< Gyroscope drift in rad/s/s, MARG only */
+    float rate;              /**< Fixed sample rate in Hz, or zero to use the
+                                  log timestamps */
+    OutputFormat format;     /**< Format of the orientation output */
+    std::string outputDir;   /**< Directory output files are written to */
+    bool align;              /**< Align the filter with the first sample it
+                                  sees instead of starting from identity */
+    size_t chunks;           /**< Number of chunks each log is split into */
+    float warmup;            /**< Seconds of samples filtered before each
+                                  chunk and then discarded */
+    bool verify;             /**< Compare chunked output with a serial run */
+    LatencyHistogram *histogram; /**< Records the duration of every filter
+                                      update when not null */
+};
+
+/**
+ * @brief Outcome of replaying a single log.
+ */
+struct ReplayResult
+{
+    ReplayResult();
+
+    std::string input;    /**< The log which was replayed */
+    std::string output;   /**< The orientation file which was written */
+    std::string error;    /**< Why the replay failed, empty on success */
+    size_t samples;       /**< Number of samples filtered */
+    double loadSeconds;   /**< Time spent loading the log */
+    double filterSeconds; /**< Time spent in filter updates */
+    double writeSeconds;  /**< Time spent writing the output */
+    double maxDeviation;  /**< Largest angle in radians between chunked and
+                               serial output, negative if not verified */
+};
+
+void runFilter(const SensorLog &log, const ReplayOptions &options,
+               const size_t start, const size_t begin, const size_t end,
+               Quaternion *out);
+void runChunked(const SensorLog &log, const ReplayOptions &options,
+                const unsigned int jobs, Quaternion *out);
+bool writeOrientations(const std::string &path, const SensorLog &log,
+                       const std::vector<Quaternion> &q,
+                       const OutputFormat format, std::string &error);
+std::string outputPath(const std::string &input, const ReplayOptions &options);
+ReplayResult replayFile(const std::string &path, const ReplayOptions &options,
+                        const unsigned int jobs);
+double seconds();
+
+#endif // REPLAY_H
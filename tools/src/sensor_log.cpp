@@ -0,0 +1,301 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  sensor_log.cpp
+ * @brief Sensor log implementation.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sensor_log.h"
+
+namespace
+{
+
+/**
+ * @brief Reads a whole file into memory.
+ */
+bool readFile(const std::string &path, std::string &contents)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+    char chunk[65536];
+    size_t n;
+    contents.clear();
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        contents.append(chunk, n);
+    }
+    const bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+/**
+ * @brief Reads a little endian 32 bit float.
+ */
+inline float loadFloat(const char *in)
+{
+    uint32_t bits = 0;
+    for (int b = 0; b < 4; ++b)
+    {
+        bits |= static_cast<uint32_t>(static_cast<uint8_t>(in[b])) << (8 * b);
+    }
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+/**
+ * @brief Reads a little endian 64 bit double.
+ */
+inline double loadDouble(const char *in)
+{
+    uint64_t bits = 0;
+    for (int b = 0; b < 8; ++b)
+    {
+        bits |= static_cast<uint64_t>(static_cast<uint8_t>(in[b])) << (8 * b);
+    }
+    double value;
+    memcpy(&value, &bits, 8);
+    return value;
+}
+
+/**
+ * @brief Tests whether a string ends with a suffix.
+ */
+bool endsWith(const std::string &s, const char *suffix)
+{
+    const size_t n = strlen(suffix);
+    return (s.size() >= n) && (0 == s.compare(s.size() - n, n, suffix));
+}
+
+} // namespace
+
+/**
+ * @brief   Default constructor.
+ * @details Creates an empty log.
+ */
+SensorLog::SensorLog() :
+    width(0)
+{
+}
+
+/**
+ * @brief   Loads a log file.
+ * @details Replaces the contents of the log with the samples in a file. The
+ *          format is chosen from the file name. A CSV log with nine channels
+ *          is accepted when six are requested, and channels() then reports
+ *          nine; the first six channels are the same either way.
+ *
+ * @param[in] path     The file to load.
+ * @param[in] channels The number of channels per sample, either 6 or 9.
+ * @retval true  If the file was loaded.
+ * @retval false If the file could not be read or is malformed. The reason is
+ *               available from error().
+ * @return       Whether the file was loaded.
+ */
+bool SensorLog::load(const std::string &path, const size_t channels)
+{
+    width = channels;
+    t.clear();
+    data.clear();
+    message.clear();
+    return endsWith(path, ".bin") ? loadBinary(path) : loadCsv(path);
+}
+
+/**
+ * @brief   Gets the reason the last load failed.
+ *
+ * @return A description of the failure, or an empty string.
+ */
+const std::string &SensorLog::error() const
+{
+    return message;
+}
+
+/**
+ * @brief   Gets the number of channels per sample.
+ *
+ * @return Either 6 or 9.
+ */
+size_t SensorLog::channels() const
+{
+    return width;
+}
+
+/**
+ * @brief   Gets the number of samples.
+ *
+ * @return The number of samples in the log.
+ */
+size_t SensorLog::size() const
+{
+    return t.size();
+}
+
+/**
+ * @brief   Gets the timestamp of a sample.
+ *
+ * @param[in] index The index of the sample.
+ * @return          The timestamp in seconds.
+ */
+double SensorLog::time(const size_t index) const
+{
+    return t[index];
+}
+
+/**
+ * @brief   Gets the channels of a sample.
+ *
+ * @param[in] index The index of the sample.
+ * @return          A pointer to channels() consecutive values.
+ */
+const float *SensorLog::sample(const size_t index) const
+{
+    return &data[index * width];
+}
+
+/**
+ * @brief   Gets the time between a sample and the one before it.
+ * @details The first sample uses the interval to the second sample.
+ *
+ * @param[in] index The index of the sample.
+ * @return          The interval in seconds, or zero if it is unknown.
+ */
+float SensorLog::interval(const size_t index) const
+{
+    if (index > 0)
+    {
+        return static_cast<float>(t[index] - t[index - 1]);
+    }
+    return (t.size() > 1) ? static_cast<float>(t[1] - t[0]) : 0.0f;
+}
+
+/**
+ * @brief Loads a CSV log.
+ */
+bool SensorLog::loadCsv(const std::string &path)
+{
+    std::string contents;
+    if (!readFile(path, contents))
+    {
+        message = "cannot read " + path;
+        return false;
+    }
+
+    const char *p = contents.c_str();
+    size_t line = 0;
+    while (*p)
+    {
+        ++line;
+        const char *end = strchr(p, '\n');
+        if (!end)
+        {
+            end = p + strlen(p);
+        }
+
+        const char c = *p;
+        if (((c >= '0') && (c <= '9')) || (c == '-') || (c == '+') || (c == '.'))
+        {
+            double values[11];
+            size_t n = 0;
+            const char *field = p;
+            while ((n < 11) && (field < end))
+            {
+                char *next;
+                values[n] = strtod(field, &next);
+                if (next == field)
+                {
+                    break;
+                }
+                ++n;
+                field = next;
+                while ((field < end) && ((*field == ',') || (*field == ' ') || (*field == '\t') || (*field == '\r')))
+                {
+                    ++field;
+                }
+            }
+
+            // A log with a magnetometer can feed filters which ignore it
+            if (t.empty() && (6 == width) && (10 == n))
+            {
+                width = 9;
+            }
+            const size_t expected = width + 1;
+            if ((n != expected) || (field != end))
+            {
+                char buffer[64];
+                snprintf(buffer, sizeof(buffer), ":%lu: expected %lu values",
+                         static_cast<unsigned long>(line), static_cast<unsigned long>(expected));
+                message = path + buffer;
+                return false;
+            }
+            t.push_back(values[0]);
+            data.insert(data.end(), values + 1, values + expected);
+        }
+
+        p = *end ? end + 1 : end;
+    }
+    return true;
+}
+
+/**
+ * @brief Loads a binary log.
+ */
+bool SensorLog::loadBinary(const std::string &path)
+{
+    std::string contents;
+    if (!readFile(path, contents))
+    {
+        message = "cannot read " + path;
+        return false;
+    }
+
+    const size_t record = 8 + (width * 4);
+    if (0 != (contents.size() % record))
+    {
+        message = path + ": size is not a multiple of the record size";
+        return false;
+    }
+
+    const size_t count = contents.size() / record;
+    t.resize(count);
+    data.resize(count * width);
+    const char *p = contents.data();
+    for (size_t i = 0; i < count; ++i, p += record)
+    {
+        t[i] = loadDouble(p);
+        for (size_t c = 0; c < width; ++c)
+        {
+            data[(i * width) + c] = loadFloat(p + 8 + (4 * c));
+        }
+    }
+    return true;
+}
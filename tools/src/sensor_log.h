@@ -0,0 +1,76 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013, 2014 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ * @file  sensor_log.h
+ * @brief Recorded sensor data loaded from CSV or binary log files.
+ */
+
+#ifndef SENSOR_LOG_H
+#define SENSOR_LOG_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief   Sensor log.
+ * @details Holds a recording of timestamped sensor samples in memory. Each
+ *          sample has either six channels (gyroscope then accelerometer) or
+ *          nine channels (gyroscope, accelerometer then magnetometer), in the
+ *          same order and units as the filter update() arguments.
+ *
+ *          Two file formats are understood:
+ *          - CSV files, where each line holds a timestamp in seconds followed
+ *            by the channels. Lines which do not start with a number, such
+ *            as a header, are skipped.
+ *          - Binary files (any name ending in .bin), which are a sequence of
+ *            records each holding the timestamp as a little endian 64 bit
+ *            double followed by the channels as little endian 32 bit floats.
+ *
+ *          Timestamps are kept as doubles, since a float cannot tell samples
+ *          apart once a log is more than a few hours long.
+ */
+class SensorLog
+{
+public:
+    SensorLog();
+    bool load(const std::string &path, const size_t channels);
+    const std::string &error() const;
+    size_t channels() const;
+    size_t size() const;
+    double time(const size_t index) const;
+    const float *sample(const size_t index) const;
+    float interval(const size_t index) const;
+
+private:
+    bool loadCsv(const std::string &path);
+    bool loadBinary(const std::string &path);
+
+    size_t width;            /**< Number of channels per sample */
+    std::vector<double> t;   /**< Timestamp of each sample in seconds */
+    std::vector<float> data; /**< Channels of every sample, interleaved */
+    std::string message;     /**< Description of the last load failure */
+};
+
+#endif // SENSOR_LOG_H
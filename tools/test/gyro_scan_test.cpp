@@ -0,0 +1,96 @@
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gyro_scan.h"
+#include "log_files.h"
+#include "sensor_log.h"
+
+namespace
+{
+
+// Small rotations about axes which change from one to the next, so the
+// products depend on their order
+std::vector<Quaternion> increments(const size_t count)
+{
+    std::vector<Quaternion> q(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        q[i] = Quaternion::fromRotationVector(0.03f * sin(0.7f * i), 0.02f * cos(0.3f * i),
+                                              0.01f * (1.0f + (i % 5)));
+    }
+    return q;
+}
+
+// Checks a scan against the products taken one at a time
+void expectPrefixProducts(const size_t count, const unsigned int jobs)
+{
+    const std::vector<Quaternion> dq = increments(count);
+    std::vector<Quaternion> q = dq;
+    prefixProduct(q.empty() ? 0 : &q[0], count, jobs);
+
+    Quaternion expected;
+    for (size_t i = 0; i < count; ++i)
+    {
+        expected = (expected * dq[i]).normalized();
+        EXPECT_NEAR(expected.w, q[i].w, 1.0e-5f) << "count " << count << " jobs " << jobs << " at " << i;
+        EXPECT_NEAR(expected.x, q[i].x, 1.0e-5f) << "count " << count << " jobs " << jobs << " at " << i;
+        EXPECT_NEAR(expected.y, q[i].y, 1.0e-5f) << "count " << count << " jobs " << jobs << " at " << i;
+        EXPECT_NEAR(expected.z, q[i].z, 1.0e-5f) << "count " << count << " jobs " << jobs << " at " << i;
+    }
+}
+
+} // namespace
+
+TEST(GyroScanTest, PrefixProductSizes)
+{
+    // Around the eight lanes of a chunk and the chunks of the threads
+    const size_t counts[] = { 0, 1, 2, 7, 8, 9, 15, 17, 63, 64, 65, 1000, 1001 };
+    const unsigned int jobs[] = { 0, 1, 3, 8 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        for (size_t j = 0; j < sizeof(jobs) / sizeof(jobs[0]); ++j)
+        {
+            expectPrefixProducts(counts[c], jobs[j]);
+        }
+    }
+}
+
+TEST(GyroScanTest, MatchesSerialIntegration)
+{
+    const float channels[6] = { 0.4f, -0.2f, 0.9f, 0.0f, 0.0f, 1.0f };
+    const std::string path = tempPath("gyro.csv");
+    ASSERT_TRUE(writeCsvLog(path, 5000, 0.0, 100.0, channels, 6));
+    SensorLog log;
+    ASSERT_TRUE(log.load(path, 6)) << log.error();
+    remove(path.c_str());
+
+    const Quaternion initial = Quaternion::fromRotationVector(0.1f, 0.2f, 0.3f);
+    std::vector<Quaternion> parallel(log.size());
+    std::vector<Quaternion> reference(log.size());
+    integrateGyro(log, 100.0f, initial, 4, &parallel[0]);
+    integrateGyroSerial(log, 100.0f, initial, &reference[0]);
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        EXPECT_NEAR(1.0f, fabs(parallel[i].dot(reference[i])), 1.0e-5f) << "at " << i;
+    }
+}
+
+TEST(GyroScanTest, EmptyAndSingleSample)
+{
+    SensorLog log;
+    integrateGyro(log, 100.0f, Quaternion(), 4, 0);
+
+    const float channels[6] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    const std::string path = tempPath("single.csv");
+    ASSERT_TRUE(writeCsvLog(path, 1, 0.0, 100.0, channels, 6));
+    ASSERT_TRUE(log.load(path, 6)) << log.error();
+    remove(path.c_str());
+
+    Quaternion parallel;
+    Quaternion reference;
+    integrateGyro(log, 100.0f, Quaternion(), 4, &parallel);
+    integrateGyroSerial(log, 100.0f, Quaternion(), &reference);
+    EXPECT_NEAR(1.0f, parallel.dot(reference), 1.0e-6f);
+    EXPECT_NEAR(0.005f, parallel.x, 1.0e-6f);
+}
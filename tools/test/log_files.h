@@ -0,0 +1,79 @@
+#ifndef LOG_FILES_H
+#define LOG_FILES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+// Path of a scratch file, unique to this process, in the temporary directory
+inline std::string tempPath(const std::string &name)
+{
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "/fusion-tools-test-%ld-", static_cast<long>(getpid()));
+    return P_tmpdir + std::string(prefix) + name;
+}
+
+// Writes text to a file, replacing it
+inline bool writeText(const std::string &path, const std::string &text)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        return false;
+    }
+    const bool ok = (text.size() == fwrite(text.data(), 1, text.size(), file));
+    return (0 == fclose(file)) && ok;
+}
+
+// Appends the bytes of a value in little endian order
+template <typename T, typename Bits>
+void appendLittleEndian(std::string &bytes, const T value)
+{
+    Bits bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (size_t b = 0; b < sizeof(bits); ++b)
+    {
+        bytes += static_cast<char>(bits >> (8 * b));
+    }
+}
+
+// Writes a binary log of a double timestamp and the channels of each sample
+inline bool writeBinaryLog(const std::string &path, const std::vector<double> &t,
+                           const std::vector<float> &channels, const size_t width)
+{
+    std::string bytes;
+    for (size_t i = 0; i < t.size(); ++i)
+    {
+        appendLittleEndian<double, uint64_t>(bytes, t[i]);
+        for (size_t c = 0; c < width; ++c)
+        {
+            appendLittleEndian<float, uint32_t>(bytes, channels[(i * width) + c]);
+        }
+    }
+    return writeText(path, bytes);
+}
+
+// Writes a CSV log of samples taken at a fixed rate, all with the same
+// gyroscope, accelerometer and, when nine channels are given, magnetometer
+inline bool writeCsvLog(const std::string &path, const size_t count, const double start,
+                        const double rate, const float *channels, const size_t width)
+{
+    std::string text = "t,gx,gy,gz,ax,ay,az\n";
+    char line[256];
+    for (size_t i = 0; i < count; ++i)
+    {
+        int n = snprintf(line, sizeof(line), "%.6f", start + (i / rate));
+        for (size_t c = 0; c < width; ++c)
+        {
+            n += snprintf(line + n, sizeof(line) - n, ",%.6f", channels[c]);
+        }
+        text += line;
+        text += "\n";
+    }
+    return writeText(path, text);
+}
+
+#endif // LOG_FILES_H
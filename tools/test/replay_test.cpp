@@ -0,0 +1,163 @@
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "log_files.h"
+#include "replay.h"
+#include "sensor_log.h"
+
+namespace
+{
+
+// Loads a log of a body turning back and forth at 100 Hz, so that the
+// filter output depends on where a run starts
+bool turningLog(SensorLog &log, const size_t count)
+{
+    std::string text = "t,gx,gy,gz,ax,ay,az\n";
+    char line[128];
+    for (size_t i = 0; i < count; ++i)
+    {
+        snprintf(line, sizeof(line), "%.2f,%.4f,%.4f,0.1,0.1,%.4f,1.0\n",
+                 0.01 * i, sin(0.05 * i), cos(0.03 * i), 0.2 * sin(0.02 * i));
+        text += line;
+    }
+    const std::string path = tempPath("turning.csv");
+    const bool ok = writeText(path, text) && log.load(path, 6);
+    remove(path.c_str());
+    return ok;
+}
+
+// Runs a log serially from its first sample
+std::vector<Quaternion> serial(const SensorLog &log, const ReplayOptions &options)
+{
+    std::vector<Quaternion> out(log.size());
+    runFilter(log, options, 0, 0, log.size(), &out[0]);
+    return out;
+}
+
+} // namespace
+
+TEST(ReplayTest, ChunkStartsAtWarmup)
+{
+    SensorLog log;
+    ASSERT_TRUE(turningLog(log, 400));
+    ReplayOptions options;
+    options.chunks = 2;
+    options.warmup = 0.05f;
+    std::vector<Quaternion> chunked(log.size());
+    runChunked(log, options, 2, &chunked[0]);
+
+    // The first chunk has nothing before it and the second starts its
+    // filter five samples, 50 ms, before its first output
+    const std::vector<Quaternion> reference = serial(log, options);
+    std::vector<Quaternion> second(200);
+    runFilter(log, options, 195, 200, 400, &second[0]);
+    for (size_t i = 0; i < 200; ++i)
+    {
+        EXPECT_EQ(reference[i], chunked[i]);
+        EXPECT_EQ(second[i], chunked[200 + i]);
+    }
+
+    // With a fixed rate the warm-up is counted in samples
+    options.rate = 50.0f;
+    runChunked(log, options, 2, &chunked[0]);
+    runFilter(log, options, 198, 200, 400, &second[0]);
+    EXPECT_EQ(second[0], chunked[200]);
+    EXPECT_EQ(second[199], chunked[399]);
+}
+
+TEST(ReplayTest, WarmupPastStart)
+{
+    SensorLog log;
+    ASSERT_TRUE(turningLog(log, 300));
+    ReplayOptions options;
+    options.chunks = 3;
+    options.warmup = 1000.0f;
+    const std::vector<Quaternion> reference = serial(log, options);
+    std::vector<Quaternion> chunked(log.size());
+
+    // Every chunk starts its filter at the first sample
+    runChunked(log, options, 3, &chunked[0]);
+    EXPECT_EQ(reference, chunked);
+
+    options.rate = 100.0f;
+    runChunked(log, options, 3, &chunked[0]);
+    EXPECT_EQ(serial(log, options), chunked);
+}
+
+TEST(ReplayTest, ChunksBeyondSamples)
+{
+    SensorLog log;
+    ASSERT_TRUE(turningLog(log, 5));
+    ReplayOptions options;
+    options.chunks = 16;
+    options.warmup = 0.0f;
+    std::vector<Quaternion> chunked(log.size());
+    runChunked(log, options, 8, &chunked[0]);
+    EXPECT_EQ(serial(log, options), chunked);
+}
+
+TEST(ReplayTest, EmptyAndSingleSample)
+{
+    SensorLog log;
+    ReplayOptions options;
+    options.chunks = 4;
+    runChunked(log, options, 4, 0);
+
+    ASSERT_TRUE(turningLog(log, 1));
+    Quaternion q(0.0f, 0.0f, 0.0f, 0.0f);
+    runChunked(log, options, 4, &q);
+    EXPECT_EQ(serial(log, options)[0], q);
+}
+
+TEST(ReplayTest, OutputPath)
+{
+    ReplayOptions options;
+    options.outputDir = "out";
+    EXPECT_EQ("out/run.orientation.csv", outputPath("logs/run.csv", options));
+    EXPECT_EQ("out/run.orientation.csv", outputPath("run", options));
+    EXPECT_EQ("out/x.tar.orientation.csv", outputPath("x.tar.gz", options));
+    EXPECT_EQ("out/.hidden.orientation.csv", outputPath("a.b/.hidden", options));
+    EXPECT_EQ("out/c.orientation.csv", outputPath("a.b/c", options));
+
+    options.format = OUTPUT_BINARY;
+    EXPECT_EQ("out/run.orientation.bin", outputPath("run.bin", options));
+    options.format = OUTPUT_STREAM;
+    EXPECT_EQ("out/run.orientation.qs", outputPath("/data/run.csv", options));
+}
+
+TEST(ReplayTest, BinaryOutputLittleEndian)
+{
+    const std::string input = tempPath("one.csv");
+    ASSERT_TRUE(writeText(input, "2,0,0,0,0,0,1\n"));
+    SensorLog log;
+    ASSERT_TRUE(log.load(input, 6));
+    remove(input.c_str());
+
+    const std::string output = tempPath("one.orientation.bin");
+    const std::vector<Quaternion> q(1, Quaternion(0.5f, 0.0f, 0.0f, -1.0f));
+    std::string error;
+    ASSERT_TRUE(writeOrientations(output, log, q, OUTPUT_BINARY, error)) << error;
+    FILE *file = fopen(output.c_str(), "rb");
+    ASSERT_TRUE(file != 0);
+    unsigned char bytes[32];
+    const size_t size = fread(bytes, 1, sizeof(bytes), file);
+    fclose(file);
+    remove(output.c_str());
+
+    // A double timestamp of 2.0 and the floats 0.5, 0, 0 and -1
+    const unsigned char expected[8 + (4 * 4)] =
+    {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40,
+        0x00, 0x00, 0x00, 0x3f,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x80, 0xbf
+    };
+    ASSERT_EQ(sizeof(expected), size);
+    for (size_t b = 0; b < size; ++b)
+    {
+        EXPECT_EQ(expected[b], bytes[b]) << "at byte " << b;
+    }
+}
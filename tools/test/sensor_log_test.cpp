@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "log_files.h"
+#include "sensor_log.h"
+
+TEST(SensorLogTest, Csv)
+{
+    const std::string path = tempPath("six.csv");
+    ASSERT_TRUE(writeText(path, "t,gx,gy,gz,ax,ay,az\n"
+                                "0.00,0.1,0.2,0.3,0.0,0.0,1.0\n"
+                                "0.01, 0.4, 0.5, 0.6, 0.0, 1.0, 0.0\r\n"
+                                "0.03\t-1\t-2\t-3\t1\t0\t0"));
+    SensorLog log;
+    ASSERT_TRUE(log.load(path, 6)) << log.error();
+    remove(path.c_str());
+
+    EXPECT_TRUE(log.error().empty());
+    EXPECT_EQ(6u, log.channels());
+    ASSERT_EQ(3u, log.size());
+    EXPECT_DOUBLE_EQ(0.01, log.time(1));
+    EXPECT_FLOAT_EQ(0.5f, log.sample(1)[1]);
+    EXPECT_FLOAT_EQ(-3.0f, log.sample(2)[2]);
+    EXPECT_FLOAT_EQ(1.0f, log.sample(2)[3]);
+    EXPECT_NEAR(0.01f, log.interval(0), 1.0e-6f);
+    EXPECT_NEAR(0.02f, log.interval(2), 1.0e-6f);
+}
+
+TEST(SensorLogTest, CsvNineChannelsForSix)
+{
+    const std::string path = tempPath("nine.csv");
+    ASSERT_TRUE(writeText(path, "0,1,2,3,4,5,6,7,8,9\n1,1,2,3,4,5,6,7,8,9\n"));
+    SensorLog log;
+    ASSERT_TRUE(log.load(path, 6)) << log.error();
+    remove(path.c_str());
+
+    EXPECT_EQ(9u, log.channels());
+    ASSERT_EQ(2u, log.size());
+    EXPECT_FLOAT_EQ(9.0f, log.sample(1)[8]);
+}
+
+TEST(SensorLogTest, CsvMalformed)
+{
+    const std::string path = tempPath("bad.csv");
+    ASSERT_TRUE(writeText(path, "t,gx,gy,gz,ax,ay,az\n0,0,0,0,0,0,1\n1,0,0,0,0,0\n"));
+    SensorLog log;
+    EXPECT_FALSE(log.load(path, 6));
+    remove(path.c_str());
+    EXPECT_NE(std::string::npos, log.error().find(":3: expected 7 values"));
+
+    EXPECT_FALSE(log.load(tempPath("missing.csv"), 6));
+    EXPECT_NE(std::string::npos, log.error().find("cannot read"));
+}
+
+TEST(SensorLogTest, EmptyAndSingleSample)
+{
+    const std::string path = tempPath("short.csv");
+    SensorLog log;
+    ASSERT_TRUE(writeText(path, "t,gx,gy,gz,ax,ay,az\n"));
+    ASSERT_TRUE(log.load(path, 6));
+    EXPECT_EQ(0u, log.size());
+
+    ASSERT_TRUE(writeText(path, "5,0,0,0,0,0,1\n"));
+    ASSERT_TRUE(log.load(path, 6));
+    remove(path.c_str());
+    ASSERT_EQ(1u, log.size());
+    EXPECT_DOUBLE_EQ(5.0, log.time(0));
+    EXPECT_EQ(0.0f, log.interval(0));
+}
+
+TEST(SensorLogTest, LongTimestamps)
+{
+    // A day into a recording a float timestamp only resolves 8 ms
+    const double start = 86400.0;
+    const float channels[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    const std::string path = tempPath("long.csv");
+    ASSERT_TRUE(writeCsvLog(path, 100, start, 1000.0, channels, 6));
+    SensorLog log;
+    ASSERT_TRUE(log.load(path, 6)) << log.error();
+    remove(path.c_str());
+
+    ASSERT_EQ(100u, log.size());
+    EXPECT_NEAR(start + 0.099, log.time(99), 1.0e-9);
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        EXPECT_NEAR(0.001f, log.interval(i), 1.0e-6f);
+    }
+}
+
+TEST(SensorLogTest, Binary)
+{
+    const std::vector<double> t = { 86400.0, 86400.001, 86400.002 };
+    std::vector<float> channels(t.size() * 9);
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        channels[i] = 0.5f * i;
+    }
+    const std::string path = tempPath("log.bin");
+    ASSERT_TRUE(writeBinaryLog(path, t, channels, 9));
+    SensorLog log;
+    ASSERT_TRUE(log.load(path, 9)) << log.error();
+
+    ASSERT_EQ(3u, log.size());
+    EXPECT_EQ(9u, log.channels());
+    EXPECT_EQ(t[2], log.time(2));
+    EXPECT_NEAR(0.001f, log.interval(1), 1.0e-6f);
+    EXPECT_EQ(channels[13], log.sample(1)[4]);
+
+    // A truncated record is rejected
+    ASSERT_TRUE(writeText(path, std::string(8 + (9 * 4) + 1, '\0')));
+    EXPECT_FALSE(log.load(path, 9));
+    remove(path.c_str());
+    EXPECT_NE(std::string::npos, log.error().find("record size"));
+}
+
+TEST(SensorLogTest, BinaryLittleEndian)
+{
+    // A timestamp of 2.0 then the six channels 0.5, 0, 0, 0, 0 and -1
+    const unsigned char bytes[8 + (6 * 4)] =
+    {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40,
+        0x00, 0x00, 0x00, 0x3f,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x80, 0xbf
+    };
+    const std::string path = tempPath("bytes.bin");
+    ASSERT_TRUE(writeText(path, std::string(reinterpret_cast<const char *>(bytes), sizeof(bytes))));
+    SensorLog log;
+    ASSERT_TRUE(log.load(path, 6)) << log.error();
+    remove(path.c_str());
+
+    ASSERT_EQ(1u, log.size());
+    EXPECT_EQ(2.0, log.time(0));
+    EXPECT_EQ(0.5f, log.sample(0)[0]);
+    EXPECT_EQ(-1.0f, log.sample(0)[5]);
+}